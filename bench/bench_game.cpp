@@ -0,0 +1,282 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Game state microbenchmarks. Builds lobby populations of increasing size and
+ * times the game:: state API against them, single threaded and with many
+ * contending threads, reporting throughput and per-call latency percentiles.
+ *
+ * Usage: rps_bench [lobbies,lobbies,...] [threads]
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <rps/core/rules.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
+#include <rps/domain/game.h>
+#include <rps/domain/mock_sink.h>
+#include <rps/domain/outbound.h>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+/**
+ * @brief Total lobby visits a scan benchmark may make per thread; keeps the
+ * linear scans at 1M lobbies from running for minutes
+ */
+constexpr size_t scan_budget = 20'000'000;
+
+struct result {
+  double ops_per_sec{0};
+  int64_t p50_ns{0};
+  int64_t p99_ns{0};
+};
+
+/**
+ * @brief Time `ops` calls of op(rng, thread) on each of `threads` threads,
+ * all released at once
+ */
+template <typename Op> result run(size_t threads, size_t ops, Op op) {
+  std::vector<std::vector<int64_t>> latencies(threads);
+  std::atomic<size_t> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      std::mt19937_64 rng(t + 1);
+      auto &samples = latencies[t];
+      samples.reserve(ops);
+      ready++;
+      while (!go.load()) {
+        std::this_thread::yield();
+      }
+      for (size_t i = 0; i < ops; ++i) {
+        const auto start = bench_clock::now();
+        op(rng, t);
+        samples.push_back((bench_clock::now() - start).count());
+      }
+    });
+  }
+  while (ready.load() < threads) {
+    std::this_thread::yield();
+  }
+  const auto start = bench_clock::now();
+  go = true;
+  for (auto &worker : workers) {
+    worker.join();
+  }
+  const std::chrono::duration<double> elapsed = bench_clock::now() - start;
+
+  std::vector<int64_t> all;
+  all.reserve(threads * ops);
+  for (const auto &samples : latencies) {
+    all.insert(all.end(), samples.begin(), samples.end());
+  }
+  std::sort(all.begin(), all.end());
+  return {.ops_per_sec = static_cast<double>(all.size()) / elapsed.count(),
+          .p50_ns = all[all.size() / 2],
+          .p99_ns = all[std::min(all.size() - 1, all.size() * 99 / 100)]};
+}
+
+void report(const char *name, size_t lobbies, size_t threads,
+            const result &r) {
+  std::printf("%-24s %9zu %7zu %14.0f %12lld %12lld\n", name, lobbies, threads,
+              r.ops_per_sec, static_cast<long long>(r.p50_ns),
+              static_cast<long long>(r.p99_ns));
+  std::fflush(stdout);
+}
+
+uint64_t next_player_id{1};
+
+dpp::slashcommand_t player_event(uint64_t id) {
+  dpp::slashcommand_t event;
+  event.command.usr.id = id;
+  return event;
+}
+
+/**
+ * @brief A population of full lobbies
+ */
+struct population {
+  std::vector<unsigned int> lobbies;
+  uint64_t first_player{0};
+
+  explicit population(size_t count) : first_player(next_player_id) {
+    lobbies.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+      unsigned int lobby_id = game::create_lobby();
+      game::add_player_to_lobby(lobby_id, player_event(next_player_id++));
+      game::add_player_to_lobby(lobby_id, player_event(next_player_id++));
+      lobbies.push_back(lobby_id);
+    }
+  }
+
+  ~population() {
+    /* Removing from the front keeps teardown linear */
+    for (unsigned int lobby_id : lobbies) {
+      game::remove_lobby_from_queue(lobby_id, true);
+    }
+  }
+
+  population(const population &) = delete;
+  population &operator=(const population &) = delete;
+
+  uint64_t random_player(std::mt19937_64 &rng) const {
+    return first_player + rng() % (lobbies.size() * 2);
+  }
+
+  unsigned int random_lobby(std::mt19937_64 &rng) const {
+    return lobbies[rng() % lobbies.size()];
+  }
+};
+
+const char *const choices[] = {"Rock", "Paper", "Scissors"};
+const core::choice picks[] = {core::choice::rock, core::choice::paper,
+                              core::choice::scissors};
+
+void bench_size(size_t lobbies, size_t threads) {
+  population pop(lobbies);
+  const size_t scan_ops =
+      std::clamp<size_t>(scan_budget / lobbies, 20, 100'000);
+
+  report("find_player_lobby_id", lobbies, threads,
+         run(threads, scan_ops,
+             [&pop](std::mt19937_64 &rng, size_t /*unused*/) {
+               game::find_player_lobby_id(pop.random_player(rng));
+             }));
+
+  /* Every lobby is full, so this is the worst case full scan */
+  report("find_open_lobby_id", lobbies, threads,
+         run(threads, scan_ops,
+             [](std::mt19937_64 & /*unused*/, size_t /*unused*/) {
+               game::find_open_lobby_id();
+             }));
+
+  report("set_player_choice", lobbies, threads,
+         run(threads, scan_ops,
+             [&pop](std::mt19937_64 &rng, size_t /*unused*/) {
+               game::set_player_choice(pop.random_player(rng),
+                                       choices[rng() % 3]);
+             }));
+
+  /* create_lobby and add_player_to_lobby grow the population; remember what
+   * was added so it can be torn down afterwards */
+  std::vector<std::vector<unsigned int>> created(threads);
+  report("create_lobby", lobbies, threads,
+         run(threads, scan_ops, [&](std::mt19937_64 & /*unused*/, size_t t) {
+           created[t].push_back(game::create_lobby());
+         }));
+
+  std::vector<unsigned int> fresh;
+  for (const auto &ids : created) {
+    fresh.insert(fresh.end(), ids.begin(), ids.end());
+  }
+  std::atomic<size_t> next_fresh{0};
+  report("add_player_to_lobby", lobbies, threads,
+         run(threads, scan_ops,
+             [&](std::mt19937_64 & /*unused*/, size_t /*unused*/) {
+               const size_t i = next_fresh++;
+               game::add_player_to_lobby(fresh[i % fresh.size()],
+                                         player_event(next_player_id + i));
+             }));
+  next_player_id += fresh.size() + 1;
+  for (unsigned int lobby_id : fresh) {
+    game::remove_lobby_from_queue(lobby_id, true);
+  }
+
+  /* Everything handle_choice does to game state once both players have
+   * chosen, without the messaging */
+  report("round_resolution", lobbies, threads,
+         run(threads, std::max<size_t>(scan_ops / 8, 10),
+             [&pop](std::mt19937_64 &rng, size_t /*unused*/) {
+               const unsigned int lobby_id = pop.random_lobby(rng);
+               game::set_player_choice(game::get_player_id(lobby_id, 0),
+                                       choices[rng() % 3]);
+               game::set_player_choice(game::get_player_id(lobby_id, 1),
+                                       choices[rng() % 3]);
+               if (game::check_both_responses(lobby_id)) {
+                 const core::outcome result = game::determine_winner(lobby_id);
+                 if (result == core::outcome::player_one) {
+                   game::increment_player_score(lobby_id, 0);
+                 } else if (result == core::outcome::player_two) {
+                   game::increment_player_score(lobby_id, 1);
+                 }
+                 game::is_game_complete(lobby_id);
+                 game::increment_game_num(lobby_id);
+                 game::reset_choices(lobby_id);
+               }
+             }));
+}
+
+std::vector<size_t> parse_sizes(const char *arg) {
+  std::vector<size_t> sizes;
+  std::stringstream stream(arg);
+  std::string size;
+  while (std::getline(stream, size, ',')) {
+    sizes.push_back(std::stoull(size));
+  }
+  return sizes;
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  /* A very large first_to so round_resolution never finishes a match */
+  config::settings settings;
+  settings.first_to = 1'000'000;
+  config::init(settings);
+
+  /* Nothing is sent and no timer is started, but the game needs both */
+  outbound::mock_sink sink({});
+  outbound::set(sink);
+  timing::virtual_clock clock;
+  timing::set(clock);
+  game::init();
+
+  std::vector<size_t> sizes = argc > 1 ? parse_sizes(argv[1])
+                                       : std::vector<size_t>{1'000, 100'000,
+                                                             1'000'000};
+  const size_t contended =
+      argc > 2 ? std::stoull(argv[2])
+               : std::max<size_t>(4, std::thread::hardware_concurrency());
+
+  std::printf("%-24s %9s %7s %14s %12s %12s\n", "benchmark", "lobbies",
+              "threads", "ops/sec", "p50 ns", "p99 ns");
+
+  report("variant::resolve", 0, 1,
+         run(1, 1'000'000, [](std::mt19937_64 &rng, size_t /*unused*/) {
+           (void)core::classic.resolve(picks[rng() % 3], picks[rng() % 3]);
+         }));
+
+  for (size_t lobbies : sizes) {
+    bench_size(lobbies, 1);
+    bench_size(lobbies, contended);
+  }
+  return 0;
+}
@@ -0,0 +1,120 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace core {
+
+/**
+ * @brief Timer handle, the same type as dpp::timer
+ */
+using timer = size_t;
+
+/**
+ * @brief Timer callback, receives the timer's handle
+ */
+using timer_callback = std::function<void(timer)>;
+
+/**
+ * @brief Game time: the timestamps timeouts are measured against, and the
+ * timers that enforce them
+ */
+class clock {
+public:
+  virtual ~clock() = default;
+
+  /**
+   * @brief Monotonic time since an arbitrary epoch
+   */
+  [[nodiscard]] virtual std::chrono::nanoseconds now() const = 0;
+
+  /**
+   * @brief Seconds since the unix epoch
+   */
+  [[nodiscard]] virtual double unix_time() const = 0;
+
+  /**
+   * @brief Start a repeating timer
+   *
+   * @param on_tick callback, receives the timer handle
+   * @param seconds interval
+   * @return timer handle, never 0
+   */
+  virtual timer start_timer(timer_callback on_tick, uint64_t seconds) = 0;
+
+  /**
+   * @brief Stop a timer. Safe to call from the timer's own callback.
+   */
+  virtual void stop_timer(timer t) = 0;
+};
+
+/**
+ * @brief Time that only moves when advanced. Starts at 0, with unix_time()
+ * anchored to the wall clock at construction. Timers fire on the thread that
+ * advances the clock, in due order.
+ */
+class virtual_clock : public clock {
+public:
+  virtual_clock();
+
+  [[nodiscard]] std::chrono::nanoseconds now() const override;
+  [[nodiscard]] double unix_time() const override;
+  timer start_timer(timer_callback on_tick, uint64_t seconds) override;
+  void stop_timer(timer t) override;
+
+  /**
+   * @brief Move time forward, firing every timer that falls due on the way.
+   * Moving backwards is ignored.
+   *
+   * @param t time since the clock was created
+   */
+  void advance_to(std::chrono::nanoseconds t);
+
+  /**
+   * @brief Move time forward by a duration
+   */
+  void advance(std::chrono::nanoseconds by) { advance_to(now() + by); }
+
+  /**
+   * @brief Number of running timers
+   */
+  [[nodiscard]] size_t timers_pending() const;
+
+private:
+  struct timer_state {
+    timer_callback on_tick;
+    std::chrono::nanoseconds interval;
+    std::chrono::nanoseconds due;
+  };
+
+  double epoch;
+  mutable std::mutex mutex;
+  std::chrono::nanoseconds current{0};
+  timer next_timer{1};
+  std::map<timer, timer_state> timers;
+  std::set<std::pair<std::chrono::nanoseconds, timer>> due;
+};
+
+} // namespace core
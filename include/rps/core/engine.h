@@ -0,0 +1,239 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <optional>
+#include <rps/core/clock.h>
+#include <rps/core/rules.h>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace core {
+
+using player_id = uint64_t;
+using lobby_id = unsigned int;
+
+struct player {
+  player_id id{0};
+  choice pick{choice::none};
+  unsigned int score{0};
+  timer queue_timer{0};
+  /**
+   * @brief Unix time the queue timer fires, 0 if none is running
+   */
+  double queue_deadline{0};
+};
+
+struct lobby {
+  lobby_id id{0};
+  unsigned int game_number{1};
+  timer game_timer{0};
+  /**
+   * @brief Unix time the game timer fires, 0 if none is running
+   */
+  double game_deadline{0};
+  std::vector<player> players;
+
+  [[nodiscard]] bool full() const { return players.size() >= 2; }
+};
+
+/**
+ * @brief A settled round
+ */
+struct round_result {
+  outcome result{outcome::forfeit};
+  /**
+   * @brief The lobby as the round ended, picks included
+   */
+  lobby state;
+  bool match_over{false};
+};
+
+/**
+ * @brief Matchmaking, lobby state, scoring and match timers for one-on-one
+ * rock paper scissors. Lobby ids start at 1; 0 means no lobby. Lobbies and
+ * seated players are indexed, so finding either is O(1), and the oldest open
+ * lobby is found in O(1) from an ordered index of lobbies still waiting.
+ *
+ * Not synchronised: the caller serialises every call, including those made
+ * from timer callbacks, which fire on the clock's thread.
+ */
+class engine {
+public:
+  /**
+   * @param c clock the game timers run on
+   * @param v variant the rounds are played and resolved with
+   */
+  explicit engine(clock &c, const variant &v = classic) : time(c), game(v) {}
+
+  /**
+   * @brief The variant rounds are played with
+   */
+  [[nodiscard]] const variant &rules() const { return game; }
+
+  /**
+   * @brief Lobby the player is in, or 0
+   */
+  [[nodiscard]] lobby_id find_player_lobby(player_id p) const;
+
+  /**
+   * @brief Oldest lobby waiting for a second player, or 0
+   */
+  [[nodiscard]] lobby_id find_open_lobby() const;
+
+  /**
+   * @brief Create an empty lobby at the back of the queue
+   */
+  lobby_id create_lobby();
+
+  /**
+   * @brief Seat a player in a lobby
+   *
+   * @return false if the lobby does not exist or is full, or the player is
+   * already seated
+   */
+  bool add_player(lobby_id id, player_id p);
+
+  /**
+   * @brief Remove a lobby, stopping its timers. A lobby that never played is
+   * given its id back if it was the last one created.
+   *
+   * @param game_over true if the lobby played a match
+   * @return the removed lobby, if it existed
+   */
+  std::optional<lobby> remove_lobby(lobby_id id, bool game_over);
+
+  /**
+   * @brief Lobby by id, valid until the next call that adds or removes one
+   */
+  [[nodiscard]] const lobby *find(lobby_id id) const;
+
+  /**
+   * @brief Record a player's pick; a pick the variant does not have is
+   * ignored
+   */
+  void set_choice(player_id p, choice c);
+  [[nodiscard]] choice get_choice(player_id p) const;
+  void reset_choices(lobby_id id);
+
+  /**
+   * @brief Both seats are filled and both players have picked
+   */
+  [[nodiscard]] bool both_chosen(lobby_id id) const;
+
+  /**
+   * @brief Result of the current round from the picks made so far
+   */
+  [[nodiscard]] outcome determine_winner(lobby_id id) const;
+
+  void increment_score(lobby_id id, unsigned int index);
+  void increment_game(lobby_id id);
+
+  /**
+   * @brief Either player has reached first_to wins
+   */
+  [[nodiscard]] bool is_complete(lobby_id id, unsigned int first_to) const;
+
+  /**
+   * @brief Settle the current round in one step: stop the game timer and score
+   * it, then either remove the lobby if the match is over or move on to the
+   * next game with fresh picks
+   *
+   * @param first_to wins needed to take the match
+   * @param timed_out the round ran out of time, which ends the match
+   * @return the round, or nothing if the lobby does not exist, is not full, or
+   * (unless timed out) is still waiting on a pick
+   */
+  std::optional<round_result> resolve_round(lobby_id id, unsigned int first_to,
+                                            bool timed_out = false);
+
+  /**
+   * @brief Give a queued player until the timer fires to find an opponent,
+   * replacing any running queue timer. Fires once.
+   */
+  void start_queue_timer(player_id p, uint64_t seconds,
+                         std::function<void()> on_expire);
+  void clear_queue_timer(player_id p);
+
+  /**
+   * @brief Give a lobby until the timer fires to finish its round, replacing
+   * any running game timer. Fires once.
+   */
+  void start_game_timer(lobby_id id, uint64_t seconds,
+                        std::function<void()> on_expire);
+  void clear_game_timer(lobby_id id);
+
+  /**
+   * @brief Remove every lobby, stopping their timers, e.g. to hand them to
+   * another process. Lobbies come out in creation order, and keep their
+   * deadlines so the timers can be restarted elsewhere. Lobby numbering
+   * starts again from 1, so they can also be restored here.
+   */
+  std::vector<lobby> release_all();
+
+  /**
+   * @brief Adopt a lobby released by another engine, with no timers running;
+   * the caller restarts them from the deadlines. Lobbies must be restored in
+   * the order release_all() gave them.
+   *
+   * @return false if the id is not above every lobby id created so far, or
+   * one of its players is already seated
+   */
+  bool restore(lobby l);
+
+  /**
+   * @brief Id of the last lobby created
+   */
+  [[nodiscard]] lobby_id last_lobby_id() const { return next_id; }
+
+  [[nodiscard]] size_t lobby_count() const { return lobbies.size(); }
+  [[nodiscard]] size_t open_lobby_count() const { return open.size(); }
+  [[nodiscard]] size_t queue_timer_count() const { return queue_timers; }
+  [[nodiscard]] size_t game_timer_count() const { return game_timers; }
+
+private:
+  lobby *find_mutable(lobby_id id);
+  player *find_player(player_id p);
+  [[nodiscard]] const player *find_player(player_id p) const;
+  timer start_once(uint64_t seconds, std::function<void()> on_expire);
+
+  clock &time;
+  variant game;
+  lobby_id next_id{0};
+  std::list<lobby> lobbies;
+  std::unordered_map<lobby_id, std::list<lobby>::iterator> by_id;
+  /**
+   * @brief The lobby each seated player is in
+   */
+  std::unordered_map<player_id, lobby_id> seats;
+  /**
+   * @brief Lobbies waiting for a second player; ids rise in creation order,
+   * so the first is the oldest
+   */
+  std::set<lobby_id> open;
+  size_t queue_timers{0};
+  size_t game_timers{0};
+};
+
+} // namespace core
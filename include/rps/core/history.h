@@ -0,0 +1,154 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <rps/core/rules.h>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief A round from one player's side
+ */
+enum class result : uint8_t {
+  win,
+  loss,
+  draw,
+};
+
+/**
+ * @brief Aggregates over a player's rounds
+ */
+struct player_stats {
+  uint64_t rounds{0};
+  uint64_t wins{0};
+  uint64_t losses{0};
+  uint64_t draws{0};
+  uint64_t matches{0};
+  uint64_t matches_won{0};
+  /**
+   * @brief Rounds per pick, indexed by choice; none counts rounds timed out
+   */
+  std::array<uint64_t, max_choices + 1> picks{};
+  /**
+   * @brief Matches won in a row up to the latest (positive) or lost in a row
+   * (negative)
+   */
+  int64_t current_streak{0};
+  uint64_t longest_win_streak{0};
+  /**
+   * @brief Unix time of the latest round, 0 if none
+   */
+  double last_played{0};
+};
+
+/**
+ * @brief Per round match history in columns: a row per player per round, with
+ * player, opponent, pick, result, match end flag and time in separate arrays.
+ * Players are dictionary coded to 32 bits and rows are partitioned on the
+ * code, so looking a player up is a vectorised scan of one dense column of
+ * one partition (AVX2 where the CPU has it, else a scalar loop the compiler
+ * can vectorise), followed by gathers from the other columns for the matching
+ * rows only.
+ *
+ * Thread safe: appends take a unique lock and queries a shared one.
+ */
+class history {
+public:
+  /**
+   * @param capacity rows kept; when a partition fills its share, its oldest
+   * half is dropped
+   */
+  explicit history(size_t capacity = 10'000'000);
+
+  /**
+   * @brief Record a round as one row per player
+   *
+   * @param players seat order
+   * @param picks seat order, none if a player timed out
+   * @param round how the round ended
+   * @param time unix time
+   */
+  void record_round(const std::array<uint64_t, 2> &players,
+                    const std::array<choice, 2> &picks, outcome round,
+                    double time);
+
+  /**
+   * @brief Mark the most recently recorded round as the last of its match
+   */
+  void end_match();
+
+  /**
+   * @brief A player's aggregates over every round kept
+   */
+  [[nodiscard]] player_stats stats(uint64_t player) const;
+
+  /**
+   * @brief A player's aggregates over rounds against one opponent
+   */
+  [[nodiscard]] player_stats versus(uint64_t player, uint64_t opponent) const;
+
+  [[nodiscard]] size_t rows() const;
+
+  /**
+   * @brief Name of the scan kernel in use, e.g. avx2
+   */
+  static const char *kernel();
+
+private:
+  static constexpr uint32_t any_opponent = UINT32_MAX;
+  static constexpr size_t partitions = 64;
+
+  struct partition {
+    std::vector<uint32_t> player_column;
+    std::vector<uint32_t> opponent_column;
+    std::vector<choice> pick_column;
+    std::vector<result> result_column;
+    /**
+     * @brief 1 on a player's row for the last round of a match
+     */
+    std::vector<uint8_t> match_end_column;
+    std::vector<double> time_column;
+
+    void append(uint32_t player, uint32_t opponent, choice pick, result r,
+                double time);
+    void drop_oldest_half();
+  };
+
+  uint32_t code_of(uint64_t player);
+  [[nodiscard]] player_stats aggregate(uint32_t player,
+                                       uint32_t opponent) const;
+
+  size_t partition_capacity;
+  mutable std::shared_mutex mutex;
+  std::unordered_map<uint64_t, uint32_t> codes;
+  std::array<partition, partitions> parts;
+  size_t total_rows{0};
+  /**
+   * @brief Partitions of the latest round's two rows, for end_match()
+   */
+  std::array<uint32_t, 2> last_round{any_opponent, any_opponent};
+};
+
+} // namespace core
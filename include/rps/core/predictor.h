@@ -0,0 +1,112 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <rps/core/rules.h>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief Guesses a player's next pick from their past picks. Each player has
+ * a model of order 0 to 3 Markov counts: how often each pick followed each of
+ * the contexts made of their last zero, one, two and three picks. Variants
+ * with more choices keep fewer orders, so a model stays within model_bytes.
+ * Models live in a fixed size direct mapped table, so updating or querying
+ * one is a hash and a few byte reads; a player pushed out by a collision
+ * starts over.
+ *
+ * Not synchronised: the caller serialises every call.
+ */
+class predictor {
+public:
+  /**
+   * @param models table size, rounded up to a power of two
+   * @param picks choices in the variant being played, 2 to max_choices
+   */
+  explicit predictor(size_t models = 1 << 16, size_t picks = 3);
+
+  /**
+   * @brief Learn a pick a player made. none is ignored.
+   */
+  void observe(uint64_t player, choice pick);
+
+  /**
+   * @brief Most likely next pick: the highest order context seen often
+   * enough to have a clear favourite decides
+   *
+   * @return choice none if nothing is known about the player
+   */
+  [[nodiscard]] choice predict(uint64_t player) const;
+
+  /**
+   * @brief Most counts a model keeps: 40 contexts of 3 picks, 31 of 5
+   */
+  static constexpr size_t model_bytes = 160;
+
+private:
+  static constexpr size_t max_order = 3;
+  /**
+   * @brief A context's counts are halved when one reaches this, so old habits
+   * fade and counts fit a byte
+   */
+  static constexpr uint8_t count_limit = 32;
+
+  struct model {
+    uint64_t player{0};
+    /**
+     * @brief Last picks as base choices digits, latest lowest
+     */
+    uint16_t recent{0};
+    /**
+     * @brief Picks seen, up to orders
+     */
+    uint8_t seen{0};
+  };
+
+  /**
+   * @brief Counts for the context of the given order in a model
+   */
+  [[nodiscard]] size_t row(size_t slot, uint16_t recent, size_t order) const;
+
+  [[nodiscard]] size_t slot(uint64_t player) const;
+
+  size_t choices;
+  /**
+   * @brief Highest order kept
+   */
+  size_t orders{0};
+  /**
+   * @brief First row of each order, and contexts of each order
+   */
+  std::array<size_t, max_order + 1> first{};
+  std::array<size_t, max_order + 1> span{};
+  /**
+   * @brief Counts in each model
+   */
+  size_t stride{0};
+  std::vector<model> table;
+  std::vector<uint8_t> counts;
+  size_t mask;
+};
+
+} // namespace core
@@ -0,0 +1,132 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <rps/core/engine.h>
+#include <rps/core/rules.h>
+#include <vector>
+
+namespace core {
+
+/**
+ * @brief Every kind of change to game state
+ */
+enum class action_type : uint8_t {
+  /**
+   * @brief A process started with empty state
+   */
+  session_start,
+  create_lobby,
+  add_player,
+  remove_lobby,
+  set_choice,
+  reset_choices,
+  increment_score,
+  increment_game,
+  resolve_round,
+  start_queue_timer,
+  clear_queue_timer,
+  start_game_timer,
+  clear_game_timer,
+  /**
+   * @brief Every lobby was taken out to hand to a successor
+   */
+  release_all,
+  /**
+   * @brief A lobby handed over by a predecessor was adopted
+   */
+  restore_lobby,
+};
+
+/**
+ * @brief One change to game state, small and fixed size so it can be
+ * journalled as is. Fields an action type does not use are left zero.
+ */
+struct action {
+  /**
+   * @brief Game time the action was applied, seconds since the unix epoch
+   */
+  double time{0};
+  /**
+   * @brief The player acted on first; both seats for restore_lobby
+   */
+  std::array<player_id, 2> players{};
+  lobby_id lobby{0};
+  /**
+   * @brief Seconds for timer starts, wins needed for resolve_round, the seat
+   * for increment_score and the game number for restore_lobby
+   */
+  uint32_t argument{0};
+  /**
+   * @brief Seat scores for restore_lobby
+   */
+  std::array<uint16_t, 2> scores{};
+  action_type type{action_type::session_start};
+  /**
+   * @brief The pick for set_choice; both seats' picks for restore_lobby
+   */
+  std::array<choice, 2> picks{choice::none, choice::none};
+  /**
+   * @brief game_over for remove_lobby, timed_out for resolve_round
+   */
+  bool flag{false};
+};
+
+static_assert(sizeof(action) == 40, "journal layout changed");
+
+/**
+ * @brief What applying an action produced, for the caller to act on
+ */
+struct applied {
+  /**
+   * @brief add_player seated the player, or restore_lobby adopted the lobby
+   */
+  bool ok{false};
+  /**
+   * @brief Id given by create_lobby
+   */
+  lobby_id created{0};
+  std::optional<lobby> removed;
+  std::optional<round_result> round;
+  /**
+   * @brief Lobbies taken out by release_all
+   */
+  std::vector<lobby> released;
+};
+
+/**
+ * @brief Apply an action to game state. The game makes every change through
+ * here, so replaying the actions it applied, in order and with a clock
+ * reading each action's time, rebuilds its state exactly.
+ *
+ * The engine's timers are armed with on_expire. Expiries reach the state only
+ * through the actions they go on to apply, so a replay passes none.
+ *
+ * @param state engine to change
+ * @param a action to apply
+ * @param on_expire called when a timer the action starts fires
+ */
+applied reduce(engine &state, const action &a,
+               std::function<void()> on_expire = {});
+
+} // namespace core
@@ -0,0 +1,335 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace core {
+
+/**
+ * @brief Most picks a variant can offer; a game message holds five buttons
+ * per row, so this is under two rows
+ */
+inline constexpr size_t max_choices = 7;
+
+/**
+ * @brief A player's pick for one round: the variant's first, second, ...
+ * choice. The names are those of the built in variants.
+ */
+enum class choice : uint8_t {
+  none,
+  rock,
+  paper,
+  scissors,
+  lizard,
+  spock,
+};
+
+/**
+ * @brief How a round ended
+ */
+enum class outcome : uint8_t {
+  player_one,
+  player_two,
+  draw,
+  /**
+   * @brief Neither player picked
+   */
+  forfeit,
+};
+
+/**
+ * @brief A game variant as data: its choices, which beats which, and the
+ * match length. Every change rebuilds a table of outcomes for each pair of
+ * picks, so deciding a round is one lookup whatever the variant.
+ *
+ * Built in variants are constexpr, so a mistake in one fails the build;
+ * custom ones are built the same way from the configuration at runtime.
+ */
+class variant {
+public:
+  /**
+   * @param title name the configuration selects the variant by
+   * @param wins_needed wins needed to take the match
+   * @param timeout seconds players have to pick each round
+   */
+  constexpr variant(std::string_view title, unsigned int wins_needed,
+                    unsigned int timeout)
+      : first_to(wins_needed), round_timeout(timeout) {
+    copy(heading, title);
+    rebuild();
+  }
+
+  /**
+   * @brief Add a choice after the existing ones
+   *
+   * @param name button label, unique in the variant
+   * @param emoji shown in channel results, e.g. :rock:
+   * @throw std::invalid_argument if the variant is full or the name is empty,
+   * too long or taken
+   */
+  constexpr choice add(std::string_view name, std::string_view emoji) {
+    if (count == max_choices) {
+      throw std::invalid_argument("too many choices");
+    }
+    if (name.empty() || parse(name) != choice::none) {
+      throw std::invalid_argument("choice names must be unique and not empty");
+    }
+    copy(names[count], name);
+    copy(emojis[count], emoji);
+    ++count;
+    rebuild();
+    return static_cast<choice>(count);
+  }
+
+  /**
+   * @brief Record that winner beats loser
+   *
+   * @throw std::invalid_argument if either is not a choice, they are the
+   * same, or loser already beats winner
+   */
+  constexpr void beats(choice winner, choice loser) {
+    if (!valid(winner) || !valid(loser) || winner == loser) {
+      throw std::invalid_argument("beats needs two different choices");
+    }
+    if ((wins[digit(loser)] & bit(winner)) != 0) {
+      throw std::invalid_argument("two choices cannot beat each other");
+    }
+    wins[digit(winner)] |= bit(loser);
+    rebuild();
+  }
+
+  /**
+   * @brief Decide a round. A player who picked beats one who did not.
+   */
+  [[nodiscard]] constexpr outcome resolve(choice player_one,
+                                          choice player_two) const {
+    return outcomes[index(player_one)][index(player_two)];
+  }
+
+  /**
+   * @brief Whether every pair of different choices has a winner, with at
+   * least two choices
+   */
+  [[nodiscard]] constexpr bool complete() const {
+    if (count < 2) {
+      return false;
+    }
+    for (uint8_t a = 1; a <= count; ++a) {
+      for (uint8_t b = a + 1; b <= count; ++b) {
+        if (outcomes[a][b] == outcome::draw) {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * @brief A choice that beats c, the first in the variant's order
+   *
+   * @return choice none if nothing beats c or c is none
+   */
+  [[nodiscard]] constexpr choice counter(choice c) const {
+    if (!valid(c)) {
+      return choice::none;
+    }
+    for (uint8_t i = 1; i <= count; ++i) {
+      if (outcomes[i][index(c)] == outcome::player_one) {
+        return static_cast<choice>(i);
+      }
+    }
+    return choice::none;
+  }
+
+  /**
+   * @brief The choice with this name
+   *
+   * @return choice none if the variant has no such choice
+   */
+  [[nodiscard]] constexpr choice parse(std::string_view name) const {
+    for (uint8_t i = 0; i < count; ++i) {
+      if (view(names[i]) == name) {
+        return static_cast<choice>(i + 1);
+      }
+    }
+    return choice::none;
+  }
+
+  /**
+   * @brief Name of a choice, empty for none
+   */
+  [[nodiscard]] constexpr std::string_view name_of(choice c) const {
+    return valid(c) ? view(names[digit(c)]) : std::string_view{};
+  }
+
+  /**
+   * @brief Emoji of a choice, empty for none
+   */
+  [[nodiscard]] constexpr std::string_view emoji_of(choice c) const {
+    return valid(c) ? view(emojis[digit(c)]) : std::string_view{};
+  }
+
+  /**
+   * @brief Whether c is one of the variant's choices
+   */
+  [[nodiscard]] constexpr bool valid(choice c) const {
+    return c != choice::none && static_cast<uint8_t>(c) <= count;
+  }
+
+  /**
+   * @brief Number of choices
+   */
+  [[nodiscard]] constexpr size_t size() const { return count; }
+
+  [[nodiscard]] constexpr std::string_view name() const { return view(heading); }
+
+  /**
+   * @brief Wins needed to take the match
+   */
+  unsigned int first_to;
+  /**
+   * @brief Seconds players have to pick each round
+   */
+  unsigned int round_timeout;
+
+private:
+  /**
+   * @brief Names fit in a button label and in the table without allocating
+   */
+  using label = std::array<char, 32>;
+
+  static constexpr void copy(label &to, std::string_view from) {
+    if (from.size() >= to.size()) {
+      throw std::invalid_argument("names are at most 31 bytes");
+    }
+    to = {};
+    for (size_t i = 0; i < from.size(); ++i) {
+      to[i] = from[i];
+    }
+  }
+
+  static constexpr std::string_view view(const label &l) {
+    size_t n{0};
+    while (n < l.size() && l[n] != '\0') {
+      ++n;
+    }
+    return {l.data(), n};
+  }
+
+  static constexpr uint8_t digit(choice c) {
+    return static_cast<uint8_t>(static_cast<uint8_t>(c) - 1);
+  }
+
+  static constexpr uint8_t bit(choice c) {
+    return static_cast<uint8_t>(1U << digit(c));
+  }
+
+  /**
+   * @brief Row or column of a pick in the outcome table. Values past
+   * max_choices are clamped to the none row, and unused choices up to it are
+   * filled as none, so any pick resolves as if it were never made.
+   */
+  static constexpr size_t index(choice c) {
+    const auto value = static_cast<uint8_t>(c);
+    return value <= max_choices ? value : 0;
+  }
+
+  constexpr void rebuild() {
+    for (uint8_t a = 0; a <= max_choices; ++a) {
+      for (uint8_t b = 0; b <= max_choices; ++b) {
+        const bool one = a != 0 && a <= count;
+        const bool two = b != 0 && b <= count;
+        outcome &o = outcomes[a][b];
+        if (!one || !two) {
+          o = one   ? outcome::player_one
+              : two ? outcome::player_two
+                    : outcome::forfeit;
+        } else if ((wins[a - 1] & (1U << (b - 1))) != 0) {
+          o = outcome::player_one;
+        } else if ((wins[b - 1] & (1U << (a - 1))) != 0) {
+          o = outcome::player_two;
+        } else {
+          o = outcome::draw;
+        }
+      }
+    }
+  }
+
+  label heading{};
+  std::array<label, max_choices> names{};
+  std::array<label, max_choices> emojis{};
+  /**
+   * @brief Bit b of wins[a] is set when choice a + 1 beats choice b + 1
+   */
+  std::array<uint8_t, max_choices> wins{};
+  uint8_t count{0};
+  std::array<std::array<outcome, max_choices + 1>, max_choices + 1>
+      outcomes{};
+};
+
+/**
+ * @brief Rock, paper, scissors, first to 4
+ */
+inline constexpr variant classic = [] {
+  variant v{"classic", 4, 30};
+  const choice rock = v.add("Rock", ":rock:");
+  const choice paper = v.add("Paper", ":page_facing_up:");
+  const choice scissors = v.add("Scissors", ":scissors:");
+  v.beats(rock, scissors);
+  v.beats(paper, rock);
+  v.beats(scissors, paper);
+  return v;
+}();
+
+/**
+ * @brief Rock, paper, scissors, lizard, Spock: each choice beats two others
+ */
+inline constexpr variant rpsls = [] {
+  variant v{"rpsls", 4, 30};
+  const choice rock = v.add("Rock", ":rock:");
+  const choice paper = v.add("Paper", ":page_facing_up:");
+  const choice scissors = v.add("Scissors", ":scissors:");
+  const choice lizard = v.add("Lizard", ":lizard:");
+  const choice spock = v.add("Spock", ":vulcan:");
+  v.beats(rock, scissors);
+  v.beats(rock, lizard);
+  v.beats(paper, rock);
+  v.beats(paper, spock);
+  v.beats(scissors, paper);
+  v.beats(scissors, lizard);
+  v.beats(lizard, paper);
+  v.beats(lizard, spock);
+  v.beats(spock, rock);
+  v.beats(spock, scissors);
+  return v;
+}();
+
+/**
+ * @brief A built in variant by name
+ *
+ * @return const variant* nullptr if there is none by that name
+ */
+const variant *builtin(std::string_view name);
+
+} // namespace core
@@ -0,0 +1,241 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <rps/core/engine.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace core {
+
+enum class tournament_format : uint8_t {
+  single_elimination,
+  double_elimination,
+  swiss,
+};
+
+/**
+ * @brief Part of the bracket a match belongs to
+ */
+enum class bracket_side : uint8_t {
+  winners,
+  losers,
+  grand_final,
+  /**
+   * @brief Played only if the losers bracket's finalist wins the grand final
+   */
+  reset,
+  swiss,
+};
+
+enum class match_state : uint8_t {
+  /**
+   * @brief A seat still waits on an earlier match
+   */
+  waiting,
+  ready,
+  playing,
+  done,
+};
+
+/**
+ * @brief An entrant index, or one of these markers
+ */
+inline constexpr uint32_t no_entrant = UINT32_MAX;
+/**
+ * @brief An empty seat: its opponent advances without playing
+ */
+inline constexpr uint32_t bye = UINT32_MAX - 1;
+/**
+ * @brief No match to go to
+ */
+inline constexpr uint32_t nowhere = UINT32_MAX;
+
+struct bracket_match {
+  /**
+   * @brief Entrant indexes, no_entrant until filled
+   */
+  std::array<uint32_t, 2> seats{no_entrant, no_entrant};
+  /**
+   * @brief Entrant index of the winner, or no_entrant; bye if both seats
+   * were byes, and no_entrant after a Swiss draw
+   */
+  uint32_t winner{no_entrant};
+  /**
+   * @brief Seat the winner and loser move to, as match * 2 + seat
+   */
+  uint32_t winner_to{nowhere};
+  uint32_t loser_to{nowhere};
+  /**
+   * @brief Lobby playing the match, 0 if none
+   */
+  lobby_id lobby{0};
+  uint16_t round{0};
+  bracket_side side{bracket_side::winners};
+  match_state state{match_state::waiting};
+};
+
+/**
+ * @brief An entrant's record
+ */
+struct standing {
+  uint32_t entrant{0};
+  /**
+   * @brief Half points: 2 per win or bye, 1 per draw
+   */
+  uint32_t points{0};
+  uint32_t wins{0};
+  uint32_t losses{0};
+  uint32_t draws{0};
+  /**
+   * @brief Swiss: sum of the opponents' points
+   */
+  uint32_t buchholz{0};
+  bool eliminated{false};
+};
+
+/**
+ * @brief Bracket state of one tournament. Entrants are indexes into the seed
+ * order given at construction, seed 1 first. Elimination brackets are built
+ * in full up front, padded with byes to a power of two; Swiss rounds are
+ * paired as the previous round finishes.
+ *
+ * Not synchronised: the caller serialises every call.
+ */
+class tournament {
+public:
+  /**
+   * @param fmt bracket format
+   * @param players entrants in seed order, at least two
+   * @param rounds Swiss rounds, 0 for enough to find a sole winner
+   * @throw std::invalid_argument with fewer than two entrants
+   */
+  tournament(tournament_format fmt, std::vector<player_id> players,
+             unsigned int rounds = 0);
+
+  /**
+   * @brief Matches that can start, in bracket order
+   */
+  [[nodiscard]] std::vector<uint32_t> ready() const;
+
+  /**
+   * @brief A ready match started in a lobby
+   */
+  void start(uint32_t match, lobby_id lobby);
+
+  /**
+   * @brief A playing match lost its lobby, e.g. to a restart; it can start
+   * again
+   */
+  void restart(uint32_t match);
+
+  /**
+   * @brief Record a playing match's result and move its players on. A draw
+   * in an elimination bracket goes to the higher seed.
+   *
+   * @param seat seat of the winner, or -1 for a draw
+   * @return false if the match was not playing
+   */
+  bool report(uint32_t match, int seat);
+
+  [[nodiscard]] bool finished() const;
+
+  /**
+   * @brief Records, best first: by points and Buchholz for Swiss, by how far
+   * each entrant got for elimination brackets
+   */
+  [[nodiscard]] std::vector<standing> standings() const;
+
+  [[nodiscard]] const std::vector<bracket_match> &matches() const {
+    return bracket;
+  }
+  [[nodiscard]] player_id entrant(uint32_t index) const {
+    return entrants[index];
+  }
+  [[nodiscard]] size_t entrant_count() const { return entrants.size(); }
+  [[nodiscard]] tournament_format format() const { return kind; }
+  /**
+   * @brief Lowest round with a match left to finish, or the last round
+   */
+  [[nodiscard]] unsigned int round() const;
+  [[nodiscard]] unsigned int rounds() const { return round_count; }
+
+  /**
+   * @brief Serialise the whole state
+   */
+  [[nodiscard]] std::string encode() const;
+
+  /**
+   * @brief Parse a state written by encode()
+   *
+   * @throw std::runtime_error if the state is truncated or inconsistent
+   */
+  static tournament decode(std::string_view state);
+
+  /**
+   * @brief Entrants above which a Swiss round's score groups are paired on
+   * several threads
+   */
+  static constexpr size_t parallel_pairing = 2048;
+
+private:
+  tournament() = default;
+
+  void build_elimination();
+  void pair_swiss();
+  /**
+   * @brief Seat an entrant, or a bye, and settle the match if it is full
+   */
+  void fill(uint32_t to, uint32_t entrant);
+  void settle(uint32_t match, uint32_t winner_seat);
+  /**
+   * @brief Knock an entrant out at a bracket depth; byes are ignored
+   */
+  void eliminate(uint32_t entrant, uint32_t depth);
+
+  tournament_format kind{tournament_format::single_elimination};
+  std::vector<player_id> entrants;
+  std::vector<bracket_match> bracket;
+  unsigned int round_count{0};
+  /**
+   * @brief Swiss: rounds paired so far
+   */
+  unsigned int paired{0};
+  /**
+   * @brief Per entrant: points, results and opponents played
+   */
+  std::vector<standing> records;
+  std::vector<std::vector<uint32_t>> opponents;
+  std::vector<uint8_t> had_bye;
+  /**
+   * @brief Per entrant: round of the match that knocked them out, 0 while
+   * still in
+   */
+  std::vector<uint32_t> knocked_out;
+  /**
+   * @brief Swiss: matches of the current round still to finish
+   */
+  size_t unfinished{0};
+};
+
+} // namespace core
@@ -0,0 +1,86 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+/**
+ * @brief Admission control driven by outbound REST pressure. The sinks report
+ * every call they start and finish; from the number in flight and a moving
+ * average of their latency the bot degrades in steps, each with its own
+ * thresholds in config, rather than queueing without bound when Discord
+ * slows down.
+ */
+namespace backpressure {
+
+/**
+ * @brief Degradation steps, each implying the ones before it
+ */
+enum class level : uint8_t {
+  normal,
+  /**
+   * @brief Result posts to queue channels are dropped; players still get
+   * their own results
+   */
+  shed_channel_posts,
+  /**
+   * @brief Full lobbies wait stretch_pairing_delay seconds before starting
+   */
+  stretch_pairing,
+  /**
+   * @brief /queue is refused with an ephemeral message
+   */
+  reject_queue,
+};
+
+/**
+ * @brief An outbound call was queued
+ */
+void started();
+
+/**
+ * @brief An outbound call completed, after any rate limit waits and retries
+ *
+ * @param latency time since it was queued
+ */
+void finished(std::chrono::nanoseconds latency);
+
+/**
+ * @brief Current step, from the thresholds in config
+ */
+level current();
+
+/**
+ * @brief Whether the current step is at least a given one. Counts the
+ * decision in rps_load_shed_total when it sheds.
+ */
+bool shedding(level at_least);
+
+/**
+ * @brief Outbound calls queued and not yet finished
+ */
+int64_t in_flight();
+
+/**
+ * @brief Moving average latency of finished outbound calls
+ */
+std::chrono::milliseconds average_latency();
+
+} // namespace backpressure
@@ -0,0 +1,58 @@
+/************************************************************************************
+ *
+ * Copyright 1993,2001,2023 Craig Edwards <brain@ssod.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+#pragma once
+#include <array>
+#include <dpp/dpp.h>
+#include <string_view>
+
+/**
+ * @brief All button handlers derive from this struct. Like commands, these
+ * structs are never instantiated. A button is routed on the prefix of its
+ * custom id (everything before the first ':'), so one handler can own several
+ * buttons and ids can carry extra state after the prefix. Add your handler to
+ * button_handlers in routes.h.
+ */
+struct button {
+  /**
+   * @brief Custom id prefixes this handler owns
+   */
+  static constexpr std::array<std::string_view, 0> prefixes{};
+
+  /**
+   * @brief Handle button click
+   * The click has already been acknowledged when this is called, unless
+   * config delivery is interactions: then the handler must answer it, with
+   * outbound::sink::update() or acknowledge(), within three seconds.
+   *
+   * @param event The button click event data
+   */
+  static void route(const dpp::button_click_t &event);
+};
+
+/**
+ * @brief A function pointer to the static route() function of a button
+ */
+using button_router = auto (*)(const dpp::button_click_t &) -> void;
+
+/**
+ * @brief Called by the on_buttonclick event to route a button by custom id
+ * prefix to its handler.
+ *
+ * @param event Button click event
+ */
+void route_button(const dpp::button_click_t &event);
@@ -0,0 +1,28 @@
+/************************************************************************************
+ *
+ * Copyright 1993,2001,2023 Craig Edwards <brain@ssod.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+#pragma once
+#include <rps/domain/button.h>
+#include <rps/domain/rps.h>
+
+struct choice_button : public button {
+  /* pick:<n>, and the names classic round prompts used as ids before */
+  static constexpr std::array<std::string_view, 4> prefixes{"pick", "Rock",
+                                                            "Paper",
+                                                            "Scissors"};
+  static void route(const dpp::button_click_t &event);
+};
@@ -0,0 +1,145 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <dpp/dpp.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Records routed interactions to a compact binary file, anonymised, so
+ * real traffic shapes can be replayed into the handlers later by rps_replay.
+ */
+namespace capture {
+
+/**
+ * @brief Kinds of captured interaction
+ */
+enum class record_type : uint8_t {
+  slashcommand = 1,
+  button_click = 2,
+};
+
+/**
+ * @brief A string option of a captured slash command, by name
+ */
+struct string_option {
+  char name[24]{};
+  char value[16]{};
+};
+
+/**
+ * @brief String options kept per record, enough for a tournament open with a
+ * format
+ */
+constexpr size_t max_string_options = 2;
+
+/**
+ * @brief One captured interaction, written to the file as is. User, guild and
+ * channel ids are replaced by a keyed hash that is consistent within one
+ * capture; names, tokens and message content are not kept.
+ */
+struct record {
+  /**
+   * @brief Microseconds since the capture started
+   */
+  uint64_t offset_us{0};
+  uint64_t user_id{0};
+  uint64_t guild_id{0};
+  uint64_t channel_id{0};
+  /**
+   * @brief Value of the first integer option, if option_name is set
+   */
+  int64_t option_value{0};
+  record_type type{record_type::slashcommand};
+  char locale[7]{};
+  /**
+   * @brief Command name or button custom id
+   */
+  char name[32]{};
+  char option_name[24]{};
+  /**
+   * @brief The first string options in order; unused slots have no name
+   */
+  string_option strings[max_string_options]{};
+};
+
+static_assert(sizeof(record) == 184, "capture file layout changed");
+
+/**
+ * @brief File magic and version, followed by records until end of file.
+ * Records are in host byte order.
+ */
+constexpr char file_magic[8] = {'R', 'P', 'S', 'C', 'A', 'P', '0', '2'};
+
+extern std::atomic<bool> active;
+
+/**
+ * @brief Check before building a record, so a disabled capture costs a single
+ * relaxed load
+ */
+inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Start capturing to a file, truncating it
+ *
+ * @param path capture file
+ * @throw std::runtime_error if the file cannot be opened
+ */
+void start(const std::string &path);
+
+/**
+ * @brief Stop capturing, flushing queued records
+ */
+void stop();
+
+/**
+ * @brief Capture a slash command
+ */
+void slashcommand(const dpp::slashcommand_t &event);
+
+/**
+ * @brief Capture a button click
+ */
+void button_click(const dpp::button_click_t &event);
+
+/**
+ * @brief Read every record of a capture file
+ *
+ * @param path capture file
+ * @return std::vector<record> records in capture order
+ * @throw std::runtime_error if the file is missing or not a capture
+ */
+std::vector<record> load(const std::string &path);
+
+/**
+ * @brief Rebuild a slash command event from a record, with a fresh
+ * interaction id timestamped with timing::get()
+ */
+dpp::slashcommand_t to_slashcommand(const record &r);
+
+/**
+ * @brief Rebuild a button click event from a record, with a fresh
+ * interaction id timestamped with timing::get()
+ */
+dpp::button_click_t to_button_click(const record &r);
+
+} // namespace capture
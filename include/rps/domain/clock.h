@@ -0,0 +1,64 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <dpp/dpp.h>
+#include <rps/core/clock.h>
+
+/**
+ * @brief Game time. Queue and game timeouts, and the timestamps they are
+ * measured against, come from the installed clock: a real_clock for the bot,
+ * or a core::virtual_clock that tools advance by hand to compress hours of
+ * timeouts into seconds. Processing latency metrics stay on
+ * std::chrono::steady_clock.
+ */
+namespace timing {
+
+using clock = core::clock;
+using virtual_clock = core::virtual_clock;
+
+/**
+ * @brief Wall clock time, with timers run by the cluster
+ */
+class real_clock : public clock {
+public:
+  explicit real_clock(dpp::cluster &bot) : cluster(bot) {}
+
+  [[nodiscard]] std::chrono::nanoseconds now() const override;
+  [[nodiscard]] double unix_time() const override;
+  dpp::timer start_timer(dpp::timer_callback_t on_tick,
+                         uint64_t seconds) override;
+  void stop_timer(dpp::timer t) override;
+
+private:
+  dpp::cluster &cluster;
+};
+
+/**
+ * @brief Install the clock used by the game. Must outlive every call to get().
+ */
+void set(clock &c);
+
+/**
+ * @brief Get the installed clock
+ */
+clock &get();
+
+} // namespace timing
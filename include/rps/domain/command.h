@@ -21,13 +21,10 @@
 
 /**
  * @brief All commands derive from this struct. Note that these structs are
- * never instantiated, all data witin them is static and constant. Register your
- * commands by calling the register_command function to get a dpp::slashcommand
- * you can then pass to global_bulk_command_create:
- *
- * bot.global_bulk_command_create({
- * 	register_command<my_command>(bot),
- * });
+ * never instantiated, all data witin them is static and constant. Add your
+ * command to slash_commands in routes.h; listeners passes every listed command
+ * through register_command to get the dpp::slashcommand objects for
+ * global_bulk_command_create, and route_command dispatches on its name.
  */
 struct command {
   /**
@@ -61,29 +58,24 @@ struct command {
 using command_router = auto (*)(const dpp::slashcommand_t &) -> void;
 
 /**
- * @brief Represents a list of registered commands stored in an unordered_map
- */
-using registered_command_list =
-    std::unordered_map<std::string_view, command_router>;
-
-/**
- * @brief Get the current map of registered commands
- *
- * @return registered_command_list& the list
- */
-registered_command_list &get_command_map();
-
-/**
- * @brief Register a command and return its slashcommand object.
+ * @brief Register a command and return its slashcommand object. Routing is
+ * done by the compile time table built from routes.h, so T must also be
+ * listed in slash_commands there.
  *
  * @tparam T command handler struct to register
  * @param bot Reference to cluster registering the command
  * @return dpp::slashcommand slashcommand object to register
  */
 template <typename T> dpp::slashcommand register_command(dpp::cluster &bot) {
-  auto &command_map = get_command_map();
-  command_map[T::name] = T::route;
-  return T::register_command(bot);
+  dpp::slashcommand cmd = T::register_command(bot);
+  if (cmd.name != T::name) {
+    /* Interactions arrive with the registered (English) name, so if lang.json
+     * renames the command it can no longer be routed */
+    bot.log(dpp::ll_error, "Command " + cmd.name +
+                               " does not match its route name " +
+                               std::string(T::name));
+  }
+  return cmd;
 }
 
 /**
@@ -92,4 +84,4 @@ template <typename T> dpp::slashcommand register_command(dpp::cluster &bot) {
  *
  * @param event Slash command interaction event
  */
-void route_command(const dpp::slashcommand_t &event);
\ No newline at end of file
+void route_command(const dpp::slashcommand_t &event);
@@ -0,0 +1,27 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+#include <rps/domain/command.h>
+#include <rps/domain/rps.h>
+
+struct tournament_command : public command {
+  static constexpr std::string_view name{"tournament"};
+  static dpp::slashcommand register_command(dpp::cluster &bot);
+  static void route(const dpp::slashcommand_t &event);
+};
@@ -16,18 +16,243 @@
  *
  ************************************************************************************/
 #pragma once
+#include <cstdint>
 #include <dpp/json_fwd.h>
+#include <rps/core/rules.h>
 #include <rps/domain/rps.h>
+#include <string>
 
 namespace config {
 
 /**
- * @brief Initialise config file
+ * @brief How game messages reach players
+ */
+enum class delivery_mode : uint8_t {
+  /**
+   * @brief Clicks are acknowledged and everything is sent as bot messages
+   */
+  messages,
+  /**
+   * @brief Clicks are answered by updating the round prompt, and results are
+   * sent as follow-ups on each player's latest click, which are rate limited
+   * per interaction rather than against the bot
+   */
+  interactions,
+};
+
+/**
+ * @brief When a load shedding step engages. Either limit trips it; 0 turns
+ * that limit off.
+ */
+struct load_threshold {
+  /**
+   * @brief Outbound REST calls queued or running
+   */
+  uint32_t in_flight{0};
+  /**
+   * @brief Moving average outbound REST latency
+   */
+  uint32_t latency_ms{0};
+};
+
+/**
+ * @brief Typed, validated view of config.json. Every field has a default, so
+ * only the tokens need to be present in the file.
+ */
+struct settings {
+  std::string live_token;
+  std::string dev_token;
+  /**
+   * @brief Log file path
+   */
+  std::string log{"rps.log"};
+  /**
+   * @brief Bot icon url used in embed footers
+   */
+  std::string icon;
+  /**
+   * @brief Shard count, 0 lets Discord recommend one
+   */
+  uint32_t shards{0};
+  bool dev{false};
+  /**
+   * @brief Minutes a player waits in queue when /queue has no timeout
+   */
+  unsigned int default_queue_time{5};
+  /**
+   * @brief Game played: a built in variant (classic, rpsls) or one defined
+   * under config variants. Read at startup; a reload does not change the
+   * game in progress.
+   */
+  core::variant variant{core::classic};
+  /**
+   * @brief Seconds players have to make a choice each game, the variant's
+   * round timeout unless set
+   */
+  unsigned int game_timeout{30};
+  /**
+   * @brief Wins needed to take the match, the variant's first_to unless set
+   */
+  unsigned int first_to{4};
+  /**
+   * @brief Seconds a lone queued player waits before a practice bot joins,
+   * 0 to disable the bot
+   */
+  unsigned int bot_wait{0};
+  /**
+   * @brief Players whose picks the practice bot remembers, up to 176 bytes
+   * each
+   */
+  uint32_t bot_models{65536};
+  /**
+   * @brief D++ REST request threads
+   */
+  uint32_t request_threads{12};
+  /**
+   * @brief D++ raw REST request threads
+   */
+  uint32_t request_threads_raw{1};
+  delivery_mode delivery{delivery_mode::messages};
+  /**
+   * @brief Commands and clicks a user may make in a burst, 0 to disable
+   * rate limiting
+   */
+  uint32_t rate_limit_burst{10};
+  /**
+   * @brief Rate a user's burst allowance refills at
+   */
+  uint32_t rate_limit_per_minute{60};
+  /**
+   * @brief Drop result posts to queue channels
+   */
+  load_threshold shed_channel_posts{500, 2000};
+  /**
+   * @brief Delay the start of newly paired matches
+   */
+  load_threshold stretch_pairing{1000, 4000};
+  /**
+   * @brief Refuse /queue
+   */
+  load_threshold reject_queue{2000, 8000};
+  /**
+   * @brief Seconds a paired match waits while pairing is stretched
+   */
+  unsigned int stretch_pairing_delay{5};
+  /**
+   * @brief Unix socket lobbies are handed over on for deploys: a starting bot
+   * waits on it for its predecessor's lobbies, and a bot sent SIGTERM hands
+   * its lobbies to the successor there. Empty to disable.
+   */
+  std::string handoff_socket;
+  /**
+   * @brief Seconds a starting bot waits on handoff_socket for a predecessor
+   */
+  unsigned int handoff_wait{10};
+  /**
+   * @brief Seconds a draining bot with no successor waits for matches to
+   * finish before exiting
+   */
+  unsigned int drain_timeout{60};
+  /**
+   * @brief Rounds kept for /stats, one row per player per round; about 20
+   * bytes each
+   */
+  uint32_t history_rows{10'000'000};
+  /**
+   * @brief Users whose DM channel id is cached, 0 to disable the cache
+   */
+  uint32_t dm_cache_size{100000};
+  /**
+   * @brief Seconds a cached DM channel id is trusted
+   */
+  uint32_t dm_cache_ttl{21600};
+  /**
+   * @brief Localhost port serving Prometheus metrics, 0 to disable
+   */
+  uint16_t metrics_port{0};
+  /**
+   * @brief Fraction of interactions traced, 0 to 1
+   */
+  double trace_sample_rate{0.01};
+  /**
+   * @brief Base url of a Discord REST stand in, e.g. http://127.0.0.1:8080.
+   * Empty sends to Discord.
+   */
+  std::string api_url;
+  /**
+   * @brief Host of a Discord gateway stand in. Empty connects to Discord.
+   */
+  std::string gateway_host;
+  /**
+   * @brief File to capture interactions to for rps_replay. Empty to disable.
+   */
+  std::string capture_file;
+  /**
+   * @brief File to journal game state actions to for rps_rebuild, appended
+   * to. Empty to disable.
+   */
+  std::string journal_file;
+  /**
+   * @brief File tournament brackets are saved to as they change and loaded
+   * from at startup. Empty to keep them in memory only.
+   */
+  std::string tournament_file;
+  /**
+   * @brief Most tournament matches started each second, across every
+   * tournament
+   */
+  unsigned int tournament_batch{100};
+  /**
+   * @brief Seconds between bracket updates posted to a tournament's channel;
+   * results in between are folded into the next post
+   */
+  unsigned int tournament_post_interval{30};
+};
+
+/**
+ * @brief Validate a parsed config document
+ *
+ * @param document parsed config.json
+ * @return settings populated settings
+ * @throw std::invalid_argument naming the first invalid key
+ */
+settings parse(const json &document);
+
+/**
+ * @brief Initialise config file and publish the first settings snapshot
  *
  * @param config_file Config file to read
+ * @throw std::exception if the file cannot be parsed or fails validation
  */
 void init(const std::string &config_file);
 
+/**
+ * @brief Publish settings directly, for tools and benchmarks that run without
+ * a config.json
+ *
+ * @param s settings to publish
+ */
+void init(const settings &s);
+
+/**
+ * @brief Get the current settings snapshot. Lock free; the reference stays
+ * valid for the life of the process, but a reload may publish a newer one, so
+ * re-read it rather than caching it.
+ *
+ * @return const settings& current settings
+ */
+const settings &current();
+
+/**
+ * @brief Reload the config file if it changed on disk, atomically swapping in
+ * a new settings snapshot. An invalid file is logged and the old snapshot kept.
+ * Only the typed settings are reloaded; get() keeps returning the document
+ * read by init().
+ *
+ * @param bot cluster to log to
+ */
+void check_reload(dpp::cluster &bot);
+
 /**
  * @brief Get all config values from a specific key
  *
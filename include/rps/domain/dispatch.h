@@ -0,0 +1,155 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <utility>
+
+/**
+ * @brief Compile time routing tables. The set of commands and components is
+ * fixed at build time, so rather than filling a hash map at startup we build a
+ * perfect hash table in a constant expression: every name lands in its own
+ * slot, and a lookup is one hash, one mask and one string comparison.
+ */
+namespace dispatch {
+
+/**
+ * @brief A list of handler structs, see routes.h
+ */
+template <typename... T> struct type_list {};
+
+/**
+ * @brief Seeded FNV-1a with a final avalanche, so the low bits used to pick a
+ * slot depend on the whole name
+ */
+constexpr uint32_t hash(std::string_view name, uint32_t seed) {
+  uint32_t h = 2166136261U ^ seed;
+  for (const char c : name) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 16777619U;
+  }
+  h ^= h >> 16;
+  h *= 0x85ebca6bU;
+  h ^= h >> 13;
+  return h;
+}
+
+/**
+ * @brief A collision free table of name to handler function pointer
+ *
+ * @tparam Handler function pointer type
+ * @tparam N number of names
+ */
+template <typename Handler, size_t N> struct table {
+  static constexpr size_t slots = std::bit_ceil(N * 2);
+
+  struct entry {
+    std::string_view name;
+    Handler handler{nullptr};
+  };
+
+  uint32_t seed{0};
+  std::array<entry, slots> entries{};
+
+  /**
+   * @brief Look up a handler
+   *
+   * @param name name to route
+   * @return Handler the handler, or nullptr if the name is unknown
+   */
+  [[nodiscard]] constexpr Handler find(std::string_view name) const {
+    const entry &e = entries[hash(name, seed) & (slots - 1)];
+    return e.name == name ? e.handler : nullptr;
+  }
+};
+
+/**
+ * @brief Search for a seed that places every name in its own slot
+ *
+ * @param routes name and handler pairs
+ * @return table<Handler, N> perfect hash table
+ */
+template <typename Handler, size_t N>
+consteval table<Handler, N>
+make_table(const std::array<std::pair<std::string_view, Handler>, N> &routes) {
+  table<Handler, N> t{};
+  for (uint32_t seed = 0; seed < 1'000'000; ++seed) {
+    std::array<bool, table<Handler, N>::slots> used{};
+    bool collision{false};
+    for (const auto &[name, handler] : routes) {
+      const size_t slot = hash(name, seed) & (table<Handler, N>::slots - 1);
+      if (used[slot]) {
+        collision = true;
+        break;
+      }
+      used[slot] = true;
+    }
+    if (collision) {
+      continue;
+    }
+    t.seed = seed;
+    for (const auto &[name, handler] : routes) {
+      t.entries[hash(name, seed) & (table<Handler, N>::slots - 1)] = {name,
+                                                                     handler};
+    }
+    return t;
+  }
+  throw "no perfect hash seed found, are there duplicate names?";
+}
+
+/**
+ * @brief Build a table from command structs, keyed on T::name
+ */
+template <typename Handler, typename... T>
+consteval auto make_command_table(type_list<T...> /*unused*/) {
+  return make_table<Handler, sizeof...(T)>({{{T::name, &T::route}...}});
+}
+
+/**
+ * @brief Build a table from component structs, keyed on every entry of
+ * T::prefixes
+ */
+template <typename Handler, typename... T>
+consteval auto make_component_table(type_list<T...> /*unused*/) {
+  constexpr size_t count = (T::prefixes.size() + ...);
+  std::array<std::pair<std::string_view, Handler>, count> routes{};
+  size_t i{0};
+  (
+      [&] {
+        for (const auto prefix : T::prefixes) {
+          routes[i++] = {prefix, &T::route};
+        }
+      }(),
+      ...);
+  return make_table<Handler, count>(routes);
+}
+
+/**
+ * @brief The routing prefix of a component custom id, everything before the
+ * first ':'. Components can carry state after the prefix.
+ */
+constexpr std::string_view custom_id_prefix(std::string_view custom_id) {
+  return custom_id.substr(0, custom_id.find(':'));
+}
+
+} // namespace dispatch
@@ -0,0 +1,81 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <dpp/snowflake.h>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace outbound {
+
+struct dm_cache_options {
+  /**
+   * @brief Most users remembered; the least recently used is evicted first
+   */
+  size_t capacity{100'000};
+  /**
+   * @brief How long a channel id is trusted before it is resolved again
+   */
+  std::chrono::seconds ttl{std::chrono::hours(6)};
+};
+
+/**
+ * @brief User id to DM channel id, so each direct message only costs the
+ * message POST. Bounded LRU with a TTL; entries are invalidated when a post
+ * to the channel comes back 403 or 404. Thread safe.
+ */
+class dm_channel_cache {
+public:
+  explicit dm_channel_cache(dm_cache_options o = {});
+
+  /**
+   * @brief Cached DM channel of a user
+   *
+   * @return dpp::snowflake channel id, 0 if unknown or expired
+   */
+  dpp::snowflake find(dpp::snowflake user_id);
+
+  void insert(dpp::snowflake user_id, dpp::snowflake channel_id);
+
+  void invalidate(dpp::snowflake user_id);
+
+  [[nodiscard]] size_t size() const;
+
+private:
+  using steady = std::chrono::steady_clock;
+
+  struct entry {
+    dpp::snowflake channel_id;
+    steady::time_point expires;
+    std::list<uint64_t>::iterator position;
+  };
+
+  dm_cache_options opts;
+  mutable std::mutex mutex;
+  /**
+   * @brief Most recently used at the front
+   */
+  std::list<uint64_t> order;
+  std::unordered_map<uint64_t, entry> entries;
+};
+
+} // namespace outbound
@@ -20,8 +20,15 @@
 
 #include <cstdint>
 #include <dpp/message.h>
+#include <optional>
+#include <rps/core/history.h>
+#include <rps/core/tournament.h>
 #include <rps/domain/config.h>
 #include <rps/domain/lang.h>
+#include <rps/domain/message_writer.h>
+#include <span>
+#include <string>
+#include <utility>
 
 using namespace i18n;
 
@@ -32,7 +39,7 @@ constexpr uint32_t EMBED_COLOR = 0xd5b994;
 inline dpp::embed_footer footer(const dpp::interaction_create_t &interaction) {
   return dpp::embed_footer()
       .set_text(tr("E_POWERED_BY", interaction))
-      .set_icon(config::get("icon"));
+      .set_icon(config::current().icon);
 };
 
 namespace embeds {
@@ -43,11 +50,38 @@ namespace embeds {
 [[nodiscard]] dpp::message leave(const dpp::interaction_create_t &interaction,
                                  const dpp::user &player);
 
+/**
+ * @brief A player's record, and optionally their record against one
+ * opponent. Picks are named after the variant's choices.
+ */
 [[nodiscard]] dpp::message
-game(const dpp::interaction_create_t &interaction, const unsigned int lobby_id,
-     const unsigned int game_num, const std::string &player_one_name,
-     const unsigned int player_one_score, const std::string &player_two_name,
-     const unsigned int player_two_score);
+stats(const dpp::interaction_create_t &interaction, const core::variant &rules,
+      const dpp::user &player, const core::player_stats &record,
+      const std::optional<std::pair<dpp::user, core::player_stats>> &versus);
+
+/**
+ * @brief A tournament's sign ups, or its progress and leading standings
+ *
+ * @param bracket nullptr until the tournament starts
+ * @param leaders names and standings of the leaders, best first
+ */
+[[nodiscard]] dpp::message tournament(
+    const dpp::interaction_create_t &interaction,
+    core::tournament_format format, size_t entrant_count,
+    const core::tournament *bracket,
+    std::span<const std::pair<std::string, core::standing>> leaders);
+
+/* The game path embeds below are written with a message_writer, so each
+ * payload is only valid until the calling thread writes another message */
+
+/**
+ * @brief A round prompt with a button for each of the variant's choices
+ */
+[[nodiscard]] outbound::payload
+game(const dpp::interaction_create_t &interaction, const core::variant &rules,
+     const unsigned int lobby_id, const unsigned int game_num,
+     const std::string &player_one_name, const unsigned int player_one_score,
+     const std::string &player_two_name, const unsigned int player_two_score);
 
 [[nodiscard]] dpp::message waiting(const dpp::interaction_create_t &interaction,
                                    const unsigned int game_num,
@@ -56,14 +90,14 @@ game(const dpp::interaction_create_t &interaction, const unsigned int lobby_id,
                                    const std::string &player_two_name,
                                    const std::string &player_two_choice);
 
-[[nodiscard]] dpp::message
+[[nodiscard]] outbound::payload
 game_result(const dpp::interaction_create_t &interaction,
             const unsigned int game_num, const std::string &player_one_name,
             const std::string &player_one_choice,
             const std::string &player_two_name,
             const std::string &player_two_choice, const std::string &result);
 
-[[nodiscard]] dpp::message match_result(
+[[nodiscard]] outbound::payload match_result(
     const dpp::interaction_create_t &interaction, const unsigned int lobby_id,
     const unsigned int game_num, const std::string &player_one_name,
     const unsigned int player_one_score, const std::string &player_two_name,
@@ -0,0 +1,107 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <rps/core/rules.h>
+#include <span>
+#include <string>
+
+/**
+ * @brief Game lifecycle events. The game publishes fixed size events to a
+ * broadcast ring while it holds its lock, which makes it the single producer
+ * and keeps events in the order the state changed. Each subscriber drains the
+ * ring on its own thread in batches, so persistence, stats and feeds never
+ * add latency to resolving a round. If a subscriber falls a whole ring behind,
+ * new events are dropped and counted rather than blocking the game.
+ */
+namespace events {
+
+enum class event_type : uint8_t {
+  lobby_created,
+  player_joined,
+  /**
+   * @brief A game's prompts were sent and its timer started
+   */
+  game_started,
+  round_resolved,
+  match_ended,
+  /**
+   * @brief A lobby left the queue without a match, e.g. a queue timeout
+   */
+  lobby_closed,
+};
+
+/**
+ * @brief One event. Player slots follow the lobby's seat order; unused ones
+ * and practice bots are 0.
+ */
+struct event {
+  /**
+   * @brief Game time, seconds since the unix epoch
+   */
+  double time{0};
+  std::array<uint64_t, 2> players{};
+  uint32_t lobby_id{0};
+  uint32_t game_number{0};
+  std::array<uint16_t, 2> scores{};
+  std::array<core::choice, 2> picks{core::choice::none, core::choice::none};
+  event_type type{event_type::lobby_created};
+  /**
+   * @brief Round or match result, for round_resolved and match_ended
+   */
+  core::outcome result{core::outcome::draw};
+};
+
+static_assert(sizeof(event) <= 48, "keep events small, they are copied");
+
+/**
+ * @brief Called with each batch a subscriber reads
+ */
+using handler = std::function<void(std::span<const event>)>;
+
+/**
+ * @brief Start a subscriber thread. Subscribe before the game starts; events
+ * published earlier are not replayed.
+ *
+ * @param name label for the subscriber's lag metric
+ * @param on_batch called on the subscriber thread with each batch
+ * @return false if the maximum number of subscribers is reached
+ */
+bool subscribe(const std::string &name, handler on_batch);
+
+/**
+ * @brief Publish an event. Only the game calls this, with its lock held.
+ */
+void publish(const event &e);
+
+/**
+ * @brief Stop every subscriber once it has read what was published
+ */
+void stop();
+
+/**
+ * @brief Subscribe a consumer counting events by type, as
+ * rps_game_events_total
+ */
+void subscribe_metrics();
+
+} // namespace events
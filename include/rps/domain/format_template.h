@@ -0,0 +1,115 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace i18n {
+
+/**
+ * @brief A translation string parsed once into literal runs and argument
+ * slots, so formatting it is a straight append into a buffer with no format
+ * string parsing. Only plain replacement fields (`{}` and `{N}`) and the
+ * `{{`/`}}` escapes are accepted; anything else is rejected when the language
+ * file is loaded rather than when a player clicks a button.
+ */
+class format_template {
+public:
+  /**
+   * @brief Parse a translation string
+   *
+   * @param source the raw translation string
+   * @throw fmt::format_error if the string is malformed
+   */
+  explicit format_template(std::string_view source);
+
+  /**
+   * @brief A template that outputs a string as is, ignoring any arguments.
+   * Stands in for a malformed translation so it still reads as its raw text.
+   */
+  static format_template literal(std::string_view source);
+
+  /**
+   * @brief The raw translation string this template was parsed from
+   */
+  [[nodiscard]] const std::string &source() const { return text; }
+
+  /**
+   * @brief Number of arguments the template consumes
+   */
+  [[nodiscard]] size_t arg_count() const { return args_needed; }
+
+  /**
+   * @brief Append the formatted template to a buffer
+   *
+   * @param out buffer to append to
+   * @param args replacement arguments
+   * @throw fmt::format_error if fewer arguments are passed than the template
+   * references
+   */
+  template <typename... T>
+  void format_to(fmt::memory_buffer &out, const T &...args) const {
+    if (args_needed > sizeof...(T)) {
+      throw fmt::format_error("argument not found");
+    }
+    for (const auto &piece : pieces) {
+      out.append(literals.data() + piece.offset,
+                 literals.data() + piece.offset + piece.length);
+      if (piece.arg != no_arg) {
+        append_arg(out, piece.arg, std::index_sequence_for<T...>{}, args...);
+      }
+    }
+  }
+
+private:
+  format_template() = default;
+
+  static constexpr uint16_t no_arg = UINT16_MAX;
+
+  /**
+   * @brief A literal run followed by an optional argument slot
+   */
+  struct piece {
+    uint32_t offset{0};
+    uint32_t length{0};
+    uint16_t arg{no_arg};
+  };
+
+  template <size_t... I, typename... T>
+  static void append_arg(fmt::memory_buffer &out, const size_t index,
+                         std::index_sequence<I...> /*unused*/,
+                         const T &...args) {
+    ((index == I ? (void)fmt::format_to(fmt::appender(out), "{}", args)
+                 : (void)0),
+     ...);
+  }
+
+  std::string text;
+  std::string literals;
+  std::vector<piece> pieces;
+  size_t args_needed{0};
+};
+
+} // namespace i18n
@@ -24,35 +24,52 @@
 #include <dpp/snowflake.h>
 #include <dpp/timer.h>
 #include <dpp/user.h>
-#include <memory>
-
-constexpr unsigned int GAME_TIMEOUT = 30;
+#include <array>
+#include <functional>
+#include <rps/core/engine.h>
+#include <rps/domain/matchmaking.h>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 
+/**
+ * @brief Discord adapter over core::engine. Holds the game lock, keeps metrics
+ * and remembers what is needed to message each queued player.
+ */
 namespace game {
-struct player_info {
-  dpp::user player;
-  dpp::slashcommand_t init_interaction;
-  dpp::timer queue_timer{};
-  std::string choice;
-  unsigned int score{0};
 
-  player_info(const dpp::user &p, dpp::slashcommand_t i)
-      : player(p), init_interaction(std::move(i)) {}
+/**
+ * @brief What the adapter remembers about a queued player
+ */
+struct player_context {
+  dpp::user player;
+  dpp::snowflake guild_id;
+  dpp::snowflake channel_id;
+  std::string locale;
+  /** @brief Token of the player's latest button click, for follow-ups */
+  std::string token;
+  /** @brief Unix time of that click; tokens expire after 15 minutes */
+  double token_time{0};
+  /** @brief Who the player queued to play */
+  matchmaking::queue_scope scope{matchmaking::queue_scope::anyone};
+  /** @brief A practice bot, which picks on its own and is never messaged */
+  bool bot{false};
 };
 
-struct rps_lobby {
-  unsigned int id{0};
-  unsigned int game_number{1};
-  dpp::timer game_timer{};
-  std::vector<std::shared_ptr<player_info>> players;
+/**
+ * @brief A lobby and its players' contexts, copied out under the lock
+ */
+struct lobby_view {
+  core::lobby lobby;
+  std::array<player_context, 2> players;
 };
 
 /**
- * @brief Initialize global game state
- *
- * @param bot creating D++ cluster
+ * @brief Initialize global game state. outbound::set() and timing::set() must
+ * have been called.
  */
-void init(dpp::cluster &bot);
+void init();
 
 /**
  * @brief Finds a lobby that the player is in, if it exists
@@ -78,15 +95,57 @@ unsigned int get_global_lobby_id();
 
 void remove_lobby_from_queue(const unsigned int lobby_id, const bool game_over);
 unsigned int create_lobby();
-void add_player_to_lobby(const unsigned int lobby_id,
-                         const dpp::slashcommand_t &event);
+
+/**
+ * @brief Outcome of seating a player in a lobby
+ */
+enum class join_result : uint8_t {
+  seated,
+  /**
+   * @brief Seated in the last free seat; this caller starts the match
+   */
+  filled,
+  /**
+   * @brief The lobby closed or filled since it was found
+   */
+  lobby_gone,
+  /**
+   * @brief The player already holds a seat, e.g. from a second /queue or a
+   * tournament match
+   */
+  player_seated,
+};
+
+/**
+ * @brief Seat the player behind a /queue in a lobby
+ */
+join_result add_player_to_lobby(
+    const unsigned int lobby_id, const dpp::slashcommand_t &event,
+    matchmaking::queue_scope scope = matchmaking::queue_scope::anyone);
+
+/**
+ * @brief List a claimed lobby in matchmaking again under its waiting
+ * player's keys, e.g. when the joiner who claimed it could not be seated
+ */
+void requeue_lobby(const unsigned int lobby_id);
+
+/**
+ * @brief Seat each pair in a lobby of its own, in one pass under the lock,
+ * for matches arranged outside the queue such as a tournament's. The lobbies
+ * are never offered to matchmaking; start each with send_game_messages().
+ *
+ * @return std::vector<unsigned int> each pair's lobby, or 0 where a player
+ * was already seated elsewhere
+ */
+std::vector<unsigned int>
+create_matches(std::span<const std::array<player_context, 2>> pairs);
+
 void set_player_choice(const dpp::snowflake player_id,
                        const std::string &choice);
 std::string get_player_choice(const dpp::snowflake player_id);
 unsigned int get_num_players(const unsigned int lobby_id);
-rps_lobby get_lobby(const unsigned int lobby_id);
-std::shared_ptr<player_info> get_player_info(const unsigned int lobby_id,
-                                             const unsigned int index);
+player_context get_player_context(const unsigned int lobby_id,
+                                  const unsigned int index);
 dpp::snowflake get_player_id(const unsigned int lobby_id,
                              const unsigned int player_index);
 void reset_choices(const unsigned int lobby_id);
@@ -95,22 +154,77 @@ void increment_player_score(const unsigned int lobby_id,
 unsigned int get_game_num(const unsigned int lobby_id);
 void increment_game_num(const unsigned int lobby_id);
 bool check_both_responses(const unsigned int lobby_id);
-std::string determine_winner(const unsigned int lobby_id);
-std::string calculate_winner(const std::string &player_one_choice,
-                             const std::string &player_two_choice);
+core::outcome determine_winner(const unsigned int lobby_id);
 std::string get_player_name(const unsigned int lobby_id,
                             const unsigned int index);
 void send_game_messages(const unsigned int lobby_id);
 bool is_game_complete(const unsigned int lobby_id);
-void send_result_messages(const unsigned int lobby_id,
-                          const unsigned int winner, const unsigned int loser,
-                          bool draw = false);
-dpp::slashcommand_t get_player_interaction(const unsigned int lobby_id,
-                                           const unsigned int index);
-void start_queue_timer(const dpp::snowflake player_id, dpp::timer timer);
+void start_queue_timer(const dpp::snowflake player_id, uint64_t seconds,
+                       std::function<void()> on_expire);
 void clear_queue_timer(const dpp::snowflake player_id);
-void start_game_timer(const unsigned int lobby_id, dpp::timer timer);
 void clear_game_timer(const unsigned int lobby_id);
 void handle_choice(const dpp::button_click_t &event);
 void handle_timeout(const unsigned int lobby_id);
-} // namespace game
\ No newline at end of file
+
+/**
+ * @brief The variant being played, fixed by init()
+ */
+const core::variant &rules();
+
+/**
+ * @brief The choice a choice button stands for: pick:<n> for the variant's
+ * nth choice, or the choice's name on round prompts sent before pick ids
+ *
+ * @return core::choice none if the id is not one of the variant's choices
+ */
+core::choice parse_pick(std::string_view custom_id);
+
+/**
+ * @brief When practice bots are on, seat one opposite a lone queued player
+ * after config bot_wait seconds, unless the lobby has filled or closed by
+ * then. The bot picks when each game starts, countering the move its
+ * opponent's pick history predicts.
+ */
+void queue_bot(const unsigned int lobby_id, const dpp::snowflake player_id);
+
+/**
+ * @brief Number of lobbies, open or playing
+ */
+size_t lobby_count();
+
+/**
+ * @brief What became of the lobbies offered to a successor
+ */
+struct handover_result {
+  size_t checkpointed{0};
+  /**
+   * @brief Lobbies resumed here after the send failed
+   */
+  size_t restored{0};
+  bool handed_off{false};
+  /**
+   * @brief Why the send failed
+   */
+  std::string error;
+};
+
+/**
+ * @brief Take every lobby out of this process, stopping its timers, and pass
+ * them to send, in creation order with the deadlines of their timers. Clicks
+ * for these lobbies are ignored afterwards. The game lock is held throughout,
+ * so if send throws the lobbies are resumed here before anything else can
+ * create a lobby in their place.
+ */
+handover_result
+hand_over(const std::function<void(const std::vector<lobby_view> &)> &send);
+
+/**
+ * @brief Resume lobbies checkpointed by a predecessor, restarting their
+ * timers from the deadlines. Call after init() and before any lobby is
+ * created. Full lobbies that were between games are sent their next game.
+ *
+ * @param lobbies lobbies in the order hand_over() gave them
+ * @return size_t lobbies resumed
+ */
+size_t restore(std::vector<lobby_view> lobbies);
+} // namespace game
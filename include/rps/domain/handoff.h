@@ -0,0 +1,92 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <dpp/dpp.h>
+#include <optional>
+#include <rps/domain/game.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @brief Drain and state handoff for deploys. On SIGTERM the bot stops taking
+ * /queue, checkpoints every lobby and streams it over a Unix socket to its
+ * successor, which is waiting on the same socket path before it connects to
+ * the gateway and resumes the matches with their timers.
+ */
+namespace handoff {
+
+/**
+ * @brief Stream magic and version. The stream is host byte order, as both
+ * processes run on the same machine.
+ */
+constexpr char stream_magic[8] = {'R', 'P', 'S', 'H', 'N', 'D', '0', '3'};
+
+/**
+ * @brief Serialise checkpointed lobbies
+ */
+std::string encode(const std::vector<game::lobby_view> &lobbies);
+
+/**
+ * @brief Parse a stream written by encode()
+ *
+ * @throw std::runtime_error if the stream is truncated or not a handoff
+ */
+std::vector<game::lobby_view> decode(std::string_view stream);
+
+/**
+ * @brief Send lobbies to a successor listening on a socket, waiting for it to
+ * confirm it parsed them
+ *
+ * @param path Unix socket path
+ * @throw std::system_error if nothing is listening or the transfer fails
+ */
+void send(const std::string &path,
+          const std::vector<game::lobby_view> &lobbies);
+
+/**
+ * @brief Listen on a socket for a predecessor's lobbies. The socket file is
+ * replaced if stale and removed afterwards.
+ *
+ * @param path Unix socket path
+ * @param wait how long to wait for a predecessor to connect
+ * @return the lobbies, or nothing if none arrived in time
+ * @throw std::system_error if the socket cannot be bound
+ */
+std::optional<std::vector<game::lobby_view>>
+receive(const std::string &path, std::chrono::milliseconds wait);
+
+/**
+ * @brief Whether this process is draining and refusing new matches
+ */
+bool draining();
+
+/**
+ * @brief Drain this process: refuse /queue, hand every lobby to the
+ * successor on config handoff_socket if one is set, else (or if the handoff
+ * fails) wait up to drain_timeout for matches to finish, then shut the
+ * cluster down. Blocks; run it off the event loop.
+ *
+ * @param bot cluster to shut down
+ */
+void drain(dpp::cluster &bot);
+
+} // namespace handoff
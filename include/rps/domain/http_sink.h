@@ -0,0 +1,121 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <dpp/dpp.h>
+#include <functional>
+#include <mutex>
+#include <rps/domain/outbound.h>
+#include <string>
+#include <unordered_map>
+
+namespace outbound {
+
+/**
+ * @brief Sends through D++'s HTTP client to a configurable base url instead of
+ * the cluster's REST queue, which always targets discord.com. Used with
+ * config api_url to run against a local Discord stand in. Rate limit headers
+ * are honoured per bucket and 429 responses retried after retry_after.
+ * Requests go through the raw request queue, so raise request_threads_raw to
+ * match the expected concurrency.
+ */
+class http_sink : public cluster_sink {
+public:
+  /**
+   * @brief Construct a new http sink
+   *
+   * @param bot cluster whose HTTP client and log are used
+   * @param api_url base url, e.g. http://127.0.0.1:8080
+   * @param token bot token sent in the Authorization header
+   * @param dm DM channel cache limits
+   */
+  http_sink(dpp::cluster &bot, std::string api_url, std::string token,
+            dm_cache_options dm = {});
+
+  void acknowledge(const dpp::interaction_create_t &event) override;
+  void reply(const dpp::interaction_create_t &event,
+             const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const dpp::message &m) override;
+  void direct_message_sync(dpp::snowflake user_id,
+                           const dpp::message &m) override;
+  void channel_message(const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const payload &p) override;
+  void direct_message_sync(dpp::snowflake user_id, const payload &p) override;
+  void channel_message(dpp::snowflake channel_id, const payload &p) override;
+  void update(const dpp::interaction_create_t &event,
+              const payload &p) override;
+  void follow_up(const std::string &token, const payload &p) override;
+  void follow_up_sync(const std::string &token, const payload &p) override;
+
+private:
+  using steady = std::chrono::steady_clock;
+  using completion =
+      std::function<void(const dpp::http_request_completion_t &)>;
+
+  struct bucket {
+    int64_t remaining{1};
+    steady::time_point reset;
+  };
+
+  /**
+   * @brief POST a JSON body, waiting out the bucket first if it is exhausted.
+   * The call counts as in flight for backpressure until its final response.
+   *
+   * @param route metric route label
+   * @param bucket_key rate limit bucket, the route plus its major parameter
+   * @param path path below /api/v10
+   * @param body JSON body
+   * @param done called with the final response, after any retries
+   */
+  void post(const char *route, const std::string &bucket_key,
+            const std::string &path, const std::string &body,
+            completion done = {});
+
+  /**
+   * @brief One attempt of post()
+   *
+   * @param attempt retries made so far
+   */
+  void send(const char *route, const std::string &bucket_key,
+            const std::string &path, const std::string &body, completion done,
+            int attempt);
+
+  /**
+   * @brief Post a message to a user's DM channel, resolving it from the cache
+   * or creating it. A 404 drops the cached channel and retries once with a
+   * fresh one; a 403 drops it.
+   */
+  void post_direct_message(const char *route, dpp::snowflake user_id,
+                           std::string message, completion done,
+                           bool retried = false);
+
+  /**
+   * @brief post_direct_message, waiting for it to be delivered
+   */
+  void post_direct_message_sync(dpp::snowflake user_id, std::string message);
+
+  std::string base;
+  std::string authorization;
+
+  std::mutex buckets_mutex;
+  std::unordered_map<std::string, bucket> buckets;
+};
+
+} // namespace outbound
@@ -0,0 +1,79 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <rps/core/reducer.h>
+#include <string>
+#include <vector>
+
+/**
+ * @brief Append only log of every action applied to game state, written as
+ * fixed size records by a background thread, so rps_rebuild can replay a
+ * day of play and show the state at any moment.
+ */
+namespace journal {
+
+/**
+ * @brief File magic and version, written when a journal file is created,
+ * followed by core::action records in host byte order. Each process appends
+ * a session that starts with a session_start action.
+ */
+constexpr char file_magic[8] = {'R', 'P', 'S', 'J', 'R', 'N', '0', '1'};
+
+extern std::atomic<bool> active;
+
+/**
+ * @brief Check before building an action for the journal alone, so a
+ * disabled journal costs a single relaxed load
+ */
+inline bool enabled() { return active.load(std::memory_order_relaxed); }
+
+/**
+ * @brief Start journalling, appending to a file. Processes that overlap, such
+ * as during a handoff, need files of their own.
+ *
+ * @param path journal file
+ * @throw std::runtime_error if the file cannot be opened or is not a journal
+ */
+void start(const std::string &path);
+
+/**
+ * @brief Stop journalling, flushing queued actions
+ */
+void stop();
+
+/**
+ * @brief Queue an action to be written. Called by the game with its lock
+ * held, so actions are written in the order they were applied. If the writer
+ * falls a whole queue behind the action is dropped and counted, which leaves
+ * a gap replay will show.
+ */
+void record(const core::action &a);
+
+/**
+ * @brief Read every action of a journal file
+ *
+ * @param path journal file
+ * @return std::vector<core::action> actions in the order applied
+ * @throw std::runtime_error if the file is missing or not a journal
+ */
+std::vector<core::action> load(const std::string &path);
+
+} // namespace journal
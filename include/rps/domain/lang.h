@@ -19,16 +19,73 @@
 
 #include <dpp/dpp.h>
 #include <fmt/format.h>
+#include <memory>
+#include <rps/domain/format_template.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <unordered_map>
 
 namespace i18n {
 
+/**
+ * @brief Every translation string from lang.json, pre-parsed into format
+ * templates. A table is immutable once built; reloading lang.json builds a new
+ * one and swaps it in.
+ */
+class template_table {
+public:
+  /**
+   * @brief Parse every string in a lang.json document. Malformed strings are
+   * reported through the errors list and skipped.
+   *
+   * @param document parsed lang.json
+   * @param errors receives one message per malformed translation
+   */
+  template_table(const dpp::json &document, std::vector<std::string> &errors);
+
+  /**
+   * @brief Find a template, falling back to English if the locale has no
+   * translation for the key
+   *
+   * @param key translation key
+   * @param lang two letter language code
+   * @return const format_template* template, or nullptr if not found
+   */
+  [[nodiscard]] const format_template *find(const std::string &key,
+                                            const std::string &lang) const;
+
+  /**
+   * @brief Number of translation keys in the table
+   */
+  [[nodiscard]] size_t size() const { return templates.size(); }
+
+private:
+  std::unordered_map<std::string,
+                     std::unordered_map<std::string, format_template>>
+      templates;
+};
+
 time_t get_mtime(const char *path);
 
-void load_lang(dpp::cluster &bot);
+/**
+ * @brief Load lang.json. outbound::set() must have been called.
+ */
+void load_lang();
 
-void check_lang_reload(dpp::cluster &bot);
+void check_lang_reload();
+
+/**
+ * @brief Get the current translation template table
+ *
+ * @return std::shared_ptr<const template_table> table snapshot
+ */
+std::shared_ptr<const template_table> templates();
+
+/**
+ * @brief Convert an interaction locale to the two letter code used as a key
+ * in lang.json
+ */
+std::string lang_code(const std::string &locale);
 
 std::string tr(const std::string &k,
                const dpp::interaction_create_t &interaction);
@@ -38,9 +95,18 @@ dpp::slashcommand tr(dpp::slashcommand cmd);
 template <typename... T>
 std::string tr(const std::string &key,
                const dpp::interaction_create_t &interaction, T &&...args) {
+  /* Reused between calls so formatting only allocates the returned string */
+  thread_local fmt::memory_buffer buffer;
+  buffer.clear();
   try {
-    return fmt::format(fmt::runtime(tr(key, interaction)),
-                       std::forward<T>(args)...);
+    const auto table = templates();
+    const format_template *tpl =
+        table->find(key, lang_code(interaction.command.locale));
+    if (tpl == nullptr) {
+      return key;
+    }
+    tpl->format_to(buffer, args...);
+    return fmt::to_string(buffer);
   } catch (const std::exception &format_exception) {
     if (interaction.from && interaction.from->creator) {
       interaction.from->creator->log(
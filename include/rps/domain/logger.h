@@ -16,10 +16,53 @@
  *
  ************************************************************************************/
 #pragma once
+#include <atomic>
+#include <cstdint>
 #include <dpp/dpp.h>
 
 namespace logger {
 
+/**
+ * @brief Kinds of structured record
+ */
+enum class record_type : uint8_t {
+  command,
+  button_click,
+  lobby_started,
+};
+
+/**
+ * @brief A fixed size log record. Interaction handlers fill one of these with
+ * raw ids and timings and push it to a lock free ring; the text is only
+ * formatted later, on the logger thread.
+ */
+struct record {
+  record_type type{record_type::command};
+  dpp::loglevel severity{dpp::ll_info};
+  uint16_t discriminator{0};
+  float msecs{0};
+  int64_t timestamp_ns{0};
+  uint64_t user_id{0};
+  uint64_t guild_id{0};
+  uint64_t lobby_id{0};
+  char name[32]{};
+  char user[33]{};
+  char locale[7]{};
+};
+
+/**
+ * @brief Lowest severity that is logged
+ */
+extern std::atomic<int> min_severity;
+
+/**
+ * @brief Check the level before building a record, so disabled levels cost a
+ * single relaxed load
+ */
+inline bool enabled(dpp::loglevel severity) {
+  return severity >= min_severity.load(std::memory_order_relaxed);
+}
+
 /**
  * @brief Initialise spdlog logger
  *
@@ -36,4 +79,34 @@ void init(const std::string &log_file);
  */
 void log(const dpp::log_t &event);
 
+/**
+ * @brief Queue a structured record for the logger thread. Never blocks; if the
+ * ring is full the record is dropped and counted.
+ *
+ * @param r record
+ */
+void push(const record &r);
+
+/**
+ * @brief Record a routed slash command
+ *
+ * @param event slash command event
+ * @param msecs time spent routing it
+ */
+void command(const dpp::slashcommand_t &event, double msecs);
+
+/**
+ * @brief Record a button click
+ *
+ * @param event button click event
+ */
+void button_click(const dpp::button_click_t &event);
+
+/**
+ * @brief Record a lobby filling up and its match starting
+ *
+ * @param lobby_id lobby id
+ */
+void lobby_started(unsigned int lobby_id);
+
 }; // namespace logger
\ No newline at end of file
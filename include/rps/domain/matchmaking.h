@@ -0,0 +1,121 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Index of lobbies waiting for an opponent, keyed on (scope,
+ * attribute): the server a lobby was queued from, its player's language, or
+ * the global queue. A waiting lobby is listed under each key its player
+ * accepts, and a joiner tries its keys narrowest first, so widening to the
+ * next scope is one more hash lookup however many servers and languages
+ * there are.
+ *
+ * The index is split into shards by key, each with its own lock, and a claim
+ * marks the lobby taken once for all its keys; copies left under the other
+ * keys are skipped and dropped when reached. No call takes a global lock.
+ */
+namespace matchmaking {
+
+/**
+ * @brief Who a queued player is willing to play, chosen with /queue
+ */
+enum class queue_scope : uint8_t {
+  /**
+   * @brief Prefer the same server, then the same language, then anyone
+   */
+  anyone,
+  /**
+   * @brief Only players queued from the same server; anyone in DMs
+   */
+  server,
+  /**
+   * @brief Only players with the same language
+   */
+  language,
+};
+
+/**
+ * @brief The kind of scope an index key belongs to
+ */
+enum class key_kind : uint8_t {
+  guild,
+  locale,
+  global,
+};
+
+struct key {
+  key_kind kind{key_kind::global};
+  /**
+   * @brief Guild id, or the language code packed into an integer; 0 for
+   * global
+   */
+  uint64_t attribute{0};
+
+  bool operator==(const key &) const = default;
+};
+
+/**
+ * @brief A player's keys, narrowest first
+ */
+struct key_list {
+  std::array<key, 3> keys{};
+  size_t count{0};
+};
+
+/**
+ * @brief The keys a player queueing with a scope is listed under and searches
+ *
+ * @param scope scope chosen with /queue
+ * @param guild_id server queued from, 0 in DMs
+ * @param locale interaction locale
+ */
+key_list keys_for(queue_scope scope, uint64_t guild_id,
+                  const std::string &locale);
+
+/**
+ * @brief List a lobby waiting for an opponent under its player's keys
+ */
+void offer(unsigned int lobby_id, const key_list &keys);
+
+/**
+ * @brief Take the oldest waiting lobby under the first key that has one. The
+ * lobby is no longer listed under any key.
+ *
+ * @return unsigned int lobby id, or 0 if no key has one
+ */
+unsigned int claim(const key_list &keys);
+
+/**
+ * @brief Stop listing a lobby, e.g. when its player leaves or a bot joins
+ *
+ * @return false if it was not listed or someone claimed it first
+ */
+bool withdraw(unsigned int lobby_id);
+
+/**
+ * @brief Stop listing every lobby, e.g. when they are handed to a successor
+ */
+void clear();
+
+} // namespace matchmaking
@@ -0,0 +1,107 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <rps/domain/outbound.h>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/**
+ * @brief Writes a message's JSON straight into a reusable thread local
+ * buffer, for sending through the outbound::sink payload overloads. Follows
+ * the same rules as component_builder: buttons fill rows of five, at most 25,
+ * and duplicate custom ids are silently dropped.
+ *
+ * Write content first, then embeds, then buttons; anything out of that order
+ * is dropped. Only one writer may be in use per thread, and a finished
+ * payload is only valid until the thread starts another message.
+ */
+class message_writer {
+public:
+  enum class button_style : uint8_t {
+    primary = 1,
+    secondary = 2,
+    success = 3,
+    danger = 4,
+  };
+
+  static constexpr size_t max_components = 25;
+  static constexpr size_t components_per_row = 5;
+
+  message_writer();
+  message_writer(const message_writer &) = delete;
+  message_writer &operator=(const message_writer &) = delete;
+
+  message_writer &content(std::string_view text);
+
+  /**
+   * @brief Start a new embed. The setters below apply to the latest embed.
+   */
+  message_writer &embed();
+  message_writer &title(std::string_view text);
+  message_writer &description(std::string_view text);
+  message_writer &thumbnail(std::string_view url);
+  message_writer &footer(std::string_view text, std::string_view icon_url);
+  message_writer &color(uint32_t rgb);
+
+  /**
+   * @brief Add a field. Fields of an embed must be added one after another.
+   */
+  message_writer &field(std::string_view name, std::string_view value,
+                        bool is_inline);
+
+  message_writer &button(std::string_view label, std::string_view id,
+                         button_style style = button_style::primary);
+
+  /**
+   * @brief For updates, strip every button from the message being edited.
+   * Buttons added afterwards are dropped.
+   */
+  message_writer &remove_components();
+
+  /**
+   * @brief Close the message
+   *
+   * @return outbound::payload view of the thread local buffer
+   */
+  outbound::payload finish();
+
+private:
+  enum class section : uint8_t { top, embed, components };
+
+  void quote(std::string_view text);
+  void top_key(std::string_view key);
+  void embed_key(std::string_view key);
+  void close_section();
+
+  std::string &out;
+  section at{section::top};
+  bool top_keys{false};
+  bool embed_keys{false};
+  bool in_fields{false};
+  size_t components{0};
+  bool components_removed{false};
+  /**
+   * @brief Offset and length in out of each escaped custom id
+   */
+  std::array<std::pair<uint32_t, uint32_t>, max_components> ids{};
+};
@@ -0,0 +1,140 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <rps/domain/outbound.h>
+#include <thread>
+#include <vector>
+
+namespace outbound {
+
+/**
+ * @brief An in-process stand in for Discord. Calls are counted per route and
+ * delayed by a configurable latency; delayed deliveries run on the sink's own
+ * scheduler thread.
+ */
+class mock_sink : public sink {
+public:
+  enum class route : uint8_t {
+    acknowledge,
+    reply,
+    direct_message,
+    direct_message_sync,
+    channel_message,
+    update,
+    follow_up,
+    follow_up_sync,
+    count,
+  };
+
+  struct options {
+    /**
+     * @brief Simulated latency of every call
+     */
+    std::chrono::microseconds latency{0};
+    /**
+     * @brief Uniform random jitter added to the latency
+     */
+    std::chrono::microseconds jitter{0};
+  };
+
+  explicit mock_sink(options o);
+  ~mock_sink() override;
+  mock_sink(const mock_sink &) = delete;
+  mock_sink &operator=(const mock_sink &) = delete;
+
+  void acknowledge(const dpp::interaction_create_t &event) override;
+  void reply(const dpp::interaction_create_t &event,
+             const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const dpp::message &m) override;
+  void direct_message_sync(dpp::snowflake user_id,
+                           const dpp::message &m) override;
+  void channel_message(const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const payload &p) override;
+  void direct_message_sync(dpp::snowflake user_id, const payload &p) override;
+  void channel_message(dpp::snowflake channel_id, const payload &p) override;
+  void update(const dpp::interaction_create_t &event,
+              const payload &p) override;
+  void follow_up(const std::string &token, const payload &p) override;
+  void follow_up_sync(const std::string &token, const payload &p) override;
+  void log(dpp::loglevel severity, const std::string &message) override;
+
+  /**
+   * @brief Called when a direct message is delivered, after its latency. Set
+   * before any traffic is generated.
+   */
+  std::function<void(dpp::snowflake user_id, bool has_components)>
+      on_direct_message;
+
+  /**
+   * @brief Lowest severity passed to stderr by log()
+   */
+  dpp::loglevel log_level{dpp::ll_warning};
+
+  [[nodiscard]] uint64_t calls(route r) const {
+    return counts[static_cast<size_t>(r)].load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] uint64_t total_calls() const;
+
+  [[nodiscard]] static const char *route_name(route r);
+
+private:
+  using steady = std::chrono::steady_clock;
+
+  struct task {
+    steady::time_point due;
+    uint64_t sequence{0};
+    std::function<void()> run;
+
+    bool operator>(const task &other) const {
+      return due != other.due ? due > other.due : sequence > other.sequence;
+    }
+  };
+
+  void count(route r) {
+    counts[static_cast<size_t>(r)].fetch_add(1, std::memory_order_relaxed);
+  }
+  steady::duration delay();
+  void deliver(dpp::snowflake user_id, bool has_components);
+  void deliver_sync(dpp::snowflake user_id, bool has_components);
+  void schedule(steady::time_point due, std::function<void()> run);
+  void run_scheduler();
+
+  options opts;
+  std::array<std::atomic<uint64_t>, static_cast<size_t>(route::count)>
+      counts{};
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::priority_queue<task, std::vector<task>, std::greater<>> tasks;
+  uint64_t next_sequence{0};
+  bool stopping{false};
+  std::thread scheduler;
+};
+
+} // namespace outbound
@@ -0,0 +1,103 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Bounded lock free queue for many producers and one consumer (Dmitry
+ * Vyukov's sequenced ring). Producers never block; when the ring is full
+ * try_push fails and the caller decides what to drop.
+ *
+ * @tparam T trivially copyable element
+ * @tparam Capacity number of slots, a power of two
+ */
+template <typename T, size_t Capacity> class mpsc_ring {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  mpsc_ring() {
+    for (size_t i = 0; i < Capacity; ++i) {
+      cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpsc_ring(const mpsc_ring &) = delete;
+  mpsc_ring &operator=(const mpsc_ring &) = delete;
+
+  /**
+   * @brief Add an element, safe from any thread
+   *
+   * @return false if the ring is full
+   */
+  bool try_push(const T &value) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    for (;;) {
+      cell &c = cells[pos & (Capacity - 1)];
+      const size_t seq = c.sequence.load(std::memory_order_acquire);
+      const auto diff =
+          static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed)) {
+          c.data = value;
+          c.sequence.store(pos + 1, std::memory_order_release);
+          return true;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  /**
+   * @brief Remove the oldest element, only from the consumer thread
+   *
+   * @return false if the ring is empty
+   */
+  bool try_pop(T &value) {
+    cell &c = cells[tail & (Capacity - 1)];
+    const size_t seq = c.sequence.load(std::memory_order_acquire);
+    if (static_cast<std::ptrdiff_t>(seq) -
+            static_cast<std::ptrdiff_t>(tail + 1) <
+        0) {
+      return false;
+    }
+    value = c.data;
+    c.sequence.store(tail + Capacity, std::memory_order_release);
+    ++tail;
+    return true;
+  }
+
+private:
+  struct cell {
+    std::atomic<size_t> sequence{0};
+    T data{};
+  };
+
+  std::array<cell, Capacity> cells;
+  alignas(64) std::atomic<size_t> head{0};
+  alignas(64) size_t tail{0};
+};
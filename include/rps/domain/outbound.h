@@ -0,0 +1,208 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <dpp/dpp.h>
+#include <functional>
+#include <rps/domain/dm_channel_cache.h>
+#include <rps/domain/metrics.h>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Everything the game sends to Discord goes through a sink. The bot
+ * uses a cluster_sink; the simulator and replay tools swap in a mock so the
+ * full match flow can run without a connection.
+ */
+namespace outbound {
+
+/**
+ * @brief A message already serialised to Discord's JSON, see message_writer.
+ * Sinks copy what they need before returning.
+ */
+struct payload {
+  std::string_view json;
+  /**
+   * @brief The message carries components
+   */
+  bool has_components{false};
+};
+
+class sink {
+public:
+  virtual ~sink() = default;
+
+  /**
+   * @brief Acknowledge a component interaction without a visible reply
+   */
+  virtual void acknowledge(const dpp::interaction_create_t &event) = 0;
+
+  /**
+   * @brief Reply to an interaction
+   */
+  virtual void reply(const dpp::interaction_create_t &event,
+                     const dpp::message &m) = 0;
+
+  /**
+   * @brief Send a direct message to a user
+   */
+  virtual void direct_message(dpp::snowflake user_id,
+                              const dpp::message &m) = 0;
+
+  /**
+   * @brief Send a direct message to a user, returning once it is delivered
+   */
+  virtual void direct_message_sync(dpp::snowflake user_id,
+                                   const dpp::message &m) = 0;
+
+  /**
+   * @brief Send a message to the channel set on it
+   */
+  virtual void channel_message(const dpp::message &m) = 0;
+
+  /**
+   * @brief Send a prepared direct message to a user
+   */
+  virtual void direct_message(dpp::snowflake user_id, const payload &p) = 0;
+
+  /**
+   * @brief Send a prepared direct message, returning once it is delivered
+   */
+  virtual void direct_message_sync(dpp::snowflake user_id,
+                                   const payload &p) = 0;
+
+  /**
+   * @brief Send a prepared message to a channel
+   */
+  virtual void channel_message(dpp::snowflake channel_id,
+                               const payload &p) = 0;
+
+  /**
+   * @brief Answer a component interaction by editing the message it came from
+   */
+  virtual void update(const dpp::interaction_create_t &event,
+                      const payload &p) = 0;
+
+  /**
+   * @brief Send a follow-up message on an interaction, within 15 minutes of it
+   *
+   * @param token the interaction's token
+   */
+  virtual void follow_up(const std::string &token, const payload &p) = 0;
+
+  /**
+   * @brief Send a follow-up message, returning once it is delivered
+   */
+  virtual void follow_up_sync(const std::string &token, const payload &p) = 0;
+
+  /**
+   * @brief Log a message
+   */
+  virtual void log(dpp::loglevel severity, const std::string &message) = 0;
+};
+
+/**
+ * @brief Sends through a live cluster, recording REST latency metrics and
+ * trace spans for each call
+ */
+class cluster_sink : public sink {
+public:
+  explicit cluster_sink(dpp::cluster &bot, dm_cache_options dm = {})
+      : cluster(bot), dm_channels(dm) {}
+
+  void acknowledge(const dpp::interaction_create_t &event) override;
+  void reply(const dpp::interaction_create_t &event,
+             const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const dpp::message &m) override;
+  void direct_message_sync(dpp::snowflake user_id,
+                           const dpp::message &m) override;
+  void channel_message(const dpp::message &m) override;
+  void direct_message(dpp::snowflake user_id, const payload &p) override;
+  void direct_message_sync(dpp::snowflake user_id, const payload &p) override;
+  void channel_message(dpp::snowflake channel_id, const payload &p) override;
+  void update(const dpp::interaction_create_t &event,
+              const payload &p) override;
+  void follow_up(const std::string &token, const payload &p) override;
+  void follow_up_sync(const std::string &token, const payload &p) override;
+  void log(dpp::loglevel severity, const std::string &message) override;
+
+protected:
+  /**
+   * @brief Resolve a user's DM channel from the cache, creating it on a miss
+   *
+   * @param then called with the channel id, or 0 if it could not be resolved
+   */
+  void with_dm_channel(dpp::snowflake user_id,
+                       std::function<void(dpp::snowflake)> then);
+
+  /**
+   * @brief POST a prepared message body to a channel. A channel id of 0 is
+   * skipped.
+   *
+   * @param done called with the HTTP status once the request completes,
+   * successful or not; 0 if nothing was sent
+   */
+  void post_message(metrics::histogram &latency, const char *route,
+                    dpp::snowflake channel_id, std::string body,
+                    std::function<void(uint16_t)> done = {});
+
+  /**
+   * @brief POST a body to a REST path
+   *
+   * @param endpoint path up to the major parameter, e.g. API_PATH "/channels"
+   * @param major major parameter; each value is its own rate limit bucket
+   * @param parameters rest of the path
+   * @param done called with the HTTP status once the request completes
+   */
+  void post(metrics::histogram &latency, const char *route,
+            const std::string &endpoint, const std::string &major,
+            const std::string &parameters, std::string body,
+            std::function<void(uint16_t)> done = {});
+
+  /**
+   * @brief POST a prepared message body to a user's DM channel. A 404 drops
+   * the cached channel and retries once with a fresh one; a 403 drops it.
+   */
+  void post_direct_message(metrics::histogram &latency, const char *route,
+                           dpp::snowflake user_id, std::string body,
+                           std::function<void()> done = {},
+                           bool retried = false);
+
+  dpp::cluster &cluster;
+  dm_channel_cache dm_channels;
+};
+
+/**
+ * @brief Latency histogram for an outbound REST route
+ *
+ * @param route route label, e.g. message_create
+ */
+metrics::histogram &rest_latency(const char *route);
+
+/**
+ * @brief Install the sink used by the game. Must outlive every call to get().
+ */
+void set(sink &s);
+
+/**
+ * @brief Get the installed sink
+ */
+sink &get();
+
+} // namespace outbound
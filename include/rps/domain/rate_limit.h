@@ -0,0 +1,125 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <dpp/snowflake.h>
+#include <memory>
+
+/**
+ * @brief Abuse protection for inbound interactions: a per user token bucket
+ * and a short lived record of recently seen keys. Both are fixed size tables
+ * of atomics, so checking them never takes a lock or allocates; an entry
+ * pushed out by a collision fails open (a fresh bucket, a missed duplicate).
+ */
+namespace rate_limit {
+
+/**
+ * @brief Token buckets keyed by user, in 4-way associative sets
+ */
+class token_buckets {
+public:
+  /**
+   * @param slots table size, rounded up to a power of two
+   */
+  explicit token_buckets(size_t slots = 1 << 16);
+
+  /**
+   * @brief Take a token from a user's bucket
+   *
+   * @param key user id, not 0
+   * @param now_ms current time in milliseconds, from any fixed origin
+   * @param burst bucket size, at most 8000 tokens
+   * @param per_minute tokens refilled per minute
+   * @return true if a token was taken
+   */
+  bool try_acquire(uint64_t key, uint64_t now_ms, uint32_t burst,
+                   uint32_t per_minute);
+
+private:
+  static constexpr size_t ways = 4;
+  /** @brief Low bits of a state hold thousandths of a token */
+  static constexpr unsigned token_bits = 23;
+  static constexpr uint64_t token_mask = (uint64_t{1} << token_bits) - 1;
+
+  struct slot {
+    std::atomic<uint64_t> owner{0};
+    /** @brief Last refill time in ms above token_bits, tokens below */
+    std::atomic<uint64_t> state{0};
+  };
+
+  std::atomic<uint64_t> &find(uint64_t key, uint64_t now_ms, uint64_t full);
+
+  std::unique_ptr<slot[]> table;
+  size_t mask;
+};
+
+/**
+ * @brief Keys seen within a time window. Direct mapped: each slot holds a
+ * key fingerprint and the time it was last seen, packed in one word.
+ */
+class recent_keys {
+public:
+  /**
+   * @param slots table size, rounded up to a power of two
+   */
+  explicit recent_keys(size_t slots = 1 << 16);
+
+  /**
+   * @brief Record a key and report whether it was already seen
+   *
+   * @param key any key; hashed before use
+   * @param now_s current time in seconds, from any fixed origin
+   * @param window_s seconds a key is remembered, under 2^20
+   * @return true if the key was seen in the last window_s seconds
+   */
+  bool seen(uint64_t key, uint64_t now_s, uint64_t window_s);
+
+private:
+  static constexpr unsigned time_bits = 20;
+  static constexpr uint64_t time_mask = (uint64_t{1} << time_bits) - 1;
+
+  std::unique_ptr<std::atomic<uint64_t>[]> table;
+  size_t mask;
+};
+
+/**
+ * @brief Take a token from a user's bucket, sized by the rate_limit_burst
+ * and rate_limit_per_minute settings. Uses game time.
+ *
+ * @return true if the user may proceed; always true when rate_limit_burst
+ * is 0
+ */
+bool allow(dpp::snowflake user_id);
+
+/**
+ * @brief Whether an interaction id was already handled, e.g. redelivered
+ * after a gateway resume
+ */
+bool duplicate_interaction(dpp::snowflake interaction_id);
+
+/**
+ * @brief Whether a user already chose in this round of a lobby
+ */
+bool duplicate_choice(dpp::snowflake user_id, unsigned int lobby_id,
+                      unsigned int game_number);
+
+} // namespace rate_limit
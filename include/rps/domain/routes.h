@@ -0,0 +1,35 @@
+/************************************************************************************
+ *
+ * Copyright 1993,2001,2023 Craig Edwards <brain@ssod.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+#pragma once
+#include <rps/domain/buttons/choice.h>
+#include <rps/domain/commands/leave.h>
+#include <rps/domain/commands/queue.h>
+#include <rps/domain/commands/stats.h>
+#include <rps/domain/commands/tournament.h>
+#include <rps/domain/dispatch.h>
+
+/**
+ * @brief Every slash command the bot registers and routes
+ */
+using slash_commands = dispatch::type_list<queue_command, leave_command,
+                                          stats_command, tournament_command>;
+
+/**
+ * @brief Every button handler the bot routes
+ */
+using button_handlers = dispatch::type_list<choice_button>;
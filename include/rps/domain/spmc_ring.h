@@ -0,0 +1,151 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/**
+ * @brief Bounded lock free broadcast ring for one producer and several
+ * consumers, in the style of the LMAX disruptor: every consumer sees every
+ * element, tracks its own position, and reads in batches straight from the
+ * ring. The producer never blocks; when the slowest consumer is a full ring
+ * behind, try_publish fails and the caller decides what to drop.
+ *
+ * @tparam T trivially copyable element
+ * @tparam Capacity number of slots, a power of two
+ * @tparam MaxConsumers most consumers that can be added
+ */
+template <typename T, size_t Capacity, size_t MaxConsumers = 8>
+class spmc_ring {
+  static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0,
+                "Capacity must be a power of two");
+
+public:
+  spmc_ring() = default;
+  spmc_ring(const spmc_ring &) = delete;
+  spmc_ring &operator=(const spmc_ring &) = delete;
+
+  /**
+   * @brief Add a consumer. Call before the first publish.
+   *
+   * @return size_t consumer index for consume(), or MaxConsumers if full
+   */
+  size_t add_consumer() {
+    const size_t index = consumers.load(std::memory_order_relaxed);
+    if (index >= MaxConsumers) {
+      return MaxConsumers;
+    }
+    gates[index].next.store(cursor.load(std::memory_order_relaxed),
+                            std::memory_order_relaxed);
+    consumers.store(index + 1, std::memory_order_release);
+    return index;
+  }
+
+  /**
+   * @brief Publish an element, only from the producer thread
+   *
+   * @return false if a consumer is a full ring behind
+   */
+  bool try_publish(const T &value) {
+    const uint64_t seq = cursor.load(std::memory_order_relaxed);
+    if (seq - gate_cache >= Capacity) {
+      gate_cache = slowest(seq);
+      if (seq - gate_cache >= Capacity) {
+        return false;
+      }
+    }
+    slots[seq & (Capacity - 1)] = value;
+    cursor.store(seq + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Hand a consumer everything published since its last call, in at
+   * most two contiguous runs (the ring may wrap), then release the slots
+   *
+   * @param consumer index from add_consumer(), only from that consumer's
+   * thread
+   * @param on_batch called with each run; the elements stay valid until it
+   * returns
+   * @param max_batch most elements to take in one call
+   * @return size_t elements consumed
+   */
+  template <typename F>
+  size_t consume(size_t consumer, F &&on_batch, size_t max_batch = Capacity) {
+    std::atomic<uint64_t> &next = gates[consumer].next;
+    const uint64_t from = next.load(std::memory_order_relaxed);
+    const uint64_t available = cursor.load(std::memory_order_acquire) - from;
+    const auto count =
+        static_cast<size_t>(std::min<uint64_t>(available, max_batch));
+    if (count == 0) {
+      return 0;
+    }
+    const size_t start = from & (Capacity - 1);
+    const size_t first = std::min(count, Capacity - start);
+    on_batch(std::span<const T>(slots.data() + start, first));
+    if (first < count) {
+      on_batch(std::span<const T>(slots.data(), count - first));
+    }
+    next.store(from + count, std::memory_order_release);
+    return count;
+  }
+
+  /**
+   * @brief Elements published so far
+   */
+  [[nodiscard]] uint64_t published() const {
+    return cursor.load(std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Elements a consumer has yet to read
+   */
+  [[nodiscard]] uint64_t lag(size_t consumer) const {
+    return published() - gates[consumer].next.load(std::memory_order_acquire);
+  }
+
+private:
+  uint64_t slowest(uint64_t seq) const {
+    uint64_t min = seq;
+    const size_t count = consumers.load(std::memory_order_acquire);
+    for (size_t i = 0; i < count; ++i) {
+      min = std::min(min, gates[i].next.load(std::memory_order_acquire));
+    }
+    return min;
+  }
+
+  struct alignas(64) gate {
+    std::atomic<uint64_t> next{0};
+  };
+
+  std::array<T, Capacity> slots{};
+  alignas(64) std::atomic<uint64_t> cursor{0};
+  /**
+   * @brief Producer's last view of the slowest consumer, so the gates are
+   * only read when the ring looks full
+   */
+  uint64_t gate_cache{0};
+  std::atomic<size_t> consumers{0};
+  std::array<gate, MaxConsumers> gates;
+};
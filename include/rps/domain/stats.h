@@ -0,0 +1,40 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <rps/core/history.h>
+
+/**
+ * @brief Player statistics for /stats. Rounds are read off the event bus into
+ * a columnar history, so recording them adds nothing to resolving a round.
+ */
+namespace stats {
+
+/**
+ * @brief Subscribe the history to game events. Call once, after config is
+ * loaded and before the game starts.
+ */
+void subscribe();
+
+/**
+ * @brief Every round kept, sized by config history_rows
+ */
+const core::history &history();
+
+} // namespace stats
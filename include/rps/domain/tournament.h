@@ -0,0 +1,141 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <dpp/dispatcher.h>
+#include <dpp/message.h>
+#include <dpp/snowflake.h>
+#include <optional>
+#include <rps/core/tournament.h>
+#include <rps/domain/game.h>
+#include <string>
+#include <string_view>
+
+/**
+ * @brief Tournaments, one per server channel. Entrants sign up in the
+ * channel and are seeded in a random order when the organiser starts it.
+ *
+ * One driver thread runs every tournament: once a second it applies the
+ * results of finished matches, replays matches whose lobby closed without a
+ * result reaching it, seats up to config tournament_batch ready matches
+ * through game::create_matches() and sends their prompts, posts a bracket
+ * update to each changed tournament's channel at most every config
+ * tournament_post_interval seconds, and saves every bracket to config
+ * tournament_file. Matches are ordinary lobbies, so they need no threads of
+ * their own and survive a handoff like any other.
+ */
+namespace tournament {
+
+/**
+ * @brief File magic and version of a saved tournament file
+ */
+constexpr char file_magic[8] = {'R', 'P', 'S', 'T', 'R', 'N', '0', '1'};
+
+/**
+ * @brief Outcome of a tournament command
+ */
+enum class result : uint8_t {
+  ok,
+  /**
+   * @brief The channel already has a tournament
+   */
+  exists,
+  /**
+   * @brief The channel has no tournament
+   */
+  none,
+  /**
+   * @brief Sign ups are closed
+   */
+  started,
+  already_joined,
+  not_joined,
+  too_few,
+  not_organiser,
+};
+
+/**
+ * @brief Open sign ups for a tournament in a channel
+ *
+ * @param rounds Swiss rounds, 0 for enough to find a sole winner
+ */
+result open(dpp::snowflake channel_id, const game::player_context &organiser,
+            core::tournament_format format, unsigned int rounds);
+
+result join(dpp::snowflake channel_id, const game::player_context &player);
+
+/**
+ * @brief Withdraw before the tournament starts
+ */
+result leave(dpp::snowflake channel_id, dpp::snowflake player_id);
+
+/**
+ * @brief Close sign ups and build the bracket. Organiser only.
+ */
+result begin(dpp::snowflake channel_id, dpp::snowflake player_id);
+
+/**
+ * @brief Drop a channel's tournament; matches in progress play out but no
+ * longer count. Organiser only.
+ */
+result cancel(dpp::snowflake channel_id, dpp::snowflake player_id);
+
+/**
+ * @brief The current bracket of a channel's tournament
+ */
+std::optional<dpp::message>
+summary(dpp::snowflake channel_id,
+        const dpp::interaction_create_t &interaction);
+
+/**
+ * @brief Follow match results. Call with the other event subscribers, before
+ * game::init().
+ */
+void subscribe();
+
+/**
+ * @brief Load saved tournaments and start the driver. Call after any handoff
+ * restore, so matches whose lobbies did not survive a restart are started
+ * again.
+ *
+ * @throw std::runtime_error if the saved file cannot be read. It is moved
+ * aside to <file>.bad, or saving is turned off if that fails, and the driver
+ * runs regardless with no tournaments.
+ */
+void start();
+
+/**
+ * @brief Stop the driver and save every tournament
+ */
+void stop();
+
+/**
+ * @brief Serialise every tournament
+ */
+std::string encode();
+
+/**
+ * @brief Replace every tournament with those of a stream written by encode()
+ *
+ * @throw std::runtime_error if the stream is truncated or inconsistent
+ */
+void decode(std::string_view stream);
+
+} // namespace tournament
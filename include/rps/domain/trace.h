@@ -0,0 +1,125 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Lightweight per-interaction tracing. An interaction_scope marks the
+ * current thread as working on an interaction; spans opened while it is active
+ * are timed with the monotonic clock and appended to a buffer owned by the
+ * thread, so recording takes no locks shared with other threads. Interactions
+ * are sampled by id (trace_sample_rate in config.json), so every hop of a
+ * sampled interaction is recorded, across threads, and unsampled ones cost one
+ * thread local read per span.
+ */
+namespace trace {
+
+/**
+ * @brief Monotonic time in nanoseconds
+ */
+inline int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+/**
+ * @brief Whether an interaction is sampled at the configured rate
+ */
+bool sampled(uint64_t interaction_id);
+
+/**
+ * @brief Interaction the current thread is tracing, 0 if none
+ */
+uint64_t current();
+
+/**
+ * @brief Record a finished span in the calling thread's buffer
+ */
+void record(const char *name, uint64_t interaction_id, int64_t start_ns,
+            int64_t end_ns);
+
+/**
+ * @brief Marks the current thread as handling an interaction until it goes out
+ * of scope
+ */
+class interaction_scope {
+public:
+  explicit interaction_scope(uint64_t interaction_id);
+  ~interaction_scope();
+  interaction_scope(const interaction_scope &) = delete;
+  interaction_scope &operator=(const interaction_scope &) = delete;
+
+private:
+  uint64_t previous;
+};
+
+/**
+ * @brief Times the enclosing scope. name must be a string literal.
+ */
+class span {
+public:
+  explicit span(const char *n)
+      : name(n), interaction(current()), start(interaction ? now_ns() : 0) {}
+  ~span() {
+    if (interaction != 0) {
+      record(name, interaction, start, now_ns());
+    }
+  }
+  span(const span &) = delete;
+  span &operator=(const span &) = delete;
+
+private:
+  const char *name;
+  uint64_t interaction;
+  int64_t start;
+};
+
+/**
+ * @brief A span that is started on one thread and finished on another, such
+ * as a REST call completing in a D++ callback. Copyable so it can be captured
+ * in a callback.
+ */
+class async_span {
+public:
+  explicit async_span(const char *n)
+      : name(n), interaction(current()), start(interaction ? now_ns() : 0) {}
+
+  void finish() const {
+    if (interaction != 0) {
+      record(name, interaction, start, now_ns());
+    }
+  }
+
+private:
+  const char *name;
+  uint64_t interaction;
+  int64_t start;
+};
+
+/**
+ * @brief Render every buffered span in the Chrome/Perfetto trace event JSON
+ * format
+ */
+std::string dump();
+
+} // namespace trace
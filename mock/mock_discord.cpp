@@ -0,0 +1,1070 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Local Discord stand in for integration performance tests. Serves the REST
+ * routes the bot uses, with Discord style rate limit headers and 429
+ * responses, and a JSON gateway that drives a population of virtual players:
+ * they /queue, receive round prompts as DMs through the REST routes, and click
+ * a choice after a think time. Point the bot at it with config api_url (REST)
+ * and gateway_host (gateway) to measure throughput end to end, including
+ * D++'s HTTP and WebSocket clients, on an offline machine.
+ *
+ * D++ always connects to the gateway with TLS on port 443, so serve it there
+ * with a certificate (D++ does not verify it, a self signed one will do):
+ *
+ *   openssl req -x509 -newkey rsa:2048 -nodes -subj /CN=localhost \
+ *     -keyout mock.key -out mock.crt
+ *   rps_mock_discord -cert mock.crt -key mock.key
+ *
+ * Usage: rps_mock_discord [-port <n>] [-gatewayport <n>] [-cert <file>]
+ *   [-key <file>] [-players <n>] [-think <s>] [-arrival <s>] [-rejoin <s>]
+ *   [-afk <p>] [-guilds <p>] [-latency <ms>] [-channellimit <n>]
+ *   [-globallimit <n>]
+ */
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dpp/json.h>
+#include <fmt/format.h>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <openssl/err.h>
+#include <openssl/evp.h>
+#include <openssl/sha.h>
+#include <openssl/ssl.h>
+#include <queue>
+#include <random>
+#include <set>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using json = dpp::json;
+using mock_clock = std::chrono::steady_clock;
+
+struct options {
+  uint16_t port{8080};
+  uint16_t gateway_port{443};
+  std::string cert;
+  std::string key;
+  size_t players{200};
+  /* Mean decision time per round, seconds */
+  double think{1};
+  /* Mean idle time between matches, seconds */
+  double arrival{2};
+  /* Seconds without a prompt after which a player considers the match over */
+  double rejoin{40};
+  double afk{0.02};
+  double guilds{0.5};
+  double latency_ms{0};
+  /* Messages per channel per 5 seconds */
+  int channel_limit{5};
+  /* Bot token requests per second, across every route */
+  int global_limit{50};
+};
+
+options opts;
+
+constexpr uint64_t discord_epoch_ms = 1420070400000;
+constexpr uint64_t application_id = 900000000000000001;
+constexpr uint64_t command_id = 900000000000000002;
+constexpr uint64_t dm_channel_base = 800000000000000000;
+
+uint64_t next_snowflake() {
+  static std::atomic<uint64_t> increment{0};
+  const auto now_ms = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::milliseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count());
+  return ((now_ms - discord_epoch_ms) << 22) | (increment++ & 0x3FFFFF);
+}
+
+json bot_user() {
+  return {{"id", std::to_string(application_id)},
+          {"username", "rps"},
+          {"discriminator", "0"},
+          {"avatar", nullptr},
+          {"bot", true}};
+}
+
+/* Counters */
+
+struct stats {
+  std::mutex mutex;
+  std::map<std::string, uint64_t> requests;
+  std::map<std::string, uint64_t> limited;
+  std::atomic<uint64_t> interactions{0};
+  std::atomic<uint64_t> prompts{0};
+
+  void request(const std::string &route, bool was_limited) {
+    std::lock_guard<std::mutex> lock(mutex);
+    requests[route]++;
+    if (was_limited) {
+      limited[route]++;
+    }
+  }
+} counters;
+
+/* Connections */
+
+/**
+ * @brief A client socket, optionally wrapped in TLS
+ */
+class connection {
+public:
+  connection(int socket, SSL *tls) : fd(socket), ssl(tls) {}
+  ~connection() {
+    if (ssl != nullptr) {
+      SSL_shutdown(ssl);
+      SSL_free(ssl);
+    }
+    close(fd);
+  }
+  connection(const connection &) = delete;
+  connection &operator=(const connection &) = delete;
+
+  /**
+   * @brief Read at least one byte, appending to buffer
+   *
+   * @return false on EOF or error
+   */
+  bool read_more(std::string &buffer) {
+    char chunk[16384];
+    const int n = ssl != nullptr ? SSL_read(ssl, chunk, sizeof(chunk))
+                                 : static_cast<int>(recv(fd, chunk,
+                                                         sizeof(chunk), 0));
+    if (n <= 0) {
+      return false;
+    }
+    buffer.append(chunk, static_cast<size_t>(n));
+    return true;
+  }
+
+  bool write_all(std::string_view data) {
+    std::lock_guard<std::mutex> lock(write_mutex);
+    while (!data.empty()) {
+      const int n =
+          ssl != nullptr
+              ? SSL_write(ssl, data.data(), static_cast<int>(data.size()))
+              : static_cast<int>(
+                    send(fd, data.data(), data.size(), MSG_NOSIGNAL));
+      if (n <= 0) {
+        return false;
+      }
+      data.remove_prefix(static_cast<size_t>(n));
+    }
+    return true;
+  }
+
+private:
+  int fd;
+  SSL *ssl;
+  std::mutex write_mutex;
+};
+
+struct request {
+  std::string method;
+  std::string path;
+  std::map<std::string, std::string> headers;
+  std::string body;
+};
+
+/**
+ * @brief Read one HTTP request from the connection
+ *
+ * @return false if the connection closed first
+ */
+bool read_request(connection &c, std::string &buffer, request &r) {
+  size_t end;
+  while ((end = buffer.find("\r\n\r\n")) == std::string::npos) {
+    if (!c.read_more(buffer)) {
+      return false;
+    }
+  }
+  const std::string head = buffer.substr(0, end);
+  buffer.erase(0, end + 4);
+
+  size_t line_end = head.find("\r\n");
+  const std::string request_line = head.substr(0, line_end);
+  const size_t sp1 = request_line.find(' ');
+  const size_t sp2 = request_line.find(' ', sp1 + 1);
+  r.method = request_line.substr(0, sp1);
+  r.path = request_line.substr(sp1 + 1, sp2 - sp1 - 1);
+  r.headers.clear();
+  while (line_end != std::string::npos) {
+    const size_t start = line_end + 2;
+    line_end = head.find("\r\n", start);
+    const std::string line = head.substr(
+        start, line_end == std::string::npos ? std::string::npos
+                                             : line_end - start);
+    const size_t colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string name = line.substr(0, colon);
+    for (auto &ch : name) {
+      ch = static_cast<char>(std::tolower(static_cast<unsigned char>(ch)));
+    }
+    const size_t value_start = line.find_first_not_of(' ', colon + 1);
+    r.headers[name] =
+        value_start == std::string::npos ? "" : line.substr(value_start);
+  }
+
+  const size_t length = r.headers.count("content-length") != 0
+                            ? std::stoul(r.headers["content-length"])
+                            : 0;
+  while (buffer.size() < length) {
+    if (!c.read_more(buffer)) {
+      return false;
+    }
+  }
+  r.body = buffer.substr(0, length);
+  buffer.erase(0, length);
+  return true;
+}
+
+std::string status_text(int status) {
+  switch (status) {
+  case 200:
+    return "OK";
+  case 204:
+    return "No Content";
+  case 400:
+    return "Bad Request";
+  case 404:
+    return "Not Found";
+  case 429:
+    return "Too Many Requests";
+  default:
+    return "Unknown";
+  }
+}
+
+struct response {
+  int status{200};
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+
+  [[nodiscard]] std::string serialise() const {
+    std::string out =
+        fmt::format("HTTP/1.1 {} {}\r\nContent-Length: {}\r\n", status,
+                    status_text(status), body.size());
+    if (!body.empty()) {
+      out += "Content-Type: application/json\r\n";
+    }
+    for (const auto &[name, value] : headers) {
+      out += name + ": " + value + "\r\n";
+    }
+    return out + "\r\n" + body;
+  }
+};
+
+/* Rate limits */
+
+/**
+ * @brief Discord style fixed window buckets: `limit` requests per window,
+ * the window starting at the first request after the last one expired
+ */
+class rate_limiter {
+public:
+  struct verdict {
+    bool allowed{true};
+    bool global{false};
+    int limit{0};
+    int remaining{0};
+    double reset_after{0};
+  };
+
+  verdict check(const std::string &bucket, int limit,
+                std::chrono::milliseconds window, bool counts_globally) {
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto now = mock_clock::now();
+    if (counts_globally && opts.global_limit > 0) {
+      state &g = take(global_bucket, now, std::chrono::seconds(1));
+      if (g.used >= opts.global_limit) {
+        return verdict{false, true, opts.global_limit, 0, seconds(g, now)};
+      }
+      g.used++;
+    }
+    state &b = take(buckets[bucket], now, window);
+    if (b.used >= limit) {
+      return verdict{false, false, limit, 0, seconds(b, now)};
+    }
+    b.used++;
+    return verdict{true, false, limit, limit - b.used, seconds(b, now)};
+  }
+
+private:
+  struct state {
+    int used{0};
+    mock_clock::time_point reset;
+  };
+
+  static state &take(state &s, mock_clock::time_point now,
+                     mock_clock::duration window) {
+    if (now >= s.reset) {
+      s.used = 0;
+      s.reset = now + window;
+    }
+    return s;
+  }
+
+  static double seconds(const state &s, mock_clock::time_point now) {
+    return std::chrono::duration<double>(s.reset - now).count();
+  }
+
+  std::mutex mutex;
+  state global_bucket;
+  std::unordered_map<std::string, state> buckets;
+} limiter;
+
+/* Virtual players */
+
+enum class player_state { idle, queued, playing };
+
+struct player {
+  uint64_t id{0};
+  uint64_t guild_id{0};
+  uint64_t channel_id{0};
+  std::string username;
+  player_state state{player_state::idle};
+  mock_clock::time_point last_activity;
+};
+
+class gateway_session;
+
+/**
+ * @brief The virtual player population, driven from a single thread
+ */
+class population {
+public:
+  void init() {
+    std::mt19937_64 setup(1);
+    std::bernoulli_distribution in_guild(opts.guilds);
+    for (size_t i = 0; i < opts.players; ++i) {
+      player p;
+      p.id = 100000 + i;
+      p.username = "player" + std::to_string(i);
+      if (in_guild(setup)) {
+        p.guild_id = 1000 + i % 16;
+        p.channel_id = 2000 + i % 64;
+      } else {
+        p.channel_id = dm_channel_base + p.id;
+      }
+      players.push_back(std::move(p));
+    }
+  }
+
+  /**
+   * @brief A message was posted to a DM channel. Called from REST threads.
+   */
+  void on_direct_message(uint64_t channel_id, const json &message) {
+    if (channel_id <= dm_channel_base || !message.contains("components") ||
+        message["components"].empty()) {
+      return;
+    }
+    counters.prompts++;
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    prompts.push_back(channel_id - dm_channel_base);
+  }
+
+  void attach(const std::shared_ptr<gateway_session> &session) {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    sessions.push_back(session);
+  }
+
+  void detach(const gateway_session *session) {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    std::erase_if(sessions,
+                  [session](const auto &s) { return s.get() == session; });
+  }
+
+  void run();
+
+private:
+  enum class action_type { queue, choose };
+
+  struct action {
+    mock_clock::time_point due;
+    size_t player{0};
+    action_type type{action_type::queue};
+
+    bool operator>(const action &other) const { return due > other.due; }
+  };
+
+  mock_clock::duration exponential(double mean_seconds) {
+    std::exponential_distribution<double> dist(1.0 / mean_seconds);
+    return std::chrono::duration_cast<mock_clock::duration>(
+        std::chrono::duration<double>(dist(rng)));
+  }
+
+  void perform(const action &a);
+  json interaction(const player &p, int type, json data);
+  bool dispatch(const json &interaction_data);
+
+  std::mt19937_64 rng{2};
+  std::vector<player> players;
+  std::priority_queue<action, std::vector<action>, std::greater<>> actions;
+
+  std::mutex inbox_mutex;
+  std::vector<uint64_t> prompts;
+
+  std::mutex sessions_mutex;
+  std::vector<std::shared_ptr<gateway_session>> sessions;
+  size_t next_session{0};
+} virtual_players;
+
+/* Gateway */
+
+std::string websocket_accept(const std::string &key) {
+  const std::string magic = key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+  unsigned char digest[SHA_DIGEST_LENGTH];
+  SHA1(reinterpret_cast<const unsigned char *>(magic.data()), magic.size(),
+       digest);
+  unsigned char encoded[64];
+  const int n = EVP_EncodeBlock(encoded, digest, SHA_DIGEST_LENGTH);
+  return {reinterpret_cast<char *>(encoded), static_cast<size_t>(n)};
+}
+
+class gateway_session {
+public:
+  explicit gateway_session(connection &c) : conn(c) {}
+
+  bool send(const json &payload) {
+    const std::string text = payload.dump();
+    std::string frame;
+    frame.push_back(static_cast<char>(0x81));
+    if (text.size() < 126) {
+      frame.push_back(static_cast<char>(text.size()));
+    } else if (text.size() <= 0xFFFF) {
+      frame.push_back(126);
+      frame.push_back(static_cast<char>(text.size() >> 8));
+      frame.push_back(static_cast<char>(text.size() & 0xFF));
+    } else {
+      frame.push_back(127);
+      for (int shift = 56; shift >= 0; shift -= 8) {
+        frame.push_back(static_cast<char>((text.size() >> shift) & 0xFF));
+      }
+    }
+    return conn.write_all(frame + text);
+  }
+
+  /**
+   * @brief Send a dispatch event with the next sequence number
+   */
+  bool dispatch(const std::string &type, json data) {
+    return send({{"op", 0},
+                 {"t", type},
+                 {"s", ++sequence},
+                 {"d", std::move(data)}});
+  }
+
+  /**
+   * @brief Read one complete client frame's payload
+   *
+   * @return false when the connection closes
+   */
+  bool read_frame(std::string &buffer, std::string &payload, int &opcode) {
+    while (true) {
+      if (buffer.size() >= 2) {
+        const auto *bytes =
+            reinterpret_cast<const unsigned char *>(buffer.data());
+        opcode = bytes[0] & 0x0F;
+        const bool masked = (bytes[1] & 0x80) != 0;
+        uint64_t length = bytes[1] & 0x7F;
+        size_t offset = 2;
+        if (length == 126 && buffer.size() >= 4) {
+          length = (uint64_t{bytes[2]} << 8) | bytes[3];
+          offset = 4;
+        } else if (length == 127 && buffer.size() >= 10) {
+          length = 0;
+          for (int i = 0; i < 8; ++i) {
+            length = (length << 8) | bytes[2 + i];
+          }
+          offset = 10;
+        } else if (length >= 126) {
+          offset = 0;
+        }
+        const size_t mask_offset = offset;
+        if (offset != 0 && masked) {
+          offset += 4;
+        }
+        if (offset != 0 && buffer.size() >= offset + length) {
+          payload = buffer.substr(offset, length);
+          if (masked) {
+            for (size_t i = 0; i < payload.size(); ++i) {
+              payload[i] = static_cast<char>(
+                  payload[i] ^ buffer[mask_offset + (i % 4)]);
+            }
+          }
+          buffer.erase(0, offset + length);
+          return true;
+        }
+      }
+      if (!conn.read_more(buffer)) {
+        return false;
+      }
+    }
+  }
+
+private:
+  connection &conn;
+  std::atomic<int64_t> sequence{0};
+};
+
+void run_gateway(connection &c, std::string buffer, const request &upgrade) {
+  const auto key = upgrade.headers.find("sec-websocket-key");
+  if (key == upgrade.headers.end()) {
+    c.write_all(response{400}.serialise());
+    return;
+  }
+  c.write_all(fmt::format("HTTP/1.1 101 Switching Protocols\r\n"
+                          "Upgrade: websocket\r\nConnection: Upgrade\r\n"
+                          "Sec-WebSocket-Accept: {}\r\n\r\n",
+                          websocket_accept(key->second)));
+
+  auto session = std::make_shared<gateway_session>(c);
+  session->send({{"op", 10}, {"d", {{"heartbeat_interval", 41250}}}});
+
+  std::string payload;
+  int opcode{0};
+  while (session->read_frame(buffer, payload, opcode)) {
+    if (opcode == 0x8) {
+      break;
+    }
+    if (opcode != 0x1) {
+      continue;
+    }
+    json message;
+    try {
+      message = json::parse(payload);
+    } catch (const std::exception &) {
+      continue;
+    }
+    const int op = message.value("op", -1);
+    if (op == 1) {
+      session->send({{"op", 11}});
+    } else if (op == 2) {
+      session->dispatch(
+          "READY",
+          {{"v", 10},
+           {"user", bot_user()},
+           {"guilds", json::array()},
+           {"session_id", fmt::format("mock-{}", next_snowflake())},
+           {"resume_gateway_url", "wss://127.0.0.1"},
+           {"shard", json::array({0, 1})},
+           {"application",
+            {{"id", std::to_string(application_id)}, {"flags", 0}}}});
+      virtual_players.attach(session);
+      std::cerr << "Gateway session identified\n";
+    }
+  }
+  virtual_players.detach(session.get());
+  std::cerr << "Gateway session closed\n";
+}
+
+/* REST */
+
+std::vector<std::string> split_path(const std::string &path) {
+  std::vector<std::string> parts;
+  size_t start = 0;
+  const std::string clean = path.substr(0, path.find('?'));
+  while (start < clean.size()) {
+    size_t end = clean.find('/', start);
+    if (end == std::string::npos) {
+      end = clean.size();
+    }
+    if (end > start) {
+      parts.push_back(clean.substr(start, end - start));
+    }
+    start = end + 1;
+  }
+  return parts;
+}
+
+response limited(const rate_limiter::verdict &v, const std::string &bucket) {
+  response r;
+  r.headers.emplace_back("X-RateLimit-Limit", std::to_string(v.limit));
+  r.headers.emplace_back("X-RateLimit-Remaining", std::to_string(v.remaining));
+  r.headers.emplace_back("X-RateLimit-Reset-After",
+                         fmt::format("{:.3f}", v.reset_after));
+  r.headers.emplace_back(
+      "X-RateLimit-Reset",
+      fmt::format("{:.3f}",
+                  std::chrono::duration<double>(
+                      std::chrono::system_clock::now().time_since_epoch())
+                          .count() +
+                      v.reset_after));
+  r.headers.emplace_back("X-RateLimit-Bucket", bucket);
+  if (!v.allowed) {
+    r.status = 429;
+    r.headers.emplace_back("Retry-After",
+                           std::to_string(static_cast<int>(v.reset_after) + 1));
+    r.headers.emplace_back("X-RateLimit-Scope", v.global ? "global" : "user");
+    if (v.global) {
+      r.headers.emplace_back("X-RateLimit-Global", "true");
+    }
+    r.body = json{{"message", "You are being rate limited."},
+                  {"retry_after", v.reset_after},
+                  {"global", v.global}}
+                 .dump();
+  }
+  return r;
+}
+
+response route_request(const request &req) {
+  const auto parts = split_path(req.path);
+  /* api, v10, ... */
+  const size_t base = parts.size() >= 2 && parts[0] == "api" ? 2 : 0;
+  auto at = [&](size_t i) -> std::string {
+    return base + i < parts.size() ? parts[base + i] : "";
+  };
+  const size_t depth = parts.size() - base;
+
+  if (req.method == "POST" && depth == 3 && at(0) == "users" &&
+      at(2) == "channels") {
+    auto v = limiter.check("create_dm", opts.global_limit,
+                           std::chrono::seconds(1), true);
+    counters.request("create_dm", !v.allowed);
+    response r = limited(v, "create_dm");
+    if (v.allowed) {
+      const json body = json::parse(req.body);
+      const std::string recipient = body.value("recipient_id", "0");
+      r.body = json{{"id", std::to_string(dm_channel_base +
+                                          std::stoull(recipient))},
+                    {"type", 1},
+                    {"recipients", json::array({{{"id", recipient},
+                                                 {"username", "player"},
+                                                 {"discriminator", "0"}}})}}
+                   .dump();
+    }
+    return r;
+  }
+
+  if (req.method == "POST" && depth == 3 && at(0) == "channels" &&
+      at(2) == "messages") {
+    const std::string bucket = "channel:" + at(1);
+    auto v = limiter.check(bucket, opts.channel_limit,
+                           std::chrono::seconds(5), true);
+    counters.request("message_create", !v.allowed);
+    response r = limited(v, bucket);
+    if (v.allowed) {
+      json message = json::parse(req.body);
+      virtual_players.on_direct_message(std::stoull(at(1)), message);
+      message["id"] = std::to_string(next_snowflake());
+      message["channel_id"] = at(1);
+      message["author"] = bot_user();
+      message["timestamp"] = "2024-01-01T00:00:00.000000+00:00";
+      r.body = message.dump();
+    }
+    return r;
+  }
+
+  if (req.method == "POST" && depth == 4 && at(0) == "interactions" &&
+      at(3) == "callback") {
+    /* Interaction tokens do not count towards the global limit */
+    const std::string bucket = "interaction:" + at(1);
+    auto v = limiter.check(bucket, 5, std::chrono::seconds(1), false);
+    counters.request("interaction_callback", !v.allowed);
+    response r = limited(v, bucket);
+    if (v.allowed) {
+      r.status = 204;
+    }
+    return r;
+  }
+
+  if (req.method == "POST" && depth == 3 && at(0) == "webhooks") {
+    /* Follow-ups share the interaction token's limit, not the global one */
+    const std::string bucket = "webhook:" + at(2);
+    auto v = limiter.check(bucket, 5, std::chrono::seconds(1), false);
+    counters.request("follow_up", !v.allowed);
+    response r = limited(v, bucket);
+    if (v.allowed) {
+      json message = json::parse(req.body);
+      message["id"] = std::to_string(next_snowflake());
+      message["webhook_id"] = at(1);
+      message["author"] = bot_user();
+      message["timestamp"] = "2024-01-01T00:00:00.000000+00:00";
+      r.body = message.dump();
+    }
+    return r;
+  }
+
+  counters.request("other", false);
+  if (req.method == "GET" && depth == 2 && at(0) == "gateway" &&
+      at(1) == "bot") {
+    return response{200,
+                    {},
+                    json{{"url", "wss://127.0.0.1"},
+                         {"shards", 1},
+                         {"session_start_limit",
+                          {{"total", 1000},
+                           {"remaining", 1000},
+                           {"reset_after", 0},
+                           {"max_concurrency", 1}}}}
+                        .dump()};
+  }
+  if (req.method == "GET" && depth == 2 && at(0) == "users" &&
+      at(1) == "@me") {
+    return response{200, {}, bot_user().dump()};
+  }
+  if (req.method == "PUT" && at(0) == "applications") {
+    return response{200, {}, "[]"};
+  }
+  return response{404, {}, R"({"message":"404: Not Found","code":0})"};
+}
+
+void serve_connection(int fd, SSL_CTX *tls) {
+  SSL *ssl = nullptr;
+  if (tls != nullptr) {
+    ssl = SSL_new(tls);
+    SSL_set_fd(ssl, fd);
+    if (SSL_accept(ssl) <= 0) {
+      SSL_free(ssl);
+      close(fd);
+      return;
+    }
+  }
+  connection c(fd, ssl);
+  std::string buffer;
+  request req;
+  while (read_request(c, buffer, req)) {
+    const auto upgrade = req.headers.find("upgrade");
+    if (upgrade != req.headers.end() &&
+        strcasecmp(upgrade->second.c_str(), "websocket") == 0) {
+      run_gateway(c, std::move(buffer), req);
+      return;
+    }
+    response r;
+    try {
+      r = route_request(req);
+    } catch (const std::exception &e) {
+      r = response{400, {}, json{{"message", e.what()}, {"code", 0}}.dump()};
+    }
+    if (opts.latency_ms > 0) {
+      std::this_thread::sleep_for(
+          std::chrono::duration<double, std::milli>(opts.latency_ms));
+    }
+    if (!c.write_all(r.serialise())) {
+      return;
+    }
+  }
+}
+
+void listen_on(uint16_t port, SSL_CTX *tls) {
+  const int listener = socket(AF_INET, SOCK_STREAM, 0);
+  const int yes = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  sockaddr_in addr{};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 ||
+      listen(listener, 128) != 0) {
+    std::cerr << fmt::format("Cannot listen on port {}: {}\n", port,
+                             std::strerror(errno));
+    exit(1);
+  }
+  std::thread([listener, tls]() {
+    const int nodelay = 1;
+    while (true) {
+      const int fd = accept(listener, nullptr, nullptr);
+      if (fd < 0) {
+        continue;
+      }
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+      std::thread(serve_connection, fd, tls).detach();
+    }
+  }).detach();
+}
+
+/* Player driver */
+
+json population::interaction(const player &p, int type, json data) {
+  const json user = {{"id", std::to_string(p.id)},
+                     {"username", p.username},
+                     {"discriminator", "0"},
+                     {"global_name", p.username},
+                     {"avatar", nullptr}};
+  const uint64_t id = next_snowflake();
+  json i = {{"id", std::to_string(id)},
+            {"application_id", std::to_string(application_id)},
+            {"type", type},
+            {"token", fmt::format("token{}", id)},
+            {"version", 1},
+            {"locale", "en-US"},
+            {"channel_id", std::to_string(p.channel_id)},
+            {"data", std::move(data)}};
+  if (p.guild_id != 0) {
+    i["guild_id"] = std::to_string(p.guild_id);
+    i["member"] = {{"user", user},
+                   {"roles", json::array()},
+                   {"joined_at", "2024-01-01T00:00:00.000000+00:00"}};
+  } else {
+    i["user"] = user;
+  }
+  return i;
+}
+
+bool population::dispatch(const json &interaction_data) {
+  std::shared_ptr<gateway_session> session;
+  {
+    std::lock_guard<std::mutex> lock(sessions_mutex);
+    if (sessions.empty()) {
+      return false;
+    }
+    session = sessions[next_session++ % sessions.size()];
+  }
+  counters.interactions++;
+  return session->dispatch("INTERACTION_CREATE", interaction_data);
+}
+
+void population::perform(const action &a) {
+  player &p = players[a.player];
+  const auto now = mock_clock::now();
+  if (a.type == action_type::queue) {
+    if (p.state != player_state::idle) {
+      return;
+    }
+    if (!dispatch(interaction(p, 2,
+                              {{"id", std::to_string(command_id)},
+                               {"name", "queue"},
+                               {"type", 1}}))) {
+      /* No bot connected yet, try again later */
+      actions.push(action{now + std::chrono::seconds(1), a.player,
+                          action_type::queue});
+      return;
+    }
+    p.state = player_state::queued;
+    p.last_activity = now;
+  } else {
+    /* Every variant has at least two choices; a third is ignored by
+     * variants without one */
+    static const char *const choices[] = {"pick:1", "pick:2", "pick:3"};
+    json click = interaction(p, 3,
+                             {{"custom_id", choices[rng() % 3]},
+                              {"component_type", 2}});
+    click["message"] = {{"id", std::to_string(next_snowflake())},
+                        {"channel_id", std::to_string(p.channel_id)},
+                        {"author", bot_user()},
+                        {"content", ""},
+                        {"timestamp", "2024-01-01T00:00:00.000000+00:00"}};
+    dispatch(click);
+  }
+}
+
+void population::run() {
+  const auto start = mock_clock::now();
+  for (size_t i = 0; i < players.size(); ++i) {
+    actions.push(action{start + exponential(opts.arrival), i,
+                        action_type::queue});
+  }
+  const auto rejoin = std::chrono::duration_cast<mock_clock::duration>(
+      std::chrono::duration<double>(opts.rejoin));
+  std::bernoulli_distribution afk(opts.afk);
+  auto next_sweep = start;
+  while (true) {
+    const auto now = mock_clock::now();
+
+    std::vector<uint64_t> ready;
+    {
+      std::lock_guard<std::mutex> lock(inbox_mutex);
+      ready.swap(prompts);
+    }
+    for (const uint64_t user_id : ready) {
+      if (user_id < 100000 || user_id - 100000 >= players.size()) {
+        continue;
+      }
+      const size_t index = user_id - 100000;
+      players[index].state = player_state::playing;
+      players[index].last_activity = now;
+      if (!afk(rng)) {
+        actions.push(
+            action{now + exponential(opts.think), index, action_type::choose});
+      }
+    }
+
+    while (!actions.empty() && actions.top().due <= now) {
+      const action a = actions.top();
+      actions.pop();
+      perform(a);
+    }
+
+    /* Prompts stop when a match ends, so a quiet player is back in the pool */
+    if (now >= next_sweep) {
+      for (size_t i = 0; i < players.size(); ++i) {
+        player &p = players[i];
+        if (p.state != player_state::idle && now - p.last_activity > rejoin) {
+          p.state = player_state::idle;
+          actions.push(
+              action{now + exponential(opts.arrival), i, action_type::queue});
+        }
+      }
+      next_sweep = now + std::chrono::milliseconds(100);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+void report_forever() {
+  std::map<std::string, uint64_t> last;
+  uint64_t last_interactions{0};
+  constexpr int interval = 5;
+  while (true) {
+    std::this_thread::sleep_for(std::chrono::seconds(interval));
+    std::map<std::string, uint64_t> requests, limited_now;
+    {
+      std::lock_guard<std::mutex> lock(counters.mutex);
+      requests = counters.requests;
+      limited_now = counters.limited;
+    }
+    const uint64_t interactions = counters.interactions.load();
+    std::string line = fmt::format(
+        "interactions {:.1f}/s, prompts {}",
+        static_cast<double>(interactions - last_interactions) / interval,
+        counters.prompts.load());
+    for (const auto &[route, count] : requests) {
+      line += fmt::format(", {} {:.1f}/s ({} limited)", route,
+                          static_cast<double>(count - last[route]) / interval,
+                          limited_now[route]);
+    }
+    std::cout << line << std::endl;
+    last = requests;
+    last_interactions = interactions;
+  }
+}
+
+void parse(int argc, char const *argv[]) {
+  struct option long_opts[] = {
+      {"port", required_argument, nullptr, 'p'},
+      {"gatewayport", required_argument, nullptr, 'g'},
+      {"cert", required_argument, nullptr, 'c'},
+      {"key", required_argument, nullptr, 'k'},
+      {"players", required_argument, nullptr, 'n'},
+      {"think", required_argument, nullptr, 't'},
+      {"arrival", required_argument, nullptr, 'a'},
+      {"rejoin", required_argument, nullptr, 'r'},
+      {"afk", required_argument, nullptr, 'f'},
+      {"guilds", required_argument, nullptr, 'u'},
+      {"latency", required_argument, nullptr, 'l'},
+      {"channellimit", required_argument, nullptr, 'C'},
+      {"globallimit", required_argument, nullptr, 'G'},
+      {nullptr, 0, nullptr, 0}};
+
+  int index{0};
+  int arg;
+  opterr = 0;
+  while ((arg = getopt_long_only(argc, (char *const *)argv, "", long_opts,
+                                 &index)) != -1) {
+    switch (arg) {
+    case 'p':
+      opts.port = static_cast<uint16_t>(std::atoi(optarg));
+      break;
+    case 'g':
+      opts.gateway_port = static_cast<uint16_t>(std::atoi(optarg));
+      break;
+    case 'c':
+      opts.cert = optarg;
+      break;
+    case 'k':
+      opts.key = optarg;
+      break;
+    case 'n':
+      opts.players = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 't':
+      opts.think = std::atof(optarg);
+      break;
+    case 'a':
+      opts.arrival = std::atof(optarg);
+      break;
+    case 'r':
+      opts.rejoin = std::atof(optarg);
+      break;
+    case 'f':
+      opts.afk = std::atof(optarg);
+      break;
+    case 'u':
+      opts.guilds = std::atof(optarg);
+      break;
+    case 'l':
+      opts.latency_ms = std::atof(optarg);
+      break;
+    case 'C':
+      opts.channel_limit = std::atoi(optarg);
+      break;
+    case 'G':
+      opts.global_limit = std::atoi(optarg);
+      break;
+    case '?':
+    default:
+      std::cerr << "Usage: " << argv[0]
+                << " [-port <n>] [-gatewayport <n>] [-cert <file>]"
+                   " [-key <file>] [-players <n>] [-think <s>]"
+                   " [-arrival <s>] [-rejoin <s>] [-afk <p>] [-guilds <p>]"
+                   " [-latency <ms>] [-channellimit <n>]"
+                   " [-globallimit <n>]\n";
+      exit(1);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  parse(argc, argv);
+
+  SSL_CTX *tls = nullptr;
+  if (!opts.cert.empty()) {
+    tls = SSL_CTX_new(TLS_server_method());
+    if (SSL_CTX_use_certificate_chain_file(tls, opts.cert.c_str()) != 1 ||
+        SSL_CTX_use_PrivateKey_file(tls, opts.key.c_str(), SSL_FILETYPE_PEM) !=
+            1) {
+      ERR_print_errors_fp(stderr);
+      return 1;
+    }
+  } else {
+    std::cerr << "No -cert given, serving the gateway without TLS; D++ will "
+                 "not be able to connect to it\n";
+  }
+
+  listen_on(opts.port, nullptr);
+  listen_on(opts.gateway_port, tls);
+  std::cerr << fmt::format("REST on http://127.0.0.1:{}, gateway on port {}, "
+                           "{} virtual players\n",
+                           opts.port, opts.gateway_port, opts.players);
+
+  virtual_players.init();
+  std::thread(report_forever).detach();
+  virtual_players.run();
+}
@@ -0,0 +1,236 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Rebuilds game state from journal files, recorded with config journal_file,
+ * by replaying their actions through core::reduce at full speed. Prints the
+ * state as it stood at the end, or at a given moment, and the reducer's
+ * throughput. Timers never fire during a rebuild: their expiries were
+ * journalled as the actions they applied. Picks are checked against the
+ * variant played, one of the built in ones.
+ *
+ * Usage: rps_rebuild <journal file>... [-until <unix time>] [-show <n>]
+ *                    [-repeat <n>] [-variant classic|rpsls]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <iostream>
+#include <limits>
+#include <rps/core/clock.h>
+#include <rps/core/engine.h>
+#include <rps/core/reducer.h>
+#include <rps/domain/journal.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+struct options {
+  std::vector<std::string> files;
+  double until{std::numeric_limits<double>::infinity()};
+  /* Lobbies to list */
+  size_t show{20};
+  /* Replays to time, for benchmarking the reducer */
+  unsigned int repeat{1};
+  const core::variant *variant{&core::classic};
+};
+
+options parse(int argc, char const *argv[]) {
+  struct option long_opts[] = {{"until", required_argument, nullptr, 'u'},
+                               {"show", required_argument, nullptr, 's'},
+                               {"repeat", required_argument, nullptr, 'r'},
+                               {"variant", required_argument, nullptr, 'v'},
+                               {nullptr, 0, nullptr, 0}};
+
+  options o;
+  int index{0};
+  int arg;
+  bool bad{false};
+  opterr = 0;
+  while ((arg = getopt_long_only(argc, (char *const *)argv, "", long_opts,
+                                 &index)) != -1) {
+    switch (arg) {
+    case 'u':
+      o.until = std::atof(optarg);
+      break;
+    case 's':
+      o.show = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'r':
+      o.repeat = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'v':
+      o.variant = core::builtin(optarg);
+      bad = bad || o.variant == nullptr;
+      break;
+    case '?':
+    default:
+      bad = true;
+      break;
+    }
+  }
+  for (int i = optind; i < argc; ++i) {
+    o.files.emplace_back(argv[i]);
+  }
+  if (bad || o.files.empty() || o.repeat == 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " <journal file>... [-until <unix time>] [-show <n>]"
+                 " [-repeat <n>] [-variant classic|rpsls]\n";
+    exit(1);
+  }
+  return o;
+}
+
+/**
+ * @brief Reads the time of the action being replayed. Timers are handed out
+ * but never fire.
+ */
+class replay_clock : public core::clock {
+public:
+  [[nodiscard]] std::chrono::nanoseconds now() const override {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::duration<double>(at));
+  }
+  [[nodiscard]] double unix_time() const override { return at; }
+  core::timer start_timer(core::timer_callback, uint64_t) override {
+    return ++next_timer;
+  }
+  void stop_timer(core::timer) override {}
+
+  double at{0};
+
+private:
+  core::timer next_timer{0};
+};
+
+/**
+ * @brief Actions that changed nothing, which the game should not journal
+ * unless something raced
+ */
+struct anomalies {
+  uint64_t refused_seats{0};
+  uint64_t missing_removes{0};
+  uint64_t refused_restores{0};
+};
+
+/**
+ * @brief Replay actions up to a moment into a fresh engine
+ *
+ * @return size_t actions applied
+ */
+size_t rebuild(const std::vector<core::action> &actions, double until,
+               replay_clock &clock, core::engine &state, anomalies &seen) {
+  size_t applied{0};
+  for (const core::action &a : actions) {
+    if (a.time > until) {
+      break;
+    }
+    clock.at = a.time;
+    const core::applied out = core::reduce(state, a);
+    applied++;
+    if (a.type == core::action_type::add_player && !out.ok) {
+      seen.refused_seats++;
+    } else if (a.type == core::action_type::remove_lobby && !out.removed) {
+      seen.missing_removes++;
+    } else if (a.type == core::action_type::restore_lobby && !out.ok) {
+      seen.refused_restores++;
+    }
+  }
+  return applied;
+}
+
+std::string pick_name(const core::variant &rules, core::choice c) {
+  const std::string_view name = rules.name_of(c);
+  return name.empty() ? "-" : std::string(name);
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  const options opts = parse(argc, argv);
+
+  std::vector<core::action> actions;
+  try {
+    for (const auto &file : opts.files) {
+      std::vector<core::action> more = journal::load(file);
+      actions.insert(actions.end(), more.begin(), more.end());
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  size_t applied{0};
+  anomalies seen;
+  replay_clock clock;
+  core::engine state(clock, *opts.variant);
+  const auto start = std::chrono::steady_clock::now();
+  for (unsigned int i = 0; i < opts.repeat; ++i) {
+    seen = {};
+    state.release_all();
+    applied = rebuild(actions, opts.until, clock, state, seen);
+  }
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  const double seconds = elapsed.count();
+  const double total = static_cast<double>(applied) * opts.repeat;
+
+  std::printf("%zu of %zu actions applied in %.3fs (%.0f/s, %u replays)\n",
+              applied, actions.size(), seconds,
+              seconds > 0 ? total / seconds : 0.0, opts.repeat);
+  std::printf("state at %.3f\n", clock.at);
+  std::printf("lobbies            %10zu  (%zu open)\n", state.lobby_count(),
+              state.open_lobby_count());
+  std::printf("last lobby id      %10u\n", state.last_lobby_id());
+  std::printf("timers             %10zu queue  %zu game\n",
+              state.queue_timer_count(), state.game_timer_count());
+  std::printf("refused seats      %10llu\n",
+              static_cast<unsigned long long>(seen.refused_seats));
+  std::printf("missing removes    %10llu\n",
+              static_cast<unsigned long long>(seen.missing_removes));
+  std::printf("refused restores   %10llu\n",
+              static_cast<unsigned long long>(seen.refused_restores));
+
+  /* Release to list them in creation order; the state is not used after */
+  const std::vector<core::lobby> lobbies = state.release_all();
+  for (size_t i = 0; i < lobbies.size() && i < opts.show; ++i) {
+    const core::lobby &l = lobbies[i];
+    std::printf("lobby %u game %u", l.id, l.game_number);
+    if (l.game_deadline != 0) {
+      std::printf(" due %.3f", l.game_deadline);
+    }
+    for (const auto &p : l.players) {
+      std::printf("  [%llu score %u pick %s",
+                  static_cast<unsigned long long>(p.id), p.score,
+                  pick_name(state.rules(), p.pick).c_str());
+      if (p.queue_deadline != 0) {
+        std::printf(" queued until %.3f", p.queue_deadline);
+      }
+      std::printf("]");
+    }
+    std::printf("\n");
+  }
+  if (lobbies.size() > opts.show) {
+    std::printf("... %zu more\n", lobbies.size() - opts.show);
+  }
+  return 0;
+}
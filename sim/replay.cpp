@@ -0,0 +1,187 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Replays a capture file, recorded with config capture_file, into the real
+ * command and button handlers against a mock outbound sink. Game time is a
+ * virtual clock that follows the capture, so queue and game timeouts fire at
+ * the same points in the traffic on every run however fast it is replayed.
+ *
+ * Usage: rps_replay <capture file> [-speed <x|max>] [-latency <ms>]
+ *                   [-jitter <ms>]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <rps/domain/capture.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
+#include <rps/domain/game.h>
+#include <rps/domain/lang.h>
+#include <rps/domain/listeners.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/mock_sink.h>
+#include <rps/domain/outbound.h>
+#include <string>
+#include <thread>
+
+namespace {
+
+using replay_clock = std::chrono::steady_clock;
+
+struct options {
+  std::string file;
+  /* Multiple of the captured pace, 0 for as fast as possible */
+  double speed{1};
+  double latency_ms{0};
+  double jitter_ms{0};
+};
+
+options parse(int argc, char const *argv[]) {
+  struct option long_opts[] = {{"speed", required_argument, nullptr, 's'},
+                               {"latency", required_argument, nullptr, 'l'},
+                               {"jitter", required_argument, nullptr, 'j'},
+                               {nullptr, 0, nullptr, 0}};
+
+  options o;
+  int index{0};
+  int arg;
+  opterr = 0;
+  while ((arg = getopt_long_only(argc, (char *const *)argv, "", long_opts,
+                                 &index)) != -1) {
+    switch (arg) {
+    case 's':
+      o.speed = std::strcmp(optarg, "max") == 0 ? 0 : std::atof(optarg);
+      break;
+    case 'l':
+      o.latency_ms = std::atof(optarg);
+      break;
+    case 'j':
+      o.jitter_ms = std::atof(optarg);
+      break;
+    case '?':
+    default:
+      o.file.clear();
+      optind = argc;
+      break;
+    }
+  }
+  if (optind < argc) {
+    o.file = argv[optind];
+  }
+  if (o.file.empty() || o.speed < 0) {
+    std::cerr << "Usage: " << argv[0]
+              << " <capture file> [-speed <x|max>] [-latency <ms>]"
+                 " [-jitter <ms>]\n";
+    exit(1);
+  }
+  return o;
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  const options opts = parse(argc, argv);
+
+  std::vector<capture::record> records;
+  try {
+    records = capture::load(opts.file);
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << "\n";
+    return 1;
+  }
+
+  config::settings settings;
+  settings.trace_sample_rate = 0;
+  config::init(settings);
+
+  outbound::mock_sink sink(outbound::mock_sink::options{
+      .latency = std::chrono::microseconds(
+          static_cast<int64_t>(opts.latency_ms * 1000)),
+      .jitter = std::chrono::microseconds(
+          static_cast<int64_t>(opts.jitter_ms * 1000)),
+  });
+  outbound::set(sink);
+  timing::virtual_clock clock;
+  timing::set(clock);
+  i18n::load_lang();
+  game::init();
+
+  /* Game time stands still while a handler runs, so time them for real */
+  metrics::histogram handler_latency;
+  const auto start = replay_clock::now();
+  uint64_t commands{0}, clicks{0};
+  for (const auto &r : records) {
+    const std::chrono::microseconds offset(r.offset_us);
+    if (opts.speed > 0) {
+      std::this_thread::sleep_until(
+          start + std::chrono::duration_cast<replay_clock::duration>(
+                      std::chrono::duration<double, std::micro>(
+                          static_cast<double>(r.offset_us) / opts.speed)));
+    }
+    clock.advance_to(offset);
+    metrics::scoped_timer timer(handler_latency);
+    if (r.type == capture::record_type::slashcommand) {
+      listeners::on_slashcommand(capture::to_slashcommand(r));
+      commands++;
+    } else {
+      listeners::on_buttonclick(capture::to_button_click(r));
+      clicks++;
+    }
+  }
+  const std::chrono::duration<double> elapsed = replay_clock::now() - start;
+
+  /* Let in flight rounds finish, then run out every pending timeout */
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  const std::chrono::microseconds captured(
+      records.empty() ? 0 : records.back().offset_us);
+  clock.advance_to(captured + std::chrono::hours(2));
+
+  const auto &matches = metrics::get_counter(
+      "rps_matches_completed_total", "Matches played to a result or timeout");
+  const auto &rounds = metrics::get_histogram(
+      "rps_click_to_result_seconds",
+      "Time from the click that completes a round to its results being sent");
+  const double completed = static_cast<double>(matches.get());
+  const double seconds = elapsed.count();
+  const auto &h = handler_latency;
+
+  std::printf("%zu interactions (%llu commands, %llu clicks) captured over "
+              "%.1fs, replayed in %.2fs (%.0f/s)\n",
+              records.size(), static_cast<unsigned long long>(commands),
+              static_cast<unsigned long long>(clicks),
+              std::chrono::duration<double>(captured).count(), seconds,
+              seconds > 0 ? records.size() / seconds : 0.0);
+  std::printf("matches completed  %10.0f\n", completed);
+  std::printf("rounds resolved    %10llu\n",
+              static_cast<unsigned long long>(rounds.total()));
+  std::printf("handler latency    p50 %6.3fms  p99 %6.3fms  p99.9 %6.3fms\n",
+              h.percentile_us(0.5) / 1e3, h.percentile_us(0.99) / 1e3,
+              h.percentile_us(0.999) / 1e3);
+  std::printf("REST calls         %10llu  (%.2f per match)\n",
+              static_cast<unsigned long long>(sink.total_calls()),
+              completed > 0 ? sink.total_calls() / completed : 0.0);
+
+  /* Detached game threads may still be running; skip static destruction */
+  std::fflush(stdout);
+  std::quick_exit(0);
+}
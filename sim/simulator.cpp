@@ -0,0 +1,424 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Offline load simulator. Drives the real command and button handlers with
+ * synthetic interactions from a population of virtual players, against a mock
+ * outbound sink with configurable REST latency, and reports match throughput,
+ * round latency and REST calls per match. Game time is a virtual clock run at
+ * 1/-timescale of wall time, and player think and idle times are given in
+ * simulated seconds, so timeouts and player behaviour shrink together.
+ *
+ * Usage: rps_sim [-players <n>] [-duration <s>] [-timescale <x>]
+ *                [-think <s>] [-arrival <s>] [-afk <p>] [-latency <ms>]
+ *                [-jitter <ms>] [-guilds <p>]
+ *                [-delivery messages|interactions] [-variant classic|rpsls]
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <dpp/dpp.h>
+#include <fmt/format.h>
+#include <getopt.h>
+#include <iostream>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <rps/core/rules.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
+#include <rps/domain/game.h>
+#include <rps/domain/lang.h>
+#include <rps/domain/listeners.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/mock_sink.h>
+#include <rps/domain/outbound.h>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+using sim_clock = std::chrono::steady_clock;
+
+struct options {
+  size_t players{1000};
+  /* Wall clock seconds to generate traffic for */
+  double duration{30};
+  double time_scale{0.05};
+  /* Mean decision time per round, simulated seconds */
+  double think{2};
+  /* Mean idle time between matches, simulated seconds */
+  double arrival{3};
+  /* Probability a player never answers a round */
+  double afk{0.02};
+  double latency_ms{50};
+  double jitter_ms{20};
+  /* Fraction of players queueing from a guild channel rather than DMs */
+  double guilds{0.5};
+  config::delivery_mode delivery{config::delivery_mode::messages};
+  const core::variant *variant{&core::classic};
+};
+
+enum class player_state { idle, queued, playing };
+
+struct player {
+  dpp::snowflake id;
+  dpp::snowflake guild_id;
+  dpp::snowflake channel_id;
+  std::string username;
+  player_state state{player_state::idle};
+};
+
+enum class action_type { queue, choose };
+
+struct action {
+  sim_clock::time_point due;
+  size_t player{0};
+  action_type type{action_type::queue};
+
+  bool operator>(const action &other) const { return due > other.due; }
+};
+
+/**
+ * @brief Discord epoch, 2015-01-01, in milliseconds
+ */
+constexpr uint64_t discord_epoch_ms = 1420070400000;
+
+/**
+ * @brief A fresh interaction id timestamped with game time, so latency
+ * measured from the interaction's creation time stays meaningful
+ */
+dpp::snowflake next_snowflake() {
+  static std::atomic<uint64_t> increment{0};
+  const auto now_ms = static_cast<uint64_t>(timing::get().unix_time() * 1000);
+  return ((now_ms - discord_epoch_ms) << 22) | (increment++ & 0x3FFFFF);
+}
+
+void fill_interaction(dpp::interaction &command, const player &p) {
+  command.id = next_snowflake();
+  command.usr.id = p.id;
+  command.usr.username = p.username;
+  command.guild_id = p.guild_id;
+  command.channel_id = p.channel_id;
+  command.locale = "en";
+  command.token = "token" + std::to_string(command.id);
+}
+
+options parse(int argc, char const *argv[]) {
+  struct option long_opts[] = {
+      {"players", required_argument, nullptr, 'p'},
+      {"duration", required_argument, nullptr, 'd'},
+      {"timescale", required_argument, nullptr, 's'},
+      {"think", required_argument, nullptr, 't'},
+      {"arrival", required_argument, nullptr, 'a'},
+      {"afk", required_argument, nullptr, 'k'},
+      {"latency", required_argument, nullptr, 'l'},
+      {"jitter", required_argument, nullptr, 'j'},
+      {"guilds", required_argument, nullptr, 'g'},
+      {"delivery", required_argument, nullptr, 'm'},
+      {"variant", required_argument, nullptr, 'v'},
+      {nullptr, 0, nullptr, 0}};
+
+  options o;
+  int index{0};
+  int arg;
+  opterr = 0;
+  while ((arg = getopt_long_only(argc, (char *const *)argv, "", long_opts,
+                                 &index)) != -1) {
+    switch (arg) {
+    case 'p':
+      o.players = std::strtoul(optarg, nullptr, 10);
+      break;
+    case 'd':
+      o.duration = std::atof(optarg);
+      break;
+    case 's':
+      o.time_scale = std::atof(optarg);
+      break;
+    case 't':
+      o.think = std::atof(optarg);
+      break;
+    case 'a':
+      o.arrival = std::atof(optarg);
+      break;
+    case 'k':
+      o.afk = std::atof(optarg);
+      break;
+    case 'l':
+      o.latency_ms = std::atof(optarg);
+      break;
+    case 'j':
+      o.jitter_ms = std::atof(optarg);
+      break;
+    case 'g':
+      o.guilds = std::atof(optarg);
+      break;
+    case 'm':
+      if (std::string(optarg) == "interactions") {
+        o.delivery = config::delivery_mode::interactions;
+        break;
+      }
+      if (std::string(optarg) == "messages") {
+        o.delivery = config::delivery_mode::messages;
+        break;
+      }
+      [[fallthrough]];
+    case 'v':
+      if (arg == 'v' && (o.variant = core::builtin(optarg)) != nullptr) {
+        break;
+      }
+      [[fallthrough]];
+    case '?':
+    default:
+      std::cerr << "Usage: " << argv[0]
+                << " [-players <n>] [-duration <s>] [-timescale <x>]"
+                   " [-think <s>] [-arrival <s>] [-afk <p>] [-latency <ms>]"
+                   " [-jitter <ms>] [-guilds <p>]"
+                   " [-delivery messages|interactions]"
+                   " [-variant classic|rpsls]\n";
+      exit(1);
+    }
+  }
+  return o;
+}
+
+class simulator {
+public:
+  simulator(const options &o, timing::virtual_clock &c)
+      : opts(o), clock(c), rng(1) {
+    population.reserve(opts.players);
+    std::bernoulli_distribution in_guild(opts.guilds);
+    for (size_t i = 0; i < opts.players; ++i) {
+      player p;
+      p.id = 100000 + i;
+      p.username = "player" + std::to_string(i);
+      /* Spread guild players over a handful of guilds and channels */
+      if (in_guild(rng)) {
+        p.guild_id = 1000 + i % 16;
+        p.channel_id = 2000 + i % 64;
+      } else {
+        p.channel_id = 3000000 + i;
+      }
+      by_id[p.id] = i;
+      population.push_back(std::move(p));
+    }
+  }
+
+  /**
+   * @brief Direct message hook, called from sink threads
+   */
+  void on_direct_message(dpp::snowflake user_id, bool has_components) {
+    /* Only the round prompt carries the choice buttons */
+    if (!has_components) {
+      return;
+    }
+    std::lock_guard<std::mutex> lock(inbox_mutex);
+    prompts.push_back(user_id);
+  }
+
+  void run() {
+    const auto start = sim_clock::now();
+    const auto end = start + std::chrono::duration_cast<sim_clock::duration>(
+                                 std::chrono::duration<double>(opts.duration));
+    for (size_t i = 0; i < population.size(); ++i) {
+      schedule(start + scaled(opts.arrival), i, action_type::queue);
+    }
+
+    auto next_sweep = start;
+    while (sim_clock::now() < end) {
+      clock.advance_to(std::chrono::duration_cast<std::chrono::nanoseconds>(
+          (sim_clock::now() - start) / opts.time_scale));
+      drain_prompts();
+      const auto now = sim_clock::now();
+      while (!actions.empty() && actions.top().due <= now) {
+        const action a = actions.top();
+        actions.pop();
+        perform(a);
+      }
+      if (now >= next_sweep) {
+        sweep();
+        next_sweep = now + std::chrono::milliseconds(100);
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+
+private:
+  /**
+   * @brief Exponentially distributed wall clock delay with the given mean in
+   * simulated seconds
+   */
+  sim_clock::duration scaled(double mean_seconds) {
+    std::exponential_distribution<double> dist(1.0 / mean_seconds);
+    return std::chrono::duration_cast<sim_clock::duration>(
+        std::chrono::duration<double>(dist(rng) * opts.time_scale));
+  }
+
+  void schedule(sim_clock::time_point due, size_t index, action_type type) {
+    actions.push(action{due, index, type});
+  }
+
+  void drain_prompts() {
+    std::vector<dpp::snowflake> ready;
+    {
+      std::lock_guard<std::mutex> lock(inbox_mutex);
+      ready.swap(prompts);
+    }
+    std::bernoulli_distribution afk(opts.afk);
+    const auto now = sim_clock::now();
+    for (const auto user_id : ready) {
+      const size_t index = by_id.at(user_id);
+      population[index].state = player_state::playing;
+      if (!afk(rng)) {
+        schedule(now + scaled(opts.think), index, action_type::choose);
+      }
+    }
+  }
+
+  void perform(const action &a) {
+    player &p = population[a.player];
+    if (a.type == action_type::queue) {
+      if (p.state != player_state::idle) {
+        return;
+      }
+      dpp::slashcommand_t event(nullptr, "");
+      fill_interaction(event.command, p);
+      dpp::command_interaction data;
+      data.name = "queue";
+      event.command.data = data;
+      p.state = player_state::queued;
+      listeners::on_slashcommand(event);
+    } else {
+      if (p.state != player_state::playing) {
+        return;
+      }
+      dpp::button_click_t event(nullptr, "");
+      fill_interaction(event.command, p);
+      event.custom_id =
+          fmt::format("pick:{}", rng() % game::rules().size() + 1);
+      listeners::on_buttonclick(event);
+    }
+  }
+
+  /**
+   * @brief Return players whose lobby has gone, after a result or a timeout,
+   * to the idle pool
+   */
+  void sweep() {
+    const auto now = sim_clock::now();
+    for (size_t i = 0; i < population.size(); ++i) {
+      player &p = population[i];
+      if (p.state != player_state::idle &&
+          game::find_player_lobby_id(p.id) == 0) {
+        p.state = player_state::idle;
+        schedule(now + scaled(opts.arrival), i, action_type::queue);
+      }
+    }
+  }
+
+  options opts;
+  timing::virtual_clock &clock;
+  std::mt19937_64 rng;
+  std::vector<player> population;
+  std::unordered_map<dpp::snowflake, size_t> by_id;
+  std::priority_queue<action, std::vector<action>, std::greater<>> actions;
+
+  std::mutex inbox_mutex;
+  std::vector<dpp::snowflake> prompts;
+};
+
+void report(const options &o, const outbound::mock_sink &sink,
+            double elapsed) {
+  const auto &matches = metrics::get_counter(
+      "rps_matches_completed_total", "Matches played to a result or timeout");
+  const auto &rounds = metrics::get_histogram(
+      "rps_click_to_result_seconds",
+      "Time from the click that completes a round to its results being sent");
+
+  const double completed = static_cast<double>(matches.get());
+  std::printf("players %zu, %.1fs wall (%.1fs simulated), latency %.0fms "
+              "+ %.0fms jitter\n",
+              o.players, elapsed, elapsed / o.time_scale, o.latency_ms,
+              o.jitter_ms);
+  std::printf("matches completed  %10.0f  (%.2f/s wall, %.2f/s simulated)\n",
+              completed, completed / elapsed, completed * o.time_scale /
+                                                  elapsed);
+  std::printf("rounds resolved    %10llu\n",
+              static_cast<unsigned long long>(rounds.total()));
+  /* Measured in game time; scale back to wall time */
+  std::printf("click to result    p50 %6.1fms  p99 %6.1fms  p99.9 %6.1fms\n",
+              rounds.percentile_us(0.5) * o.time_scale / 1e3,
+              rounds.percentile_us(0.99) * o.time_scale / 1e3,
+              rounds.percentile_us(0.999) * o.time_scale / 1e3);
+  std::printf("REST calls         %10llu  (%.2f per match)\n",
+              static_cast<unsigned long long>(sink.total_calls()),
+              completed > 0 ? sink.total_calls() / completed : 0.0);
+  for (size_t r = 0; r < static_cast<size_t>(outbound::mock_sink::route::count);
+       ++r) {
+    const auto route = static_cast<outbound::mock_sink::route>(r);
+    std::printf("  %-28s %10llu  (%.2f per match)\n",
+                outbound::mock_sink::route_name(route),
+                static_cast<unsigned long long>(sink.calls(route)),
+                completed > 0 ? sink.calls(route) / completed : 0.0);
+  }
+}
+
+} // namespace
+
+int main(int argc, char const *argv[]) {
+  const options opts = parse(argc, argv);
+
+  config::settings settings;
+  settings.trace_sample_rate = 0;
+  settings.delivery = opts.delivery;
+  settings.variant = *opts.variant;
+  settings.first_to = opts.variant->first_to;
+  settings.game_timeout = opts.variant->round_timeout;
+  config::init(settings);
+
+  outbound::mock_sink sink(outbound::mock_sink::options{
+      .latency = std::chrono::microseconds(
+          static_cast<int64_t>(opts.latency_ms * 1000)),
+      .jitter = std::chrono::microseconds(
+          static_cast<int64_t>(opts.jitter_ms * 1000)),
+  });
+  outbound::set(sink);
+  timing::virtual_clock clock;
+  timing::set(clock);
+  i18n::load_lang();
+  game::init();
+
+  simulator sim(opts, clock);
+  sink.on_direct_message = [&sim](dpp::snowflake user_id,
+                                  bool has_components) {
+    sim.on_direct_message(user_id, has_components);
+  };
+
+  const auto start = sim_clock::now();
+  sim.run();
+  const std::chrono::duration<double> elapsed = sim_clock::now() - start;
+  report(opts, sink, elapsed.count());
+
+  /* Detached game threads and sink deliveries may still be running; skip
+   * static destruction rather than tear state down underneath them */
+  std::fflush(stdout);
+  std::quick_exit(0);
+}
@@ -0,0 +1,91 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <rps/core/clock.h>
+
+namespace core {
+
+virtual_clock::virtual_clock()
+    : epoch(std::chrono::duration<double>(
+                std::chrono::system_clock::now().time_since_epoch())
+                .count()) {}
+
+std::chrono::nanoseconds virtual_clock::now() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return current;
+}
+
+double virtual_clock::unix_time() const {
+  return epoch + std::chrono::duration<double>(now()).count();
+}
+
+timer virtual_clock::start_timer(timer_callback on_tick, uint64_t seconds) {
+  std::lock_guard<std::mutex> lock(mutex);
+  const timer handle = next_timer++;
+  /* A zero interval would fire forever within one advance */
+  const std::chrono::nanoseconds interval =
+      std::max<std::chrono::nanoseconds>(std::chrono::seconds(seconds),
+                                         std::chrono::nanoseconds(1));
+  timers[handle] =
+      timer_state{std::move(on_tick), interval, current + interval};
+  due.emplace(current + interval, handle);
+  return handle;
+}
+
+void virtual_clock::stop_timer(timer t) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = timers.find(t);
+  if (it == timers.end()) {
+    return;
+  }
+  due.erase({it->second.due, t});
+  timers.erase(it);
+}
+
+void virtual_clock::advance_to(std::chrono::nanoseconds t) {
+  for (;;) {
+    timer handle{0};
+    timer_callback on_tick;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (due.empty() || due.begin()->first > t) {
+        current = std::max(current, t);
+        return;
+      }
+      const auto [when, next] = *due.begin();
+      due.erase(due.begin());
+      current = std::max(current, when);
+
+      /* Timers repeat until stopped, like D++ timers */
+      timer_state &state = timers.at(next);
+      state.due = when + state.interval;
+      due.emplace(state.due, next);
+      handle = next;
+      on_tick = state.on_tick;
+    }
+    on_tick(handle);
+  }
+}
+
+size_t virtual_clock::timers_pending() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return timers.size();
+}
+
+} // namespace core
@@ -0,0 +1,309 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <iterator>
+#include <rps/core/engine.h>
+#include <utility>
+
+namespace core {
+
+lobby_id engine::find_player_lobby(player_id p) const {
+  const auto seat = seats.find(p);
+  return seat != seats.end() ? seat->second : 0;
+}
+
+lobby_id engine::find_open_lobby() const {
+  return open.empty() ? 0 : *open.begin();
+}
+
+lobby_id engine::create_lobby() {
+  lobby l;
+  l.id = ++next_id;
+  lobbies.push_back(std::move(l));
+  by_id[next_id] = std::prev(lobbies.end());
+  open.insert(next_id);
+  return next_id;
+}
+
+bool engine::add_player(lobby_id id, player_id p) {
+  lobby *l = find_mutable(id);
+  if (l == nullptr || l->full() || !seats.try_emplace(p, id).second) {
+    return false;
+  }
+  l->players.push_back(player{p});
+  if (l->full()) {
+    open.erase(id);
+  }
+  return true;
+}
+
+std::optional<lobby> engine::remove_lobby(lobby_id id, bool game_over) {
+  const auto found = by_id.find(id);
+  if (found == by_id.end()) {
+    return std::nullopt;
+  }
+  const auto it = found->second;
+  for (const auto &pl : it->players) {
+    if (pl.queue_timer != 0) {
+      time.stop_timer(pl.queue_timer);
+      queue_timers--;
+    }
+    seats.erase(pl.id);
+  }
+  if (it->game_timer != 0) {
+    time.stop_timer(it->game_timer);
+    game_timers--;
+  }
+  open.erase(id);
+  if (!game_over && id == next_id) {
+    next_id--;
+  }
+  lobby removed = std::move(*it);
+  by_id.erase(found);
+  lobbies.erase(it);
+  return removed;
+}
+
+const lobby *engine::find(lobby_id id) const {
+  const auto found = by_id.find(id);
+  return found != by_id.end() ? &*found->second : nullptr;
+}
+
+lobby *engine::find_mutable(lobby_id id) {
+  return const_cast<lobby *>(std::as_const(*this).find(id));
+}
+
+const player *engine::find_player(player_id p) const {
+  const lobby *l = find(find_player_lobby(p));
+  if (l == nullptr) {
+    return nullptr;
+  }
+  for (const auto &pl : l->players) {
+    if (pl.id == p) {
+      return &pl;
+    }
+  }
+  return nullptr;
+}
+
+player *engine::find_player(player_id p) {
+  return const_cast<player *>(std::as_const(*this).find_player(p));
+}
+
+void engine::set_choice(player_id p, choice c) {
+  player *pl = find_player(p);
+  if (pl != nullptr && (c == choice::none || game.valid(c))) {
+    pl->pick = c;
+  }
+}
+
+choice engine::get_choice(player_id p) const {
+  const player *pl = find_player(p);
+  return pl != nullptr ? pl->pick : choice::none;
+}
+
+void engine::reset_choices(lobby_id id) {
+  if (lobby *l = find_mutable(id)) {
+    for (auto &pl : l->players) {
+      pl.pick = choice::none;
+    }
+  }
+}
+
+bool engine::both_chosen(lobby_id id) const {
+  const lobby *l = find(id);
+  return l != nullptr && l->full() &&
+         l->players[0].pick != choice::none &&
+         l->players[1].pick != choice::none;
+}
+
+outcome engine::determine_winner(lobby_id id) const {
+  const lobby *l = find(id);
+  if (l == nullptr || !l->full()) {
+    return outcome::forfeit;
+  }
+  return game.resolve(l->players[0].pick, l->players[1].pick);
+}
+
+void engine::increment_score(lobby_id id, unsigned int index) {
+  lobby *l = find_mutable(id);
+  if (l != nullptr && index < l->players.size()) {
+    l->players[index].score++;
+  }
+}
+
+void engine::increment_game(lobby_id id) {
+  if (lobby *l = find_mutable(id)) {
+    l->game_number++;
+  }
+}
+
+bool engine::is_complete(lobby_id id, unsigned int first_to) const {
+  const lobby *l = find(id);
+  if (l == nullptr) {
+    return false;
+  }
+  for (const auto &pl : l->players) {
+    if (pl.score >= first_to) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::optional<round_result> engine::resolve_round(lobby_id id,
+                                                 unsigned int first_to,
+                                                 bool timed_out) {
+  lobby *l = find_mutable(id);
+  if (l == nullptr || !l->full() || (!timed_out && !both_chosen(id))) {
+    return std::nullopt;
+  }
+  clear_game_timer(id);
+
+  round_result round;
+  round.result = game.resolve(l->players[0].pick, l->players[1].pick);
+  if (round.result == outcome::player_one) {
+    l->players[0].score++;
+  } else if (round.result == outcome::player_two) {
+    l->players[1].score++;
+  }
+  round.state = *l;
+  round.match_over = timed_out || is_complete(id, first_to);
+
+  if (round.match_over) {
+    remove_lobby(id, true);
+  } else {
+    increment_game(id);
+    reset_choices(id);
+  }
+  return round;
+}
+
+std::vector<lobby> engine::release_all() {
+  std::vector<lobby> released;
+  released.reserve(lobbies.size());
+  for (auto &l : lobbies) {
+    for (auto &pl : l.players) {
+      if (pl.queue_timer != 0) {
+        time.stop_timer(pl.queue_timer);
+        pl.queue_timer = 0;
+      }
+    }
+    if (l.game_timer != 0) {
+      time.stop_timer(l.game_timer);
+      l.game_timer = 0;
+    }
+    released.push_back(std::move(l));
+  }
+  lobbies.clear();
+  by_id.clear();
+  seats.clear();
+  next_id = 0;
+  open.clear();
+  queue_timers = 0;
+  game_timers = 0;
+  return released;
+}
+
+bool engine::restore(lobby l) {
+  if (l.id <= next_id || l.players.size() > 2) {
+    return false;
+  }
+  for (size_t i = 0; i < l.players.size(); ++i) {
+    if (seats.contains(l.players[i].id)) {
+      for (size_t j = 0; j < i; ++j) {
+        seats.erase(l.players[j].id);
+      }
+      return false;
+    }
+    seats[l.players[i].id] = l.id;
+  }
+  l.game_timer = 0;
+  for (auto &pl : l.players) {
+    pl.queue_timer = 0;
+  }
+  next_id = l.id;
+  if (!l.full()) {
+    open.insert(l.id);
+  }
+  lobbies.push_back(std::move(l));
+  by_id[next_id] = std::prev(lobbies.end());
+  return true;
+}
+
+timer engine::start_once(uint64_t seconds, std::function<void()> on_expire) {
+  clock &c = time;
+  return c.start_timer(
+      [&c, on_expire = std::move(on_expire)](timer t) {
+        c.stop_timer(t);
+        on_expire();
+      },
+      seconds);
+}
+
+void engine::start_queue_timer(player_id p, uint64_t seconds,
+                               std::function<void()> on_expire) {
+  player *pl = find_player(p);
+  if (pl == nullptr) {
+    return;
+  }
+  if (pl->queue_timer != 0) {
+    time.stop_timer(pl->queue_timer);
+  } else {
+    queue_timers++;
+  }
+  pl->queue_timer = start_once(seconds, std::move(on_expire));
+  pl->queue_deadline = time.unix_time() + static_cast<double>(seconds);
+}
+
+void engine::clear_queue_timer(player_id p) {
+  player *pl = find_player(p);
+  if (pl != nullptr && pl->queue_timer != 0) {
+    time.stop_timer(pl->queue_timer);
+    pl->queue_timer = 0;
+    pl->queue_deadline = 0;
+    queue_timers--;
+  }
+}
+
+void engine::start_game_timer(lobby_id id, uint64_t seconds,
+                              std::function<void()> on_expire) {
+  lobby *l = find_mutable(id);
+  if (l == nullptr) {
+    return;
+  }
+  if (l->game_timer != 0) {
+    time.stop_timer(l->game_timer);
+  } else {
+    game_timers++;
+  }
+  l->game_timer = start_once(seconds, std::move(on_expire));
+  l->game_deadline = time.unix_time() + static_cast<double>(seconds);
+}
+
+void engine::clear_game_timer(lobby_id id) {
+  lobby *l = find_mutable(id);
+  if (l != nullptr && l->game_timer != 0) {
+    time.stop_timer(l->game_timer);
+    l->game_timer = 0;
+    l->game_deadline = 0;
+    game_timers--;
+  }
+}
+
+} // namespace core
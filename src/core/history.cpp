@@ -0,0 +1,241 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <mutex>
+#include <rps/core/history.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define RPS_HISTORY_AVX2 1
+#include <immintrin.h>
+#endif
+
+namespace core {
+
+/**
+ * @brief Indices of the rows in a column equal to a code, in row order
+ */
+using select_kernel = void (*)(const uint32_t *column, size_t n, uint32_t code,
+                               std::vector<uint32_t> &rows);
+
+static void select_scalar(const uint32_t *column, size_t n, uint32_t code,
+                          std::vector<uint32_t> &rows) {
+  for (size_t i = 0; i < n; ++i) {
+    if (column[i] == code) {
+      rows.push_back(static_cast<uint32_t>(i));
+    }
+  }
+}
+
+#ifdef RPS_HISTORY_AVX2
+/**
+ * @brief 32 rows per iteration; most blocks hold no match and cost four
+ * compares and a test
+ */
+__attribute__((target("avx2"))) static void
+select_avx2(const uint32_t *column, size_t n, uint32_t code,
+            std::vector<uint32_t> &rows) {
+  const __m256i needle = _mm256_set1_epi32(static_cast<int>(code));
+  size_t i = 0;
+  for (; i + 32 <= n; i += 32) {
+    const auto *block = reinterpret_cast<const __m256i *>(column + i);
+    const __m256i eq0 =
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(block + 0), needle);
+    const __m256i eq1 =
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(block + 1), needle);
+    const __m256i eq2 =
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(block + 2), needle);
+    const __m256i eq3 =
+        _mm256_cmpeq_epi32(_mm256_loadu_si256(block + 3), needle);
+    const __m256i any =
+        _mm256_or_si256(_mm256_or_si256(eq0, eq1), _mm256_or_si256(eq2, eq3));
+    if (_mm256_testz_si256(any, any)) {
+      continue;
+    }
+    const __m256i eqs[4] = {eq0, eq1, eq2, eq3};
+    for (size_t k = 0; k < 4; ++k) {
+      auto mask = static_cast<uint32_t>(
+          _mm256_movemask_ps(_mm256_castsi256_ps(eqs[k])));
+      while (mask != 0) {
+        rows.push_back(static_cast<uint32_t>(i + k * 8) +
+                       std::countr_zero(mask));
+        mask &= mask - 1;
+      }
+    }
+  }
+  const size_t tail = rows.size();
+  select_scalar(column + i, n - i, code, rows);
+  for (size_t k = tail; k < rows.size(); ++k) {
+    rows[k] += static_cast<uint32_t>(i);
+  }
+}
+#endif
+
+static select_kernel pick_kernel() {
+#ifdef RPS_HISTORY_AVX2
+  if (__builtin_cpu_supports("avx2")) {
+    return select_avx2;
+  }
+#endif
+  return select_scalar;
+}
+
+static const select_kernel select_rows = pick_kernel();
+
+const char *history::kernel() {
+#ifdef RPS_HISTORY_AVX2
+  if (select_rows == select_avx2) {
+    return "avx2";
+  }
+#endif
+  return "scalar";
+}
+
+history::history(size_t capacity)
+    : partition_capacity(std::max<size_t>(capacity / partitions, 2)) {}
+
+uint32_t history::code_of(uint64_t player) {
+  const auto [it, added] =
+      codes.try_emplace(player, static_cast<uint32_t>(codes.size()));
+  return it->second;
+}
+
+void history::partition::append(uint32_t player, uint32_t opponent,
+                                choice pick, result r, double time) {
+  player_column.push_back(player);
+  opponent_column.push_back(opponent);
+  pick_column.push_back(pick);
+  result_column.push_back(r);
+  match_end_column.push_back(0);
+  time_column.push_back(time);
+}
+
+void history::partition::drop_oldest_half() {
+  const auto drop = static_cast<std::ptrdiff_t>(player_column.size() / 2);
+  const auto erase_front = [drop](auto &column) {
+    column.erase(column.begin(), column.begin() + drop);
+  };
+  erase_front(player_column);
+  erase_front(opponent_column);
+  erase_front(pick_column);
+  erase_front(result_column);
+  erase_front(match_end_column);
+  erase_front(time_column);
+}
+
+void history::record_round(const std::array<uint64_t, 2> &players,
+                           const std::array<choice, 2> &picks, outcome round,
+                           double time) {
+  std::array<result, 2> results{result::draw, result::draw};
+  if (round == outcome::player_one) {
+    results = {result::win, result::loss};
+  } else if (round == outcome::player_two) {
+    results = {result::loss, result::win};
+  } else if (round == outcome::forfeit) {
+    results = {result::loss, result::loss};
+  }
+
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  const std::array<uint32_t, 2> seat{code_of(players[0]), code_of(players[1])};
+  for (size_t i = 0; i < 2; ++i) {
+    const uint32_t index = seat[i] % partitions;
+    partition &part = parts[index];
+    if (part.player_column.size() >= partition_capacity) {
+      total_rows -= part.player_column.size();
+      part.drop_oldest_half();
+      total_rows += part.player_column.size();
+    }
+    part.append(seat[i], seat[1 - i], picks[i], results[i], time);
+    total_rows++;
+    last_round[i] = index;
+  }
+}
+
+void history::end_match() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  for (const uint32_t index : last_round) {
+    if (index < partitions && !parts[index].match_end_column.empty()) {
+      parts[index].match_end_column.back() = 1;
+    }
+  }
+}
+
+player_stats history::aggregate(uint32_t player, uint32_t opponent) const {
+  const partition &part = parts[player % partitions];
+  thread_local std::vector<uint32_t> rows;
+  rows.clear();
+  select_rows(part.player_column.data(), part.player_column.size(), player,
+              rows);
+
+  player_stats s;
+  int64_t streak{0};
+  for (const uint32_t row : rows) {
+    if (opponent != any_opponent && part.opponent_column[row] != opponent) {
+      continue;
+    }
+    s.rounds++;
+    s.picks[static_cast<size_t>(part.pick_column[row])]++;
+    const result r = part.result_column[row];
+    s.wins += r == result::win;
+    s.losses += r == result::loss;
+    s.draws += r == result::draw;
+    s.last_played = part.time_column[row];
+    if (part.match_end_column[row] == 0) {
+      continue;
+    }
+    /* The deciding round's result is the match's */
+    s.matches++;
+    if (r == result::win) {
+      s.matches_won++;
+      streak = streak > 0 ? streak + 1 : 1;
+      s.longest_win_streak =
+          std::max(s.longest_win_streak, static_cast<uint64_t>(streak));
+    } else {
+      streak = streak < 0 ? streak - 1 : -1;
+    }
+  }
+  s.current_streak = streak;
+  return s;
+}
+
+player_stats history::stats(uint64_t player) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  const auto it = codes.find(player);
+  if (it == codes.end()) {
+    return {};
+  }
+  return aggregate(it->second, any_opponent);
+}
+
+player_stats history::versus(uint64_t player, uint64_t opponent) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  const auto it = codes.find(player);
+  const auto other = codes.find(opponent);
+  if (it == codes.end() || other == codes.end()) {
+    return {};
+  }
+  return aggregate(it->second, other->second);
+}
+
+size_t history::rows() const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  return total_rows;
+}
+
+} // namespace core
@@ -0,0 +1,105 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <rps/core/predictor.h>
+
+namespace core {
+
+predictor::predictor(size_t models, size_t picks)
+    : choices(std::clamp<size_t>(picks, 2, max_choices)),
+      table(std::bit_ceil(std::max<size_t>(models, 1))),
+      mask(table.size() - 1) {
+  /* Keep every order whose contexts still fit in model_bytes */
+  size_t rows{0};
+  size_t contexts{1};
+  for (size_t order = 0; order <= max_order; ++order) {
+    if ((rows + contexts) * choices > model_bytes) {
+      break;
+    }
+    orders = order;
+    first[order] = rows;
+    span[order] = contexts;
+    rows += contexts;
+    contexts *= choices;
+  }
+  stride = rows * choices;
+  counts.resize(table.size() * stride);
+}
+
+size_t predictor::slot(uint64_t player) const {
+  /* splitmix64 finaliser, so sequential snowflakes spread over the table */
+  uint64_t z = player + 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return (z ^ (z >> 31)) & mask;
+}
+
+size_t predictor::row(size_t slot, uint16_t recent, size_t order) const {
+  /* A context is the last order picks */
+  return slot * stride + (first[order] + recent % span[order]) * choices;
+}
+
+void predictor::observe(uint64_t player, choice pick) {
+  if (pick == choice::none || static_cast<size_t>(pick) > choices) {
+    return;
+  }
+  const size_t at = slot(player);
+  model &m = table[at];
+  if (m.player != player) {
+    m = model{};
+    m.player = player;
+    std::fill_n(counts.begin() + static_cast<ptrdiff_t>(at * stride), stride,
+                0);
+  }
+  const auto digit = static_cast<uint16_t>(static_cast<uint8_t>(pick) - 1);
+  for (size_t order = 0; order <= m.seen; ++order) {
+    uint8_t *row_counts = &counts[row(at, m.recent, order)];
+    if (++row_counts[digit] >= count_limit) {
+      for (size_t i = 0; i < choices; ++i) {
+        row_counts[i] /= 2;
+      }
+    }
+  }
+  m.recent =
+      static_cast<uint16_t>((m.recent * choices + digit) % span[orders]);
+  m.seen = static_cast<uint8_t>(std::min<size_t>(m.seen + 1U, orders));
+}
+
+choice predictor::predict(uint64_t player) const {
+  const size_t at = slot(player);
+  const model &m = table[at];
+  if (m.player != player) {
+    return choice::none;
+  }
+  for (size_t order = m.seen + 1; order-- > 0;) {
+    const uint8_t *begin = &counts[row(at, m.recent, order)];
+    const uint8_t *end = begin + choices;
+    const uint8_t *top = std::max_element(begin, end);
+    /* Needs a favourite seen at least twice and ahead of the others */
+    if (*top < 2 || std::count(begin, end, *top) > 1) {
+      continue;
+    }
+    return static_cast<choice>(top - begin + 1);
+  }
+  return choice::none;
+}
+
+} // namespace core
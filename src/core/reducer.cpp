@@ -0,0 +1,96 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <rps/core/reducer.h>
+#include <utility>
+
+namespace core {
+
+/**
+ * @brief The lobby a restore_lobby action describes
+ */
+static lobby restored_lobby(const action &a) {
+  lobby l;
+  l.id = a.lobby;
+  l.game_number = a.argument;
+  for (size_t i = 0; i < a.players.size(); ++i) {
+    if (a.players[i] == 0) {
+      continue;
+    }
+    player p{a.players[i]};
+    p.pick = a.picks[i];
+    p.score = a.scores[i];
+    l.players.push_back(p);
+  }
+  return l;
+}
+
+applied reduce(engine &state, const action &a,
+               std::function<void()> on_expire) {
+  applied out;
+  switch (a.type) {
+  case action_type::session_start:
+  case action_type::release_all:
+    out.released = state.release_all();
+    break;
+  case action_type::create_lobby:
+    out.created = state.create_lobby();
+    break;
+  case action_type::add_player:
+    out.ok = state.add_player(a.lobby, a.players[0]);
+    break;
+  case action_type::remove_lobby:
+    out.removed = state.remove_lobby(a.lobby, a.flag);
+    break;
+  case action_type::set_choice:
+    state.set_choice(a.players[0], a.picks[0]);
+    break;
+  case action_type::reset_choices:
+    state.reset_choices(a.lobby);
+    break;
+  case action_type::increment_score:
+    state.increment_score(a.lobby, a.argument);
+    break;
+  case action_type::increment_game:
+    state.increment_game(a.lobby);
+    break;
+  case action_type::resolve_round:
+    out.round = state.resolve_round(a.lobby, a.argument, a.flag);
+    break;
+  case action_type::start_queue_timer:
+    state.start_queue_timer(a.players[0], a.argument,
+                            on_expire ? std::move(on_expire) : [] {});
+    break;
+  case action_type::clear_queue_timer:
+    state.clear_queue_timer(a.players[0]);
+    break;
+  case action_type::start_game_timer:
+    state.start_game_timer(a.lobby, a.argument,
+                           on_expire ? std::move(on_expire) : [] {});
+    break;
+  case action_type::clear_game_timer:
+    state.clear_game_timer(a.lobby);
+    break;
+  case action_type::restore_lobby:
+    out.ok = state.restore(restored_lobby(a));
+    break;
+  }
+  return out;
+}
+
+} // namespace core
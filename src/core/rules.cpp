@@ -0,0 +1,53 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <array>
+#include <rps/core/rules.h>
+
+namespace core {
+
+static_assert(classic.complete() && rpsls.complete());
+static_assert(classic.resolve(choice::rock, choice::scissors) ==
+              outcome::player_one);
+static_assert(classic.resolve(choice::rock, choice::paper) ==
+              outcome::player_two);
+static_assert(classic.resolve(choice::paper, choice::none) ==
+              outcome::player_one);
+static_assert(classic.resolve(choice::none, choice::none) == outcome::forfeit);
+static_assert(classic.counter(choice::scissors) == choice::rock);
+static_assert(rpsls.resolve(choice::spock, choice::lizard) ==
+              outcome::player_two);
+/* Out of range picks count as none */
+static_assert(classic.resolve(choice::lizard, choice::rock) ==
+              outcome::player_two);
+static_assert(classic.resolve(static_cast<choice>(9), choice::rock) ==
+              outcome::player_two);
+static_assert(classic.resolve(static_cast<choice>(255), choice::none) ==
+              outcome::forfeit);
+
+const variant *builtin(std::string_view name) {
+  static constexpr std::array<const variant *, 2> variants{&classic, &rpsls};
+  for (const variant *v : variants) {
+    if (v->name() == name) {
+      return v;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace core
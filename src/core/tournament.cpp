@@ -0,0 +1,597 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstring>
+#include <numeric>
+#include <rps/core/tournament.h>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace core {
+
+/**
+ * @brief Pairs per block when splitting a Swiss round into work
+ */
+static constexpr size_t pairing_block = 256;
+
+tournament::tournament(tournament_format fmt, std::vector<player_id> players,
+                       unsigned int rounds)
+    : kind(fmt), entrants(std::move(players)) {
+  const size_t n = entrants.size();
+  if (n < 2) {
+    throw std::invalid_argument("a tournament needs two or more entrants");
+  }
+  records.resize(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    records[i].entrant = i;
+  }
+  opponents.resize(n);
+  had_bye.resize(n);
+  knocked_out.resize(n);
+  if (kind == tournament_format::swiss) {
+    /* Enough rounds to leave one entrant unbeaten */
+    round_count = rounds != 0 ? rounds : std::bit_width(n - 1);
+    pair_swiss();
+  } else {
+    build_elimination();
+  }
+}
+
+void tournament::build_elimination() {
+  const size_t size = std::bit_ceil(entrants.size());
+  const auto levels = static_cast<unsigned int>(std::countr_zero(size));
+  const bool doubled = kind == tournament_format::double_elimination;
+  const auto add = [this](bracket_side side, unsigned int round) {
+    bracket.push_back({.round = static_cast<uint16_t>(round), .side = side});
+    return static_cast<uint32_t>(bracket.size() - 1);
+  };
+  const auto seat = [](uint32_t match, uint32_t s) { return match * 2 + s; };
+
+  /* Winners bracket: round r has size >> r matches, each feeding the next */
+  std::vector<uint32_t> winners(levels + 1);
+  for (unsigned int r = 1; r <= levels; ++r) {
+    winners[r] = static_cast<uint32_t>(bracket.size());
+    for (size_t j = 0; j < size >> r; ++j) {
+      add(bracket_side::winners, r);
+    }
+  }
+  for (unsigned int r = 1; r < levels; ++r) {
+    for (uint32_t j = 0; j < size >> r; ++j) {
+      bracket[winners[r] + j].winner_to = seat(winners[r + 1] + j / 2, j % 2);
+    }
+  }
+
+  if (doubled) {
+    /* Losers bracket: odd rounds pair the survivors, even rounds bring in
+     * the losers of the next winners round, in reverse to delay rematches */
+    const unsigned int losers_rounds = 2 * (levels - 1);
+    std::vector<uint32_t> losers(losers_rounds + 1);
+    for (unsigned int l = 1; l <= losers_rounds; ++l) {
+      losers[l] = static_cast<uint32_t>(bracket.size());
+      for (size_t m = 0; m < size >> ((l + 1) / 2 + 1); ++m) {
+        add(bracket_side::losers, l);
+      }
+    }
+    const uint32_t final_round = losers_rounds + 1;
+    const uint32_t grand_final = add(bracket_side::grand_final, final_round);
+    add(bracket_side::reset, final_round);
+
+    if (levels == 1) {
+      bracket[winners[1]].loser_to = seat(grand_final, 1);
+    } else {
+      for (uint32_t j = 0; j < size / 2; ++j) {
+        bracket[winners[1] + j].loser_to = seat(losers[1] + j / 2, j % 2);
+      }
+    }
+    for (unsigned int r = 2; r <= levels; ++r) {
+      const uint32_t count = static_cast<uint32_t>(size >> r);
+      for (uint32_t j = 0; j < count; ++j) {
+        bracket[winners[r] + j].loser_to =
+            seat(losers[2 * (r - 1)] + (count - 1 - j), 1);
+      }
+    }
+    for (unsigned int l = 1; l <= losers_rounds; ++l) {
+      const auto count = static_cast<uint32_t>(size >> ((l + 1) / 2 + 1));
+      for (uint32_t m = 0; m < count; ++m) {
+        uint32_t &to = bracket[losers[l] + m].winner_to;
+        if (l == losers_rounds) {
+          to = seat(grand_final, 1);
+        } else if (l % 2 == 1) {
+          to = seat(losers[l + 1] + m, 0);
+        } else {
+          to = seat(losers[l + 1] + m / 2, m % 2);
+        }
+      }
+    }
+    bracket[winners[levels]].winner_to = seat(grand_final, 0);
+  }
+
+  /* Seed so the top seeds meet last: 1 v 8, 4 v 5, 2 v 7, 3 v 6 */
+  std::vector<uint32_t> order{0};
+  while (order.size() < size) {
+    std::vector<uint32_t> next;
+    next.reserve(order.size() * 2);
+    const auto sum = static_cast<uint32_t>(order.size() * 2 - 1);
+    for (const uint32_t s : order) {
+      next.push_back(s);
+      next.push_back(sum - s);
+    }
+    order = std::move(next);
+  }
+  for (uint32_t j = 0; j < size; ++j) {
+    fill(seat(winners[1] + j / 2, j % 2),
+         order[j] < entrants.size() ? order[j] : bye);
+  }
+}
+
+/**
+ * @brief Whether a has played b
+ */
+static bool played(const std::vector<uint32_t> &a_opponents, uint32_t b) {
+  return std::find(a_opponents.begin(), a_opponents.end(), b) !=
+         a_opponents.end();
+}
+
+void tournament::pair_swiss() {
+  ++paired;
+  std::vector<uint32_t> order(entrants.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+    return records[a].points > records[b].points;
+  });
+
+  /* The lowest ranked entrant yet to have one sits out with a bye */
+  if (order.size() % 2 == 1) {
+    auto sits = std::find_if(order.rbegin(), order.rend(),
+                             [this](uint32_t e) { return had_bye[e] == 0; });
+    if (sits == order.rend()) {
+      sits = order.rbegin();
+    }
+    const uint32_t e = *sits;
+    order.erase(std::next(sits).base());
+    had_bye[e] = 1;
+    records[e].points += 2;
+    bracket.push_back({.seats = {e, bye},
+                       .winner = e,
+                       .round = static_cast<uint16_t>(paired),
+                       .side = bracket_side::swiss,
+                       .state = match_state::done});
+  }
+
+  /* Score groups, each passing its odd one out down to the next. Within a
+   * group the top half meets the bottom half, so a group splits into
+   * blocks of the two halves' matching slices that pair independently. */
+  struct block {
+    std::vector<uint32_t>::const_iterator top;
+    std::vector<uint32_t>::const_iterator bottom;
+    size_t pairs;
+  };
+  std::vector<std::vector<uint32_t>> groups;
+  std::vector<uint32_t> carry;
+  for (size_t i = 0; i < order.size();) {
+    size_t j = i;
+    while (j < order.size() &&
+           records[order[j]].points == records[order[i]].points) {
+      ++j;
+    }
+    std::vector<uint32_t> group = std::move(carry);
+    carry.clear();
+    group.insert(group.end(), order.begin() + static_cast<ptrdiff_t>(i),
+                 order.begin() + static_cast<ptrdiff_t>(j));
+    if (group.size() % 2 == 1) {
+      carry.push_back(group.back());
+      group.pop_back();
+    }
+    if (!group.empty()) {
+      groups.push_back(std::move(group));
+    }
+    i = j;
+  }
+  std::vector<block> blocks;
+  for (const auto &group : groups) {
+    const size_t half = group.size() / 2;
+    for (size_t at = 0; at < half; at += pairing_block) {
+      const auto offset = static_cast<ptrdiff_t>(at);
+      blocks.push_back({group.begin() + offset,
+                        group.begin() + static_cast<ptrdiff_t>(half) + offset,
+                        std::min(pairing_block, half - at)});
+    }
+  }
+
+  /* Each top entrant takes the first free bottom entrant from its own
+   * place on that it has not played, or its own place if all are rematches */
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> pairs(blocks.size());
+  const auto pair_block = [&](size_t b) {
+    const block &work = blocks[b];
+    std::vector<uint8_t> taken(work.pairs);
+    auto &out = pairs[b];
+    out.reserve(work.pairs);
+    for (size_t i = 0; i < work.pairs; ++i) {
+      const uint32_t top = work.top[static_cast<ptrdiff_t>(i)];
+      size_t pick = work.pairs;
+      size_t fallback = work.pairs;
+      for (size_t step = 0; step < work.pairs; ++step) {
+        const size_t j = (i + step) % work.pairs;
+        if (taken[j] != 0) {
+          continue;
+        }
+        if (fallback == work.pairs) {
+          fallback = j;
+        }
+        if (!played(opponents[top], work.bottom[static_cast<ptrdiff_t>(j)])) {
+          pick = j;
+          break;
+        }
+      }
+      if (pick == work.pairs) {
+        pick = fallback;
+      }
+      taken[pick] = 1;
+      out.emplace_back(top, work.bottom[static_cast<ptrdiff_t>(pick)]);
+    }
+  };
+  const size_t threads = std::min<size_t>(
+      blocks.size(), std::max(1U, std::thread::hardware_concurrency()));
+  if (entrants.size() < parallel_pairing || threads < 2) {
+    for (size_t b = 0; b < blocks.size(); ++b) {
+      pair_block(b);
+    }
+  } else {
+    std::atomic<size_t> next{0};
+    std::vector<std::jthread> workers;
+    workers.reserve(threads);
+    for (size_t t = 0; t < threads; ++t) {
+      workers.emplace_back([&]() {
+        for (size_t b = next.fetch_add(1, std::memory_order_relaxed);
+             b < blocks.size();
+             b = next.fetch_add(1, std::memory_order_relaxed)) {
+          pair_block(b);
+        }
+      });
+    }
+  }
+
+  for (const auto &block_pairs : pairs) {
+    for (const auto &[a, b] : block_pairs) {
+      bracket.push_back({.seats = {a, b},
+                         .round = static_cast<uint16_t>(paired),
+                         .side = bracket_side::swiss,
+                         .state = match_state::ready});
+      ++unfinished;
+    }
+  }
+}
+
+void tournament::fill(uint32_t to, uint32_t entrant) {
+  bracket_match &m = bracket[to / 2];
+  m.seats[to % 2] = entrant;
+  if (m.seats[0] == no_entrant || m.seats[1] == no_entrant) {
+    return;
+  }
+  if (m.seats[0] == bye || m.seats[1] == bye) {
+    /* Two byes settle with a bye as the winner */
+    settle(to / 2, m.seats[0] == bye ? 1 : 0);
+    return;
+  }
+  m.state = match_state::ready;
+}
+
+void tournament::eliminate(uint32_t entrant, uint32_t depth) {
+  if (entrant < entrants.size() && knocked_out[entrant] == 0) {
+    knocked_out[entrant] = depth;
+  }
+}
+
+void tournament::settle(uint32_t match, uint32_t winner_seat) {
+  bracket_match &m = bracket[match];
+  const uint32_t winner = m.seats[winner_seat];
+  const uint32_t loser = m.seats[1 - winner_seat];
+  m.state = match_state::done;
+  m.winner = winner;
+  m.lobby = 0;
+  switch (m.side) {
+  case bracket_side::swiss:
+    return;
+  case bracket_side::grand_final: {
+    /* The winners bracket finalist has yet to lose; if they just did, the
+     * two play again */
+    bracket_match &reset = bracket[match + 1];
+    if (winner_seat == 1 && loser != bye) {
+      reset.seats = m.seats;
+      reset.state = match_state::ready;
+    } else {
+      reset.state = match_state::done;
+      reset.winner = winner;
+      eliminate(loser, m.round);
+    }
+    return;
+  }
+  case bracket_side::reset:
+    eliminate(loser, m.round);
+    return;
+  case bracket_side::winners:
+  case bracket_side::losers:
+    break;
+  }
+  if (m.winner_to != nowhere) {
+    fill(m.winner_to, winner);
+  }
+  if (m.loser_to != nowhere) {
+    fill(m.loser_to, loser);
+  } else {
+    eliminate(loser, m.round);
+  }
+}
+
+std::vector<uint32_t> tournament::ready() const {
+  std::vector<uint32_t> out;
+  for (uint32_t i = 0; i < bracket.size(); ++i) {
+    if (bracket[i].state == match_state::ready) {
+      out.push_back(i);
+    }
+  }
+  return out;
+}
+
+void tournament::start(uint32_t match, lobby_id lobby) {
+  if (match < bracket.size() && bracket[match].state == match_state::ready) {
+    bracket[match].state = match_state::playing;
+    bracket[match].lobby = lobby;
+  }
+}
+
+void tournament::restart(uint32_t match) {
+  if (match < bracket.size() && bracket[match].state == match_state::playing) {
+    bracket[match].state = match_state::ready;
+    bracket[match].lobby = 0;
+  }
+}
+
+bool tournament::report(uint32_t match, int seat) {
+  if (match >= bracket.size() || bracket[match].state != match_state::playing) {
+    return false;
+  }
+  bracket_match &m = bracket[match];
+  const auto [a, b] = m.seats;
+  opponents[a].push_back(b);
+  opponents[b].push_back(a);
+  if (seat < 0 && kind == tournament_format::swiss) {
+    m.state = match_state::done;
+    m.lobby = 0;
+    for (const uint32_t e : m.seats) {
+      records[e].draws++;
+      records[e].points += 1;
+    }
+  } else {
+    if (seat < 0) {
+      seat = a < b ? 0 : 1;
+    }
+    const uint32_t winner = m.seats[static_cast<size_t>(seat)];
+    const uint32_t loser = m.seats[static_cast<size_t>(1 - seat)];
+    records[winner].wins++;
+    records[winner].points += 2;
+    records[loser].losses++;
+    settle(match, static_cast<uint32_t>(seat));
+  }
+  if (kind == tournament_format::swiss && --unfinished == 0 &&
+      paired < round_count) {
+    pair_swiss();
+  }
+  return true;
+}
+
+bool tournament::finished() const {
+  if (kind == tournament_format::swiss && paired < round_count) {
+    return false;
+  }
+  return std::all_of(bracket.begin(), bracket.end(), [](const auto &m) {
+    return m.state == match_state::done;
+  });
+}
+
+unsigned int tournament::round() const {
+  unsigned int lowest{0};
+  unsigned int highest{0};
+  for (const auto &m : bracket) {
+    highest = std::max<unsigned int>(highest, m.round);
+    if (m.state != match_state::done &&
+        (lowest == 0 || m.round < lowest)) {
+      lowest = m.round;
+    }
+  }
+  return lowest != 0 ? lowest : highest;
+}
+
+std::vector<standing> tournament::standings() const {
+  std::vector<standing> out = records;
+  for (auto &s : out) {
+    s.eliminated = knocked_out[s.entrant] != 0;
+    for (const uint32_t o : opponents[s.entrant]) {
+      s.buchholz += records[o].points;
+    }
+  }
+  if (kind == tournament_format::swiss) {
+    std::sort(out.begin(), out.end(), [](const auto &a, const auto &b) {
+      return std::tie(b.points, b.buchholz, a.entrant) <
+             std::tie(a.points, a.buchholz, b.entrant);
+    });
+  } else {
+    /* Still in first, then by how deep each entrant went out */
+    std::sort(out.begin(), out.end(), [this](const auto &a, const auto &b) {
+      const uint32_t a_depth =
+          a.eliminated ? knocked_out[a.entrant] : UINT32_MAX;
+      const uint32_t b_depth =
+          b.eliminated ? knocked_out[b.entrant] : UINT32_MAX;
+      return std::tie(b_depth, b.wins, a.entrant) <
+             std::tie(a_depth, a.wins, b.entrant);
+    });
+  }
+  return out;
+}
+
+template <typename T> static void put(std::string &out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+/**
+ * @brief Bounds checked cursor over an encoded state
+ */
+struct state_cursor {
+  std::string_view in;
+
+  template <typename T> T get() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    if (in.size() < sizeof(T)) {
+      throw std::runtime_error("tournament state truncated");
+    }
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+  }
+
+  /**
+   * @brief A count of items taking at least size bytes each
+   */
+  size_t count(size_t size) {
+    const auto n = get<uint32_t>();
+    if (n > in.size() / size) {
+      throw std::runtime_error("tournament state truncated");
+    }
+    return n;
+  }
+};
+
+std::string tournament::encode() const {
+  std::string out;
+  out.reserve(16 + entrants.size() * 40 + bracket.size() * 24);
+  put(out, static_cast<uint8_t>(kind));
+  put(out, static_cast<uint32_t>(round_count));
+  put(out, static_cast<uint32_t>(paired));
+  put(out, static_cast<uint32_t>(entrants.size()));
+  for (uint32_t i = 0; i < entrants.size(); ++i) {
+    put(out, static_cast<uint64_t>(entrants[i]));
+    put(out, records[i].points);
+    put(out, records[i].wins);
+    put(out, records[i].losses);
+    put(out, records[i].draws);
+    put(out, had_bye[i]);
+    put(out, knocked_out[i]);
+    put(out, static_cast<uint32_t>(opponents[i].size()));
+    for (const uint32_t o : opponents[i]) {
+      put(out, o);
+    }
+  }
+  put(out, static_cast<uint32_t>(bracket.size()));
+  for (const auto &m : bracket) {
+    put(out, m.seats[0]);
+    put(out, m.seats[1]);
+    put(out, m.winner);
+    put(out, m.winner_to);
+    put(out, m.loser_to);
+    put(out, static_cast<uint32_t>(m.lobby));
+    put(out, m.round);
+    put(out, static_cast<uint8_t>(m.side));
+    put(out, static_cast<uint8_t>(m.state));
+  }
+  return out;
+}
+
+tournament tournament::decode(std::string_view state) {
+  state_cursor in{state};
+  tournament t;
+  const auto kind = in.get<uint8_t>();
+  if (kind > static_cast<uint8_t>(tournament_format::swiss)) {
+    throw std::runtime_error("tournament state has an unknown format");
+  }
+  t.kind = static_cast<tournament_format>(kind);
+  t.round_count = in.get<uint32_t>();
+  t.paired = in.get<uint32_t>();
+  /* An entrant takes at least 33 bytes and a match 26 */
+  const size_t n = in.count(33);
+  t.entrants.resize(n);
+  t.records.resize(n);
+  t.opponents.resize(n);
+  t.had_bye.resize(n);
+  t.knocked_out.resize(n);
+  for (uint32_t i = 0; i < n; ++i) {
+    t.entrants[i] = in.get<uint64_t>();
+    t.records[i].entrant = i;
+    t.records[i].points = in.get<uint32_t>();
+    t.records[i].wins = in.get<uint32_t>();
+    t.records[i].losses = in.get<uint32_t>();
+    t.records[i].draws = in.get<uint32_t>();
+    t.had_bye[i] = in.get<uint8_t>();
+    t.knocked_out[i] = in.get<uint32_t>();
+    t.opponents[i].resize(in.count(sizeof(uint32_t)));
+    for (auto &o : t.opponents[i]) {
+      o = in.get<uint32_t>();
+      if (o >= n) {
+        throw std::runtime_error("tournament state has a bad opponent");
+      }
+    }
+  }
+  if (n < 2) {
+    throw std::runtime_error("tournament state has too few entrants");
+  }
+  t.bracket.resize(in.count(26));
+  const auto is_entrant = [n](uint32_t e) {
+    return e < n || e == no_entrant || e == bye;
+  };
+  const auto is_seat = [&t](uint32_t to) {
+    return to == nowhere || to / 2 < t.bracket.size();
+  };
+  for (auto &m : t.bracket) {
+    m.seats[0] = in.get<uint32_t>();
+    m.seats[1] = in.get<uint32_t>();
+    m.winner = in.get<uint32_t>();
+    m.winner_to = in.get<uint32_t>();
+    m.loser_to = in.get<uint32_t>();
+    m.lobby = in.get<uint32_t>();
+    m.round = in.get<uint16_t>();
+    const auto side = in.get<uint8_t>();
+    const auto state_value = in.get<uint8_t>();
+    if (side > static_cast<uint8_t>(bracket_side::swiss) ||
+        state_value > static_cast<uint8_t>(match_state::done) ||
+        !is_entrant(m.seats[0]) || !is_entrant(m.seats[1]) ||
+        !is_entrant(m.winner) || !is_seat(m.winner_to) ||
+        !is_seat(m.loser_to)) {
+      throw std::runtime_error("tournament state has a bad match");
+    }
+    m.side = static_cast<bracket_side>(side);
+    m.state = static_cast<match_state>(state_value);
+    if (m.side == bracket_side::grand_final &&
+        &m + 1 == t.bracket.data() + t.bracket.size()) {
+      throw std::runtime_error("tournament state has no reset match");
+    }
+    if (m.side == bracket_side::swiss && m.round == t.paired &&
+        m.state != match_state::done) {
+      ++t.unfinished;
+    }
+  }
+  return t;
+}
+
+} // namespace core
@@ -0,0 +1,127 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <atomic>
+#include <fmt/format.h>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/config.h>
+#include <rps/domain/metrics.h>
+
+namespace backpressure {
+
+static metrics::gauge &in_flight_gauge = metrics::get_gauge(
+    "rps_outbound_in_flight", "Outbound REST calls queued or running");
+static metrics::gauge &latency_gauge = metrics::get_gauge(
+    "rps_outbound_latency_average_ms",
+    "Moving average latency of outbound REST calls");
+static metrics::gauge &level_gauge = metrics::get_gauge(
+    "rps_load_shed_level",
+    "0 normal, 1 shedding channel posts, 2 stretching pairing, 3 rejecting "
+    "/queue");
+
+static metrics::counter &shed(const char *action) {
+  return metrics::get_counter("rps_load_shed_total",
+                              "Work skipped to relieve outbound pressure",
+                              fmt::format("action=\"{}\"", action));
+}
+
+static metrics::counter &shed_channel_posts = shed("channel_post");
+static metrics::counter &shed_pairing = shed("stretch_pairing");
+static metrics::counter &shed_queue = shed("reject_queue");
+
+/**
+ * @brief Weight of each new sample in the moving average. At 1/32 the
+ * average follows a sustained change within about a hundred calls.
+ */
+static constexpr double smoothing = 1.0 / 32;
+
+static std::atomic<int64_t> pending{0};
+static std::atomic<double> average_ms{0};
+
+void started() {
+  in_flight_gauge.set(pending.fetch_add(1, std::memory_order_relaxed) + 1);
+}
+
+void finished(std::chrono::nanoseconds latency) {
+  in_flight_gauge.set(pending.fetch_sub(1, std::memory_order_relaxed) - 1);
+  const double sample =
+      std::chrono::duration<double, std::milli>(latency).count();
+  double current = average_ms.load(std::memory_order_relaxed);
+  double next{0};
+  do {
+    next = current + (sample - current) * smoothing;
+  } while (!average_ms.compare_exchange_weak(current, next,
+                                             std::memory_order_relaxed));
+  latency_gauge.set(static_cast<int64_t>(next));
+}
+
+/**
+ * @brief Whether a threshold is crossed. Latency only counts while calls are
+ * in flight, so an average left high by a burst cannot pin the bot in a
+ * degraded step once the queues have drained.
+ */
+static bool exceeded(const config::load_threshold &t, int64_t calls,
+                     double latency_ms) {
+  return (t.in_flight > 0 && calls >= t.in_flight) ||
+         (t.latency_ms > 0 && calls > 0 && latency_ms >= t.latency_ms);
+}
+
+level current() {
+  const config::settings &s = config::current();
+  const int64_t calls = pending.load(std::memory_order_relaxed);
+  const double latency_ms = average_ms.load(std::memory_order_relaxed);
+  level l = level::normal;
+  if (exceeded(s.reject_queue, calls, latency_ms)) {
+    l = level::reject_queue;
+  } else if (exceeded(s.stretch_pairing, calls, latency_ms)) {
+    l = level::stretch_pairing;
+  } else if (exceeded(s.shed_channel_posts, calls, latency_ms)) {
+    l = level::shed_channel_posts;
+  }
+  level_gauge.set(static_cast<int64_t>(l));
+  return l;
+}
+
+bool shedding(level at_least) {
+  if (current() < at_least) {
+    return false;
+  }
+  switch (at_least) {
+  case level::shed_channel_posts:
+    shed_channel_posts.inc();
+    break;
+  case level::stretch_pairing:
+    shed_pairing.inc();
+    break;
+  case level::reject_queue:
+    shed_queue.inc();
+    break;
+  case level::normal:
+    break;
+  }
+  return true;
+}
+
+int64_t in_flight() { return pending.load(std::memory_order_relaxed); }
+
+std::chrono::milliseconds average_latency() {
+  return std::chrono::milliseconds(
+      static_cast<int64_t>(average_ms.load(std::memory_order_relaxed)));
+}
+
+} // namespace backpressure
@@ -0,0 +1,76 @@
+/************************************************************************************
+ *
+ * Copyright 1993,2001,2023 Craig Edwards <brain@ssod.org>
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+#include <fmt/format.h>
+#include <rps/domain/buttons/choice.h>
+#include <rps/domain/config.h>
+#include <rps/domain/game.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/rate_limit.h>
+#include <thread>
+
+static metrics::counter &duplicate_choices = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"button\",reason=\"repeat_choice\"");
+
+static metrics::counter &invalid_choices = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"button\",reason=\"invalid_choice\"");
+
+void choice_button::route(const dpp::button_click_t &event) {
+  const bool answered =
+      config::current().delivery != config::delivery_mode::interactions;
+  const dpp::snowflake player_id = event.command.get_issuing_user().id;
+  unsigned int player_lobby_id = game::find_player_lobby_id(player_id);
+  if (player_lobby_id == 0) {
+    outbound::get().log(
+        dpp::ll_error,
+        fmt::format("Unable to find lobby ID for {}", event.raw_event));
+    if (!answered) {
+      outbound::get().acknowledge(event);
+    }
+    return;
+  }
+
+  /* A stale or forged id is not a choice, and must not use up the round's
+   * one choice either */
+  if (game::parse_pick(event.custom_id) == core::choice::none) {
+    invalid_choices.inc();
+    if (!answered) {
+      outbound::get().acknowledge(event);
+    }
+    return;
+  }
+
+  /* The first choice in a round stands; repeat clicks cost no worker */
+  if (rate_limit::duplicate_choice(player_id, player_lobby_id,
+                                   game::get_game_num(player_lobby_id))) {
+    duplicate_choices.inc();
+    if (!answered) {
+      outbound::get().acknowledge(event);
+    }
+    return;
+  }
+
+  /* Spawn worker so sync methods don't block main event loop. The event is
+   * copied into the worker as it outlives this handler */
+  std::thread worker(game::handle_choice, event);
+  worker.detach();
+}
@@ -0,0 +1,238 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <rps/domain/capture.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/mpsc_ring.h>
+#include <stdexcept>
+#include <thread>
+
+namespace capture {
+
+constexpr size_t record_ring_size = 8192;
+
+/**
+ * @brief Discord epoch, 2015-01-01, in milliseconds
+ */
+constexpr uint64_t discord_epoch_ms = 1420070400000;
+
+std::atomic<bool> active{false};
+
+static mpsc_ring<record, record_ring_size> records;
+
+static std::atomic<uint64_t> dropped{0};
+
+static std::chrono::steady_clock::time_point started;
+
+/**
+ * @brief Per capture key for the id hash
+ */
+static uint64_t key{0};
+
+static std::FILE *file{nullptr};
+
+static std::jthread writer;
+
+/**
+ * @brief splitmix64 over the keyed id; 0 stays 0 so absent guilds stay absent
+ */
+static uint64_t anonymise(uint64_t id) {
+  if (id == 0) {
+    return 0;
+  }
+  uint64_t z = id ^ key;
+  z += 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  z ^= z >> 31;
+  /* Keep it a plausible snowflake: nonzero and below 2^63 */
+  return (z >> 1) | 1;
+}
+
+template <size_t N>
+static void copy_field(char (&field)[N], const std::string &value) {
+  const size_t len = std::min(value.size(), N - 1);
+  std::copy_n(value.data(), len, field);
+  field[len] = '\0';
+}
+
+static record make_record(const dpp::interaction_create_t &event,
+                          record_type type) {
+  const dpp::user &user = event.command.get_issuing_user();
+  record r{.offset_us = static_cast<uint64_t>(
+               std::chrono::duration_cast<std::chrono::microseconds>(
+                   std::chrono::steady_clock::now() - started)
+                   .count()),
+           .user_id = anonymise(user.id),
+           .guild_id = anonymise(event.command.guild_id),
+           .channel_id = anonymise(event.command.channel_id),
+           .type = type};
+  copy_field(r.locale, event.command.locale);
+  return r;
+}
+
+static void push(const record &r) {
+  if (!records.try_push(r)) {
+    dropped.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+static void write_records(const std::stop_token &stop) {
+  record r;
+  for (;;) {
+    bool idle{true};
+    while (records.try_pop(r)) {
+      idle = false;
+      std::fwrite(&r, sizeof(r), 1, file);
+    }
+    if (stop.stop_requested() && idle) {
+      return;
+    }
+    if (idle) {
+      std::fflush(file);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void start(const std::string &path) {
+  stop();
+  file = std::fopen(path.c_str(), "wb");
+  if (file == nullptr) {
+    throw std::runtime_error("Cannot open capture file " + path);
+  }
+  std::fwrite(file_magic, sizeof(file_magic), 1, file);
+  key = std::random_device{}() | (uint64_t{std::random_device{}()} << 32);
+  started = std::chrono::steady_clock::now();
+  dropped.store(0, std::memory_order_relaxed);
+  writer = std::jthread(write_records);
+  active.store(true, std::memory_order_relaxed);
+}
+
+void stop() {
+  active.store(false, std::memory_order_relaxed);
+  if (writer.joinable()) {
+    writer.request_stop();
+    writer.join();
+  }
+  if (file != nullptr) {
+    std::fclose(file);
+    file = nullptr;
+  }
+}
+
+void slashcommand(const dpp::slashcommand_t &event) {
+  record r = make_record(event, record_type::slashcommand);
+  copy_field(r.name, event.command.get_command_name());
+  const dpp::command_interaction command =
+      event.command.get_command_interaction();
+  size_t strings{0};
+  for (const auto &option : command.options) {
+    if (std::holds_alternative<int64_t>(option.value) &&
+        r.option_name[0] == '\0') {
+      copy_field(r.option_name, option.name);
+      r.option_value = std::get<int64_t>(option.value);
+    } else if (const auto *value = std::get_if<std::string>(&option.value);
+               value != nullptr && strings < max_string_options) {
+      copy_field(r.strings[strings].name, option.name);
+      copy_field(r.strings[strings].value, *value);
+      ++strings;
+    }
+  }
+  push(r);
+}
+
+void button_click(const dpp::button_click_t &event) {
+  record r = make_record(event, record_type::button_click);
+  copy_field(r.name, event.custom_id);
+  push(r);
+}
+
+std::vector<record> load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(file_magic)]{};
+  if (!in.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), file_magic)) {
+    throw std::runtime_error(path + " is not a capture file");
+  }
+  std::vector<record> out;
+  record r;
+  while (in.read(reinterpret_cast<char *>(&r), sizeof(r))) {
+    out.push_back(r);
+  }
+  return out;
+}
+
+/**
+ * @brief Interaction id timestamped with game time, which click to result
+ * latency is measured against
+ */
+static dpp::snowflake fresh_interaction_id() {
+  static std::atomic<uint64_t> increment{0};
+  const auto now_ms = static_cast<uint64_t>(timing::get().unix_time() * 1000);
+  return ((now_ms - discord_epoch_ms) << 22) | (increment++ & 0x3FFFFF);
+}
+
+static void fill_interaction(dpp::interaction &command, const record &r) {
+  command.id = fresh_interaction_id();
+  command.usr.id = r.user_id;
+  command.usr.username = "user" + std::to_string(r.user_id % 100000);
+  command.guild_id = r.guild_id;
+  command.channel_id = r.channel_id;
+  command.locale = r.locale;
+}
+
+dpp::slashcommand_t to_slashcommand(const record &r) {
+  dpp::slashcommand_t event(nullptr, "");
+  fill_interaction(event.command, r);
+  dpp::command_interaction command;
+  command.name = r.name;
+  if (r.option_name[0] != '\0') {
+    dpp::command_data_option option;
+    option.name = r.option_name;
+    option.type = dpp::co_integer;
+    option.value = r.option_value;
+    command.options.push_back(option);
+  }
+  for (const string_option &string : r.strings) {
+    if (string.name[0] == '\0') {
+      break;
+    }
+    dpp::command_data_option option;
+    option.name = string.name;
+    option.type = dpp::co_string;
+    option.value = std::string(string.value);
+    command.options.push_back(option);
+  }
+  event.command.data = command;
+  return event;
+}
+
+dpp::button_click_t to_button_click(const record &r) {
+  dpp::button_click_t event(nullptr, "");
+  fill_interaction(event.command, r);
+  event.custom_id = r.name;
+  return event;
+}
+
+} // namespace capture
@@ -0,0 +1,42 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <rps/domain/clock.h>
+
+namespace timing {
+
+static clock *installed{nullptr};
+
+void set(clock &c) { installed = &c; }
+
+clock &get() { return *installed; }
+
+std::chrono::nanoseconds real_clock::now() const {
+  return std::chrono::steady_clock::now().time_since_epoch();
+}
+
+double real_clock::unix_time() const { return dpp::utility::time_f(); }
+
+dpp::timer real_clock::start_timer(dpp::timer_callback_t on_tick,
+                                   uint64_t seconds) {
+  return cluster.start_timer(std::move(on_tick), seconds);
+}
+
+void real_clock::stop_timer(dpp::timer t) { cluster.stop_timer(t); }
+
+} // namespace timing
@@ -16,23 +16,61 @@
  *
  ************************************************************************************/
 #include <dpp/dpp.h>
+#include <fmt/format.h>
 #include <rps/domain/command.h>
+#include <rps/domain/config.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/routes.h>
 
 /**
- * @brief Internal command map
+ * @brief Wraps a command's route() to record how long it takes
  */
-static registered_command_list registered_commands;
+template <typename T> struct timed_command {
+  static constexpr std::string_view name = T::name;
+  static void route(const dpp::slashcommand_t &event) {
+    static metrics::histogram &latency = metrics::get_histogram(
+        "rps_command_duration_seconds", "Time spent handling slash commands",
+        fmt::format("command=\"{}\"", T::name));
+    metrics::scoped_timer timer(latency);
+    T::route(event);
+  }
+};
+
+template <typename... T>
+constexpr auto timed(dispatch::type_list<T...> /*unused*/) {
+  return dispatch::type_list<timed_command<T>...>{};
+}
+
+/**
+ * @brief Slash command routing table, built at compile time
+ */
+static constexpr auto command_routes =
+    dispatch::make_command_table<command_router>(timed(slash_commands{}));
 
-registered_command_list &get_command_map() { return registered_commands; }
+/**
+ * @brief Button routing table, built at compile time
+ */
+static constexpr auto button_routes =
+    dispatch::make_component_table<button_router>(button_handlers{});
 
 void route_command(const dpp::slashcommand_t &event) {
-  auto ref = registered_commands.find(event.command.get_command_name());
-  if (ref != registered_commands.end()) {
-    auto ptr = ref->second;
+  const std::string &name = event.command.get_command_name();
+  command_router ptr = command_routes.find(name);
+  if (ptr != nullptr) {
     (*ptr)(event);
   } else {
-    event.from->creator->log(dpp::ll_error,
-                             "Unable to route command: " +
-                                 event.command.get_command_name());
+    outbound::get().log(dpp::ll_error, "Unable to route command: " + name);
+  }
+}
+
+void route_button(const dpp::button_click_t &event) {
+  button_router ptr =
+      button_routes.find(dispatch::custom_id_prefix(event.custom_id));
+  if (ptr != nullptr) {
+    (*ptr)(event);
+  } else if (config::current().delivery ==
+             config::delivery_mode::interactions) {
+    outbound::get().acknowledge(event);
   }
-}
\ No newline at end of file
+}
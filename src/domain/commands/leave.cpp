@@ -20,6 +20,7 @@
 #include <rps/domain/commands/leave.h>
 #include <rps/domain/embeds.h>
 #include <rps/domain/game.h>
+#include <rps/domain/outbound.h>
 
 using namespace i18n;
 
@@ -33,15 +34,16 @@ void leave_command::route(const dpp::slashcommand_t &event) {
       game::find_player_lobby_id(event.command.usr.id);
   if (player_lobby_id == 0) {
     /* Lobby not found */
-    event.reply(
+    outbound::get().reply(
+        event,
         dpp::message("You are not in a lobby.").set_flags(dpp::m_ephemeral));
     return;
   }
 
   if (game::get_num_players(player_lobby_id) == 2) {
     /* Match found */
-    event.reply(dpp::message("You are already in a match.")
-                    .set_flags(dpp::m_ephemeral));
+    outbound::get().reply(event, dpp::message("You are already in a match.")
+                                     .set_flags(dpp::m_ephemeral));
     return;
   }
 
@@ -50,5 +52,5 @@ void leave_command::route(const dpp::slashcommand_t &event) {
   game::remove_lobby_from_queue(player_lobby_id, false);
 
   /* Send confirmation embed */
-  event.reply(embeds::leave(event, event.command.usr));
+  outbound::get().reply(event, embeds::leave(event, event.command.usr));
 }
\ No newline at end of file
@@ -20,11 +20,18 @@
 #include <dpp/appcommand.h>
 #include <dpp/message.h>
 #include <dpp/misc-enum.h>
-#include <dpp/timer.h>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/clock.h>
 #include <rps/domain/commands/leave.h>
 #include <rps/domain/commands/queue.h>
 #include <rps/domain/embeds.h>
 #include <rps/domain/game.h>
+#include <rps/domain/handoff.h>
+#include <rps/domain/logger.h>
+#include <rps/domain/matchmaking.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/trace.h>
+#include <thread>
 #include <variant>
 
 using namespace i18n;
@@ -35,58 +42,139 @@ dpp::slashcommand queue_command::register_command(dpp::cluster &bot) {
                 .add_option(dpp::command_option(dpp::co_integer, "co_queue",
                                                 "cod_queue")
                                 .set_min_value(1)
-                                .set_max_value(60)));
+                                .set_max_value(60))
+                .add_option(
+                    dpp::command_option(dpp::co_string, "co_queue_scope",
+                                        "cod_queue_scope")
+                        .add_choice(dpp::command_option_choice(
+                            "cc_scope_anyone", std::string("anyone")))
+                        .add_choice(dpp::command_option_choice(
+                            "cc_scope_server", std::string("server")))
+                        .add_choice(dpp::command_option_choice(
+                            "cc_scope_language", std::string("language")))));
+}
+
+/**
+ * @brief Scope picked with the scope option, anyone if left out
+ */
+static matchmaking::queue_scope
+scope_option(const dpp::slashcommand_t &event) {
+  const auto value = event.get_parameter(tr("co_queue_scope", event));
+  if (const auto *scope = std::get_if<std::string>(&value)) {
+    if (*scope == "server") {
+      return matchmaking::queue_scope::server;
+    }
+    if (*scope == "language") {
+      return matchmaking::queue_scope::language;
+    }
+  }
+  return matchmaking::queue_scope::anyone;
 }
 
 void queue_command::route(const dpp::slashcommand_t &event) {
-  dpp::cluster *bot = event.from->creator;
+  if (handoff::draining()) {
+    outbound::get().reply(event, dpp::message(tr("R_RESTARTING", event))
+                                     .set_flags(dpp::m_ephemeral));
+    return;
+  }
+  if (backpressure::shedding(backpressure::level::reject_queue)) {
+    outbound::get().reply(event, dpp::message(tr("R_BUSY", event))
+                                     .set_flags(dpp::m_ephemeral));
+    return;
+  }
 
   unsigned int player_lobby_id =
       game::find_player_lobby_id(event.command.usr.id);
   if (player_lobby_id != 0) {
     /* Game found */
-    event.reply(dpp::message(tr("R_PLAYER_ALREADY_IN_LOBBY", event))
-                    .set_flags(dpp::m_ephemeral));
+    outbound::get().reply(
+        event, dpp::message(tr("R_PLAYER_ALREADY_IN_LOBBY", event))
+                   .set_flags(dpp::m_ephemeral));
     return;
   }
 
-  /* No player game found, finding open game */
-  unsigned int open_lobby_id = game::find_open_lobby_id();
-
-  if (open_lobby_id == 0) {
-    open_lobby_id = game::create_lobby();
-  }
-
-  game::add_player_to_lobby(open_lobby_id, event);
-
   long queue_time = 0;
   if (std::holds_alternative<std::monostate>(
           event.get_parameter(tr("CO_QUEUE", event)))) {
-    queue_time = config::get("default_queue_time");
+    queue_time = config::current().default_queue_time;
   } else {
     queue_time =
         std::get<std::int64_t>(event.get_parameter(tr("CO_QUEUE", event)));
   }
+  const auto start_queue_timer = [&event, queue_time](unsigned int lobby_id) {
+    game::start_queue_timer(event.command.usr.id, 60 * queue_time, [=]() {
+      game::remove_lobby_from_queue(lobby_id, false);
+      outbound::get().channel_message(
+          embeds::leave(event, event.command.usr)
+              .set_channel_id(event.command.channel_id));
+    });
+  };
 
-  game::start_queue_timer(
-      event.command.usr.id,
-      event.from->creator->start_timer(
-          [=](unsigned long t) {
-            game::remove_lobby_from_queue(open_lobby_id, false);
-            event.from->creator->message_create(
-                embeds::leave(event, event.command.usr)
-                    .set_channel_id(event.command.channel_id));
-            event.from->creator->stop_timer(t);
-          },
-          60 * queue_time));
+  /* No player game found, pairing with a waiting lobby in scope */
+  const matchmaking::queue_scope scope = scope_option(event);
+  const matchmaking::key_list keys = matchmaking::keys_for(
+      scope, event.command.guild_id, event.command.locale);
+  unsigned int open_lobby_id = 0;
+  game::join_result joined{game::join_result::lobby_gone};
+  while ((open_lobby_id = matchmaking::claim(keys)) != 0 &&
+         (joined = game::add_player_to_lobby(open_lobby_id, event, scope)) ==
+             game::join_result::lobby_gone) {
+    /* Closed since it was listed; try the next */
+  }
 
-  const unsigned int player_count = game::get_num_players(open_lobby_id);
+  if (joined == game::join_result::player_seated) {
+    /* Seated since the check above; the waiter keeps their place */
+    game::requeue_lobby(open_lobby_id);
+    outbound::get().reply(
+        event, dpp::message(tr("R_PLAYER_ALREADY_IN_LOBBY", event))
+                   .set_flags(dpp::m_ephemeral));
+    return;
+  }
+
+  if (open_lobby_id == 0) {
+    open_lobby_id = game::create_lobby();
+    joined = game::add_player_to_lobby(open_lobby_id, event, scope);
+    if (joined != game::join_result::seated) {
+      game::remove_lobby_from_queue(open_lobby_id, false);
+      outbound::get().reply(
+          event, dpp::message(tr("R_PLAYER_ALREADY_IN_LOBBY", event))
+                     .set_flags(dpp::m_ephemeral));
+      return;
+    }
+    /* Everything of ours is in place before a joiner can claim it */
+    start_queue_timer(open_lobby_id);
+    matchmaking::offer(open_lobby_id, keys);
+  } else {
+    start_queue_timer(open_lobby_id);
+  }
+
+  /* Only the join that filled the lobby starts its match */
+  const bool filled = joined == game::join_result::filled;
+  const unsigned int player_count = filled ? 2 : 1;
 
   /* Send confirmation embed */
-  event.reply(embeds::queue(event, event.command.usr, player_count));
+  dpp::message confirmation;
+  {
+    trace::span span("embeds::queue");
+    confirmation = embeds::queue(event, event.command.usr, player_count);
+  }
+  outbound::get().reply(event, confirmation);
 
-  if (player_count == 2) {
-    bot->log(dpp::ll_debug, fmt::format("Lobby {} started!", open_lobby_id));
+  if (!filled) {
+    game::queue_bot(open_lobby_id, event.command.usr.id);
+  } else {
+    logger::lobby_started(open_lobby_id);
+    if (backpressure::shedding(backpressure::level::stretch_pairing)) {
+      /* Spread match starts out while the outbound queues drain */
+      timing::get().start_timer(
+          [open_lobby_id](core::timer t) {
+            timing::get().stop_timer(t);
+            std::thread worker(game::send_game_messages, open_lobby_id);
+            worker.detach();
+          },
+          config::current().stretch_pairing_delay);
+      return;
+    }
     std::thread worker(game::send_game_messages, open_lobby_id);
     worker.detach();
   }
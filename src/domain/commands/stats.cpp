@@ -0,0 +1,68 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <dpp/appcommand.h>
+#include <rps/domain/commands/stats.h>
+#include <rps/domain/embeds.h>
+#include <rps/domain/game.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/stats.h>
+#include <variant>
+
+using namespace i18n;
+
+dpp::slashcommand stats_command::register_command(dpp::cluster &bot) {
+  return tr(dpp::slashcommand("c_stats", "d_stats", bot.me.id)
+                .set_dm_permission(true)
+                .add_option(dpp::command_option(dpp::co_user,
+                                                "co_stats_player",
+                                                "cod_stats_player"))
+                .add_option(dpp::command_option(
+                    dpp::co_user, "co_stats_versus", "cod_stats_versus")));
+}
+
+/**
+ * @brief The user passed for a user option, or nullptr if it was left out
+ */
+static const dpp::user *user_option(const dpp::slashcommand_t &event,
+                                    const std::string &key) {
+  const auto value = event.get_parameter(tr(key, event));
+  if (!std::holds_alternative<dpp::snowflake>(value)) {
+    return nullptr;
+  }
+  const auto &resolved = event.command.resolved.users;
+  const auto found = resolved.find(std::get<dpp::snowflake>(value));
+  return found == resolved.end() ? nullptr : &found->second;
+}
+
+void stats_command::route(const dpp::slashcommand_t &event) {
+  const dpp::user *player = user_option(event, "co_stats_player");
+  if (player == nullptr) {
+    player = &event.command.usr;
+  }
+  const core::history &rounds = stats::history();
+
+  std::optional<std::pair<dpp::user, core::player_stats>> versus;
+  if (const dpp::user *opponent = user_option(event, "co_stats_versus")) {
+    versus.emplace(*opponent, rounds.versus(player->id, opponent->id));
+  }
+
+  outbound::get().reply(event,
+                        embeds::stats(event, game::rules(), *player,
+                                      rounds.stats(player->id), versus));
+}
@@ -0,0 +1,166 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <cstdint>
+#include <dpp/appcommand.h>
+#include <dpp/message.h>
+#include <rps/domain/commands/tournament.h>
+#include <rps/domain/embeds.h>
+#include <rps/domain/game.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/tournament.h>
+#include <variant>
+
+using namespace i18n;
+
+dpp::slashcommand tournament_command::register_command(dpp::cluster &bot) {
+  dpp::command_option action(dpp::co_string, "co_tournament_action",
+                             "cod_tournament_action", true);
+  for (const char *choice : {"open", "join", "leave", "start", "cancel",
+                             "status"}) {
+    action.add_choice(dpp::command_option_choice(
+        std::string("cc_tournament_") + choice, std::string(choice)));
+  }
+  return tr(dpp::slashcommand("c_tournament", "d_tournament", bot.me.id)
+                .set_dm_permission(false)
+                .add_option(action)
+                .add_option(
+                    dpp::command_option(dpp::co_string, "co_tournament_format",
+                                        "cod_tournament_format")
+                        .add_choice(dpp::command_option_choice(
+                            "cc_tournament_single", std::string("single")))
+                        .add_choice(dpp::command_option_choice(
+                            "cc_tournament_double", std::string("double")))
+                        .add_choice(dpp::command_option_choice(
+                            "cc_tournament_swiss", std::string("swiss"))))
+                .add_option(dpp::command_option(dpp::co_integer,
+                                                "co_tournament_rounds",
+                                                "cod_tournament_rounds")
+                                .set_min_value(1)
+                                .set_max_value(20)));
+}
+
+/**
+ * @brief Format picked with the format option, single elimination if left out
+ */
+static core::tournament_format
+format_option(const dpp::slashcommand_t &event) {
+  const auto value = event.get_parameter(tr("co_tournament_format", event));
+  if (const auto *format = std::get_if<std::string>(&value)) {
+    if (*format == "double") {
+      return core::tournament_format::double_elimination;
+    }
+    if (*format == "swiss") {
+      return core::tournament_format::swiss;
+    }
+  }
+  return core::tournament_format::single_elimination;
+}
+
+/**
+ * @brief Reply key for a tournament command's outcome
+ */
+static const char *response(tournament::result outcome) {
+  switch (outcome) {
+  case tournament::result::exists:
+    return "R_TOURNAMENT_EXISTS";
+  case tournament::result::none:
+    return "R_TOURNAMENT_NONE";
+  case tournament::result::started:
+    return "R_TOURNAMENT_STARTED";
+  case tournament::result::already_joined:
+    return "R_TOURNAMENT_ALREADY_JOINED";
+  case tournament::result::not_joined:
+    return "R_TOURNAMENT_NOT_JOINED";
+  case tournament::result::too_few:
+    return "R_TOURNAMENT_TOO_FEW";
+  case tournament::result::not_organiser:
+    return "R_TOURNAMENT_NOT_ORGANISER";
+  case tournament::result::ok:
+    break;
+  }
+  return "R_TOURNAMENT_NONE";
+}
+
+void tournament_command::route(const dpp::slashcommand_t &event) {
+  const dpp::snowflake channel_id = event.command.channel_id;
+  const dpp::snowflake user_id = event.command.usr.id;
+  if (event.command.guild_id.empty()) {
+    outbound::get().reply(event,
+                          dpp::message(tr("R_TOURNAMENT_SERVER_ONLY", event))
+                              .set_flags(dpp::m_ephemeral));
+    return;
+  }
+
+  const auto value = event.get_parameter(tr("co_tournament_action", event));
+  const auto *action = std::get_if<std::string>(&value);
+  if (action == nullptr || *action == "status") {
+    if (auto summary = tournament::summary(channel_id, event)) {
+      outbound::get().reply(event, *summary);
+    } else {
+      outbound::get().reply(event,
+                            dpp::message(tr("R_TOURNAMENT_NONE", event))
+                                .set_flags(dpp::m_ephemeral));
+    }
+    return;
+  }
+
+  game::player_context context;
+  context.player = event.command.usr;
+  context.guild_id = event.command.guild_id;
+  context.channel_id = channel_id;
+  context.locale = event.command.locale;
+
+  tournament::result outcome{tournament::result::none};
+  const char *confirmation{""};
+  if (*action == "open") {
+    unsigned int rounds{0};
+    const auto given = event.get_parameter(tr("co_tournament_rounds", event));
+    if (const auto *r = std::get_if<std::int64_t>(&given)) {
+      rounds = static_cast<unsigned int>(*r);
+    }
+    outcome =
+        tournament::open(channel_id, context, format_option(event), rounds);
+    if (outcome == tournament::result::ok) {
+      /* The organiser plays too */
+      tournament::join(channel_id, context);
+    }
+    confirmation = "R_TOURNAMENT_OPENED";
+  } else if (*action == "join") {
+    outcome = tournament::join(channel_id, context);
+    confirmation = "R_TOURNAMENT_JOINED";
+  } else if (*action == "leave") {
+    outcome = tournament::leave(channel_id, user_id);
+    confirmation = "R_TOURNAMENT_LEFT";
+  } else if (*action == "start") {
+    outcome = tournament::begin(channel_id, user_id);
+    confirmation = "R_TOURNAMENT_BEGUN";
+  } else if (*action == "cancel") {
+    outcome = tournament::cancel(channel_id, user_id);
+    confirmation = "R_TOURNAMENT_CANCELLED";
+  }
+
+  if (outcome != tournament::result::ok) {
+    outbound::get().reply(event, dpp::message(tr(response(outcome), event))
+                                     .set_flags(dpp::m_ephemeral));
+    return;
+  }
+  outbound::get().reply(event,
+                        dpp::message(tr(confirmation, event,
+                                        event.command.usr.format_username())));
+}
@@ -15,19 +15,221 @@
  * limitations under the License.
  *
  ************************************************************************************/
+#include <atomic>
 #include <dpp/dpp.h>
 #include <dpp/json.h>
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <rps/domain/config.h>
+#include <rps/domain/lang.h>
 #include <rps/domain/rps.h>
+#include <stdexcept>
+#include <vector>
 
 namespace config {
 
 static json configdocument;
 
+static std::string config_path;
+static time_t last_config{0};
+
+/**
+ * @brief The published snapshot. Readers only ever load this pointer.
+ */
+static std::atomic<const settings *> snapshot{nullptr};
+
+/**
+ * @brief Every snapshot ever published. Readers may still hold a reference
+ * to an old one, and reloads are rare, so they are never freed.
+ */
+static std::vector<std::unique_ptr<const settings>> snapshots;
+static std::mutex snapshots_mutex;
+
+template <typename T>
+static void read(const json &document, const char *key, T &value) {
+  if (!document.contains(key)) {
+    return;
+  }
+  try {
+    value = document.at(key).get<T>();
+  } catch (const std::exception &e) {
+    throw std::invalid_argument(
+        fmt::format("config key {}: {}", key, e.what()));
+  }
+}
+
+template <typename T>
+static void read(const json &document, const char *key, T &value, T min,
+                 T max) {
+  if (!document.contains(key)) {
+    return;
+  }
+  int64_t v{0};
+  read(document, key, v);
+  if (v < static_cast<int64_t>(min) || v > static_cast<int64_t>(max)) {
+    throw std::invalid_argument(fmt::format(
+        "config key {}: {} is outside the range {}-{}", key, v, min, max));
+  }
+  value = static_cast<T>(v);
+}
+
+static void read(const json &document, const char *step,
+                 load_threshold &value) {
+  read(document, fmt::format("{}_in_flight", step).c_str(), value.in_flight,
+       0U, 1'000'000U);
+  read(document, fmt::format("{}_latency_ms", step).c_str(),
+       value.latency_ms, 0U, 600'000U);
+}
+
+/**
+ * @brief A custom variant: its match length and a list of choices, each with
+ * a name, an emoji and the names of the choices it beats
+ */
+static core::variant read_variant(const std::string &name,
+                                  const json &definition) {
+  core::variant v{name, core::classic.first_to, core::classic.round_timeout};
+  read(definition, "first_to", v.first_to, 1U, 50U);
+  read(definition, "round_timeout", v.round_timeout, 5U, 600U);
+  const json &choices = definition.at("choices");
+  for (const auto &choice : choices) {
+    std::string emoji;
+    read(choice, "emoji", emoji);
+    v.add(choice.at("name").get<std::string>(), emoji);
+  }
+  for (const auto &choice : choices) {
+    const core::choice winner = v.parse(choice.at("name").get<std::string>());
+    for (const auto &loser : choice.value("beats", json::array())) {
+      const auto loser_name = loser.get<std::string>();
+      if (v.parse(loser_name) == core::choice::none) {
+        throw std::invalid_argument(
+            fmt::format("{} beats {}, which is not a choice",
+                        v.name_of(winner), loser_name));
+      }
+      v.beats(winner, v.parse(loser_name));
+    }
+  }
+  if (!v.complete()) {
+    throw std::invalid_argument(
+        "needs two or more choices and a winner for every pair");
+  }
+  return v;
+}
+
+static core::variant read_variant(const json &document) {
+  std::string name{core::classic.name()};
+  read(document, "variant", name);
+  if (document.contains("variants") && document.at("variants").contains(name)) {
+    try {
+      return read_variant(name, document.at("variants").at(name));
+    } catch (const std::exception &e) {
+      throw std::invalid_argument(
+          fmt::format("config key variants.{}: {}", name, e.what()));
+    }
+  }
+  if (const core::variant *v = core::builtin(name)) {
+    return *v;
+  }
+  throw std::invalid_argument(
+      fmt::format("config key variant: no variant named {}", name));
+}
+
+settings parse(const json &document) {
+  settings s;
+  read(document, "live_token", s.live_token);
+  read(document, "dev_token", s.dev_token);
+  read(document, "log", s.log);
+  read(document, "icon", s.icon);
+  read(document, "dev", s.dev);
+  read(document, "shards", s.shards, 0U, 4096U);
+  read(document, "default_queue_time", s.default_queue_time, 1U, 60U);
+  s.variant = read_variant(document);
+  s.game_timeout = s.variant.round_timeout;
+  s.first_to = s.variant.first_to;
+  read(document, "game_timeout", s.game_timeout, 5U, 600U);
+  read(document, "first_to", s.first_to, 1U, 50U);
+  read(document, "bot_wait", s.bot_wait, 0U, 3600U);
+  read(document, "bot_models", s.bot_models, 1U, 1U << 24);
+  read(document, "request_threads", s.request_threads, 1U, 256U);
+  read(document, "request_threads_raw", s.request_threads_raw, 1U, 64U);
+  std::string delivery{"messages"};
+  read(document, "delivery", delivery);
+  if (delivery == "interactions") {
+    s.delivery = delivery_mode::interactions;
+  } else if (delivery != "messages") {
+    throw std::invalid_argument(
+        "config key delivery: must be messages or interactions");
+  }
+  read(document, "rate_limit_burst", s.rate_limit_burst, 0U, 1000U);
+  read(document, "rate_limit_per_minute", s.rate_limit_per_minute, 1U,
+       6000U);
+  read(document, "shed_channel_posts", s.shed_channel_posts);
+  read(document, "stretch_pairing", s.stretch_pairing);
+  read(document, "reject_queue", s.reject_queue);
+  read(document, "stretch_pairing_delay", s.stretch_pairing_delay, 1U, 60U);
+  read(document, "handoff_socket", s.handoff_socket);
+  read(document, "handoff_wait", s.handoff_wait, 0U, 600U);
+  read(document, "drain_timeout", s.drain_timeout, 0U, 3600U);
+  read(document, "history_rows", s.history_rows, 1000U, 1'000'000'000U);
+  read(document, "dm_cache_size", s.dm_cache_size, 0U, 10'000'000U);
+  read(document, "dm_cache_ttl", s.dm_cache_ttl, 60U, 604'800U);
+  read(document, "metrics_port", s.metrics_port, uint16_t{0},
+       uint16_t{65535});
+  read(document, "trace_sample_rate", s.trace_sample_rate);
+  read(document, "api_url", s.api_url);
+  read(document, "gateway_host", s.gateway_host);
+  read(document, "capture_file", s.capture_file);
+  read(document, "journal_file", s.journal_file);
+  read(document, "tournament_file", s.tournament_file);
+  read(document, "tournament_batch", s.tournament_batch, 1U, 10'000U);
+  read(document, "tournament_post_interval", s.tournament_post_interval, 1U,
+       3600U);
+  if (s.trace_sample_rate < 0 || s.trace_sample_rate > 1) {
+    throw std::invalid_argument(
+        "config key trace_sample_rate: must be between 0 and 1");
+  }
+  if (s.live_token.empty() && s.dev_token.empty()) {
+    throw std::invalid_argument("config: no live_token or dev_token set");
+  }
+  return s;
+}
+
+static void publish(settings s) {
+  std::lock_guard<std::mutex> lock(snapshots_mutex);
+  snapshots.emplace_back(std::make_unique<const settings>(std::move(s)));
+  snapshot.store(snapshots.back().get(), std::memory_order_release);
+}
+
 void init(const std::string &config_file) {
   /* Set up the bot cluster and read the configuration json */
+  config_path = config_file;
+  last_config = i18n::get_mtime(config_file.c_str());
   std::ifstream configfile(config_file);
   configfile >> configdocument;
+  publish(parse(configdocument));
+}
+
+void init(const settings &s) { publish(s); }
+
+const settings &current() { return *snapshot.load(std::memory_order_acquire); }
+
+void check_reload(dpp::cluster &bot) {
+  time_t mtime = i18n::get_mtime(config_path.c_str());
+  if (mtime <= last_config) {
+    return;
+  }
+  last_config = mtime;
+  try {
+    json document;
+    std::ifstream configfile(config_path);
+    configfile >> document;
+    publish(parse(document));
+    bot.log(dpp::ll_info, "Reloaded " + config_path);
+  } catch (const std::exception &e) {
+    bot.log(dpp::ll_error, fmt::format("Error in {}, keeping previous "
+                                       "settings: {}",
+                                       config_path, e.what()));
+  }
 }
 
 bool exists(const std::string &key) { return configdocument.contains(key); }
@@ -0,0 +1,91 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <rps/domain/dm_channel_cache.h>
+#include <rps/domain/metrics.h>
+
+namespace outbound {
+
+static metrics::counter &cache_hits =
+    metrics::get_counter("rps_dm_channel_cache_total",
+                         "DM channel cache lookups", "result=\"hit\"");
+static metrics::counter &cache_misses =
+    metrics::get_counter("rps_dm_channel_cache_total",
+                         "DM channel cache lookups", "result=\"miss\"");
+static metrics::counter &cache_invalidations = metrics::get_counter(
+    "rps_dm_channel_cache_invalidations_total",
+    "DM channels dropped after a 403 or 404");
+
+dm_channel_cache::dm_channel_cache(dm_cache_options o) : opts(o) {}
+
+dpp::snowflake dm_channel_cache::find(dpp::snowflake user_id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(user_id);
+  if (it == entries.end()) {
+    cache_misses.inc();
+    return 0;
+  }
+  if (steady::now() >= it->second.expires) {
+    order.erase(it->second.position);
+    entries.erase(it);
+    cache_misses.inc();
+    return 0;
+  }
+  order.splice(order.begin(), order, it->second.position);
+  cache_hits.inc();
+  return it->second.channel_id;
+}
+
+void dm_channel_cache::insert(dpp::snowflake user_id,
+                              dpp::snowflake channel_id) {
+  if (opts.capacity == 0 || channel_id == 0) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  const auto expires = steady::now() + opts.ttl;
+  auto it = entries.find(user_id);
+  if (it != entries.end()) {
+    it->second.channel_id = channel_id;
+    it->second.expires = expires;
+    order.splice(order.begin(), order, it->second.position);
+    return;
+  }
+  if (entries.size() >= opts.capacity) {
+    entries.erase(order.back());
+    order.pop_back();
+  }
+  order.push_front(user_id);
+  entries.emplace(user_id, entry{channel_id, expires, order.begin()});
+}
+
+void dm_channel_cache::invalidate(dpp::snowflake user_id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = entries.find(user_id);
+  if (it != entries.end()) {
+    order.erase(it->second.position);
+    entries.erase(it);
+    cache_invalidations.inc();
+  }
+}
+
+size_t dm_channel_cache::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+} // namespace outbound
@@ -20,6 +20,7 @@
 #include <dpp/snowflake.h>
 #include <dpp/user.h>
 #include <fmt/format.h>
+#include <iterator>
 #include <rps/domain/embeds.h>
 #include <rps/domain/rps.h>
 
@@ -29,8 +30,8 @@ namespace embeds {
 dpp::message queue(const dpp::interaction_create_t &interaction,
                    const dpp::user &player, const unsigned int player_count) {
   std::string type_to_join =
-      fmt::format(fmt::runtime(tr("E_TYPE_TO_JOIN", interaction)),
-                  tr("c_queue", interaction), tr("c_queue", interaction));
+      tr("E_TYPE_TO_JOIN", interaction, tr("c_queue", interaction),
+         tr("c_queue", interaction));
 
   if (player_count == 1) {
     return dpp::embed()
@@ -64,42 +65,188 @@ dpp::message leave(const dpp::interaction_create_t &interaction,
           .set_color(EMBED_COLOR));
 }
 
-dpp::message game(const dpp::interaction_create_t &interaction,
-                  const unsigned int lobby_id, const unsigned int game_num,
-                  const std::string &player_one_name,
-                  const unsigned int player_one_score,
-                  const std::string &player_two_name,
-                  const unsigned int player_two_score) {
-  return dpp::message()
-      .add_embed(
-          dpp::embed()
-              .set_title(fmt::format("Lobby #{} - Game {}", lobby_id, game_num))
-              /* TODO: Add variable for first to 4 wins */
-              .set_description(tr("E_MAKE_SELECTION", interaction))
-              .add_field(fmt::format("{}", player_one_score), player_one_name,
-                         true)
-              .add_field(fmt::format("{}", player_two_score), player_two_name,
-                         true)
-              .set_footer(footer(interaction))
-              .set_color(EMBED_COLOR))
-      .add_component(
-          dpp::component()
-              .add_component(dpp::component()
-                                 .set_type(dpp::component_type::cot_button)
-                                 .set_label("Rock")
-                                 .set_id("Rock")
-                                 .set_style(dpp::component_style::cos_primary))
-              .add_component(dpp::component()
-                                 .set_type(dpp::component_type::cot_button)
-                                 .set_label("Paper")
-                                 .set_id("Paper")
-                                 .set_style(dpp::component_style::cos_primary))
-              .add_component(
-                  dpp::component()
-                      .set_type(dpp::component_type::cot_button)
-                      .set_label("Scissors")
-                      .set_id("Scissors")
-                      .set_style(dpp::component_style::cos_primary)));
+/**
+ * @brief Whole percent of part in total, 0 if total is 0
+ */
+static uint64_t percent(uint64_t part, uint64_t total) {
+  return total == 0 ? 0 : (part * 100 + total / 2) / total;
+}
+
+/**
+ * @brief Share of rounds on each of the variant's choices, then timed out
+ */
+static std::string picks_summary(const dpp::interaction_create_t &interaction,
+                                 const core::variant &rules,
+                                 const core::player_stats &record) {
+  std::string summary;
+  for (size_t i = 1; i <= rules.size(); ++i) {
+    summary += tr("E_STATS_PICK", interaction,
+                  rules.name_of(static_cast<core::choice>(i)),
+                  percent(record.picks[i], record.rounds));
+    summary += " · ";
+  }
+  summary += tr("E_STATS_TIMED_OUT", interaction,
+                percent(record.picks[0], record.rounds));
+  return summary;
+}
+
+static std::string rounds_summary(const dpp::interaction_create_t &interaction,
+                                  const core::player_stats &record) {
+  return tr("E_STATS_ROUNDS_VALUE", interaction, record.rounds,
+            percent(record.wins, record.rounds), record.wins, record.losses,
+            record.draws);
+}
+
+dpp::message
+stats(const dpp::interaction_create_t &interaction, const core::variant &rules,
+      const dpp::user &player, const core::player_stats &record,
+      const std::optional<std::pair<dpp::user, core::player_stats>> &versus) {
+  dpp::embed embed =
+      dpp::embed()
+          .set_title(tr("E_STATS_TITLE", interaction, player.format_username()))
+          .set_thumbnail(player.get_avatar_url(AVATAR_SIZE))
+          .set_footer(footer(interaction))
+          .set_color(EMBED_COLOR);
+  if (record.rounds == 0) {
+    embed.set_description(tr("E_STATS_NONE", interaction));
+  } else {
+    const std::string streak =
+        record.current_streak < 0
+            ? fmt::format("{}L", -record.current_streak)
+            : fmt::format("{}W", record.current_streak);
+    embed
+        .add_field(tr("E_STATS_ROUNDS", interaction),
+                   rounds_summary(interaction, record))
+        .add_field(tr("E_STATS_MATCHES", interaction),
+                   tr("E_STATS_MATCHES_VALUE", interaction, record.matches,
+                      record.matches_won))
+        .add_field(tr("E_STATS_PICKS", interaction),
+                   picks_summary(interaction, rules, record))
+        .add_field(tr("E_STATS_STREAK", interaction),
+                   tr("E_STATS_STREAK_VALUE", interaction, streak,
+                      record.longest_win_streak));
+  }
+  if (versus) {
+    const auto &[opponent, head_to_head] = *versus;
+    embed.add_field(
+        tr("E_STATS_VERSUS", interaction, opponent.format_username()),
+        head_to_head.rounds == 0
+            ? tr("E_STATS_NONE", interaction)
+            : fmt::format("{}\n{}", rounds_summary(interaction, head_to_head),
+                          tr("E_STATS_MATCHES_VALUE", interaction,
+                             head_to_head.matches, head_to_head.matches_won)));
+  }
+  return dpp::message().add_embed(embed);
+}
+
+static std::string format_name(const dpp::interaction_create_t &interaction,
+                               core::tournament_format format) {
+  switch (format) {
+  case core::tournament_format::single_elimination:
+    return tr("E_TOURNAMENT_SINGLE", interaction);
+  case core::tournament_format::double_elimination:
+    return tr("E_TOURNAMENT_DOUBLE", interaction);
+  case core::tournament_format::swiss:
+    return tr("E_TOURNAMENT_SWISS", interaction);
+  }
+  return "";
+}
+
+/**
+ * @brief Matches played and in progress, in the current round for Swiss
+ */
+static std::string progress(const dpp::interaction_create_t &interaction,
+                            const core::tournament &bracket) {
+  const unsigned int round = bracket.round();
+  const bool swiss = bracket.format() == core::tournament_format::swiss;
+  size_t played{0};
+  size_t in_progress{0};
+  size_t total{0};
+  for (const auto &m : bracket.matches()) {
+    if (m.seats[0] >= core::bye || m.seats[1] >= core::bye ||
+        (swiss && m.round != round)) {
+      continue;
+    }
+    total++;
+    if (m.state == core::match_state::done) {
+      played++;
+    } else if (m.state == core::match_state::playing) {
+      in_progress++;
+    }
+  }
+  if (swiss) {
+    return tr("E_TOURNAMENT_SWISS_PROGRESS", interaction, round,
+              bracket.rounds(), played, total, in_progress);
+  }
+  return tr("E_TOURNAMENT_ELIMINATION_PROGRESS", interaction, played,
+            in_progress);
+}
+
+dpp::message
+tournament(const dpp::interaction_create_t &interaction,
+           core::tournament_format format, size_t entrant_count,
+           const core::tournament *bracket,
+           std::span<const std::pair<std::string, core::standing>> leaders) {
+  dpp::embed embed = dpp::embed()
+                         .set_title(format_name(interaction, format))
+                         .set_footer(footer(interaction))
+                         .set_color(EMBED_COLOR);
+  if (bracket == nullptr) {
+    embed.set_description(
+        tr("E_TOURNAMENT_SIGN_UPS", interaction, entrant_count));
+    return dpp::message().add_embed(embed);
+  }
+  if (bracket->finished() && !leaders.empty()) {
+    embed.set_description(
+        tr("E_TOURNAMENT_WINNER", interaction, leaders.front().first));
+  } else {
+    embed.set_description(
+        tr("E_TOURNAMENT_ENTRANTS", interaction, entrant_count));
+    embed.add_field(tr("E_TOURNAMENT_PROGRESS", interaction),
+                    progress(interaction, *bracket));
+  }
+  std::string standings;
+  for (size_t i = 0; i < leaders.size(); ++i) {
+    const auto &[name, standing] = leaders[i];
+    standings += tr("E_TOURNAMENT_STANDING", interaction, i + 1, name,
+                    standing.wins, standing.losses, standing.draws);
+    standings += "\n";
+  }
+  if (!standings.empty()) {
+    embed.add_field(tr("E_TOURNAMENT_STANDINGS", interaction), standings);
+  }
+  return dpp::message().add_embed(embed);
+}
+
+outbound::payload game(const dpp::interaction_create_t &interaction,
+                       const core::variant &rules, const unsigned int lobby_id,
+                       const unsigned int game_num,
+                       const std::string &player_one_name,
+                       const unsigned int player_one_score,
+                       const std::string &player_two_name,
+                       const unsigned int player_two_score) {
+  fmt::memory_buffer title;
+  fmt::format_to(std::back_inserter(title), "Lobby #{} - Game {}", lobby_id,
+                 game_num);
+  message_writer writer;
+  writer.embed()
+      .title({title.data(), title.size()})
+      .description(tr("E_MAKE_SELECTION", interaction,
+                      config::current().game_timeout,
+                      config::current().first_to))
+      .field(fmt::format_int(player_one_score).c_str(), player_one_name, true)
+      .field(fmt::format_int(player_two_score).c_str(), player_two_name, true)
+      .footer(tr("E_POWERED_BY", interaction), config::current().icon)
+      .color(EMBED_COLOR);
+  /* Ids are the choice's place in the variant, see game::parse_pick */
+  fmt::memory_buffer id;
+  for (size_t i = 1; i <= rules.size(); ++i) {
+    id.clear();
+    fmt::format_to(std::back_inserter(id), "pick:{}", i);
+    writer.button(rules.name_of(static_cast<core::choice>(i)),
+                  {id.data(), id.size()});
+  }
+  return writer.finish();
 }
 
 dpp::message waiting(const dpp::interaction_create_t &interaction,
@@ -120,42 +267,53 @@ dpp::message waiting(const dpp::interaction_create_t &interaction,
           .set_color(EMBED_COLOR));
 }
 
-dpp::message game_result(const dpp::interaction_create_t &interaction,
-                         const unsigned int game_num,
-                         const std::string &player_one_name,
-                         const std::string &player_one_choice,
-                         const std::string &player_two_name,
-                         const std::string &player_two_choice,
-                         const std::string &result) {
-  return dpp::message().add_embed(
-      dpp::embed()
-          .set_title(fmt::format("GAME {}", result))
-          .set_description(fmt::format("Game {}", game_num))
-          .add_field(player_one_choice.empty() ? "DNP" : player_one_choice,
-                     player_one_name, true)
-          .add_field(player_two_choice.empty() ? "DNP" : player_two_choice,
-                     player_two_name, true)
-          .set_footer(footer(interaction))
-          .set_color(EMBED_COLOR));
+outbound::payload game_result(const dpp::interaction_create_t &interaction,
+                              const unsigned int game_num,
+                              const std::string &player_one_name,
+                              const std::string &player_one_choice,
+                              const std::string &player_two_name,
+                              const std::string &player_two_choice,
+                              const std::string &result) {
+  fmt::memory_buffer title;
+  fmt::format_to(std::back_inserter(title), "GAME {}", result);
+  fmt::memory_buffer description;
+  fmt::format_to(std::back_inserter(description), "Game {}", game_num);
+  return message_writer()
+      .embed()
+      .title({title.data(), title.size()})
+      .description({description.data(), description.size()})
+      .field(player_one_choice.empty() ? "DNP" : player_one_choice,
+             player_one_name, true)
+      .field(player_two_choice.empty() ? "DNP" : player_two_choice,
+             player_two_name, true)
+      .footer(tr("E_POWERED_BY", interaction), config::current().icon)
+      .color(EMBED_COLOR)
+      .finish();
 }
 
-dpp::message match_result(const dpp::interaction_create_t &interaction,
-                          const unsigned int lobby_id,
-                          const unsigned int game_num,
-                          const std::string &player_one_name,
-                          const unsigned int player_one_score,
-                          const std::string &player_two_name,
-                          const unsigned int player_two_score,
-                          const dpp::user &winner, bool double_afk) {
-  return dpp::message().add_embed(
-      dpp::embed()
-          .set_title(fmt::format("Lobby #{} Results", lobby_id))
-          .set_description(fmt::format("**Games Played:** {}", game_num))
-          .add_field(fmt::format("{}", player_one_score), player_one_name, true)
-          .add_field(fmt::format("{}", player_two_score), player_two_name, true)
-          .set_thumbnail(double_afk ? "" : winner.get_avatar_url(AVATAR_SIZE))
-          .set_footer(footer(interaction))
-          .set_color(EMBED_COLOR));
+outbound::payload match_result(const dpp::interaction_create_t &interaction,
+                               const unsigned int lobby_id,
+                               const unsigned int game_num,
+                               const std::string &player_one_name,
+                               const unsigned int player_one_score,
+                               const std::string &player_two_name,
+                               const unsigned int player_two_score,
+                               const dpp::user &winner, bool double_afk) {
+  fmt::memory_buffer title;
+  fmt::format_to(std::back_inserter(title), "Lobby #{} Results", lobby_id);
+  fmt::memory_buffer description;
+  fmt::format_to(std::back_inserter(description), "**Games Played:** {}",
+                 game_num);
+  return message_writer()
+      .embed()
+      .title({title.data(), title.size()})
+      .description({description.data(), description.size()})
+      .field(fmt::format_int(player_one_score).c_str(), player_one_name, true)
+      .field(fmt::format_int(player_two_score).c_str(), player_two_name, true)
+      .thumbnail(double_afk ? "" : winner.get_avatar_url(AVATAR_SIZE))
+      .footer(tr("E_POWERED_BY", interaction), config::current().icon)
+      .color(EMBED_COLOR)
+      .finish();
 }
 
 }; // namespace embeds
\ No newline at end of file
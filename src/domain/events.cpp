@@ -0,0 +1,129 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <chrono>
+#include <fmt/format.h>
+#include <mutex>
+#include <rps/domain/events.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/spmc_ring.h>
+#include <thread>
+#include <vector>
+
+namespace events {
+
+static constexpr size_t ring_size = 1 << 16;
+static constexpr size_t max_subscribers = 8;
+/**
+ * @brief Most events handed to a subscriber at once, so lag is published
+ * regularly under a sustained burst
+ */
+static constexpr size_t max_batch = 1024;
+
+static spmc_ring<event, ring_size, max_subscribers> ring;
+
+static std::mutex subscribers_mutex;
+static std::vector<std::jthread> subscribers;
+
+static metrics::counter &published = metrics::get_counter(
+    "rps_events_published_total", "Game events published to subscribers");
+static metrics::counter &dropped = metrics::get_counter(
+    "rps_events_dropped_total",
+    "Game events dropped because a subscriber fell a full ring behind");
+
+static void run(const std::stop_token &stop, size_t consumer,
+                metrics::gauge &lag, const handler &on_batch) {
+  for (;;) {
+    const size_t read = ring.consume(consumer, on_batch, max_batch);
+    lag.set(static_cast<int64_t>(ring.lag(consumer)));
+    if (read > 0) {
+      continue;
+    }
+    if (stop.stop_requested()) {
+      return;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+}
+
+bool subscribe(const std::string &name, handler on_batch) {
+  std::lock_guard<std::mutex> lock(subscribers_mutex);
+  const size_t consumer = ring.add_consumer();
+  if (consumer == max_subscribers) {
+    return false;
+  }
+  metrics::gauge &lag = metrics::get_gauge(
+      "rps_event_subscriber_lag", "Events published but not yet read",
+      fmt::format("subscriber=\"{}\"", name));
+  subscribers.emplace_back(
+      [consumer, &lag, on_batch = std::move(on_batch)](
+          const std::stop_token &stop) { run(stop, consumer, lag, on_batch); });
+  return true;
+}
+
+void publish(const event &e) {
+  if (ring.try_publish(e)) {
+    published.inc();
+  } else {
+    dropped.inc();
+  }
+}
+
+void stop() {
+  std::lock_guard<std::mutex> lock(subscribers_mutex);
+  for (auto &subscriber : subscribers) {
+    subscriber.request_stop();
+  }
+  subscribers.clear();
+}
+
+static const char *type_name(event_type type) {
+  switch (type) {
+  case event_type::lobby_created:
+    return "lobby_created";
+  case event_type::player_joined:
+    return "player_joined";
+  case event_type::game_started:
+    return "game_started";
+  case event_type::round_resolved:
+    return "round_resolved";
+  case event_type::match_ended:
+    return "match_ended";
+  case event_type::lobby_closed:
+    return "lobby_closed";
+  }
+  return "unknown";
+}
+
+void subscribe_metrics() {
+  static constexpr size_t types =
+      static_cast<size_t>(event_type::lobby_closed) + 1;
+  std::array<metrics::counter *, types> counters{};
+  for (size_t i = 0; i < types; ++i) {
+    counters[i] = &metrics::get_counter(
+        "rps_game_events_total", "Game lifecycle events",
+        fmt::format("type=\"{}\"", type_name(static_cast<event_type>(i))));
+  }
+  subscribe("metrics", [counters](std::span<const event> batch) {
+    for (const event &e : batch) {
+      counters[static_cast<size_t>(e.type)]->inc();
+    }
+  });
+}
+
+} // namespace events
@@ -0,0 +1,99 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <rps/domain/format_template.h>
+
+namespace i18n {
+
+format_template::format_template(std::string_view source) : text(source) {
+  piece current{};
+  bool automatic{false}, manual{false};
+  uint16_t next_arg{0};
+
+  auto close_piece = [&](uint16_t arg) {
+    current.length = literals.size() - current.offset;
+    current.arg = arg;
+    pieces.push_back(current);
+    current = piece{.offset = static_cast<uint32_t>(literals.size())};
+    if (arg != no_arg && arg + 1U > args_needed) {
+      args_needed = arg + 1U;
+    }
+  };
+
+  for (size_t i = 0; i < source.size(); ++i) {
+    const char c = source[i];
+    if (c == '}') {
+      if (i + 1 < source.size() && source[i + 1] == '}') {
+        literals += '}';
+        ++i;
+        continue;
+      }
+      throw fmt::format_error("unmatched '}' in format string");
+    }
+    if (c != '{') {
+      literals += c;
+      continue;
+    }
+    if (i + 1 < source.size() && source[i + 1] == '{') {
+      literals += '{';
+      ++i;
+      continue;
+    }
+
+    size_t end = source.find('}', i + 1);
+    if (end == std::string_view::npos) {
+      throw fmt::format_error("unmatched '{' in format string");
+    }
+    std::string_view field = source.substr(i + 1, end - i - 1);
+    if (field.empty()) {
+      automatic = true;
+      close_piece(next_arg++);
+    } else {
+      unsigned int index{0};
+      for (const char digit : field) {
+        if (digit < '0' || digit > '9') {
+          throw fmt::format_error(
+              "only {} and {N} replacement fields are allowed in translations");
+        }
+        index = index * 10 + (digit - '0');
+        if (index >= no_arg) {
+          throw fmt::format_error("argument index out of range");
+        }
+      }
+      manual = true;
+      close_piece(static_cast<uint16_t>(index));
+    }
+    if (automatic && manual) {
+      throw fmt::format_error(
+          "cannot switch from automatic to manual argument indexing");
+    }
+    i = end;
+  }
+  close_piece(no_arg);
+}
+
+format_template format_template::literal(std::string_view source) {
+  format_template tpl;
+  tpl.text = source;
+  tpl.literals = source;
+  tpl.pieces.push_back(
+      {.length = static_cast<uint32_t>(source.size()), .arg = no_arg});
+  return tpl;
+}
+
+} // namespace i18n
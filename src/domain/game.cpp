@@ -16,25 +16,55 @@
  *
  ************************************************************************************/
 
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
 #include <dpp/dispatcher.h>
 #include <dpp/exception.h>
 #include <dpp/message.h>
 #include <dpp/misc-enum.h>
 #include <dpp/snowflake.h>
-#include <dpp/timer.h>
 #include <fmt/format.h>
-#include <list>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <random>
+#include <rps/core/predictor.h>
+#include <rps/core/reducer.h>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
 #include <rps/domain/embeds.h>
+#include <rps/domain/events.h>
 #include <rps/domain/game.h>
+#include <rps/domain/journal.h>
+#include <rps/domain/logger.h>
+#include <rps/domain/message_writer.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/trace.h>
+#include <shared_mutex>
+#include <span>
+#include <thread>
+#include <unordered_map>
 
 namespace game {
 
-/**
- * @brief Tracks global lobby ID
- */
-unsigned int global_lobby_id{0};
+static metrics::gauge &lobbies_active = metrics::get_gauge(
+    "rps_lobbies_active", "Lobbies waiting for players or in a match");
+static metrics::gauge &queue_depth =
+    metrics::get_gauge("rps_queue_depth", "Lobbies waiting for an opponent");
+static metrics::gauge &queue_timers =
+    metrics::get_gauge("rps_timers_active", "Running timers", "kind=\"queue\"");
+static metrics::gauge &game_timers =
+    metrics::get_gauge("rps_timers_active", "Running timers", "kind=\"game\"");
+static metrics::counter &matches_completed = metrics::get_counter(
+    "rps_matches_completed_total", "Matches played to a result or timeout");
+static metrics::histogram &click_to_result = metrics::get_histogram(
+    "rps_click_to_result_seconds",
+    "Time from the click that completes a round to its results being sent");
 
 /**
  * @brief Important that only one client reads/writes to game state!
@@ -42,771 +72,897 @@ unsigned int global_lobby_id{0};
 std::shared_mutex game_mutex;
 
 /**
- * @brief Collection of pending lobbies
+ * @brief Acquire the game lock, tracing how long we waited for it
  */
-std::list<rps_lobby> lobby_queue;
+static std::unique_lock<std::shared_mutex> lock_game() {
+  trace::span span("game_mutex");
+  return std::unique_lock<std::shared_mutex>(game_mutex);
+}
 
 /**
- * @brief Creating rps_bot
+ * @brief Lobbies, scores and timers. Guarded by game_mutex.
  */
-dpp::cluster *creator{nullptr};
+static std::unique_ptr<core::engine> state;
 
-void init(dpp::cluster &bot) {
-  creator = &bot;
-  creator->log(dpp::ll_info, "Game state initialized");
+/**
+ * @brief Change the state: stamp the action with game time, journal it and
+ * reduce it. Every change goes through here. Call with the lock held.
+ */
+static core::applied apply(core::action a,
+                           std::function<void()> on_expire = {}) {
+  a.time = timing::get().unix_time();
+  journal::record(a);
+  return core::reduce(*state, a, std::move(on_expire));
 }
 
 /**
- * @brief PROTECTED
- *
- * @param player_id
- * @return unsigned int
+ * @brief Discord details of every seated player. Guarded by game_mutex.
  */
-unsigned int find_player_lobby_id(const dpp::snowflake player_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
+static std::unordered_map<uint64_t, player_context> contexts;
 
-  if (lobby_queue.empty()) {
-    return 0;
-  }
+/**
+ * @brief Every player's pick habits, for the practice bot. Guarded by
+ * game_mutex.
+ */
+static std::unique_ptr<core::predictor> habits;
 
-  for (const auto &lobby : lobby_queue) {
-    for (const auto &player_info : lobby.players) {
-      if (player_info->player.id == player_id) {
-        return lobby.id;
-      }
-    }
-  }
+/**
+ * @brief Practice bots are seated as this bit plus their lobby's id. Discord
+ * snowflakes and the ids of the load tools stay below it, so a bot can never
+ * share a seat or a context with a player.
+ */
+static constexpr uint64_t bot_ids = uint64_t{1} << 63;
+
+static bool is_bot(uint64_t player_id) { return (player_id & bot_ids) != 0; }
 
-  return 0;
+/**
+ * @brief Mirror the engine's counts into the gauges. Call with the lock held.
+ */
+static void publish_gauges() {
+  lobbies_active.set(static_cast<int64_t>(state->lobby_count()));
+  queue_depth.set(static_cast<int64_t>(state->open_lobby_count()));
+  queue_timers.set(static_cast<int64_t>(state->queue_timer_count()));
+  game_timers.set(static_cast<int64_t>(state->game_timer_count()));
 }
 
 /**
- * @brief PROTECTED
- *
- * @return unsigned int
+ * @brief Publish a lifecycle event about a lobby. Call with the lock held,
+ * which keeps the event bus single producer and in state order.
  */
-unsigned int find_open_lobby_id() {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
+static void publish_event(events::event_type type, const core::lobby &lobby,
+                          core::outcome result = core::outcome::draw) {
+  events::event e;
+  e.time = timing::get().unix_time();
+  e.type = type;
+  e.lobby_id = lobby.id;
+  e.game_number = lobby.game_number;
+  e.result = result;
+  for (size_t i = 0; i < lobby.players.size() && i < e.players.size(); ++i) {
+    e.players[i] = is_bot(lobby.players[i].id) ? 0 : lobby.players[i].id;
+    e.scores[i] = static_cast<uint16_t>(lobby.players[i].score);
+    e.picks[i] = lobby.players[i].pick;
+  }
+  events::publish(e);
+}
 
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.players.size() < 2) {
-      return lobby.id;
+/**
+ * @brief Copy a lobby for messaging. Call with the lock held.
+ */
+static lobby_view view_of(const core::lobby &lobby) {
+  lobby_view view{lobby, {}};
+  for (size_t i = 0; i < lobby.players.size() && i < view.players.size();
+       ++i) {
+    auto it = contexts.find(lobby.players[i].id);
+    if (it != contexts.end()) {
+      view.players[i] = it->second;
     }
   }
-
-  return 0;
+  return view;
 }
 
 /**
- * @brief Get the global lobby id object
- * PROTECTED
- * @return unsigned int
+ * @brief An interaction carrying a player's locale, for tr() and the embeds
  */
+static dpp::interaction_create_t localised(const player_context &context) {
+  dpp::interaction_create_t interaction;
+  interaction.command.locale = context.locale;
+  return interaction;
+}
+
+void init() {
+  auto game_lock = lock_game();
+  state = std::make_unique<core::engine>(timing::get(),
+                                         config::current().variant);
+  habits = std::make_unique<core::predictor>(config::current().bot_models,
+                                             state->rules().size());
+  apply({.type = core::action_type::session_start});
+  contexts.clear();
+  publish_gauges();
+  outbound::get().log(dpp::ll_info, "Game state initialized");
+}
+
+unsigned int find_player_lobby_id(const dpp::snowflake player_id) {
+  auto game_lock = lock_game();
+  return state->find_player_lobby(player_id);
+}
+
+unsigned int find_open_lobby_id() {
+  auto game_lock = lock_game();
+  return state->find_open_lobby();
+}
+
 unsigned int get_global_lobby_id() {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  return global_lobby_id;
+  auto game_lock = lock_game();
+  return state->last_lobby_id();
 }
 
-/**
- * @brief PROTECTED
- *
- * @param lobby_id
- * @param game_over
- */
 void remove_lobby_from_queue(const unsigned int lobby_id, bool game_over) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-
   if (!game_over) {
-    global_lobby_id--;
+    matchmaking::withdraw(lobby_id);
   }
-
-  for (auto it = lobby_queue.begin(); it != lobby_queue.end(); ++it) {
-    if (it->id == lobby_id) {
-      lobby_queue.erase(it);
-      return;
+  auto game_lock = lock_game();
+  auto removed = apply({.lobby = lobby_id,
+                        .type = core::action_type::remove_lobby,
+                        .flag = game_over})
+                     .removed;
+  if (removed) {
+    for (const auto &player : removed->players) {
+      contexts.erase(player.id);
+    }
+    if (!game_over) {
+      publish_event(events::event_type::lobby_closed, *removed);
     }
   }
+  publish_gauges();
 }
 
-/**
- * @brief Create a lobby object
- * PROTECTED
- * @return unsigned int
- */
 unsigned int create_lobby() {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-
-  rps_lobby lobby;
-  lobby.id = ++global_lobby_id;
-  lobby_queue.push_back(lobby);
-  return lobby.id;
+  auto game_lock = lock_game();
+  const unsigned int lobby_id =
+      apply({.type = core::action_type::create_lobby}).created;
+  publish_event(events::event_type::lobby_created, *state->find(lobby_id));
+  publish_gauges();
+  return lobby_id;
+}
+
+join_result add_player_to_lobby(const unsigned int lobby_id,
+                                const dpp::slashcommand_t &event,
+                                matchmaking::queue_scope scope) {
+  auto game_lock = lock_game();
+  const bool seated = apply({.players = {event.command.usr.id},
+                             .lobby = lobby_id,
+                             .type = core::action_type::add_player})
+                          .ok;
+  if (!seated) {
+    return state->find_player_lobby(event.command.usr.id) != 0
+               ? join_result::player_seated
+               : join_result::lobby_gone;
+  }
+  player_context &context = contexts[event.command.usr.id];
+  context = player_context{};
+  context.player = event.command.usr;
+  context.guild_id = event.command.guild_id;
+  context.channel_id = event.command.channel_id;
+  context.locale = event.command.locale;
+  context.scope = scope;
+  const core::lobby &lobby = *state->find(lobby_id);
+  publish_event(events::event_type::player_joined, lobby);
+  publish_gauges();
+  return lobby.full() ? join_result::filled : join_result::seated;
 }
 
 /**
- * @brief PROTECTED
- *
- * @param lobby_id
- * @param event
+ * @brief List a lobby with one waiting player under that player's keys. Call
+ * with the lock held.
  */
-void add_player_to_lobby(const unsigned int lobby_id,
-                         const dpp::slashcommand_t &event) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &it : lobby_queue) {
-    if (it.id == lobby_id) {
-      it.players.emplace_back(
-          std::make_shared<player_info>(event.command.usr, event));
-    }
+static void offer_waiting(const unsigned int lobby_id) {
+  const core::lobby *lobby = state->find(lobby_id);
+  if (lobby == nullptr || lobby->players.size() != 1) {
+    return;
   }
-}
-
-/**
- * @brief Set the player choice object
- *
- * PROTECTED
- * @param player_id
- * @param choice
- */
-void set_player_choice(const dpp::snowflake player_id,
-                       const std::string &choice) {
-  unsigned int player_lobby_id = find_player_lobby_id(player_id);
-
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  if (player_lobby_id == 0) {
+  const auto it = contexts.find(lobby->players[0].id);
+  if (it == contexts.end()) {
     return;
   }
-
-  for (auto &lobby : lobby_queue) {
-    for (auto &player_info : lobby.players) {
-      if (player_info->player.id == player_id) {
-        player_info->choice = choice;
-        return;
+  const player_context &waiting = it->second;
+  matchmaking::offer(lobby_id, matchmaking::keys_for(waiting.scope,
+                                                     waiting.guild_id,
+                                                     waiting.locale));
+}
+
+void requeue_lobby(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  offer_waiting(lobby_id);
+}
+
+std::vector<unsigned int>
+create_matches(std::span<const std::array<player_context, 2>> pairs) {
+  std::vector<unsigned int> lobbies;
+  lobbies.reserve(pairs.size());
+  auto game_lock = lock_game();
+  for (const auto &pair : pairs) {
+    const unsigned int lobby_id =
+        apply({.type = core::action_type::create_lobby}).created;
+    publish_event(events::event_type::lobby_created, *state->find(lobby_id));
+    bool seated{true};
+    for (size_t i = 0; i < pair.size() && seated; ++i) {
+      seated = apply({.players = {pair[i].player.id},
+                      .lobby = lobby_id,
+                      .type = core::action_type::add_player})
+                   .ok;
+      if (seated) {
+        publish_event(events::event_type::player_joined,
+                      *state->find(lobby_id));
       }
     }
-  }
-}
-
-/**
- * @brief Get the player choice object
- *
- * PROTECTED
- * @param player_id
- * @return std::string
- */
-std::string get_player_choice(const dpp::snowflake player_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    for (auto &player_info : lobby.players) {
-      if (player_info->player.id == player_id) {
-        return player_info->choice;
+    if (!seated) {
+      /* A player is busy elsewhere; the pair can be tried again later */
+      if (auto removed = apply({.lobby = lobby_id,
+                                .type = core::action_type::remove_lobby})
+                             .removed) {
+        publish_event(events::event_type::lobby_closed, *removed);
       }
+      lobbies.push_back(0);
+      continue;
     }
-  }
-
-  return "";
-}
-
-/**
- * @brief Get the num players object
- *
- * PROTECTED
- * @param lobby_id
- * @return unsigned int
- */
-unsigned int get_num_players(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.size();
+    for (const auto &context : pair) {
+      contexts[context.player.id] = context;
     }
+    lobbies.push_back(lobby_id);
   }
+  publish_gauges();
+  return lobbies;
+}
 
-  return 0;
+void set_player_choice(const dpp::snowflake player_id,
+                       const std::string &choice) {
+  auto game_lock = lock_game();
+  apply({.players = {player_id},
+         .type = core::action_type::set_choice,
+         .picks = {state->rules().parse(choice)}});
 }
 
-/**
- * @brief Get the lobby object
- *
- * PROTECTED
- * @param lobby_id
- * @return rps_lobby
- */
-rps_lobby get_lobby(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby;
-    }
-  }
-  return {};
+std::string get_player_choice(const dpp::snowflake player_id) {
+  auto game_lock = lock_game();
+  return std::string(state->rules().name_of(state->get_choice(player_id)));
 }
 
-unsigned int get_player_score(const unsigned int lobby_id,
-                              const unsigned int index) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.at(index)->score;
-    }
-  }
-  return 0;
+unsigned int get_num_players(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  const core::lobby *lobby = state->find(lobby_id);
+  return lobby != nullptr ? lobby->players.size() : 0;
 }
 
-/**
- * @brief Get the player info object
- *
- * PROTECTED
- * @param player_id
- * @return std::shared_ptr<player_info>
- */
-std::shared_ptr<player_info> get_player_info(const unsigned int lobby_id,
-                                             const unsigned int index) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.at(index);
-    }
+player_context get_player_context(const unsigned int lobby_id,
+                                  const unsigned int index) {
+  auto game_lock = lock_game();
+  const core::lobby *lobby = state->find(lobby_id);
+  if (lobby == nullptr || index >= lobby->players.size()) {
+    return {};
   }
-  return nullptr;
+  return view_of(*lobby).players.at(index);
 }
 
-/**
- * @brief Get the player id object
- *
- * PROTECTED
- * @param lobby_id
- * @param player_index
- * @return dpp::snowflake
- */
 dpp::snowflake get_player_id(const unsigned int lobby_id,
                              const unsigned int player_index) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.at(player_index)->player.id;
-    }
+  auto game_lock = lock_game();
+  const core::lobby *lobby = state->find(lobby_id);
+  if (lobby == nullptr || player_index >= lobby->players.size()) {
+    return 0;
   }
-  return 0;
+  return lobby->players[player_index].id;
 }
 
-/**
- * @brief PROTECTED
- *
- * @param lobby_id
- */
 void reset_choices(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      for (auto &player_info : lobby.players) {
-        player_info->choice = "";
-      }
-      return;
-    }
-  }
+  auto game_lock = lock_game();
+  apply({.lobby = lobby_id, .type = core::action_type::reset_choices});
 }
 
-/**
- * @brief PROTECTED
- *
- * @param lobby_id
- * @param player_num
- */
 void increment_player_score(const unsigned int lobby_id,
                             const unsigned int player_num) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      lobby.players[player_num]->score++;
-      return;
-    }
+  auto game_lock = lock_game();
+  apply({.lobby = lobby_id,
+         .argument = player_num,
+         .type = core::action_type::increment_score});
+}
+
+unsigned int get_game_num(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  const core::lobby *lobby = state->find(lobby_id);
+  return lobby != nullptr ? lobby->game_number : 0;
+}
+
+void increment_game_num(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  apply({.lobby = lobby_id, .type = core::action_type::increment_game});
+}
+
+bool check_both_responses(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  return state->both_chosen(lobby_id);
+}
+
+core::outcome determine_winner(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  return state->determine_winner(lobby_id);
+}
+
+std::string get_player_name(const unsigned int lobby_id,
+                            const unsigned int index) {
+  return get_player_context(lobby_id, index).player.format_username();
+}
+
+bool is_game_complete(const unsigned int lobby_id) {
+  const unsigned int first_to = config::current().first_to;
+  auto game_lock = lock_game();
+  return state->is_complete(lobby_id, first_to);
+}
+
+void start_queue_timer(const dpp::snowflake player_id, uint64_t seconds,
+                       std::function<void()> on_expire) {
+  auto game_lock = lock_game();
+  apply({.players = {player_id},
+         .argument = static_cast<uint32_t>(seconds),
+         .type = core::action_type::start_queue_timer},
+        std::move(on_expire));
+  publish_gauges();
+}
+
+void clear_queue_timer(const dpp::snowflake player_id) {
+  auto game_lock = lock_game();
+  apply({.players = {player_id}, .type = core::action_type::clear_queue_timer});
+  publish_gauges();
+}
+
+void clear_game_timer(const unsigned int lobby_id) {
+  auto game_lock = lock_game();
+  apply({.lobby = lobby_id, .type = core::action_type::clear_game_timer});
+  publish_gauges();
+}
+
+const core::variant &rules() {
+  /* The engine's variant never changes after init, so no lock is needed */
+  return state->rules();
+}
+
+core::choice parse_pick(std::string_view custom_id) {
+  static constexpr std::string_view pick_prefix{"pick:"};
+  if (!custom_id.starts_with(pick_prefix)) {
+    return rules().parse(custom_id);
   }
+  custom_id.remove_prefix(pick_prefix.size());
+  unsigned int n{0};
+  const auto [end, error] = std::from_chars(
+      custom_id.data(), custom_id.data() + custom_id.size(), n);
+  const auto pick = static_cast<core::choice>(n);
+  if (error != std::errc() || end != custom_id.data() + custom_id.size() ||
+      n > core::max_choices || !rules().valid(pick)) {
+    return core::choice::none;
+  }
+  return pick;
 }
 
+
 /**
- * @brief Get the game num object
- *
- * PROTECTED
- * @param lobby_id
- * @return unsigned int
+ * @brief The bot's pick against an opponent: the counter to their predicted
+ * pick, or a random one while the bot knows nothing about them. Call with the
+ * lock held.
  */
-unsigned int get_game_num(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.game_number;
-    }
+static core::choice bot_pick(uint64_t opponent) {
+  const core::choice guess = habits->predict(opponent);
+  const core::choice counter = state->rules().counter(guess);
+  if (counter != core::choice::none) {
+    return counter;
   }
-  return 0;
+  static std::minstd_rand random{std::random_device{}()};
+  return static_cast<core::choice>(random() % state->rules().size() + 1);
 }
 
 /**
- * @brief PROTECTED
- *
- * @param lobby_id
+ * @brief Teach the predictor the picks of a settled round. Call with the lock
+ * held.
  */
-void increment_game_num(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      lobby.game_number++;
+static void learn(const core::lobby &lobby) {
+  for (const auto &player : lobby.players) {
+    if (!is_bot(player.id)) {
+      habits->observe(player.id, player.pick);
     }
   }
 }
 
 /**
- * @brief PROTECTED
+ * @brief Seat a practice bot opposite a lobby's lone player
  *
- * @param lobby_id
- * @return true if both players have responded
- * @return false if at least one player has not responded
+ * @return false if the lobby has filled, closed or been reused since
  */
-bool check_both_responses(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return !lobby.players.front()->choice.empty() &&
-             !lobby.players.back()->choice.empty();
-    }
+static bool add_bot(const unsigned int lobby_id,
+                    const dpp::snowflake player_id) {
+  auto game_lock = lock_game();
+  const core::lobby *lobby = state->find(lobby_id);
+  if (lobby == nullptr || lobby->players.size() != 1 ||
+      lobby->players[0].id != player_id || !matchmaking::withdraw(lobby_id)) {
+    return false;
+  }
+  const uint64_t bot_id = bot_ids | lobby_id;
+  if (!apply({.players = {bot_id},
+              .lobby = lobby_id,
+              .type = core::action_type::add_player})
+           .ok) {
+    /* Withdrawn above; the player keeps waiting for someone else */
+    offer_waiting(lobby_id);
+    return false;
+  }
+  player_context bot;
+  bot.player.id = bot_id;
+  bot.player.username = "RPS Bot";
+  bot.bot = true;
+  contexts[bot_id] = bot;
+  publish_event(events::event_type::player_joined, *state->find(lobby_id));
+  publish_gauges();
+  return true;
+}
+
+void queue_bot(const unsigned int lobby_id, const dpp::snowflake player_id) {
+  const unsigned int wait = config::current().bot_wait;
+  if (wait == 0) {
+    return;
   }
-  return false;
+  timing::get().start_timer(
+      [lobby_id, player_id](core::timer t) {
+        timing::get().stop_timer(t);
+        if (!add_bot(lobby_id, player_id)) {
+          return;
+        }
+        logger::lobby_started(lobby_id);
+        std::thread worker(send_game_messages, lobby_id);
+        worker.detach();
+      },
+      wait);
 }
 
-std::string determine_winner(const unsigned int lobby_id) {
-  rps_lobby player_lobby = get_lobby(lobby_id);
-  std::string player_one_choice = get_player_choice(get_player_id(lobby_id, 0));
-  std::string player_two_choice = get_player_choice(get_player_id(lobby_id, 1));
-
-  return calculate_winner(player_one_choice, player_two_choice);
-}
-
-std::string calculate_winner(const std::string &player_one_choice,
-                             const std::string &player_two_choice) {
-  if (player_one_choice.empty() || player_two_choice.empty()) {
-    if (!player_one_choice.empty()) {
-      return "1";
-    }
-    if (!player_two_choice.empty()) {
-      return "2";
-    }
-  }
-  if (player_one_choice == "Rock") {
-    if (player_two_choice == "Rock") {
-      return "D";
-    }
-    if (player_two_choice == "Paper") {
-      return "2";
-    }
-    if (player_two_choice == "Scissors") {
-      return "1";
-    }
-  }
-  if (player_one_choice == "Paper") {
-    if (player_two_choice == "Rock") {
-      return "1";
+void send_game_messages(const unsigned int lobby_id) {
+  lobby_view view;
+  {
+    auto game_lock = lock_game();
+    const core::lobby *lobby = state->find(lobby_id);
+    if (lobby == nullptr || !lobby->full()) {
+      outbound::get().log(dpp::ll_critical, "Could not find lobby");
+      return;
     }
-    if (player_two_choice == "Paper") {
-      return "D";
+    view = view_of(*lobby);
+    if (lobby->game_number == 1) {
+      for (const auto &player : view.lobby.players) {
+        apply({.players = {player.id},
+               .type = core::action_type::clear_queue_timer});
+      }
     }
-    if (player_two_choice == "Scissors") {
-      return "2";
+    apply({.lobby = lobby_id,
+           .argument = config::current().game_timeout,
+           .type = core::action_type::start_game_timer},
+          [lobby_id]() { handle_timeout(lobby_id); });
+    /* A bot picks up front, so the round settles on its opponent's click */
+    for (size_t i = 0; i < view.lobby.players.size(); ++i) {
+      if (view.players[i].bot) {
+        apply({.players = {view.lobby.players[i].id},
+               .type = core::action_type::set_choice,
+               .picks = {bot_pick(view.lobby.players[1 - i].id)}});
+      }
     }
+    publish_event(events::event_type::game_started, *lobby);
+    publish_gauges();
   }
-  if (player_one_choice == "Scissors") {
-    if (player_two_choice == "Rock") {
-      return "2";
-    }
-    if (player_two_choice == "Paper") {
-      return "1";
+
+  const auto &players = view.lobby.players;
+  for (size_t i = 0; i < view.players.size(); ++i) {
+    if (view.players[i].bot) {
+      continue;
     }
-    if (player_two_choice == "Scissors") {
-      return "D";
+    outbound::payload game_message;
+    {
+      trace::span span("embeds::game");
+      game_message = embeds::game(
+          localised(view.players[i]), rules(), lobby_id,
+          view.lobby.game_number, view.players[0].player.format_username(),
+          players[0].score, view.players[1].player.format_username(),
+          players[1].score);
     }
+    outbound::get().direct_message(players[i].id, game_message);
   }
-  return "FF";
 }
 
 /**
- * @brief Get the player name object
- *
- * PROTECTED
- * @param lobby_id
- * @param player_index
- * @return std::string
+ * @brief Post a message in every server channel the players queued from
  */
-std::string get_player_name(const unsigned int lobby_id,
-                            const unsigned int index) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.at(index)->player.format_username();
+static void post_to_queue_channels(const lobby_view &view,
+                                   const outbound::payload &msg) {
+  std::optional<dpp::snowflake> posted;
+  for (const auto &player : view.players) {
+    if (player.guild_id.empty() || player.guild_id == 0 ||
+        posted == player.channel_id) {
+      continue;
     }
+    outbound::get().channel_message(player.channel_id, msg);
+    posted = player.channel_id;
   }
-  return "";
 }
 
-void send_game_messages(const unsigned int lobby_id) {
-  rps_lobby found_lobby = get_lobby(lobby_id);
-  if (found_lobby.id == 0) {
-    creator->log(dpp::ll_critical, "Could not find lobby");
+/**
+ * @brief Whether results go out as follow-ups on the player's last click
+ */
+static bool use_follow_up(const player_context &ctx) {
+  /* Interaction tokens live for 15 minutes; leave a minute of slack */
+  static constexpr double token_lifetime = 14 * 60;
+  return config::current().delivery == config::delivery_mode::interactions &&
+         !ctx.token.empty() &&
+         timing::get().unix_time() - ctx.token_time < token_lifetime;
+}
+
+/**
+ * @brief Send a player a message, as a follow-up to their last click when
+ * interaction delivery is on and the token is still valid, else as a DM
+ */
+static void deliver(const player_context &ctx, const outbound::payload &msg,
+                    bool sync = false) {
+  if (ctx.bot) {
     return;
   }
-  unsigned int game_num = get_game_num(lobby_id);
-
-  if (game_num == 1) {
-    for (auto &player_info : found_lobby.players) {
-      clear_queue_timer(player_info->player.id);
+  if (use_follow_up(ctx)) {
+    if (sync) {
+      outbound::get().follow_up_sync(ctx.token, msg);
+    } else {
+      outbound::get().follow_up(ctx.token, msg);
     }
-  }
-
-  std::string player_one_name = get_player_name(lobby_id, 0);
-  unsigned int player_one_score = get_player_score(lobby_id, 0);
-  std::string player_two_name = get_player_name(lobby_id, 1);
-  unsigned int player_two_score = get_player_score(lobby_id, 1);
-
-  start_game_timer(lobby_id, creator->start_timer(
-                                 [=](unsigned long t) {
-                                   handle_timeout(lobby_id);
-                                   creator->stop_timer(t);
-                                 },
-                                 GAME_TIMEOUT));
-
-  for (const auto &player_info : found_lobby.players) {
-    creator->direct_message_create(
-        player_info->player.id,
-        embeds::game(player_info->init_interaction, lobby_id, game_num,
-                     player_one_name, player_one_score, player_two_name,
-                     player_two_score));
+  } else if (sync) {
+    outbound::get().direct_message_sync(ctx.player.id, msg);
+  } else {
+    outbound::get().direct_message(ctx.player.id, msg);
   }
 }
 
-bool is_game_complete(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players.front()->score == 4 ||
-             lobby.players.back()->score == 4;
-    }
-  }
-  return false;
-}
-
-void send_result_messages(const unsigned int lobby_id,
-                          const unsigned int winner, const unsigned int loser,
-                          bool draw) {
-  unsigned int game_num = get_game_num(lobby_id);
-  std::string player_one_name = get_player_name(lobby_id, 0);
-  std::string player_one_choice = get_player_choice(get_player_id(lobby_id, 0));
-  unsigned int player_one_score = get_player_score(lobby_id, 0);
-  std::string player_two_name = get_player_name(lobby_id, 1);
-  std::string player_two_choice = get_player_choice(get_player_id(lobby_id, 1));
-  unsigned int player_two_score = get_player_score(lobby_id, 1);
-  dpp::slashcommand_t winner_int = get_player_interaction(lobby_id, winner);
-  dpp::slashcommand_t loser_int = get_player_interaction(lobby_id, loser);
-
-  dpp::message msg_win = embeds::game_result(
-      winner_int, game_num, player_one_name, player_one_choice, player_two_name,
-      player_two_choice, "WIN");
-  dpp::message msg_loss = embeds::game_result(
-      loser_int, game_num, player_one_name, player_one_choice, player_two_name,
-      player_two_choice, "LOSS");
-  if (draw) {
-    msg_win = embeds::game_result(winner_int, game_num, player_one_name,
-                                  player_one_choice, player_two_name,
-                                  player_two_choice, "DRAW");
-    msg_loss = embeds::game_result(loser_int, game_num, player_one_name,
-                                   player_one_choice, player_two_name,
-                                   player_two_choice, "DRAW");
-  }
+static void send_result_messages(const lobby_view &view,
+                                 const unsigned int winner,
+                                 const unsigned int loser, bool draw = false) {
+  const auto &players = view.lobby.players;
+  const unsigned int game_num = view.lobby.game_number;
+  const std::string player_one_name = view.players[0].player.format_username();
+  const std::string player_two_name = view.players[1].player.format_username();
+  const std::string player_one_choice(rules().name_of(players[0].pick));
+  const std::string player_two_choice(rules().name_of(players[1].pick));
 
   /* These need to be sent before the next game message is sent, so we make them
-   * synchronous */
-  creator->direct_message_create_sync(get_player_id(lobby_id, winner), msg_win);
-  creator->direct_message_create_sync(get_player_id(lobby_id, loser), msg_loss);
-
-  /* Hack to set player emoji */
-  std::string player_one_emoji_choice =
-      (player_one_choice == "Rock")
-          ? ":rock:"
-          : ((player_one_choice == "Paper") ? ":page_facing_up:"
-                                            : ":scissors:");
-  std::string player_two_emoji_choice =
-      (player_two_choice == "Rock")
-          ? ":rock:"
-          : ((player_two_choice == "Paper") ? ":page_facing_up:"
-                                            : ":scissors:");
+   * synchronous. Each payload is sent before the next is written. */
+  const char *win_result = draw ? "DRAW" : "WIN";
+  const char *loss_result = draw ? "DRAW" : "LOSS";
+  outbound::payload msg;
+  {
+    trace::span span("embeds::game_result");
+    msg = embeds::game_result(localised(view.players[winner]), game_num,
+                              player_one_name, player_one_choice,
+                              player_two_name, player_two_choice, win_result);
+  }
+  deliver(view.players[winner], msg, true);
+  {
+    trace::span span("embeds::game_result");
+    msg = embeds::game_result(localised(view.players[loser]), game_num,
+                              player_one_name, player_one_choice,
+                              player_two_name, player_two_choice, loss_result);
+  }
+  deliver(view.players[loser], msg, true);
+
+  /* Channel posts are the first thing shed when Discord falls behind */
+  if (backpressure::shedding(backpressure::level::shed_channel_posts)) {
+    return;
+  }
 
   /* Create normal text message for result (may have a higher rate limit?) */
-  dpp::message result_msg;
+  const std::string_view player_one_emoji_choice =
+      rules().emoji_of(players[0].pick);
+  const std::string_view player_two_emoji_choice =
+      rules().emoji_of(players[1].pick);
+  fmt::memory_buffer result_msg;
   if (draw) {
-    result_msg = dpp::message(fmt::format(
-        "__**Lobby #{} - Game {}**__\n{}  {}  {}  |  {}  {}  {}", lobby_id,
-        game_num, player_one_name, player_one_emoji_choice, player_one_score,
-        player_two_score, player_two_emoji_choice, player_two_name));
-  } else {
+    fmt::format_to(std::back_inserter(result_msg),
+                   "__**Lobby #{} - Game {}**__\n{}  {}  {}  |  {}  {}  {}",
+                   view.lobby.id, game_num, player_one_name,
+                   player_one_emoji_choice, players[0].score, players[1].score,
+                   player_two_emoji_choice, player_two_name);
+  } else if (winner == 0) {
     /* Determine which name + score to bold */
-    if (winner == 0) {
-      result_msg = dpp::message(fmt::format(
-          "__**Lobby #{} - Game {}**__\n**{}**  {}  **{}**  |  {}  {}  {}",
-          lobby_id, game_num, player_one_name, player_one_emoji_choice,
-          player_one_score, player_two_score, player_two_emoji_choice,
-          player_two_name));
-    } else {
-      result_msg = dpp::message(fmt::format(
-          "__**Lobby #{} - Game {}**__\n{}  {}  {}  |  **{}**  {}  **{}**",
-          lobby_id, game_num, player_one_name, player_one_emoji_choice,
-          player_one_score, player_two_score, player_two_emoji_choice,
-          player_two_name));
-    }
+    fmt::format_to(
+        std::back_inserter(result_msg),
+        "__**Lobby #{} - Game {}**__\n**{}**  {}  **{}**  |  {}  {}  {}",
+        view.lobby.id, game_num, player_one_name, player_one_emoji_choice,
+        players[0].score, players[1].score, player_two_emoji_choice,
+        player_two_name);
+  } else {
+    fmt::format_to(
+        std::back_inserter(result_msg),
+        "__**Lobby #{} - Game {}**__\n{}  {}  {}  |  **{}**  {}  **{}**",
+        view.lobby.id, game_num, player_one_name, player_one_emoji_choice,
+        players[0].score, players[1].score, player_two_emoji_choice,
+        player_two_name);
   }
 
   /* Send results in channels that players queued in */
-  dpp::slashcommand_t player_one_interaction =
-      get_player_interaction(lobby_id, 0);
-  dpp::slashcommand_t player_two_interaction =
-      get_player_interaction(lobby_id, 1);
-
-  /* Both of them were in DMs, so no work needed */
-  if ((player_one_interaction.command.guild_id.empty() ||
-       player_one_interaction.command.guild_id == 0) &&
-      (player_two_interaction.command.guild_id.empty() ||
-       player_two_interaction.command.guild_id == 0)) {
-    return;
+  message_writer text;
+  text.content({result_msg.data(), result_msg.size()});
+  post_to_queue_channels(view, text.finish());
+}
+
+static void send_match_results(const lobby_view &view,
+                               const dpp::user &winner,
+                               bool double_afk = false) {
+  matches_completed.inc();
+  const auto &players = view.lobby.players;
+  const auto match_result = [&](const dpp::interaction_create_t &locale) {
+    return embeds::match_result(
+        locale, view.lobby.id, view.lobby.game_number,
+        view.players[0].player.format_username(), players[0].score,
+        view.players[1].player.format_username(), players[1].score, winner,
+        double_afk);
+  };
+
+  for (size_t i = 0; i < view.players.size(); ++i) {
+    deliver(view.players[i], match_result(localised(view.players[i])));
   }
 
-  /* Just send one if they are the same */
-  if (player_one_interaction.command.channel_id ==
-      player_two_interaction.command.channel_id) {
-    creator->message_create(
-        result_msg.set_guild_id(player_one_interaction.command.guild_id)
-            .set_channel_id(player_one_interaction.command.channel_id));
+  /* Send results in channels that players queued in */
+  if (!backpressure::shedding(backpressure::level::shed_channel_posts)) {
+    post_to_queue_channels(view, match_result(dpp::interaction_create_t()));
+  }
+}
+
+void handle_choice(const dpp::button_click_t &event) {
+  /* Runs on its own worker thread, so pick the interaction's trace back up */
+  trace::interaction_scope trace_scope(event.command.id);
+  trace::span span("handle_choice");
+
+  const dpp::snowflake player_id = event.command.get_issuing_user().id;
+  const unsigned int first_to = config::current().first_to;
+  const core::choice pick = parse_pick(event.custom_id);
+  if (pick == core::choice::none) {
+    if (config::current().delivery == config::delivery_mode::interactions) {
+      outbound::get().acknowledge(event);
+    }
     return;
   }
 
-  if (!player_one_interaction.command.guild_id.empty() &&
-      player_one_interaction.command.guild_id != 0) {
-    creator->message_create(
-        result_msg.set_guild_id(player_one_interaction.command.guild_id)
-            .set_channel_id(player_one_interaction.command.channel_id));
+  /* 1. Set the choice and, if it was the second one, settle the round in the
+   * same critical section so two clicks cannot both settle it */
+  std::optional<core::round_result> round;
+  lobby_view view;
+  {
+    auto game_lock = lock_game();
+    const unsigned int lobby_id = state->find_player_lobby(player_id);
+    apply({.players = {player_id},
+           .type = core::action_type::clear_queue_timer});
+    if (auto ctx = contexts.find(player_id); ctx != contexts.end()) {
+      ctx->second.token = event.command.token;
+      ctx->second.token_time = event.command.id.get_creation_time();
+    }
+    apply({.players = {player_id},
+           .type = core::action_type::set_choice,
+           .picks = {pick}});
+    round = apply({.lobby = lobby_id,
+                   .argument = first_to,
+                   .type = core::action_type::resolve_round})
+                .round;
+    if (round) {
+      view = view_of(round->state);
+      learn(round->state);
+      publish_event(events::event_type::round_resolved, round->state,
+                    round->result);
+      if (round->match_over) {
+        publish_event(events::event_type::match_ended, round->state,
+                      round->result);
+        for (const auto &player : round->state.players) {
+          contexts.erase(player.id);
+        }
+      }
+    }
+    publish_gauges();
   }
 
-  if (!player_two_interaction.command.guild_id.empty() &&
-      player_two_interaction.command.guild_id != 0) {
-    creator->message_create(
-        result_msg.set_guild_id(player_two_interaction.command.guild_id)
-            .set_channel_id(player_two_interaction.command.message_id));
+  /* 2. Confirm the choice, replacing the buttons in place when we answer
+   * interactions directly */
+  message_writer confirm;
+  confirm.content(tr("E_YOU_SELECTED", event, rules().name_of(pick),
+                     tr("E_WAITING", event)));
+  if (config::current().delivery == config::delivery_mode::interactions) {
+    outbound::get().update(event, confirm.remove_components().finish());
+  } else {
+    outbound::get().direct_message(player_id, confirm.finish());
+  }
+  if (!round) {
+    return;
   }
-}
 
-/**
- * @brief Get the player interaction object
- *
- * PROTECTED
- * @param lobby_id
- * @param index
- * @return dpp::slashcommand_t
- */
-dpp::slashcommand_t get_player_interaction(const unsigned int lobby_id,
-                                           const unsigned int index) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (const auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      return lobby.players[index]->init_interaction;
-    }
+  /* 3. Report the round, then the match or the next game */
+  dpp::user winner;
+  if (round->result == core::outcome::player_one) {
+    winner = view.players[0].player;
+    send_result_messages(view, 0, 1);
+  } else if (round->result == core::outcome::player_two) {
+    winner = view.players[1].player;
+    send_result_messages(view, 1, 0);
+  } else if (round->result == core::outcome::draw) {
+    send_result_messages(view, 0, 1, true);
+  }
+  click_to_result.observe_seconds(timing::get().unix_time() -
+                                  event.command.id.get_creation_time());
+
+  if (round->match_over) {
+    send_match_results(view, winner);
+  } else {
+    send_game_messages(view.lobby.id);
   }
-  return {};
 }
 
-/**
- * @brief PROTECTED
- *
- * @param player_id
- * @param timer
- */
-void start_queue_timer(const dpp::snowflake player_id, dpp::timer timer) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    for (auto &player_info : lobby.players) {
-      if (player_info->player.id == player_id) {
-        player_info->queue_timer = timer;
-        return;
+void handle_timeout(const unsigned int lobby_id) {
+  std::optional<core::round_result> round;
+  lobby_view view;
+  {
+    auto game_lock = lock_game();
+    round = apply({.lobby = lobby_id,
+                   .argument = config::current().first_to,
+                   .type = core::action_type::resolve_round,
+                   .flag = true})
+                .round;
+    if (round) {
+      view = view_of(round->state);
+      learn(round->state);
+      publish_event(events::event_type::round_resolved, round->state,
+                    round->result);
+      publish_event(events::event_type::match_ended, round->state,
+                    round->result);
+      for (const auto &player : round->state.players) {
+        contexts.erase(player.id);
       }
     }
+    publish_gauges();
+  }
+  if (!round) {
+    return;
+  }
+
+  if (round->result == core::outcome::player_one) {
+    send_match_results(view, view.players[0].player);
+  } else if (round->result == core::outcome::player_two) {
+    send_match_results(view, view.players[1].player);
+  } else if (round->result == core::outcome::forfeit) {
+    send_match_results(view, dpp::user(), true);
   }
 }
 
+size_t lobby_count() {
+  auto game_lock = lock_game();
+  return state->lobby_count();
+}
+
 /**
- * @brief PROTECTED
- *
- * @param player_id
+ * @brief Take every lobby out of the engine. Call with the lock held.
  */
-void clear_queue_timer(const dpp::snowflake player_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    for (auto &player_info : lobby.players) {
-      if (player_info->player.id == player_id) {
-        creator->stop_timer(player_info->queue_timer);
-        return;
-      }
-    }
+static std::vector<lobby_view> checkpoint() {
+  std::vector<core::lobby> released =
+      apply({.type = core::action_type::release_all}).released;
+  matchmaking::clear();
+  std::vector<lobby_view> lobbies;
+  lobbies.reserve(released.size());
+  for (auto &lobby : released) {
+    lobbies.push_back(view_of(lobby));
   }
+  contexts.clear();
+  publish_gauges();
+  return lobbies;
 }
 
 /**
- * @brief PROTECTED
- *
- * @param lobby_id
- * @param timer
+ * @brief Whole seconds left until a deadline, at least one
  */
-void start_game_timer(const unsigned int lobby_id, dpp::timer timer) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      lobby.game_timer = timer;
-      return;
-    }
-  }
+static uint64_t seconds_until(double deadline) {
+  const double left = deadline - timing::get().unix_time();
+  return left < 1 ? 1 : static_cast<uint64_t>(std::ceil(left));
 }
 
 /**
- * @brief PROTECTED
+ * @brief Adopt checkpointed lobbies. Call with the lock held.
  *
- * @param lobby_id
+ * @param to_start filled with full lobbies that were between games
+ * @return size_t lobbies adopted
  */
-void clear_game_timer(const unsigned int lobby_id) {
-  std::lock_guard<std::shared_mutex> game_lock(game_mutex);
-  for (auto &lobby : lobby_queue) {
-    if (lobby.id == lobby_id) {
-      creator->stop_timer(lobby.game_timer);
-      return;
-    }
-  }
+static size_t adopt(std::vector<lobby_view> &lobbies,
+                    std::vector<unsigned int> &to_start) {
+  size_t restored{0};
+  for (auto &view : lobbies) {
+    const core::lobby &lobby = view.lobby;
+    core::action adopt{.lobby = lobby.id,
+                       .argument = lobby.game_number,
+                       .type = core::action_type::restore_lobby};
+    for (size_t i = 0; i < lobby.players.size() && i < 2; ++i) {
+      adopt.players[i] = lobby.players[i].id;
+      adopt.scores[i] = static_cast<uint16_t>(lobby.players[i].score);
+      adopt.picks[i] = lobby.players[i].pick;
+    }
+    if (!apply(adopt).ok) {
+      continue;
+    }
+    restored++;
+    for (size_t i = 0; i < lobby.players.size(); ++i) {
+      const player_context &context = view.players.at(i);
+      contexts[lobby.players[i].id] = context;
+      if (lobby.players[i].queue_deadline == 0) {
+        continue;
+      }
+      /* Same expiry as a /queue timeout, from what was saved */
+      apply(
+          {.players = {lobby.players[i].id},
+           .argument = static_cast<uint32_t>(
+               seconds_until(lobby.players[i].queue_deadline)),
+           .type = core::action_type::start_queue_timer},
+          [lobby_id = lobby.id, context]() {
+            remove_lobby_from_queue(lobby_id, false);
+            outbound::get().channel_message(
+                embeds::leave(localised(context), context.player)
+                    .set_channel_id(context.channel_id));
+          });
+    }
+    offer_waiting(lobby.id);
+    if (lobby.game_deadline != 0) {
+      apply({.lobby = lobby.id,
+             .argument =
+                 static_cast<uint32_t>(seconds_until(lobby.game_deadline)),
+             .type = core::action_type::start_game_timer},
+            [lobby_id = lobby.id]() { handle_timeout(lobby_id); });
+    } else if (lobby.full()) {
+      to_start.push_back(lobby.id);
+    }
+  }
+  publish_gauges();
+  return restored;
 }
 
-void send_match_results(const unsigned int lobby_id, const dpp::user &winner,
-                        bool double_afk = false) {
-  dpp::slashcommand_t player_one_interaction =
-      get_player_interaction(lobby_id, 0);
-  dpp::slashcommand_t player_two_interaction =
-      get_player_interaction(lobby_id, 1);
-
-  dpp::message player_one_message = embeds::match_result(
-      player_one_interaction, lobby_id, get_game_num(lobby_id),
-      get_player_name(lobby_id, 0), get_player_score(lobby_id, 0),
-      get_player_name(lobby_id, 1), get_player_score(lobby_id, 1), winner,
-      double_afk);
-
-  dpp::message player_two_message = embeds::match_result(
-      player_two_interaction, lobby_id, get_game_num(lobby_id),
-      get_player_name(lobby_id, 0), get_player_score(lobby_id, 0),
-      get_player_name(lobby_id, 1), get_player_score(lobby_id, 1), winner,
-      double_afk);
-
-  creator->direct_message_create(get_player_id(lobby_id, 0),
-                                 player_one_message);
-  creator->direct_message_create(get_player_id(lobby_id, 1),
-                                 player_two_message);
-
-  /* Send results in channels that players queued in */
-  dpp::message msg = embeds::match_result(
-      dpp::interaction_create_t(), lobby_id, get_game_num(lobby_id),
-      get_player_name(lobby_id, 0), get_player_score(lobby_id, 0),
-      get_player_name(lobby_id, 1), get_player_score(lobby_id, 1), winner,
-      double_afk);
-
-  /* Both of them were in DMs, so no work needed */
-  if ((player_one_interaction.command.guild_id.empty() ||
-       player_one_interaction.command.guild_id == 0) &&
-      (player_two_interaction.command.guild_id.empty() ||
-       player_two_interaction.command.guild_id == 0)) {
-    return;
-  }
-
-  /* Just send one if they are the same */
-  if (player_one_interaction.command.channel_id ==
-      player_two_interaction.command.channel_id) {
-    creator->message_create(
-        msg.set_guild_id(player_one_interaction.command.guild_id)
-            .set_channel_id(player_one_interaction.command.channel_id));
-    return;
-  }
-
-  if (!player_one_interaction.command.guild_id.empty() &&
-      player_one_interaction.command.guild_id != 0) {
-    creator->message_create(
-        msg.set_guild_id(player_one_interaction.command.guild_id)
-            .set_channel_id(player_one_interaction.command.channel_id));
-    return;
-  }
-
-  if (!player_two_interaction.command.guild_id.empty() &&
-      player_two_interaction.command.guild_id != 0) {
-    creator->message_create(
-        msg.set_guild_id(player_two_interaction.command.guild_id)
-            .set_channel_id(player_two_interaction.command.message_id));
-    return;
+/**
+ * @brief Send the next game to lobbies that were between games
+ */
+static void start_adopted(const std::vector<unsigned int> &to_start) {
+  for (const unsigned int lobby_id : to_start) {
+    std::thread worker(send_game_messages, lobby_id);
+    worker.detach();
   }
 }
 
-void handle_choice(const dpp::button_click_t &event) {
-  /* Find player lobby */
-  unsigned int player_lobby_id =
-      find_player_lobby_id(event.command.get_issuing_user().id);
-
-  rps_lobby player_lobby = get_lobby(player_lobby_id);
-
-  /* 1. Go set the choice, then send a confirmation message */
-  clear_queue_timer(event.command.get_issuing_user().id);
-  set_player_choice(event.command.get_issuing_user().id, event.custom_id);
-  creator->direct_message_create(
-      event.command.get_issuing_user().id,
-      dpp::message(fmt::format("You selected {}! {}", event.custom_id,
-                               tr("E_WAITING", event))));
-
-  /* 2. If both choices are selected, determine who won and increment winner
-   */
-  if (check_both_responses(player_lobby_id)) {
-    clear_game_timer(player_lobby_id);
-    std::string result = determine_winner(player_lobby_id);
-    dpp::user winner;
-    if (result == "1") {
-      winner = get_player_info(player_lobby_id, 0)->player;
-      increment_player_score(player_lobby_id, 0);
-      send_result_messages(player_lobby_id, 0, 1);
-    } else if (result == "2") {
-      winner = get_player_info(player_lobby_id, 1)->player;
-      increment_player_score(player_lobby_id, 1);
-      send_result_messages(player_lobby_id, 1, 0);
-    } else if (result == "D") {
-      send_result_messages(player_lobby_id, 0, 1, true);
-    }
-
-    if (is_game_complete(player_lobby_id)) {
-      /* Finish up */
-      send_match_results(player_lobby_id, winner);
-      remove_lobby_from_queue(player_lobby_id, true);
-    } else {
-      /* Send message */
-      increment_game_num(player_lobby_id);
-      reset_choices(player_lobby_id);
-      send_game_messages(player_lobby_id);
+handover_result hand_over(
+    const std::function<void(const std::vector<lobby_view> &)> &send) {
+  handover_result result;
+  std::vector<unsigned int> to_start;
+  {
+    auto game_lock = lock_game();
+    std::vector<lobby_view> lobbies = checkpoint();
+    result.checkpointed = lobbies.size();
+    try {
+      send(lobbies);
+      result.handed_off = true;
+    } catch (const std::exception &e) {
+      result.error = e.what();
+      /* Nothing can have been created since the checkpoint, so every id is
+       * still free */
+      result.restored = adopt(lobbies, to_start);
     }
   }
+  start_adopted(to_start);
+  return result;
 }
 
-void handle_timeout(const unsigned int lobby_id) {
-  std::string result = determine_winner(lobby_id);
-  dpp::user winner;
-  if (result == "1") {
-    increment_player_score(lobby_id, 0);
-    send_match_results(lobby_id, get_player_info(lobby_id, 0)->player);
-  } else if (result == "2") {
-    increment_player_score(lobby_id, 1);
-    send_match_results(lobby_id, get_player_info(lobby_id, 1)->player);
-  } else if (result == "FF") {
-    send_match_results(lobby_id, winner, true);
+size_t restore(std::vector<lobby_view> lobbies) {
+  std::vector<unsigned int> to_start;
+  size_t restored{0};
+  {
+    auto game_lock = lock_game();
+    restored = adopt(lobbies, to_start);
   }
-
-  remove_lobby_from_queue(lobby_id, true);
+  /* Paired or between games when checkpointed: send their next game */
+  start_adopted(to_start);
+  return restored;
 }
 
-} // namespace game
\ No newline at end of file
+} // namespace game
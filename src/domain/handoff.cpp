@@ -0,0 +1,331 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fmt/format.h>
+#include <poll.h>
+#include <rps/domain/config.h>
+#include <rps/domain/handoff.h>
+#include <stdexcept>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unistd.h>
+
+namespace handoff {
+
+static std::atomic<bool> drain_started{false};
+
+/**
+ * @brief How long either side waits on a stalled peer once connected
+ */
+static constexpr timeval io_timeout{10, 0};
+
+static constexpr char ack = 'K';
+
+template <typename T> static void put(std::string &out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void put(std::string &out, std::string_view value) {
+  put(out, static_cast<uint32_t>(value.size()));
+  out.append(value);
+}
+
+/**
+ * @brief Bounds checked cursor over a stream
+ */
+struct cursor {
+  std::string_view in;
+
+  void need(size_t n) const {
+    if (in.size() < n) {
+      throw std::runtime_error("handoff stream truncated");
+    }
+  }
+
+  template <typename T> T get() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    need(sizeof(T));
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+  }
+
+  std::string get_string() {
+    const auto size = get<uint32_t>();
+    need(size);
+    std::string value(in.substr(0, size));
+    in.remove_prefix(size);
+    return value;
+  }
+};
+
+std::string encode(const std::vector<game::lobby_view> &lobbies) {
+  std::string out;
+  out.reserve(sizeof(stream_magic) + 8 + lobbies.size() * 160);
+  out.append(stream_magic, sizeof(stream_magic));
+  put(out, static_cast<uint64_t>(lobbies.size()));
+  for (const auto &view : lobbies) {
+    const core::lobby &lobby = view.lobby;
+    put(out, static_cast<uint32_t>(lobby.id));
+    put(out, static_cast<uint32_t>(lobby.game_number));
+    put(out, lobby.game_deadline);
+    put(out, static_cast<uint8_t>(lobby.players.size()));
+    for (size_t i = 0; i < lobby.players.size(); ++i) {
+      const core::player &player = lobby.players[i];
+      const game::player_context &context = view.players.at(i);
+      put(out, static_cast<uint64_t>(player.id));
+      put(out, static_cast<uint8_t>(player.pick));
+      put(out, static_cast<uint32_t>(player.score));
+      put(out, player.queue_deadline);
+      put(out, std::string_view(context.player.username));
+      put(out, static_cast<uint16_t>(context.player.discriminator));
+      put(out, static_cast<uint64_t>(context.guild_id));
+      put(out, static_cast<uint64_t>(context.channel_id));
+      put(out, std::string_view(context.locale));
+      put(out, std::string_view(context.token));
+      put(out, context.token_time);
+      put(out, static_cast<uint8_t>(context.scope));
+      put(out, static_cast<uint8_t>(context.bot));
+    }
+  }
+  return out;
+}
+
+std::vector<game::lobby_view> decode(std::string_view stream) {
+  if (stream.substr(0, sizeof(stream_magic)) !=
+      std::string_view(stream_magic, sizeof(stream_magic))) {
+    throw std::runtime_error("not a handoff stream");
+  }
+  cursor in{stream.substr(sizeof(stream_magic))};
+  const auto count = in.get<uint64_t>();
+  /* Every lobby takes at least 17 bytes, so a bad count cannot over-reserve */
+  if (count > in.in.size() / 17) {
+    throw std::runtime_error("handoff stream truncated");
+  }
+
+  std::vector<game::lobby_view> lobbies(count);
+  for (auto &view : lobbies) {
+    core::lobby &lobby = view.lobby;
+    lobby.id = in.get<uint32_t>();
+    lobby.game_number = in.get<uint32_t>();
+    lobby.game_deadline = in.get<double>();
+    const auto players = in.get<uint8_t>();
+    if (players > view.players.size()) {
+      throw std::runtime_error("handoff lobby has too many players");
+    }
+    lobby.players.resize(players);
+    for (size_t i = 0; i < players; ++i) {
+      core::player &player = lobby.players[i];
+      game::player_context &context = view.players[i];
+      player.id = in.get<uint64_t>();
+      player.pick = static_cast<core::choice>(in.get<uint8_t>());
+      player.score = in.get<uint32_t>();
+      player.queue_deadline = in.get<double>();
+      context.player.id = player.id;
+      context.player.username = in.get_string();
+      context.player.discriminator = in.get<uint16_t>();
+      context.guild_id = in.get<uint64_t>();
+      context.channel_id = in.get<uint64_t>();
+      context.locale = in.get_string();
+      context.token = in.get_string();
+      context.token_time = in.get<double>();
+      const auto scope = in.get<uint8_t>();
+      if (scope > static_cast<uint8_t>(matchmaking::queue_scope::language)) {
+        throw std::runtime_error("handoff player has an unknown queue scope");
+      }
+      context.scope = static_cast<matchmaking::queue_scope>(scope);
+      context.bot = in.get<uint8_t>() != 0;
+    }
+  }
+  return lobbies;
+}
+
+/**
+ * @brief Owns a file descriptor
+ */
+struct descriptor {
+  int fd{-1};
+
+  explicit descriptor(int f) : fd(f) {
+    if (fd < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "handoff socket");
+    }
+  }
+  ~descriptor() { ::close(fd); }
+  descriptor(const descriptor &) = delete;
+  descriptor &operator=(const descriptor &) = delete;
+};
+
+static sockaddr_un address_of(const std::string &path) {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    throw std::system_error(ENAMETOOLONG, std::generic_category(),
+                            "handoff socket path");
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+  return address;
+}
+
+static void set_timeouts(int fd) {
+  (void)setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &io_timeout,
+                   sizeof(io_timeout));
+  (void)setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &io_timeout,
+                   sizeof(io_timeout));
+}
+
+[[noreturn]] static void fail(const char *what) {
+  throw std::system_error(errno, std::generic_category(), what);
+}
+
+void send(const std::string &path,
+          const std::vector<game::lobby_view> &lobbies) {
+  const std::string stream = encode(lobbies);
+  const sockaddr_un address = address_of(path);
+  descriptor socket(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  set_timeouts(socket.fd);
+  if (::connect(socket.fd, reinterpret_cast<const sockaddr *>(&address),
+                sizeof(address)) != 0) {
+    fail("handoff connect");
+  }
+
+  size_t sent{0};
+  while (sent < stream.size()) {
+    const ssize_t n = ::send(socket.fd, stream.data() + sent,
+                             stream.size() - sent, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fail("handoff send");
+    }
+    sent += static_cast<size_t>(n);
+  }
+  ::shutdown(socket.fd, SHUT_WR);
+
+  /* The successor acknowledges once it has parsed the stream */
+  char reply{0};
+  errno = 0;
+  if (::recv(socket.fd, &reply, 1, 0) != 1 || reply != ack) {
+    if (errno == 0) {
+      errno = EPROTO;
+    }
+    fail("handoff acknowledgement");
+  }
+}
+
+std::optional<std::vector<game::lobby_view>>
+receive(const std::string &path, std::chrono::milliseconds wait) {
+  const sockaddr_un address = address_of(path);
+  descriptor listener(::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0));
+  ::unlink(path.c_str());
+  if (::bind(listener.fd, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener.fd, 1) != 0) {
+    fail("handoff listen");
+  }
+
+  pollfd ready{listener.fd, POLLIN, 0};
+  const int polled = ::poll(&ready, 1, static_cast<int>(wait.count()));
+  if (polled <= 0) {
+    ::unlink(path.c_str());
+    return std::nullopt;
+  }
+  descriptor peer(::accept4(listener.fd, nullptr, nullptr, SOCK_CLOEXEC));
+  ::unlink(path.c_str());
+  set_timeouts(peer.fd);
+
+  std::string stream;
+  char buffer[65536];
+  for (;;) {
+    const ssize_t n = ::recv(peer.fd, buffer, sizeof(buffer), 0);
+    if (n == 0) {
+      break;
+    }
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      fail("handoff receive");
+    }
+    stream.append(buffer, static_cast<size_t>(n));
+  }
+
+  std::vector<game::lobby_view> lobbies = decode(stream);
+  (void)::send(peer.fd, &ack, 1, MSG_NOSIGNAL);
+  return lobbies;
+}
+
+bool draining() { return drain_started.load(std::memory_order_relaxed); }
+
+void drain(dpp::cluster &bot) {
+  if (drain_started.exchange(true)) {
+    return;
+  }
+  const config::settings &s = config::current();
+  bot.log(dpp::ll_info, "Draining: no longer accepting /queue");
+
+  bool handed_off{false};
+  if (!s.handoff_socket.empty()) {
+    const auto start = std::chrono::steady_clock::now();
+    const game::handover_result result = game::hand_over(
+        [&s](const std::vector<game::lobby_view> &lobbies) {
+          send(s.handoff_socket, lobbies);
+        });
+    handed_off = result.handed_off;
+    if (handed_off) {
+      const auto elapsed =
+          std::chrono::duration_cast<std::chrono::milliseconds>(
+              std::chrono::steady_clock::now() - start);
+      bot.log(dpp::ll_info,
+              fmt::format("Handed {} lobbies to successor in {}ms",
+                          result.checkpointed, elapsed.count()));
+    } else {
+      bot.log(dpp::ll_error,
+              fmt::format("Handoff failed, finishing {} of {} lobbies here: {}",
+                          result.restored, result.checkpointed,
+                          result.error));
+    }
+  }
+
+  if (!handed_off) {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::seconds(s.drain_timeout);
+    while (game::lobby_count() > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+    const size_t abandoned = game::lobby_count();
+    if (abandoned > 0) {
+      bot.log(dpp::ll_warning,
+              fmt::format("Drain timed out with {} lobbies open", abandoned));
+    }
+  }
+  bot.shutdown();
+}
+
+} // namespace handoff
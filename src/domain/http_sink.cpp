@@ -0,0 +1,296 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <cstdlib>
+#include <dpp/json.h>
+#include <fmt/format.h>
+#include <future>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/http_sink.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/rps.h>
+#include <rps/domain/trace.h>
+#include <strings.h>
+#include <thread>
+
+namespace outbound {
+
+static constexpr int max_retries = 5;
+
+static metrics::counter &ratelimited(const char *route) {
+  return metrics::get_counter("rps_rest_ratelimited_total",
+                              "Outbound REST calls answered with a 429",
+                              fmt::format("route=\"{}\"", route));
+}
+
+/**
+ * @brief Case insensitive response header lookup
+ */
+static std::string header(const dpp::http_request_completion_t &response,
+                          const char *name) {
+  for (const auto &[key, value] : response.headers) {
+    if (strcasecmp(key.c_str(), name) == 0) {
+      return value;
+    }
+  }
+  return "";
+}
+
+static double header_seconds(const dpp::http_request_completion_t &response,
+                             const char *name) {
+  const std::string value = header(response, name);
+  return value.empty() ? 0 : std::atof(value.c_str());
+}
+
+/**
+ * @brief Run fn after a delay without holding up a request thread
+ */
+static void later(std::chrono::steady_clock::duration delay,
+                  std::function<void()> fn) {
+  std::thread([delay, fn = std::move(fn)]() {
+    std::this_thread::sleep_for(delay);
+    fn();
+  }).detach();
+}
+
+http_sink::http_sink(dpp::cluster &bot, std::string api_url,
+                     std::string token, dm_cache_options dm)
+    : cluster_sink(bot, dm), base(std::move(api_url)),
+      authorization("Bot " + std::move(token)) {
+  while (!base.empty() && base.back() == '/') {
+    base.pop_back();
+  }
+  base += "/api/v10";
+}
+
+void http_sink::post(const char *route, const std::string &bucket_key,
+                     const std::string &path, const std::string &body,
+                     completion done) {
+  backpressure::started();
+  send(route, bucket_key, path, body,
+       [done = std::move(done), start = steady::now()](
+           const dpp::http_request_completion_t &response) {
+         backpressure::finished(steady::now() - start);
+         if (done) {
+           done(response);
+         }
+       },
+       0);
+}
+
+void http_sink::send(const char *route, const std::string &bucket_key,
+                     const std::string &path, const std::string &body,
+                     completion done, int attempt) {
+  steady::duration wait{0};
+  {
+    std::lock_guard<std::mutex> lock(buckets_mutex);
+    bucket &b = buckets[bucket_key];
+    const auto now = steady::now();
+    if (b.remaining <= 0 && now < b.reset) {
+      wait = b.reset - now;
+    } else {
+      b.remaining--;
+    }
+  }
+  if (wait.count() > 0) {
+    later(wait, [=, this]() {
+      send(route, bucket_key, path, body, done, attempt);
+    });
+    return;
+  }
+
+  metrics::histogram &latency = rest_latency(route);
+  cluster.request(
+      base + path, dpp::m_post,
+      [=, this, &latency, span = trace::async_span(route),
+       start = steady::now()](const dpp::http_request_completion_t &response) {
+        latency.observe(steady::now() - start);
+        span.finish();
+
+        const std::string remaining =
+            header(response, "x-ratelimit-remaining");
+        if (!remaining.empty()) {
+          const auto reset_after = std::chrono::duration_cast<steady::duration>(
+              std::chrono::duration<double>(
+                  header_seconds(response, "x-ratelimit-reset-after")));
+          std::lock_guard<std::mutex> lock(buckets_mutex);
+          bucket &b = buckets[bucket_key];
+          b.remaining = std::atoll(remaining.c_str());
+          b.reset = steady::now() + reset_after;
+        }
+
+        if (response.status == 429 && attempt < max_retries) {
+          ratelimited(route).inc();
+          double retry_after = header_seconds(response, "retry-after");
+          try {
+            retry_after = json::parse(response.body)
+                              .value("retry_after", retry_after);
+          } catch (const std::exception &) {
+            /* Keep the header value */
+          }
+          later(std::chrono::duration_cast<steady::duration>(
+                    std::chrono::duration<double>(retry_after)),
+                [=, this]() {
+                  send(route, bucket_key, path, body, done, attempt + 1);
+                });
+          return;
+        }
+        if (response.error != dpp::h_success || response.status >= 400) {
+          cluster.log(dpp::ll_error,
+                      fmt::format("{} {}: HTTP {} {}", route, path,
+                                  response.status, response.body));
+        }
+        if (done) {
+          done(response);
+        }
+      },
+      body, "application/json", {{"Authorization", authorization}});
+}
+
+void http_sink::post_direct_message(const char *route, dpp::snowflake user_id,
+                                    std::string message, completion done,
+                                    bool retried) {
+  const auto send = [=, this](dpp::snowflake channel_id) {
+    post(route, fmt::format("message_create:{}", channel_id),
+         fmt::format("/channels/{}/messages", channel_id), message,
+         [=, this](const dpp::http_request_completion_t &response) {
+           if (response.status == 403 || response.status == 404) {
+             dm_channels.invalidate(user_id);
+           }
+           if (response.status == 404 && !retried) {
+             post_direct_message(route, user_id, message, done, true);
+             return;
+           }
+           if (done) {
+             done(response);
+           }
+         });
+  };
+
+  const dpp::snowflake cached = dm_channels.find(user_id);
+  if (cached != 0) {
+    send(cached);
+    return;
+  }
+
+  json recipient = {{"recipient_id", std::to_string(user_id)}};
+  post("create_dm", "create_dm", "/users/@me/channels", recipient.dump(),
+       [=, this](const dpp::http_request_completion_t &response) {
+         dpp::snowflake channel_id;
+         try {
+           channel_id = dpp::snowflake(
+               json::parse(response.body).value("id", std::string("0")));
+         } catch (const std::exception &) {
+         }
+         if (channel_id == 0) {
+           if (done) {
+             done(response);
+           }
+           return;
+         }
+         dm_channels.insert(user_id, channel_id);
+         send(channel_id);
+       });
+}
+
+void http_sink::acknowledge(const dpp::interaction_create_t &event) {
+  post("acknowledge", "interaction",
+       fmt::format("/interactions/{}/{}/callback", event.command.id,
+                   event.command.token),
+       R"({"type":6})");
+}
+
+void http_sink::reply(const dpp::interaction_create_t &event,
+                      const dpp::message &m) {
+  json response = {{"type", 4}, {"data", json::parse(m.build_json())}};
+  post("reply", "interaction",
+       fmt::format("/interactions/{}/{}/callback", event.command.id,
+                   event.command.token),
+       response.dump());
+}
+
+void http_sink::post_direct_message_sync(dpp::snowflake user_id,
+                                         std::string message) {
+  auto delivered = std::make_shared<std::promise<void>>();
+  post_direct_message(
+      "direct_message_create_sync", user_id, std::move(message),
+      [delivered](const dpp::http_request_completion_t &) {
+        delivered->set_value();
+      });
+  delivered->get_future().wait_for(std::chrono::seconds(30));
+}
+
+void http_sink::direct_message(dpp::snowflake user_id, const dpp::message &m) {
+  post_direct_message("direct_message_create", user_id, m.build_json(), {});
+}
+
+void http_sink::direct_message_sync(dpp::snowflake user_id,
+                                    const dpp::message &m) {
+  post_direct_message_sync(user_id, m.build_json());
+}
+
+void http_sink::channel_message(const dpp::message &m) {
+  channel_message(m.channel_id, payload{m.build_json()});
+}
+
+void http_sink::direct_message(dpp::snowflake user_id, const payload &p) {
+  post_direct_message("direct_message_create", user_id, std::string(p.json),
+                      {});
+}
+
+void http_sink::direct_message_sync(dpp::snowflake user_id,
+                                    const payload &p) {
+  post_direct_message_sync(user_id, std::string(p.json));
+}
+
+void http_sink::channel_message(dpp::snowflake channel_id, const payload &p) {
+  post("message_create", fmt::format("message_create:{}", channel_id),
+       fmt::format("/channels/{}/messages", channel_id), std::string(p.json));
+}
+
+void http_sink::update(const dpp::interaction_create_t &event,
+                       const payload &p) {
+  std::string body;
+  body.reserve(p.json.size() + 20);
+  body += R"({"type":7,"data":)";
+  body += p.json;
+  body += '}';
+  post("update", "interaction",
+       fmt::format("/interactions/{}/{}/callback", event.command.id,
+                   event.command.token),
+       body);
+}
+
+void http_sink::follow_up(const std::string &token, const payload &p) {
+  post("follow_up", "webhook:" + token,
+       fmt::format("/webhooks/{}/{}", cluster.me.id, token),
+       std::string(p.json));
+}
+
+void http_sink::follow_up_sync(const std::string &token, const payload &p) {
+  auto delivered = std::make_shared<std::promise<void>>();
+  post("follow_up_sync", "webhook:" + token,
+       fmt::format("/webhooks/{}/{}", cluster.me.id, token),
+       std::string(p.json),
+       [delivered](const dpp::http_request_completion_t &) {
+         delivered->set_value();
+       });
+  delivered->get_future().wait_for(std::chrono::seconds(30));
+}
+
+} // namespace outbound
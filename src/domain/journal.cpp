@@ -0,0 +1,119 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <rps/domain/journal.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/mpsc_ring.h>
+#include <stdexcept>
+#include <thread>
+
+namespace journal {
+
+constexpr size_t action_ring_size = 1 << 16;
+
+std::atomic<bool> active{false};
+
+static mpsc_ring<core::action, action_ring_size> actions;
+
+static metrics::counter &dropped = metrics::get_counter(
+    "rps_journal_dropped_total",
+    "Game state actions not journalled because the writer fell behind");
+
+static std::FILE *file{nullptr};
+
+static std::jthread writer;
+
+static void write_actions(const std::stop_token &stop) {
+  core::action a;
+  for (;;) {
+    bool idle{true};
+    while (actions.try_pop(a)) {
+      idle = false;
+      std::fwrite(&a, sizeof(a), 1, file);
+    }
+    if (stop.stop_requested() && idle) {
+      return;
+    }
+    if (idle) {
+      std::fflush(file);
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+void start(const std::string &path) {
+  stop();
+  file = std::fopen(path.c_str(), "ab+");
+  if (file == nullptr) {
+    throw std::runtime_error("Cannot open journal file " + path);
+  }
+  char magic[sizeof(file_magic)]{};
+  std::rewind(file);
+  const size_t read = std::fread(magic, 1, sizeof(magic), file);
+  if (read == 0) {
+    std::fwrite(file_magic, sizeof(file_magic), 1, file);
+  } else if (read != sizeof(magic) ||
+             !std::equal(magic, magic + sizeof(magic), file_magic)) {
+    std::fclose(file);
+    file = nullptr;
+    throw std::runtime_error(path + " is not a journal file");
+  }
+  /* Reads and writes on one stream need a seek between them */
+  std::fseek(file, 0, SEEK_END);
+  writer = std::jthread(write_actions);
+  active.store(true, std::memory_order_relaxed);
+}
+
+void stop() {
+  active.store(false, std::memory_order_relaxed);
+  if (writer.joinable()) {
+    writer.request_stop();
+    writer.join();
+  }
+  if (file != nullptr) {
+    std::fclose(file);
+    file = nullptr;
+  }
+}
+
+void record(const core::action &a) {
+  if (enabled() && !actions.try_push(a)) {
+    dropped.inc();
+  }
+}
+
+std::vector<core::action> load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[sizeof(file_magic)]{};
+  if (!in.read(magic, sizeof(magic)) ||
+      !std::equal(magic, magic + sizeof(magic), file_magic)) {
+    throw std::runtime_error(path + " is not a journal file");
+  }
+  std::vector<core::action> out;
+  core::action a;
+  while (in.read(reinterpret_cast<char *>(&a), sizeof(a))) {
+    out.push_back(a);
+  }
+  return out;
+}
+
+} // namespace journal
@@ -18,6 +18,7 @@
 #include <dpp/dpp.h>
 #include <fmt/format.h>
 #include <rps/domain/lang.h>
+#include <rps/domain/outbound.h>
 #include <rps/domain/rps.h>
 #include <sys/stat.h>
 
@@ -27,6 +28,65 @@ std::shared_mutex lang_mutex;
 static dpp::interaction_create_t english{};
 time_t last_lang{0};
 json *lang{nullptr};
+std::shared_ptr<const template_table> lang_templates;
+
+template_table::template_table(const json &document,
+                               std::vector<std::string> &errors) {
+  for (auto key = document.begin(); key != document.end(); ++key) {
+    auto &translations = templates[key.key()];
+    for (auto v = key->begin(); v != key->end(); ++v) {
+      if (!v->is_string()) {
+        continue;
+      }
+      const std::string &source = v->get_ref<const std::string &>();
+      try {
+        translations.emplace(v.key(), format_template(source));
+      } catch (const fmt::format_error &e) {
+        errors.emplace_back(
+            fmt::format("Malformed translation {} lang {}: {}", key.key(),
+                        v.key(), e.what()));
+        /* Shown as written, as it was before templates were parsed */
+        translations.emplace(v.key(), format_template::literal(source));
+      }
+    }
+  }
+}
+
+const format_template *template_table::find(const std::string &key,
+                                            const std::string &lang) const {
+  auto o = templates.find(key);
+  if (o == templates.end()) {
+    return nullptr;
+  }
+  auto v = o->second.find(lang);
+  if (v == o->second.end()) {
+    v = o->second.find("en");
+  }
+  return v == o->second.end() ? nullptr : &v->second;
+}
+
+std::shared_ptr<const template_table> templates() {
+  std::shared_lock lang_lock(lang_mutex);
+  return lang_templates;
+}
+
+std::string lang_code(const std::string &locale) {
+  return locale.empty() ? "en" : locale.substr(0, 2);
+}
+
+/**
+ * @brief Build the template table for a freshly parsed lang.json, logging any
+ * malformed translations so they are caught at load time
+ */
+static std::shared_ptr<const template_table>
+compile_templates(const json &document) {
+  std::vector<std::string> errors;
+  auto table = std::make_shared<const template_table>(document, errors);
+  for (const auto &error : errors) {
+    outbound::get().log(dpp::ll_error, error);
+  }
+  return table;
+}
 
 time_t get_mtime(const char *path) {
   struct stat stat_buf {};
@@ -36,7 +96,7 @@ time_t get_mtime(const char *path) {
   return stat_buf.st_mtime;
 }
 
-void check_lang_reload(dpp::cluster &bot) {
+void check_lang_reload() {
   if (get_mtime("lang.json") > last_lang) {
     std::unique_lock lang_lock(lang_mutex);
     last_lang = get_mtime("lang.json");
@@ -48,46 +108,35 @@ void check_lang_reload(dpp::cluster &bot) {
       // Parse updated contents
       langfile >> *new_lang;
 
+      lang_templates = compile_templates(*new_lang);
       lang = new_lang;
       delete old_lang;
     } catch (const std::exception &e) {
-      bot.log(dpp::ll_error, fmt::format("Error in lang.json: ", e.what()));
+      outbound::get().log(dpp::ll_error,
+                          fmt::format("Error in lang.json: {}", e.what()));
       delete new_lang;
     }
   }
 }
 
-void load_lang(dpp::cluster &bot) {
+void load_lang() {
   std::unique_lock lang_lock(lang_mutex);
   last_lang = get_mtime("lang.json");
   english.command.locale = "en";
   std::ifstream lang_file("lang.json");
   lang = new json();
   lang_file >> *lang;
-  bot.log(dpp::ll_info,
-          fmt::format("Language strings count: {}", lang->size()));
+  lang_templates = compile_templates(*lang);
+  outbound::get().log(dpp::ll_info, fmt::format("Language strings count: {}",
+                                               lang->size()));
 }
 
 std::string tr(const std::string &k,
                const dpp::interaction_create_t &interaction) {
-  std::string lang_name = (interaction.command.locale == "")
-                              ? "en"
-                              : interaction.command.locale.substr(0, 2);
-  std::shared_lock lang_lock(lang_mutex);
-  try {
-    auto o = lang->find(k);
-    if (o != lang->end()) {
-      auto v = o->find(lang_name);
-      if (v != o->end()) {
-        return v->get<std::string>();
-      }
-      return tr(k, english);
-    }
-  } catch (const std::exception &e) {
-    std::cout << "i18n error on " << k << " " << lang_name << ": " << e.what()
-              << "\n";
-  }
-  return k;
+  const auto table = templates();
+  const format_template *tpl =
+      table->find(k, lang_code(interaction.command.locale));
+  return tpl == nullptr ? k : tpl->source();
 }
 
 std::string discord_lang(const std::string &l) {
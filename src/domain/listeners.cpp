@@ -20,23 +20,31 @@
 #include <fmt/core.h>
 #include <fmt/format.h>
 #include <malloc.h>
+#include <rps/domain/capture.h>
 #include <rps/domain/command.h>
+#include <rps/domain/config.h>
 #include <rps/domain/embeds.h>
 #include <rps/domain/game.h>
 #include <rps/domain/lang.h>
 #include <rps/domain/listeners.h>
-
-#include <rps/domain/commands/leave.h>
-#include <rps/domain/commands/queue.h>
+#include <rps/domain/logger.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/rate_limit.h>
+#include <rps/domain/routes.h>
+#include <rps/domain/trace.h>
 #include <string>
 
 namespace listeners {
 
+template <typename... T>
+std::vector<dpp::slashcommand> register_commands(dpp::cluster &bot,
+                                                 dispatch::type_list<T...>) {
+  return {register_command<T>(bot)...};
+}
+
 std::vector<dpp::slashcommand> get_commands(dpp::cluster &bot) {
-  return {
-      register_command<queue_command>(bot),
-      register_command<leave_command>(bot),
-  };
+  return register_commands(bot, slash_commands{});
 }
 
 std::string json_commands(dpp::cluster &bot) {
@@ -69,7 +77,8 @@ void on_ready(const dpp::ready_t &event) {
     };
 
     bot.start_timer([set_presence](dpp::timer t) { set_presence(); }, 240);
-    bot.start_timer([&bot](dpp::timer t) { i18n::check_lang_reload(bot); }, 60);
+    bot.start_timer([](dpp::timer t) { i18n::check_lang_reload(); }, 60);
+    bot.start_timer([&bot](dpp::timer t) { config::check_reload(bot); }, 60);
     bot.start_timer(
         [](dpp::timer t) {
           /* Garbage collect free memory by consolidating free malloc() blocks
@@ -82,36 +91,69 @@ void on_ready(const dpp::ready_t &event) {
   }
 }
 
+static metrics::counter &rate_limited_commands = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"command\",reason=\"rate_limited\"");
+static metrics::counter &rate_limited_clicks = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"button\",reason=\"rate_limited\"");
+static metrics::counter &duplicate_commands = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"command\",reason=\"duplicate\"");
+static metrics::counter &duplicate_clicks = metrics::get_counter(
+    "rps_interactions_dropped_total",
+    "Interactions dropped before reaching a handler",
+    "kind=\"button\",reason=\"duplicate\"");
+
 void on_slashcommand(const dpp::slashcommand_t &event) {
+  trace::interaction_scope trace_scope(event.command.id);
+  if (capture::enabled()) {
+    capture::slashcommand(event);
+  }
+  /* A redelivered interaction was already answered, so drop it silently */
+  if (rate_limit::duplicate_interaction(event.command.id)) {
+    duplicate_commands.inc();
+    return;
+  }
+  if (!rate_limit::allow(event.command.get_issuing_user().id)) {
+    rate_limited_commands.inc();
+    outbound::get().reply(event, dpp::message(tr("R_SLOW_DOWN", event))
+                                     .set_flags(dpp::m_ephemeral));
+    return;
+  }
   double start = dpp::utility::time_f();
-  route_command(event);
-  event.from->creator->log(
-      dpp::ll_info,
-      fmt::format("COMMAND: {} by {} ({} Guild: {}) Locale: {}, msecs: {:.02f}",
-                  event.command.get_command_name(),
-                  event.command.usr.format_username(), event.command.usr.id,
-                  event.command.guild_id, event.command.locale,
-                  (dpp::utility::time_f() - start) * 1000));
+  {
+    trace::span span("route_command");
+    route_command(event);
+  }
+  logger::command(event, (dpp::utility::time_f() - start) * 1000);
 }
 
 void on_buttonclick(const dpp::button_click_t &event) {
-  event.reply();
-
-  /* Instance of game */
-  if (event.custom_id == "Rock" || event.custom_id == "Paper" ||
-      event.custom_id == "Scissors") {
-    unsigned int player_lobby_id =
-        game::find_player_lobby_id(event.command.get_issuing_user().id);
-    if (player_lobby_id == 0) {
-      event.from->creator->log(
-          dpp::ll_error,
-          fmt::format("Unable to find lobby ID for {}", event.raw_event));
-      return;
-    }
-
-    /* Spawn worker so sync methods don't block main event loop */
-    std::thread worker(game::handle_choice, std::ref(event));
-    worker.detach();
+  trace::interaction_scope trace_scope(event.command.id);
+  if (capture::enabled()) {
+    capture::button_click(event);
+  }
+  if (rate_limit::duplicate_interaction(event.command.id)) {
+    duplicate_clicks.inc();
+    return;
+  }
+  /* Spam is acknowledged so the client stops spinning, but goes no further */
+  if (!rate_limit::allow(event.command.get_issuing_user().id)) {
+    rate_limited_clicks.inc();
+    outbound::get().acknowledge(event);
+    return;
+  }
+  /* With interaction delivery the handler answers the click itself */
+  if (config::current().delivery != config::delivery_mode::interactions) {
+    trace::span span("ack");
+    outbound::get().acknowledge(event);
   }
+  logger::button_click(event);
+  trace::span span("route_button");
+  route_button(event);
 }
 } // namespace listeners
\ No newline at end of file
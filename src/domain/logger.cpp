@@ -17,12 +17,17 @@
  * limitations under the License.
  *
  ************************************************************************************/
+#include <algorithm>
+#include <chrono>
 #include <dpp/dpp.h>
 #include <fmt/format.h>
+#include <rps/domain/logger.h>
+#include <rps/domain/mpsc_ring.h>
 #include <spdlog/async.h>
 #include <spdlog/sinks/rotating_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <thread>
 
 namespace logger {
 
@@ -30,8 +35,114 @@ using spdlog_level = spdlog::level::level_enum;
 
 constexpr int max_log_size = 1024 * 1024 * 5;
 
+constexpr size_t record_ring_size = 8192;
+
+std::atomic<int> min_severity{dpp::ll_debug};
+
 static std::shared_ptr<spdlog::logger> async_logger;
 
+/**
+ * @brief Synchronous logger on the same sinks, used by the record thread which
+ * already runs off the interaction path
+ */
+static std::shared_ptr<spdlog::logger> record_logger;
+
+static mpsc_ring<record, record_ring_size> records;
+
+static std::atomic<uint64_t> dropped_records{0};
+
+/**
+ * @brief Drains records; declared last so it is joined before the loggers it
+ * writes to are destroyed
+ */
+static std::jthread record_thread;
+
+static spdlog_level to_spdlog(dpp::loglevel severity) {
+  switch (severity) {
+  case dpp::ll_trace:
+    return spdlog_level::trace;
+  case dpp::ll_debug:
+    return spdlog_level::debug;
+  case dpp::ll_info:
+    return spdlog_level::info;
+  case dpp::ll_warning:
+    return spdlog_level::warn;
+  case dpp::ll_error:
+    return spdlog_level::err;
+  case dpp::ll_critical:
+  default:
+    return spdlog_level::critical;
+  }
+}
+
+template <size_t N>
+static void copy_field(char (&field)[N], const std::string &value) {
+  const size_t len = std::min(value.size(), N - 1);
+  std::copy_n(value.data(), len, field);
+  field[len] = '\0';
+}
+
+static int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+static void format_record(const record &r, fmt::memory_buffer &out) {
+  auto user = [&r]() {
+    /* Same shape as dpp::user::format_username() */
+    return r.discriminator ? fmt::format("{}#{:04d}", r.user, r.discriminator)
+                           : std::string(r.user);
+  };
+  switch (r.type) {
+  case record_type::command:
+    fmt::format_to(
+        fmt::appender(out),
+        "COMMAND: {} by {} ({} Guild: {}) Locale: {}, msecs: {:.02f}", r.name,
+        user(), r.user_id, r.guild_id, r.locale, r.msecs);
+    break;
+  case record_type::button_click:
+    fmt::format_to(fmt::appender(out), "BUTTON: {} by {} ({})", r.name,
+                   user(), r.user_id);
+    break;
+  case record_type::lobby_started:
+    fmt::format_to(fmt::appender(out), "Lobby {} started!", r.lobby_id);
+    break;
+  }
+}
+
+static void drain_records(const std::stop_token &stop) {
+  fmt::memory_buffer line;
+  record r;
+  uint64_t reported_drops{0};
+  for (;;) {
+    bool idle{true};
+    while (records.try_pop(r)) {
+      idle = false;
+      line.clear();
+      format_record(r, line);
+      record_logger->log(spdlog::log_clock::time_point(
+                             std::chrono::duration_cast<
+                                 spdlog::log_clock::duration>(
+                                 std::chrono::nanoseconds(r.timestamp_ns))),
+                         spdlog::source_loc{}, to_spdlog(r.severity),
+                         spdlog::string_view_t(line.data(), line.size()));
+    }
+    const uint64_t drops = dropped_records.load(std::memory_order_relaxed);
+    if (drops != reported_drops) {
+      record_logger->warn("Dropped {} log records, ring full",
+                          drops - reported_drops);
+      reported_drops = drops;
+    }
+    if (stop.stop_requested() && idle) {
+      return;
+    }
+    if (idle) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
 void init(const std::string &log_file) {
   /* Set up spdlog logger */
   spdlog::init_thread_pool(8192, 2);
@@ -46,8 +157,66 @@ void init(const std::string &log_file) {
   async_logger->set_pattern("%^%Y-%m-%d %H:%M:%S.%e [%L] [th#%t]%$ : %v");
   async_logger->set_level(spdlog_level::debug);
 
+  record_logger = std::make_shared<spdlog::logger>("records", sinks.begin(),
+                                                   sinks.end());
+  record_logger->set_pattern("%^%Y-%m-%d %H:%M:%S.%e [%L] [records]%$ : %v");
+  record_logger->set_level(spdlog_level::debug);
+  min_severity.store(dpp::ll_debug, std::memory_order_relaxed);
+
   spdlog::register_logger(async_logger);
+  spdlog::register_logger(record_logger);
   spdlog::flush_every(std::chrono::seconds(5));
+
+  record_thread = std::jthread(drain_records);
+}
+
+void push(const record &r) {
+  if (!records.try_push(r)) {
+    dropped_records.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void command(const dpp::slashcommand_t &event, double msecs) {
+  if (!enabled(dpp::ll_info)) {
+    return;
+  }
+  record r{.type = record_type::command,
+           .severity = dpp::ll_info,
+           .discriminator = event.command.usr.discriminator,
+           .msecs = static_cast<float>(msecs),
+           .timestamp_ns = now_ns(),
+           .user_id = event.command.usr.id,
+           .guild_id = event.command.guild_id};
+  copy_field(r.name, event.command.get_command_name());
+  copy_field(r.user, event.command.usr.username);
+  copy_field(r.locale, event.command.locale);
+  push(r);
+}
+
+void button_click(const dpp::button_click_t &event) {
+  if (!enabled(dpp::ll_debug)) {
+    return;
+  }
+  const dpp::user &user = event.command.get_issuing_user();
+  record r{.type = record_type::button_click,
+           .severity = dpp::ll_debug,
+           .discriminator = user.discriminator,
+           .timestamp_ns = now_ns(),
+           .user_id = user.id,
+           .guild_id = event.command.guild_id};
+  copy_field(r.name, event.custom_id);
+  copy_field(r.user, user.username);
+  push(r);
+}
+
+void lobby_started(unsigned int lobby_id) {
+  if (!enabled(dpp::ll_debug)) {
+    return;
+  }
+  push(record{.type = record_type::lobby_started,
+              .severity = dpp::ll_debug,
+              .timestamp_ns = now_ns(),
+              .lobby_id = lobby_id});
 }
 
 void log(const dpp::log_t &event) {
@@ -0,0 +1,213 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <rps/domain/lang.h>
+#include <rps/domain/matchmaking.h>
+#include <rps/domain/metrics.h>
+#include <unordered_map>
+
+namespace matchmaking {
+
+static constexpr size_t shard_count = 64;
+
+/**
+ * @brief One waiting lobby, shared by every key it is listed under
+ */
+struct ticket {
+  unsigned int lobby_id{0};
+  std::atomic<bool> taken{false};
+};
+
+struct key_hash {
+  size_t operator()(const key &k) const {
+    return std::hash<uint64_t>()(k.attribute * 3 +
+                                 static_cast<uint64_t>(k.kind));
+  }
+};
+
+/**
+ * @brief Waiting lobbies under the keys that hash to one shard, oldest first
+ */
+struct queue_shard {
+  std::mutex mutex;
+  std::unordered_map<key, std::deque<std::shared_ptr<ticket>>, key_hash>
+      queues;
+};
+
+/**
+ * @brief Tickets by lobby, for withdraw()
+ */
+struct ticket_shard {
+  std::mutex mutex;
+  std::unordered_map<unsigned int, std::shared_ptr<ticket>> tickets;
+};
+
+static std::array<queue_shard, shard_count> queue_shards;
+static std::array<ticket_shard, shard_count> ticket_shards;
+
+static metrics::counter &paired_counter(const char *scope) {
+  return metrics::get_counter("rps_matchmaking_pairs_total",
+                              "Players paired, by the scope that matched",
+                              std::string("scope=\"") + scope + "\"");
+}
+
+/**
+ * @brief Pairs by key_kind
+ */
+static const std::array<metrics::counter *, 3> paired{
+    &paired_counter("guild"), &paired_counter("locale"),
+    &paired_counter("global")};
+
+static queue_shard &shard_of(const key &k) {
+  /* Mix the hash, as std::hash of an integer is usually the identity */
+  return queue_shards[(key_hash()(k) * 0x9e3779b97f4a7c15) >> 58];
+}
+
+static ticket_shard &shard_of(unsigned int lobby_id) {
+  return ticket_shards[lobby_id % shard_count];
+}
+
+/**
+ * @brief Drop tickets already taken from the front of a queue
+ */
+static void pop_taken(std::deque<std::shared_ptr<ticket>> &queue) {
+  while (!queue.empty() && queue.front()->taken.load()) {
+    queue.pop_front();
+  }
+}
+
+key_list keys_for(queue_scope scope, uint64_t guild_id,
+                  const std::string &locale) {
+  uint64_t language{0};
+  for (const char c : i18n::lang_code(locale)) {
+    language = (language << 8) | static_cast<uint8_t>(c);
+  }
+  key_list list;
+  const auto add = [&list](key_kind kind, uint64_t attribute) {
+    list.keys[list.count++] = key{kind, attribute};
+  };
+  if (scope != queue_scope::language && guild_id != 0) {
+    add(key_kind::guild, guild_id);
+  }
+  if (scope == queue_scope::server && guild_id != 0) {
+    return list;
+  }
+  add(key_kind::locale, language);
+  if (scope != queue_scope::language) {
+    add(key_kind::global, 0);
+  }
+  return list;
+}
+
+void offer(unsigned int lobby_id, const key_list &keys) {
+  auto listed = std::make_shared<ticket>();
+  listed->lobby_id = lobby_id;
+  {
+    ticket_shard &shard = shard_of(lobby_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.tickets[lobby_id] = listed;
+  }
+  for (size_t i = 0; i < keys.count; ++i) {
+    queue_shard &shard = shard_of(keys.keys[i]);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto &queue = shard.queues[keys.keys[i]];
+    /* Keys that are rarely searched still shed their claimed copies */
+    pop_taken(queue);
+    queue.push_back(listed);
+  }
+}
+
+/**
+ * @brief Forget a lobby's ticket, if it is still the one given
+ */
+static void forget(const std::shared_ptr<ticket> &claimed) {
+  ticket_shard &shard = shard_of(claimed->lobby_id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  const auto it = shard.tickets.find(claimed->lobby_id);
+  if (it != shard.tickets.end() && it->second == claimed) {
+    shard.tickets.erase(it);
+  }
+}
+
+unsigned int claim(const key_list &keys) {
+  for (size_t i = 0; i < keys.count; ++i) {
+    std::shared_ptr<ticket> claimed;
+    {
+      queue_shard &shard = shard_of(keys.keys[i]);
+      std::lock_guard<std::mutex> lock(shard.mutex);
+      const auto it = shard.queues.find(keys.keys[i]);
+      if (it == shard.queues.end()) {
+        continue;
+      }
+      auto &queue = it->second;
+      while (!queue.empty()) {
+        std::shared_ptr<ticket> front = std::move(queue.front());
+        queue.pop_front();
+        if (!front->taken.exchange(true)) {
+          claimed = std::move(front);
+          break;
+        }
+      }
+      if (queue.empty()) {
+        shard.queues.erase(it);
+      }
+    }
+    if (claimed) {
+      forget(claimed);
+      paired[static_cast<size_t>(keys.keys[i].kind)]->inc();
+      return claimed->lobby_id;
+    }
+  }
+  return 0;
+}
+
+bool withdraw(unsigned int lobby_id) {
+  std::shared_ptr<ticket> listed;
+  {
+    ticket_shard &shard = shard_of(lobby_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    const auto it = shard.tickets.find(lobby_id);
+    if (it == shard.tickets.end()) {
+      return false;
+    }
+    listed = std::move(it->second);
+    shard.tickets.erase(it);
+  }
+  return !listed->taken.exchange(true);
+}
+
+void clear() {
+  for (auto &shard : ticket_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    for (auto &[lobby_id, listed] : shard.tickets) {
+      listed->taken.store(true);
+    }
+    shard.tickets.clear();
+  }
+  for (auto &shard : queue_shards) {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.queues.clear();
+  }
+}
+
+} // namespace matchmaking
@@ -0,0 +1,263 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <fmt/format.h>
+#include <iterator>
+#include <rps/domain/message_writer.h>
+
+/**
+ * @brief Initial capacity of each thread's buffer; a game embed with buttons
+ * is well under this, so the buffer normally never grows
+ */
+static constexpr size_t initial_capacity = 4096;
+
+static std::string &thread_buffer() {
+  thread_local std::string buffer = []() {
+    std::string b;
+    b.reserve(initial_capacity);
+    return b;
+  }();
+  return buffer;
+}
+
+message_writer::message_writer() : out(thread_buffer()) {
+  out.clear();
+  out.push_back('{');
+}
+
+void message_writer::quote(std::string_view text) {
+  out.push_back('"');
+  for (const char c : text) {
+    switch (c) {
+    case '"':
+      out += "\\\"";
+      break;
+    case '\\':
+      out += "\\\\";
+      break;
+    case '\n':
+      out += "\\n";
+      break;
+    case '\r':
+      out += "\\r";
+      break;
+    case '\t':
+      out += "\\t";
+      break;
+    default:
+      if (static_cast<unsigned char>(c) < 0x20) {
+        fmt::format_to(std::back_inserter(out), "\\u{:04x}",
+                       static_cast<unsigned int>(c));
+      } else {
+        out.push_back(c);
+      }
+    }
+  }
+  out.push_back('"');
+}
+
+void message_writer::close_section() {
+  if (at == section::embed) {
+    if (in_fields) {
+      out.push_back(']');
+      in_fields = false;
+    }
+    out += "}]";
+  } else if (at == section::components) {
+    out += "]}]";
+  }
+  at = section::top;
+}
+
+void message_writer::top_key(std::string_view key) {
+  close_section();
+  if (top_keys) {
+    out.push_back(',');
+  }
+  top_keys = true;
+  quote(key);
+  out.push_back(':');
+}
+
+void message_writer::embed_key(std::string_view key) {
+  if (in_fields) {
+    out.push_back(']');
+    in_fields = false;
+  }
+  if (embed_keys) {
+    out.push_back(',');
+  }
+  embed_keys = true;
+  quote(key);
+  out.push_back(':');
+}
+
+message_writer &message_writer::content(std::string_view text) {
+  if (at == section::top && !top_keys) {
+    top_key("content");
+    quote(text);
+  }
+  return *this;
+}
+
+message_writer &message_writer::embed() {
+  if (at == section::components) {
+    return *this;
+  }
+  if (at == section::embed) {
+    if (in_fields) {
+      out.push_back(']');
+      in_fields = false;
+    }
+    out += "},{";
+  } else {
+    top_key("embeds");
+    out += "[{";
+    at = section::embed;
+  }
+  embed_keys = false;
+  return *this;
+}
+
+message_writer &message_writer::title(std::string_view text) {
+  if (at == section::embed) {
+    embed_key("title");
+    quote(text);
+  }
+  return *this;
+}
+
+message_writer &message_writer::description(std::string_view text) {
+  if (at == section::embed) {
+    embed_key("description");
+    quote(text);
+  }
+  return *this;
+}
+
+message_writer &message_writer::thumbnail(std::string_view url) {
+  if (at == section::embed && !url.empty()) {
+    embed_key("thumbnail");
+    out += "{\"url\":";
+    quote(url);
+    out.push_back('}');
+  }
+  return *this;
+}
+
+message_writer &message_writer::footer(std::string_view text,
+                                       std::string_view icon_url) {
+  if (at == section::embed) {
+    embed_key("footer");
+    out += "{\"text\":";
+    quote(text);
+    if (!icon_url.empty()) {
+      out += ",\"icon_url\":";
+      quote(icon_url);
+    }
+    out.push_back('}');
+  }
+  return *this;
+}
+
+message_writer &message_writer::color(uint32_t rgb) {
+  if (at == section::embed) {
+    embed_key("color");
+    fmt::format_to(std::back_inserter(out), "{}", rgb);
+  }
+  return *this;
+}
+
+message_writer &message_writer::field(std::string_view name,
+                                      std::string_view value, bool is_inline) {
+  if (at != section::embed) {
+    return *this;
+  }
+  if (in_fields) {
+    out.push_back(',');
+  } else {
+    embed_key("fields");
+    out.push_back('[');
+    in_fields = true;
+  }
+  out += "{\"name\":";
+  quote(name);
+  out += ",\"value\":";
+  quote(value);
+  out += is_inline ? ",\"inline\":true}" : ",\"inline\":false}";
+  return *this;
+}
+
+message_writer &message_writer::button(std::string_view label,
+                                       std::string_view id,
+                                       button_style style) {
+  if (components >= max_components || components_removed) {
+    /* Already at the max of 5x5 buttons */
+    return *this;
+  }
+
+  /* Escape the id at the end of the buffer to compare it with the ids
+   * already written, then take it back off */
+  const size_t mark = out.size();
+  quote(id);
+  const std::string_view escaped(out.data() + mark, out.size() - mark);
+  for (size_t i = 0; i < components; ++i) {
+    if (std::string_view(out.data() + ids[i].first, ids[i].second) ==
+        escaped) {
+      /* Drop duplicate ids */
+      out.resize(mark);
+      return *this;
+    }
+  }
+  out.resize(mark);
+
+  if (at != section::components) {
+    top_key("components");
+    out += "[{\"type\":1,\"components\":[";
+    at = section::components;
+  } else if (components % components_per_row == 0) {
+    out += "]},{\"type\":1,\"components\":[";
+  } else {
+    out.push_back(',');
+  }
+  out += "{\"type\":2,\"label\":";
+  quote(label);
+  fmt::format_to(std::back_inserter(out), ",\"style\":{},\"custom_id\":",
+                 static_cast<int>(style));
+  const size_t id_start = out.size();
+  quote(id);
+  ids[components++] = {static_cast<uint32_t>(id_start),
+                       static_cast<uint32_t>(out.size() - id_start)};
+  out.push_back('}');
+  return *this;
+}
+
+message_writer &message_writer::remove_components() {
+  if (at != section::components) {
+    top_key("components");
+    out += "[]";
+    components_removed = true;
+  }
+  return *this;
+}
+
+outbound::payload message_writer::finish() {
+  close_section();
+  out.push_back('}');
+  return outbound::payload{out, components > 0};
+}
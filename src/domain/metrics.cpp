@@ -0,0 +1,273 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <deque>
+#include <fmt/format.h>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <netinet/in.h>
+#include <rps/domain/metrics.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <thread>
+#include <unistd.h>
+#include <variant>
+
+namespace metrics {
+
+namespace {
+
+struct entry {
+  std::string name;
+  std::string help;
+  std::string labels;
+  std::variant<counter, gauge, histogram> metric;
+
+  template <typename T>
+  entry(std::string_view n, std::string_view h, std::string_view l,
+        std::in_place_type_t<T> type)
+      : name(n), help(h), labels(l), metric(type) {}
+};
+
+struct page {
+  std::string content_type;
+  std::function<std::string()> handler;
+};
+
+/**
+ * @brief Registered metrics. Entries are never removed, and a deque never
+ * moves its elements, so references handed out stay valid.
+ */
+struct registry {
+  std::mutex mutex;
+  std::deque<entry> entries;
+  std::map<std::string, page> pages;
+};
+
+registry &get_registry() {
+  static registry r;
+  return r;
+}
+
+template <typename T>
+T &find_or_create(std::string_view name, std::string_view help,
+                  std::string_view labels) {
+  registry &r = get_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto &e : r.entries) {
+    if (e.name == name && e.labels == labels) {
+      return std::get<T>(e.metric);
+    }
+  }
+  return std::get<T>(
+      r.entries.emplace_back(name, help, labels, std::in_place_type<T>)
+          .metric);
+}
+
+std::string with_labels(const std::string &labels, const std::string &extra) {
+  if (labels.empty()) {
+    return extra.empty() ? "" : "{" + extra + "}";
+  }
+  return "{" + labels + (extra.empty() ? "" : "," + extra) + "}";
+}
+
+void render_entry(fmt::memory_buffer &out, const entry &e) {
+  auto it = fmt::appender(out);
+  if (const auto *c = std::get_if<counter>(&e.metric)) {
+    fmt::format_to(it, "{}{} {}\n", e.name, with_labels(e.labels, ""),
+                   c->get());
+  } else if (const auto *g = std::get_if<gauge>(&e.metric)) {
+    fmt::format_to(it, "{}{} {}\n", e.name, with_labels(e.labels, ""),
+                   g->get());
+  } else if (const auto *h = std::get_if<histogram>(&e.metric)) {
+    /* Counts only grow, so every bucket up to the highest one used so far
+     * is emitted on every scrape and the le series stay stable */
+    size_t used{0};
+    for (size_t i = 0; i < histogram::buckets; ++i) {
+      if (h->count(i) != 0) {
+        used = i + 1;
+      }
+    }
+    uint64_t cumulative{0};
+    for (size_t i = 0; i < used; ++i) {
+      cumulative += h->count(i);
+      fmt::format_to(
+          it, "{}_bucket{} {}\n", e.name,
+          with_labels(e.labels,
+                      fmt::format("le=\"{}\"",
+                                  histogram::bucket_bound(i) / 1e6)),
+          cumulative);
+    }
+    fmt::format_to(it, "{}_bucket{} {}\n", e.name,
+                   with_labels(e.labels, "le=\"+Inf\""), cumulative);
+    fmt::format_to(it, "{}_sum{} {}\n", e.name, with_labels(e.labels, ""),
+                   h->sum() / 1e6);
+    fmt::format_to(it, "{}_count{} {}\n", e.name, with_labels(e.labels, ""),
+                   cumulative);
+  }
+}
+
+const char *type_name(const entry &e) {
+  switch (e.metric.index()) {
+  case 0:
+    return "counter";
+  case 1:
+    return "gauge";
+  default:
+    return "histogram";
+  }
+}
+
+void respond(int client, const std::string &status,
+             const std::string &content_type, const std::string &body) {
+  std::string response = fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\n"
+                                     "Content-Length: {}\r\n"
+                                     "Connection: close\r\n\r\n{}",
+                                     status, content_type, body.size(), body);
+  size_t sent{0};
+  while (sent < response.size()) {
+    ssize_t n = send(client, response.data() + sent, response.size() - sent,
+                     MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    sent += n;
+  }
+}
+
+void handle_client(int client) {
+  char request[2048];
+  ssize_t n = recv(client, request, sizeof(request) - 1, 0);
+  if (n <= 0) {
+    return;
+  }
+  request[n] = '\0';
+
+  /* Only the request line matters: "GET /path HTTP/1.1" */
+  std::string_view line(request, n);
+  line = line.substr(0, line.find("\r\n"));
+  if (!line.starts_with("GET ")) {
+    respond(client, "405 Method Not Allowed", "text/plain", "");
+    return;
+  }
+  line.remove_prefix(4);
+  std::string path(line.substr(0, line.find(' ')));
+  path = path.substr(0, path.find('?'));
+
+  page found;
+  {
+    registry &r = get_registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    auto it = r.pages.find(path);
+    if (it == r.pages.end()) {
+      respond(client, "404 Not Found", "text/plain", "");
+      return;
+    }
+    found = it->second;
+  }
+  respond(client, "200 OK", found.content_type, found.handler());
+}
+
+} // namespace
+
+counter &get_counter(std::string_view name, std::string_view help,
+                     std::string_view labels) {
+  return find_or_create<counter>(name, help, labels);
+}
+
+gauge &get_gauge(std::string_view name, std::string_view help,
+                 std::string_view labels) {
+  return find_or_create<gauge>(name, help, labels);
+}
+
+histogram &get_histogram(std::string_view name, std::string_view help,
+                         std::string_view labels) {
+  return find_or_create<histogram>(name, help, labels);
+}
+
+std::string render() {
+  registry &r = get_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  /* Group label sets under one HELP/TYPE header per metric name */
+  std::map<std::string_view, std::vector<const entry *>> by_name;
+  for (const auto &e : r.entries) {
+    by_name[e.name].push_back(&e);
+  }
+
+  fmt::memory_buffer out;
+  for (const auto &[name, entries] : by_name) {
+    fmt::format_to(fmt::appender(out), "# HELP {} {}\n# TYPE {} {}\n", name,
+                   entries.front()->help, name, type_name(*entries.front()));
+    for (const entry *e : entries) {
+      render_entry(out, *e);
+    }
+  }
+  return fmt::to_string(out);
+}
+
+void add_page(const std::string &path, const std::string &content_type,
+              std::function<std::string()> handler) {
+  registry &r = get_registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.pages[path] = page{content_type, std::move(handler)};
+}
+
+void serve(uint16_t port) {
+  add_page("/metrics", "text/plain; version=0.0.4", render);
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  if (listener < 0) {
+    throw std::system_error(errno, std::generic_category(), "metrics socket");
+  }
+  int reuse{1};
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address{};
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listener, reinterpret_cast<sockaddr *>(&address),
+           sizeof(address)) < 0 ||
+      listen(listener, 16) < 0) {
+    int error = errno;
+    close(listener);
+    throw std::system_error(error, std::generic_category(),
+                            fmt::format("metrics port {}", port));
+  }
+
+  std::thread server([listener]() {
+    for (;;) {
+      int client = accept(listener, nullptr, nullptr);
+      if (client < 0) {
+        continue;
+      }
+      /* Scrapes are infrequent, serving them inline keeps this simple */
+      timeval timeout{.tv_sec = 2, .tv_usec = 0};
+      setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+      handle_client(client);
+      close(client);
+    }
+  });
+  server.detach();
+}
+
+} // namespace metrics
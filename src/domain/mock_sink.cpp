@@ -0,0 +1,186 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <iostream>
+#include <random>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/mock_sink.h>
+
+namespace outbound {
+
+mock_sink::mock_sink(options o) : opts(o) {
+  scheduler = std::thread(&mock_sink::run_scheduler, this);
+}
+
+mock_sink::~mock_sink() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  scheduler.join();
+}
+
+mock_sink::steady::duration mock_sink::delay() {
+  if (opts.jitter.count() <= 0) {
+    return opts.latency;
+  }
+  thread_local std::mt19937_64 rng(std::random_device{}());
+  return opts.latency +
+         std::chrono::microseconds(rng() % (opts.jitter.count() + 1));
+}
+
+void mock_sink::schedule(steady::time_point due, std::function<void()> run) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push(task{due, next_sequence++, std::move(run)});
+  }
+  wake.notify_one();
+}
+
+void mock_sink::run_scheduler() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stopping) {
+    if (tasks.empty()) {
+      wake.wait(lock);
+      continue;
+    }
+    if (tasks.top().due > steady::now()) {
+      wake.wait_until(lock, tasks.top().due);
+      continue;
+    }
+    std::function<void()> run = std::move(const_cast<task &>(tasks.top()).run);
+    tasks.pop();
+    lock.unlock();
+    run();
+    lock.lock();
+  }
+}
+
+void mock_sink::acknowledge(const dpp::interaction_create_t & /*event*/) {
+  count(route::acknowledge);
+}
+
+void mock_sink::reply(const dpp::interaction_create_t & /*event*/,
+                      const dpp::message & /*m*/) {
+  count(route::reply);
+}
+
+void mock_sink::deliver(dpp::snowflake user_id, bool has_components) {
+  count(route::direct_message);
+  /* In flight until the simulated response, so backpressure sees latency */
+  backpressure::started();
+  const auto start = steady::now();
+  schedule(start + delay(), [this, user_id, has_components, start]() {
+    backpressure::finished(steady::now() - start);
+    if (on_direct_message) {
+      on_direct_message(user_id, has_components);
+    }
+  });
+}
+
+void mock_sink::deliver_sync(dpp::snowflake user_id, bool has_components) {
+  count(route::direct_message_sync);
+  std::this_thread::sleep_for(delay());
+  if (on_direct_message) {
+    on_direct_message(user_id, has_components);
+  }
+}
+
+void mock_sink::direct_message(dpp::snowflake user_id, const dpp::message &m) {
+  deliver(user_id, !m.components.empty());
+}
+
+void mock_sink::direct_message_sync(dpp::snowflake user_id,
+                                    const dpp::message &m) {
+  deliver_sync(user_id, !m.components.empty());
+}
+
+void mock_sink::channel_message(const dpp::message & /*m*/) {
+  count(route::channel_message);
+}
+
+void mock_sink::direct_message(dpp::snowflake user_id, const payload &p) {
+  deliver(user_id, p.has_components);
+}
+
+void mock_sink::direct_message_sync(dpp::snowflake user_id,
+                                    const payload &p) {
+  deliver_sync(user_id, p.has_components);
+}
+
+void mock_sink::channel_message(dpp::snowflake /*channel_id*/,
+                                const payload & /*p*/) {
+  count(route::channel_message);
+}
+
+void mock_sink::update(const dpp::interaction_create_t & /*event*/,
+                       const payload & /*p*/) {
+  count(route::update);
+}
+
+void mock_sink::follow_up(const std::string & /*token*/,
+                          const payload & /*p*/) {
+  count(route::follow_up);
+}
+
+void mock_sink::follow_up_sync(const std::string & /*token*/,
+                               const payload & /*p*/) {
+  count(route::follow_up_sync);
+  std::this_thread::sleep_for(delay());
+}
+
+void mock_sink::log(dpp::loglevel severity, const std::string &message) {
+  if (severity >= log_level) {
+    std::cerr << message << "\n";
+  }
+}
+
+uint64_t mock_sink::total_calls() const {
+  uint64_t total{0};
+  for (const auto &c : counts) {
+    total += c.load(std::memory_order_relaxed);
+  }
+  return total;
+}
+
+const char *mock_sink::route_name(route r) {
+  switch (r) {
+  case route::acknowledge:
+    return "acknowledge";
+  case route::reply:
+    return "reply";
+  case route::direct_message:
+    return "direct_message_create";
+  case route::direct_message_sync:
+    return "direct_message_create_sync";
+  case route::channel_message:
+    return "message_create";
+  case route::update:
+    return "update";
+  case route::follow_up:
+    return "follow_up";
+  case route::follow_up_sync:
+    return "follow_up_sync";
+  case route::count:
+    break;
+  }
+  return "unknown";
+}
+
+} // namespace outbound
@@ -0,0 +1,236 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <chrono>
+#include <fmt/format.h>
+#include <future>
+#include <memory>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/trace.h>
+
+namespace outbound {
+
+static sink *installed{nullptr};
+
+void set(sink &s) { installed = &s; }
+
+sink &get() { return *installed; }
+
+metrics::histogram &rest_latency(const char *route) {
+  return metrics::get_histogram("rps_rest_duration_seconds",
+                                "Outbound REST call latency",
+                                fmt::format("route=\"{}\"", route));
+}
+
+static metrics::histogram &rest_acknowledge = rest_latency("acknowledge");
+static metrics::histogram &rest_reply = rest_latency("reply");
+static metrics::histogram &rest_direct_message =
+    rest_latency("direct_message_create");
+static metrics::histogram &rest_direct_message_sync =
+    rest_latency("direct_message_create_sync");
+static metrics::histogram &rest_message = rest_latency("message_create");
+static metrics::histogram &rest_update = rest_latency("update");
+static metrics::histogram &rest_follow_up = rest_latency("follow_up");
+static metrics::histogram &rest_follow_up_sync = rest_latency("follow_up_sync");
+
+/**
+ * @brief Completion callback recording a REST call's latency, and tracing it
+ * if the calling thread is tracing an interaction
+ */
+static dpp::command_completion_event_t observe_rest(metrics::histogram &h,
+                                                    const char *route) {
+  backpressure::started();
+  return [&h, span = trace::async_span(route),
+          start = std::chrono::steady_clock::now()](
+             const dpp::confirmation_callback_t &callback) {
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    h.observe(elapsed);
+    backpressure::finished(elapsed);
+    span.finish();
+    if (callback.is_error()) {
+      dpp::utility::log_error()(callback);
+    }
+  };
+}
+
+void cluster_sink::acknowledge(const dpp::interaction_create_t &event) {
+  event.reply(observe_rest(rest_acknowledge, "acknowledge"));
+}
+
+void cluster_sink::reply(const dpp::interaction_create_t &event,
+                         const dpp::message &m) {
+  event.reply(m, observe_rest(rest_reply, "reply"));
+}
+
+void cluster_sink::direct_message(dpp::snowflake user_id,
+                                  const dpp::message &m) {
+  direct_message(user_id, payload{m.build_json(), !m.components.empty()});
+}
+
+void cluster_sink::direct_message_sync(dpp::snowflake user_id,
+                                       const dpp::message &m) {
+  direct_message_sync(user_id,
+                      payload{m.build_json(), !m.components.empty()});
+}
+
+void cluster_sink::channel_message(const dpp::message &m) {
+  cluster.message_create(m, observe_rest(rest_message, "message_create"));
+}
+
+void cluster_sink::with_dm_channel(dpp::snowflake user_id,
+                                   std::function<void(dpp::snowflake)> then) {
+  const dpp::snowflake cached = dm_channels.find(user_id);
+  if (cached != 0) {
+    then(cached);
+    return;
+  }
+  backpressure::started();
+  cluster.create_dm_channel(
+      user_id, [this, user_id, then = std::move(then),
+                start = std::chrono::steady_clock::now()](
+                   const dpp::confirmation_callback_t &callback) {
+        backpressure::finished(std::chrono::steady_clock::now() - start);
+        if (callback.is_error()) {
+          dpp::utility::log_error()(callback);
+          then(0);
+          return;
+        }
+        const auto channel = callback.get<dpp::channel>();
+        dm_channels.insert(user_id, channel.id);
+        then(channel.id);
+      });
+}
+
+void cluster_sink::post(metrics::histogram &latency, const char *route,
+                        const std::string &endpoint, const std::string &major,
+                        const std::string &parameters, std::string body,
+                        std::function<void(uint16_t)> done) {
+  backpressure::started();
+  cluster.post_rest(
+      endpoint, major, parameters, dpp::m_post, body,
+      [this, route, &latency, done = std::move(done),
+       span = trace::async_span(route),
+       start = std::chrono::steady_clock::now()](
+          dpp::json & /*unused*/, const dpp::http_request_completion_t &http) {
+        const auto elapsed = std::chrono::steady_clock::now() - start;
+        latency.observe(elapsed);
+        backpressure::finished(elapsed);
+        span.finish();
+        if (http.error != dpp::h_success || http.status >= 400) {
+          cluster.log(dpp::ll_error, fmt::format("{}: HTTP {} {}", route,
+                                                 http.status, http.body));
+        }
+        if (done) {
+          done(http.status);
+        }
+      });
+}
+
+void cluster_sink::post_message(metrics::histogram &latency, const char *route,
+                                dpp::snowflake channel_id, std::string body,
+                                std::function<void(uint16_t)> done) {
+  if (channel_id == 0) {
+    if (done) {
+      done(0);
+    }
+    return;
+  }
+  post(latency, route, API_PATH "/channels", std::to_string(channel_id),
+       "messages", std::move(body), std::move(done));
+}
+
+void cluster_sink::post_direct_message(metrics::histogram &latency,
+                                       const char *route,
+                                       dpp::snowflake user_id,
+                                       std::string body,
+                                       std::function<void()> done,
+                                       bool retried) {
+  with_dm_channel(user_id, [=, this, &latency](dpp::snowflake channel_id) {
+    post_message(latency, route, channel_id, body,
+                 [=, this, &latency](uint16_t status) {
+                   if (status == 403 || status == 404) {
+                     dm_channels.invalidate(user_id);
+                   }
+                   if (status == 404 && !retried) {
+                     post_direct_message(latency, route, user_id, body, done,
+                                         true);
+                     return;
+                   }
+                   if (done) {
+                     done();
+                   }
+                 });
+  });
+}
+
+void cluster_sink::direct_message(dpp::snowflake user_id, const payload &p) {
+  post_direct_message(rest_direct_message, "direct_message_create", user_id,
+                      std::string(p.json));
+}
+
+void cluster_sink::direct_message_sync(dpp::snowflake user_id,
+                                       const payload &p) {
+  trace::span span("direct_message_create_sync");
+  auto delivered = std::make_shared<std::promise<void>>();
+  post_direct_message(rest_direct_message_sync, "direct_message_create_sync",
+                      user_id, std::string(p.json),
+                      [delivered]() { delivered->set_value(); });
+  delivered->get_future().wait_for(std::chrono::seconds(30));
+}
+
+void cluster_sink::channel_message(dpp::snowflake channel_id,
+                                   const payload &p) {
+  post_message(rest_message, "message_create", channel_id,
+               std::string(p.json));
+}
+
+void cluster_sink::update(const dpp::interaction_create_t &event,
+                          const payload &p) {
+  std::string body;
+  body.reserve(p.json.size() + 20);
+  body += R"({"type":7,"data":)";
+  body += p.json;
+  body += '}';
+  post(rest_update, "update", API_PATH "/interactions",
+       fmt::format("{}/{}", event.command.id, event.command.token), "callback",
+       std::move(body));
+}
+
+void cluster_sink::follow_up(const std::string &token, const payload &p) {
+  /* The token is part of the major parameter so each interaction gets its own
+   * bucket, matching Discord's per interaction limits */
+  post(rest_follow_up, "follow_up", API_PATH "/webhooks",
+       fmt::format("{}/{}", cluster.me.id, token), "", std::string(p.json));
+}
+
+void cluster_sink::follow_up_sync(const std::string &token, const payload &p) {
+  trace::span span("follow_up_sync");
+  auto delivered = std::make_shared<std::promise<void>>();
+  post(rest_follow_up_sync, "follow_up_sync", API_PATH "/webhooks",
+       fmt::format("{}/{}", cluster.me.id, token), "", std::string(p.json),
+       [delivered](uint16_t /*status*/) { delivered->set_value(); });
+  delivered->get_future().wait_for(std::chrono::seconds(30));
+}
+
+void cluster_sink::log(dpp::loglevel severity, const std::string &message) {
+  cluster.log(severity, message);
+}
+
+} // namespace outbound
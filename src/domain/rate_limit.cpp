@@ -0,0 +1,158 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <bit>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
+#include <rps/domain/rate_limit.h>
+
+namespace rate_limit {
+
+/**
+ * @brief splitmix64 finaliser, so sequential ids spread over the table
+ */
+static uint64_t mix(uint64_t z) {
+  z += 0x9e3779b97f4a7c15;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+token_buckets::token_buckets(size_t slots)
+    : table(std::make_unique<slot[]>(std::bit_ceil(std::max(slots, ways)))),
+      mask(std::bit_ceil(std::max(slots, ways)) - 1) {}
+
+std::atomic<uint64_t> &token_buckets::find(uint64_t key, uint64_t now_ms,
+                                           uint64_t full) {
+  const size_t set = mix(key) & mask & ~(ways - 1);
+  const uint64_t fresh = (now_ms << token_bits) | full;
+
+  for (size_t i = set; i < set + ways; ++i) {
+    if (table[i].owner.load(std::memory_order_acquire) == key) {
+      return table[i].state;
+    }
+  }
+
+  /* Not present: claim an empty way, else evict the least recently used.
+   * Racing claims for the same key may land in two ways; both work. */
+  size_t victim = set;
+  uint64_t oldest = UINT64_MAX;
+  for (size_t i = set; i < set + ways; ++i) {
+    uint64_t owner = table[i].owner.load(std::memory_order_acquire);
+    if (owner == 0) {
+      table[i].state.store(fresh, std::memory_order_relaxed);
+      if (table[i].owner.compare_exchange_strong(owner, key,
+                                                 std::memory_order_acq_rel)) {
+        return table[i].state;
+      }
+    }
+    const uint64_t when =
+        table[i].state.load(std::memory_order_relaxed) >> token_bits;
+    if (when < oldest) {
+      oldest = when;
+      victim = i;
+    }
+  }
+  table[victim].owner.store(key, std::memory_order_release);
+  table[victim].state.store(fresh, std::memory_order_relaxed);
+  return table[victim].state;
+}
+
+bool token_buckets::try_acquire(uint64_t key, uint64_t now_ms, uint32_t burst,
+                                uint32_t per_minute) {
+  const uint64_t full = std::min<uint64_t>(burst, 8000) * 1000;
+  std::atomic<uint64_t> &state = find(key, now_ms, full);
+
+  uint64_t current = state.load(std::memory_order_relaxed);
+  for (;;) {
+    const uint64_t last = current >> token_bits;
+    const uint64_t elapsed = now_ms > last ? now_ms - last : 0;
+    /* Thousandths of a token per ms is per_minute / 60 */
+    const uint64_t tokens = std::min(
+        full, (current & token_mask) + elapsed * per_minute / 60);
+    if (tokens < 1000) {
+      return false;
+    }
+    const uint64_t next =
+        (std::max(now_ms, last) << token_bits) | (tokens - 1000);
+    if (state.compare_exchange_weak(current, next,
+                                    std::memory_order_relaxed)) {
+      return true;
+    }
+  }
+}
+
+recent_keys::recent_keys(size_t slots)
+    : table(std::make_unique<std::atomic<uint64_t>[]>(
+          std::bit_ceil(std::max<size_t>(slots, 1)))),
+      mask(std::bit_ceil(std::max<size_t>(slots, 1)) - 1) {}
+
+bool recent_keys::seen(uint64_t key, uint64_t now_s, uint64_t window_s) {
+  const uint64_t h = mix(key);
+  /* Fingerprint from the bits not used for the slot; never 0, so an empty
+   * slot matches nothing */
+  const uint64_t fingerprint = (h >> time_bits) | 1;
+  const uint64_t entry = (fingerprint << time_bits) | (now_s & time_mask);
+  const uint64_t previous =
+      table[h & mask].exchange(entry, std::memory_order_acq_rel);
+  return previous >> time_bits == fingerprint &&
+         ((now_s - previous) & time_mask) < window_s;
+}
+
+/**
+ * @brief Seconds a handled interaction or choice is remembered. Gateway
+ * redeliveries and double clicks arrive well within this.
+ */
+static constexpr uint64_t remember_seconds = 60;
+
+static token_buckets buckets;
+static recent_keys interactions;
+static recent_keys choices;
+
+/**
+ * @brief Game time since the first check, so it fits the packed states
+ */
+static double elapsed() {
+  static const double origin = timing::get().unix_time();
+  const double now = timing::get().unix_time() - origin;
+  return now > 0 ? now : 0;
+}
+
+bool allow(dpp::snowflake user_id) {
+  const config::settings &s = config::current();
+  if (s.rate_limit_burst == 0 || user_id == 0) {
+    return true;
+  }
+  return buckets.try_acquire(user_id, static_cast<uint64_t>(elapsed() * 1000),
+                             s.rate_limit_burst, s.rate_limit_per_minute);
+}
+
+bool duplicate_interaction(dpp::snowflake interaction_id) {
+  return interactions.seen(interaction_id, static_cast<uint64_t>(elapsed()),
+                           remember_seconds);
+}
+
+bool duplicate_choice(dpp::snowflake user_id, unsigned int lobby_id,
+                      unsigned int game_number) {
+  const uint64_t round = (uint64_t{lobby_id} << 32) | game_number;
+  return choices.seen(mix(user_id) ^ round, static_cast<uint64_t>(elapsed()),
+                      remember_seconds);
+}
+
+} // namespace rate_limit
@@ -0,0 +1,53 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <rps/domain/config.h>
+#include <rps/domain/events.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/stats.h>
+
+namespace stats {
+
+static core::history &store() {
+  static core::history rounds(config::current().history_rows);
+  return rounds;
+}
+
+const core::history &history() { return store(); }
+
+void subscribe() {
+  static metrics::gauge &rows = metrics::get_gauge(
+      "rps_history_rows", "Rounds kept for /stats, one row per player");
+  core::history &rounds = store();
+  events::subscribe("stats", [&rounds](std::span<const events::event> batch) {
+    for (const events::event &e : batch) {
+      if (e.players[0] == 0 || e.players[1] == 0) {
+        /* Practice games against a bot are not on anyone's record */
+        continue;
+      }
+      if (e.type == events::event_type::round_resolved) {
+        rounds.record_round(e.players, e.picks, e.result, e.time);
+      } else if (e.type == events::event_type::match_ended) {
+        rounds.end_match();
+      }
+    }
+    rows.set(static_cast<int64_t>(rounds.rows()));
+  });
+}
+
+} // namespace stats
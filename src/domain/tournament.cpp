@@ -0,0 +1,683 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <rps/domain/backpressure.h>
+#include <rps/domain/clock.h>
+#include <rps/domain/config.h>
+#include <rps/domain/embeds.h>
+#include <rps/domain/events.h>
+#include <rps/domain/handoff.h>
+#include <rps/domain/logger.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/tournament.h>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+
+namespace tournament {
+
+/**
+ * @brief Standings listed in a bracket post
+ */
+static constexpr size_t leaders_shown = 10;
+
+/**
+ * @brief Seconds a playing match's lobby may be gone before its end is taken
+ * as lost on the event bus and the match is played again. Ends normally
+ * arrive well within a second of the lobby closing.
+ */
+static constexpr double lost_after = 10;
+
+struct entry {
+  dpp::snowflake channel_id;
+  game::player_context organiser;
+  core::tournament_format format{core::tournament_format::single_elimination};
+  unsigned int rounds{0};
+  /** @brief In sign up order, then in seed order once started */
+  std::vector<game::player_context> entrants;
+  std::unordered_set<uint64_t> signed_up;
+  std::optional<core::tournament> bracket;
+  /** @brief Changed since it was last posted */
+  bool dirty{false};
+  double last_post{0};
+};
+
+/**
+ * @brief Where a lobby's match sits
+ */
+struct match_ref {
+  dpp::snowflake channel_id;
+  uint32_t match{0};
+  /** @brief Game time the lobby was first found gone, 0 while it is there */
+  double missing_since{0};
+};
+
+static std::mutex tournaments_mutex;
+static std::unordered_map<uint64_t, entry> tournaments;
+static std::unordered_map<unsigned int, match_ref> playing;
+/** @brief Ends of playing matches, applied by the driver */
+static std::vector<events::event> ended;
+/** @brief Changed since it was last saved */
+static bool unsaved{false};
+/** @brief Off when an unreadable file could not be moved aside */
+static bool saving{true};
+
+static std::jthread driver;
+
+static metrics::gauge &active = metrics::get_gauge(
+    "rps_tournaments_active", "Tournaments signing up or in progress");
+static metrics::counter &matches_started = metrics::get_counter(
+    "rps_tournament_matches_started_total", "Tournament matches started");
+static metrics::counter &save_errors = metrics::get_counter(
+    "rps_tournament_save_errors_total",
+    "Times the tournament file could not be written");
+
+template <typename T> static void put(std::string &out, T value) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+static void put(std::string &out, std::string_view value) {
+  put(out, static_cast<uint32_t>(value.size()));
+  out.append(value);
+}
+
+static void put(std::string &out, const game::player_context &context) {
+  put(out, static_cast<uint64_t>(context.player.id));
+  put(out, std::string_view(context.player.username));
+  put(out, static_cast<uint16_t>(context.player.discriminator));
+  put(out, static_cast<uint64_t>(context.guild_id));
+  put(out, static_cast<uint64_t>(context.channel_id));
+  put(out, std::string_view(context.locale));
+}
+
+/**
+ * @brief Bounds checked cursor over a stream
+ */
+struct cursor {
+  std::string_view in;
+
+  void need(size_t n) const {
+    if (in.size() < n) {
+      throw std::runtime_error("tournament stream truncated");
+    }
+  }
+
+  template <typename T> T get() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    need(sizeof(T));
+    T value;
+    std::memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return value;
+  }
+
+  std::string get_string() {
+    const auto size = get<uint32_t>();
+    need(size);
+    std::string value(in.substr(0, size));
+    in.remove_prefix(size);
+    return value;
+  }
+
+  game::player_context get_context() {
+    game::player_context context;
+    context.player.id = get<uint64_t>();
+    context.player.username = get_string();
+    context.player.discriminator = get<uint16_t>();
+    context.guild_id = get<uint64_t>();
+    context.channel_id = get<uint64_t>();
+    context.locale = get_string();
+    return context;
+  }
+};
+
+static dpp::interaction_create_t
+localised(const game::player_context &context) {
+  dpp::interaction_create_t interaction;
+  interaction.command.locale = context.locale;
+  return interaction;
+}
+
+/**
+ * @brief A tournament's bracket post. Call with the lock held.
+ */
+static dpp::message describe(const entry &t,
+                             const dpp::interaction_create_t &interaction) {
+  std::vector<std::pair<std::string, core::standing>> leaders;
+  if (t.bracket) {
+    const std::vector<core::standing> standings = t.bracket->standings();
+    const size_t shown = std::min(standings.size(), leaders_shown);
+    leaders.reserve(shown);
+    for (size_t i = 0; i < shown; ++i) {
+      leaders.emplace_back(
+          t.entrants[standings[i].entrant].player.format_username(),
+          standings[i]);
+    }
+  }
+  return embeds::tournament(interaction, t.format, t.entrants.size(),
+                            t.bracket ? &*t.bracket : nullptr, leaders);
+}
+
+/**
+ * @brief Whether a playing match's lobby still seats both its players
+ */
+static bool lobby_holds(const core::tournament &bracket, uint32_t match) {
+  const core::bracket_match &m = bracket.matches()[match];
+  return m.lobby != 0 &&
+         game::find_player_lobby_id(bracket.entrant(m.seats[0])) == m.lobby &&
+         game::find_player_lobby_id(bracket.entrant(m.seats[1])) == m.lobby;
+}
+
+/**
+ * @brief Record the ends of playing matches. Call with the lock held.
+ */
+static void apply_results() {
+  for (const events::event &e : ended) {
+    const auto found = playing.find(e.lobby_id);
+    if (found == playing.end()) {
+      continue;
+    }
+    const match_ref ref = found->second;
+    playing.erase(found);
+    const auto t = tournaments.find(ref.channel_id);
+    if (t == tournaments.end() || !t->second.bracket) {
+      continue;
+    }
+    core::tournament &bracket = *t->second.bracket;
+    if (e.type == events::event_type::lobby_closed) {
+      bracket.restart(ref.match);
+    } else {
+      int seat{-1};
+      if (e.result == core::outcome::player_one) {
+        seat = 0;
+      } else if (e.result == core::outcome::player_two) {
+        seat = 1;
+      }
+      const uint32_t first = bracket.matches()[ref.match].seats[0];
+      if (seat >= 0 && e.players[0] != bracket.entrant(first)) {
+        seat = 1 - seat;
+      }
+      bracket.report(ref.match, seat);
+    }
+    t->second.dirty = true;
+    unsaved = true;
+  }
+  ended.clear();
+}
+
+/**
+ * @brief Play again the matches whose lobby closed without its end reaching
+ * us, e.g. when the event bus dropped it. Call with the lock held, after
+ * apply_results().
+ */
+static void reconcile(double now) {
+  for (auto it = playing.begin(); it != playing.end();) {
+    match_ref &ref = it->second;
+    const auto t = tournaments.find(ref.channel_id);
+    if (t == tournaments.end() || !t->second.bracket) {
+      it = playing.erase(it);
+      continue;
+    }
+    core::tournament &bracket = *t->second.bracket;
+    if (lobby_holds(bracket, ref.match)) {
+      ref.missing_since = 0;
+    } else if (ref.missing_since == 0) {
+      ref.missing_since = now;
+    } else if (now - ref.missing_since >= lost_after) {
+      bracket.restart(ref.match);
+      t->second.dirty = true;
+      unsaved = true;
+      it = playing.erase(it);
+      continue;
+    }
+    ++it;
+  }
+}
+
+/**
+ * @brief Seat up to a batch of ready matches. Call with the lock held.
+ *
+ * @return std::vector<unsigned int> lobbies to send prompts to
+ */
+static std::vector<unsigned int> seat_matches() {
+  const size_t batch = config::current().tournament_batch;
+  std::vector<std::array<game::player_context, 2>> pairs;
+  std::vector<match_ref> refs;
+  std::unordered_set<uint64_t> seated;
+  for (auto &[channel_id, t] : tournaments) {
+    if (!t.bracket) {
+      continue;
+    }
+    for (const uint32_t match : t.bracket->ready()) {
+      if (pairs.size() >= batch) {
+        break;
+      }
+      const auto &seats = t.bracket->matches()[match].seats;
+      std::array<game::player_context, 2> pair{t.entrants[seats[0]],
+                                               t.entrants[seats[1]]};
+      bool busy{false};
+      for (auto &context : pair) {
+        /* Results go to the players and the bracket post, not the channel */
+        context.guild_id = 0;
+        busy = busy || seated.contains(context.player.id) ||
+               game::find_player_lobby_id(context.player.id) != 0;
+      }
+      if (busy) {
+        continue;
+      }
+      seated.insert(pair[0].player.id);
+      seated.insert(pair[1].player.id);
+      pairs.push_back(std::move(pair));
+      refs.push_back({t.channel_id, match});
+    }
+  }
+  if (pairs.empty()) {
+    return {};
+  }
+  std::vector<unsigned int> lobbies = game::create_matches(pairs);
+  for (size_t i = 0; i < lobbies.size(); ++i) {
+    if (lobbies[i] == 0) {
+      /* Left ready for the next tick */
+      continue;
+    }
+    entry &t = tournaments[refs[i].channel_id];
+    t.bracket->start(refs[i].match, lobbies[i]);
+    playing[lobbies[i]] = refs[i];
+    t.dirty = true;
+    unsaved = true;
+  }
+  std::erase(lobbies, 0U);
+  return lobbies;
+}
+
+/**
+ * @brief Bracket posts due, and finished tournaments dropped once posted.
+ * Call with the lock held.
+ */
+static std::vector<dpp::message> due_posts(double now) {
+  std::vector<dpp::message> posts;
+  if (backpressure::shedding(backpressure::level::shed_channel_posts)) {
+    return posts;
+  }
+  const double interval = config::current().tournament_post_interval;
+  for (auto it = tournaments.begin(); it != tournaments.end();) {
+    entry &t = it->second;
+    const bool finished = t.bracket && t.bracket->finished();
+    if (t.dirty && (finished || now - t.last_post >= interval)) {
+      posts.push_back(
+          describe(t, localised(t.organiser)).set_channel_id(t.channel_id));
+      t.dirty = false;
+      t.last_post = now;
+    }
+    if (finished && !t.dirty) {
+      it = tournaments.erase(it);
+      unsaved = true;
+    } else {
+      ++it;
+    }
+  }
+  active.set(static_cast<int64_t>(tournaments.size()));
+  return posts;
+}
+
+/**
+ * @brief Write every tournament to the tournament file, through a temporary
+ * file so a crash leaves the last complete save
+ */
+static void save(const std::string &stream) {
+  const std::string &path = config::current().tournament_file;
+  if (path.empty() || !saving) {
+    return;
+  }
+  const std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+    if (!out.write(stream.data(), static_cast<std::streamsize>(stream.size()))
+             .flush()) {
+      save_errors.inc();
+      return;
+    }
+  }
+  if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+    save_errors.inc();
+  }
+}
+
+/**
+ * @brief Serialise every tournament. Call with the lock held.
+ */
+static std::string encode_locked() {
+  std::string out;
+  out.append(file_magic, sizeof(file_magic));
+  put(out, static_cast<uint64_t>(tournaments.size()));
+  for (const auto &[channel_id, t] : tournaments) {
+    put(out, static_cast<uint64_t>(t.channel_id));
+    put(out, t.organiser);
+    put(out, static_cast<uint8_t>(t.format));
+    put(out, static_cast<uint32_t>(t.rounds));
+    put(out, static_cast<uint64_t>(t.entrants.size()));
+    for (const auto &context : t.entrants) {
+      put(out, context);
+    }
+    put(out, static_cast<uint8_t>(t.bracket.has_value()));
+    if (t.bracket) {
+      put(out, std::string_view(t.bracket->encode()));
+    }
+  }
+  return out;
+}
+
+static void drive(const std::stop_token &stop) {
+  while (!stop.stop_requested()) {
+    std::vector<unsigned int> lobbies;
+    std::vector<dpp::message> posts;
+    std::string stream;
+    {
+      std::lock_guard<std::mutex> lock(tournaments_mutex);
+      const double now = timing::get().unix_time();
+      apply_results();
+      /* Lobbies handed to a successor are gone from here, not lost */
+      if (!handoff::draining()) {
+        reconcile(now);
+        if (!backpressure::shedding(backpressure::level::stretch_pairing)) {
+          lobbies = seat_matches();
+        }
+      }
+      posts = due_posts(now);
+      if (unsaved) {
+        stream = encode_locked();
+        unsaved = false;
+      }
+    }
+    for (const unsigned int lobby_id : lobbies) {
+      logger::lobby_started(lobby_id);
+      game::send_game_messages(lobby_id);
+      matches_started.inc();
+    }
+    for (const auto &post : posts) {
+      outbound::get().channel_message(post);
+    }
+    if (!stream.empty()) {
+      save(stream);
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(1));
+  }
+}
+
+result open(dpp::snowflake channel_id, const game::player_context &organiser,
+            core::tournament_format format, unsigned int rounds) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  if (tournaments.contains(channel_id)) {
+    return result::exists;
+  }
+  entry &t = tournaments[channel_id];
+  t.channel_id = channel_id;
+  t.organiser = organiser;
+  t.format = format;
+  t.rounds = rounds;
+  active.set(static_cast<int64_t>(tournaments.size()));
+  unsaved = true;
+  return result::ok;
+}
+
+result join(dpp::snowflake channel_id, const game::player_context &player) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  const auto found = tournaments.find(channel_id);
+  if (found == tournaments.end()) {
+    return result::none;
+  }
+  entry &t = found->second;
+  if (t.bracket) {
+    return result::started;
+  }
+  if (!t.signed_up.insert(player.player.id).second) {
+    return result::already_joined;
+  }
+  t.entrants.push_back(player);
+  t.dirty = true;
+  unsaved = true;
+  return result::ok;
+}
+
+result leave(dpp::snowflake channel_id, dpp::snowflake player_id) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  const auto found = tournaments.find(channel_id);
+  if (found == tournaments.end()) {
+    return result::none;
+  }
+  entry &t = found->second;
+  if (t.bracket) {
+    return result::started;
+  }
+  if (t.signed_up.erase(player_id) == 0) {
+    return result::not_joined;
+  }
+  std::erase_if(t.entrants, [player_id](const game::player_context &c) {
+    return c.player.id == player_id;
+  });
+  t.dirty = true;
+  unsaved = true;
+  return result::ok;
+}
+
+result begin(dpp::snowflake channel_id, dpp::snowflake player_id) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  const auto found = tournaments.find(channel_id);
+  if (found == tournaments.end()) {
+    return result::none;
+  }
+  entry &t = found->second;
+  if (t.organiser.player.id != player_id) {
+    return result::not_organiser;
+  }
+  if (t.bracket) {
+    return result::started;
+  }
+  if (t.entrants.size() < 2) {
+    return result::too_few;
+  }
+  static std::minstd_rand random{std::random_device{}()};
+  std::shuffle(t.entrants.begin(), t.entrants.end(), random);
+  std::vector<core::player_id> seeds;
+  seeds.reserve(t.entrants.size());
+  for (const auto &context : t.entrants) {
+    seeds.push_back(context.player.id);
+  }
+  t.bracket.emplace(t.format, std::move(seeds), t.rounds);
+  t.dirty = true;
+  unsaved = true;
+  return result::ok;
+}
+
+result cancel(dpp::snowflake channel_id, dpp::snowflake player_id) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  const auto found = tournaments.find(channel_id);
+  if (found == tournaments.end()) {
+    return result::none;
+  }
+  if (found->second.organiser.player.id != player_id) {
+    return result::not_organiser;
+  }
+  std::erase_if(playing, [channel_id](const auto &p) {
+    return p.second.channel_id == channel_id;
+  });
+  tournaments.erase(found);
+  active.set(static_cast<int64_t>(tournaments.size()));
+  unsaved = true;
+  return result::ok;
+}
+
+std::optional<dpp::message>
+summary(dpp::snowflake channel_id,
+        const dpp::interaction_create_t &interaction) {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  const auto found = tournaments.find(channel_id);
+  if (found == tournaments.end()) {
+    return std::nullopt;
+  }
+  return describe(found->second, interaction);
+}
+
+std::string encode() {
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  return encode_locked();
+}
+
+void decode(std::string_view stream) {
+  if (stream.substr(0, sizeof(file_magic)) !=
+      std::string_view(file_magic, sizeof(file_magic))) {
+    throw std::runtime_error("not a tournament file");
+  }
+  cursor in{stream.substr(sizeof(file_magic))};
+  std::unordered_map<uint64_t, entry> loaded;
+  const auto count = in.get<uint64_t>();
+  for (uint64_t i = 0; i < count; ++i) {
+    entry t;
+    t.channel_id = in.get<uint64_t>();
+    t.organiser = in.get_context();
+    t.format = static_cast<core::tournament_format>(in.get<uint8_t>());
+    t.rounds = in.get<uint32_t>();
+    const auto entrants = in.get<uint64_t>();
+    /* Each entrant takes at least 34 bytes */
+    if (entrants > in.in.size() / 34) {
+      throw std::runtime_error("tournament stream truncated");
+    }
+    t.entrants.reserve(entrants);
+    for (uint64_t e = 0; e < entrants; ++e) {
+      t.entrants.push_back(in.get_context());
+      t.signed_up.insert(t.entrants.back().player.id);
+    }
+    if (in.get<uint8_t>() != 0) {
+      t.bracket.emplace(core::tournament::decode(in.get_string()));
+      if (t.bracket->entrant_count() != t.entrants.size()) {
+        throw std::runtime_error("tournament entrants do not match bracket");
+      }
+    }
+    loaded[t.channel_id] = std::move(t);
+  }
+
+  std::lock_guard<std::mutex> lock(tournaments_mutex);
+  tournaments = std::move(loaded);
+  playing.clear();
+  for (auto &[channel_id, t] : tournaments) {
+    if (!t.bracket) {
+      continue;
+    }
+    const auto &matches = t.bracket->matches();
+    for (uint32_t m = 0; m < matches.size(); ++m) {
+      if (matches[m].state != core::match_state::playing) {
+        continue;
+      }
+      /* Keep matches whose lobby was handed over; start the rest again */
+      if (lobby_holds(*t.bracket, m)) {
+        playing[matches[m].lobby] = {t.channel_id, m};
+      } else {
+        t.bracket->restart(m);
+      }
+    }
+    t.dirty = true;
+  }
+  active.set(static_cast<int64_t>(tournaments.size()));
+}
+
+void subscribe() {
+  events::subscribe("tournament", [](std::span<const events::event> batch) {
+    std::lock_guard<std::mutex> lock(tournaments_mutex);
+    for (const events::event &e : batch) {
+      if ((e.type == events::event_type::match_ended ||
+           e.type == events::event_type::lobby_closed) &&
+          playing.contains(e.lobby_id)) {
+        ended.push_back(e);
+      }
+    }
+  });
+}
+
+/**
+ * @brief Read and decode the tournament file, if there is one
+ */
+static void load(const std::string &path) {
+  std::ifstream in(path, std::ios::binary);
+  if (!in) {
+    /* Nothing saved yet */
+    return;
+  }
+  std::ostringstream contents;
+  contents << in.rdbuf();
+  decode(contents.str());
+}
+
+void start() {
+  const std::string &path = config::current().tournament_file;
+  std::string error;
+  if (!path.empty()) {
+    try {
+      load(path);
+    } catch (const std::exception &e) {
+      /* Keep the unreadable file for inspection rather than saving over it */
+      const std::string aside = path + ".bad";
+      if (std::rename(path.c_str(), aside.c_str()) == 0) {
+        error = std::string(e.what()) + ", moved to " + aside;
+      } else {
+        saving = false;
+        error = std::string(e.what()) + ", not saving over " + path;
+      }
+    }
+  }
+  if (!driver.joinable()) {
+    driver = std::jthread(drive);
+  }
+  if (!error.empty()) {
+    throw std::runtime_error(error);
+  }
+}
+
+void stop() {
+  if (driver.joinable()) {
+    driver.request_stop();
+    driver.join();
+  }
+  std::string stream;
+  {
+    std::lock_guard<std::mutex> lock(tournaments_mutex);
+    apply_results();
+    /* A successor we handed over to owns the file now */
+    if (unsaved && !handoff::draining()) {
+      stream = encode_locked();
+      unsaved = false;
+    }
+  }
+  if (!stream.empty()) {
+    save(stream);
+  }
+}
+
+} // namespace tournament
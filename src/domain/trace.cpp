@@ -0,0 +1,163 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <rps/domain/config.h>
+#include <rps/domain/trace.h>
+#include <vector>
+
+namespace trace {
+
+namespace {
+
+constexpr size_t buffer_size = 4096;
+
+struct event {
+  const char *name{nullptr};
+  uint64_t interaction{0};
+  int64_t start_ns{0};
+  int64_t end_ns{0};
+};
+
+/**
+ * @brief Ring of recent spans for one thread. The mutex is only ever
+ * contended by dump().
+ */
+struct thread_buffer {
+  std::mutex mutex;
+  std::array<event, buffer_size> events{};
+  size_t next{0};
+  uint32_t tid{0};
+};
+
+/**
+ * @brief All buffers ever created, and the ones whose threads have exited.
+ * Game workers are short lived threads, so buffers are recycled rather than
+ * allocated per thread.
+ */
+struct buffer_pool {
+  std::mutex mutex;
+  std::vector<std::shared_ptr<thread_buffer>> all;
+  std::vector<std::shared_ptr<thread_buffer>> idle;
+};
+
+buffer_pool &get_pool() {
+  static buffer_pool pool;
+  return pool;
+}
+
+struct buffer_lease {
+  std::shared_ptr<thread_buffer> buffer;
+
+  buffer_lease() {
+    buffer_pool &pool = get_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    if (!pool.idle.empty()) {
+      buffer = std::move(pool.idle.back());
+      pool.idle.pop_back();
+    } else {
+      buffer = std::make_shared<thread_buffer>();
+      buffer->tid = pool.all.size() + 1;
+      pool.all.push_back(buffer);
+    }
+  }
+
+  ~buffer_lease() {
+    buffer_pool &pool = get_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    pool.idle.push_back(std::move(buffer));
+  }
+
+  buffer_lease(const buffer_lease &) = delete;
+  buffer_lease &operator=(const buffer_lease &) = delete;
+};
+
+thread_local uint64_t current_interaction{0};
+
+} // namespace
+
+bool sampled(uint64_t interaction_id) {
+  const double rate = config::current().trace_sample_rate;
+  if (rate <= 0 || interaction_id == 0) {
+    return false;
+  }
+  if (rate >= 1) {
+    return true;
+  }
+  /* Snowflakes are time ordered, so mix the bits before taking a fraction */
+  uint64_t h = interaction_id;
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  return static_cast<double>(h >> 11) * 0x1.0p-53 < rate;
+}
+
+uint64_t current() { return current_interaction; }
+
+void record(const char *name, uint64_t interaction_id, int64_t start_ns,
+            int64_t end_ns) {
+  thread_local buffer_lease lease;
+  thread_buffer &buffer = *lease.buffer;
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.events[buffer.next % buffer_size] = {name, interaction_id, start_ns,
+                                              end_ns};
+  buffer.next++;
+}
+
+interaction_scope::interaction_scope(uint64_t interaction_id)
+    : previous(current_interaction) {
+  current_interaction = sampled(interaction_id) ? interaction_id : 0;
+}
+
+interaction_scope::~interaction_scope() { current_interaction = previous; }
+
+std::string dump() {
+  std::vector<std::shared_ptr<thread_buffer>> buffers;
+  {
+    buffer_pool &pool = get_pool();
+    std::lock_guard<std::mutex> lock(pool.mutex);
+    buffers = pool.all;
+  }
+
+  fmt::memory_buffer out;
+  auto it = fmt::appender(out);
+  fmt::format_to(it, "{{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first{true};
+  for (const auto &buffer : buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    const size_t count = std::min(buffer->next, buffer_size);
+    for (size_t i = buffer->next - count; i < buffer->next; ++i) {
+      const event &e = buffer->events[i % buffer_size];
+      fmt::format_to(it,
+                     "{}{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                     "\"ts\":{:.3f},\"dur\":{:.3f},\"args\":{{"
+                     "\"interaction\":\"{}\"}}}}",
+                     first ? "" : ",", e.name, buffer->tid, e.start_ns / 1e3,
+                     (e.end_ns - e.start_ns) / 1e3, e.interaction);
+      first = false;
+    }
+  }
+  fmt::format_to(it, "]}}");
+  return fmt::to_string(out);
+}
+
+} // namespace trace
@@ -19,35 +19,110 @@
 #define _GNU_SOURCE
 #endif
 
+#include <chrono>
+#include <csignal>
 #include <cstdlib>
 #include <dpp/dpp.h>
+#include <fmt/format.h>
+#include <memory>
+#include <rps/domain/capture.h>
+#include <rps/domain/clock.h>
 #include <rps/domain/commandline.h>
 #include <rps/domain/config.h>
+#include <rps/domain/events.h>
 #include <rps/domain/game.h>
+#include <rps/domain/handoff.h>
+#include <rps/domain/http_sink.h>
+#include <rps/domain/journal.h>
 #include <rps/domain/lang.h>
 #include <rps/domain/listeners.h>
 #include <rps/domain/logger.h>
+#include <rps/domain/metrics.h>
+#include <rps/domain/outbound.h>
+#include <rps/domain/stats.h>
+#include <rps/domain/trace.h>
+#include <rps/domain/tournament.h>
+#include <thread>
 
 int main(int argc, char const *argv[]) {
+  /* SIGTERM starts a drain on its own thread. Block it before anything
+   * starts a thread, the logger included, so every thread inherits the mask
+   * and only sigwait() receives it. */
+  sigset_t drain_signals;
+  sigemptyset(&drain_signals);
+  sigaddset(&drain_signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &drain_signals, nullptr);
+
   (void)std::setlocale(LC_ALL, "en_US.UTF-8");
 
   config::init("config.json");
-  logger::init(config::get("log"));
+  const config::settings &settings = config::current();
+  logger::init(settings.log);
   commandline_config cli = commandline::parse(argc, argv);
 
-  auto token = cli.dev ? config::get("dev_token") : config::get("live_token");
+  const std::string &token =
+      cli.dev ? settings.dev_token : settings.live_token;
+
+  /* A local gateway stand in speaks uncompressed JSON on a single shard */
+  const bool local_gateway = !settings.gateway_host.empty();
 
-  dpp::cluster bot(token, dpp::i_guilds, config::get("shards"), cli.cluster_id,
-                   cli.max_clusters, true, dpp::cache_policy::cpol_none);
+  dpp::cluster bot(token, dpp::i_guilds,
+                   local_gateway && settings.shards == 0 ? 1 : settings.shards,
+                   cli.cluster_id, cli.max_clusters, !local_gateway,
+                   dpp::cache_policy::cpol_none, settings.request_threads,
+                   settings.request_threads_raw);
 
-  i18n::load_lang(bot);
+  const outbound::dm_cache_options dm_cache{
+      settings.dm_cache_size, std::chrono::seconds(settings.dm_cache_ttl)};
+  std::unique_ptr<outbound::sink> sink;
+  if (settings.api_url.empty()) {
+    sink = std::make_unique<outbound::cluster_sink>(bot, dm_cache);
+  } else {
+    sink = std::make_unique<outbound::http_sink>(bot, settings.api_url, token,
+                                                 dm_cache);
+  }
+  outbound::set(*sink);
+  timing::real_clock clock(bot);
+  timing::set(clock);
+  i18n::load_lang();
 
   if (cli.display_commands) {
     std::cerr << listeners::json_commands(bot) << "\n";
     exit(0);
   }
 
-  bot.set_websocket_protocol(dpp::ws_etf);
+  if (local_gateway) {
+    bot.default_gateway = settings.gateway_host;
+    bot.set_websocket_protocol(dpp::ws_json);
+  } else {
+    bot.set_websocket_protocol(dpp::ws_etf);
+  }
+
+  if (settings.metrics_port != 0) {
+    try {
+      metrics::add_page("/trace", "application/json", trace::dump);
+      metrics::serve(settings.metrics_port);
+    } catch (const std::exception &e) {
+      bot.log(dpp::ll_error, fmt::format("Metrics disabled: {}", e.what()));
+    }
+  }
+
+  if (!settings.capture_file.empty()) {
+    try {
+      capture::start(settings.capture_file);
+    } catch (const std::exception &e) {
+      bot.log(dpp::ll_error, fmt::format("Capture disabled: {}", e.what()));
+    }
+  }
+
+  /* Before game::init, so the journal opens with its session start */
+  if (!settings.journal_file.empty()) {
+    try {
+      journal::start(settings.journal_file);
+    } catch (const std::exception &e) {
+      bot.log(dpp::ll_error, fmt::format("Journal disabled: {}", e.what()));
+    }
+  }
 
   // security::init(bot);
 
@@ -56,9 +131,58 @@ int main(int argc, char const *argv[]) {
   bot.on_button_click(&listeners::on_buttonclick);
   bot.on_ready(&listeners::on_ready);
 
+  /* Event subscribers must be running before the game publishes */
+  events::subscribe_metrics();
+  stats::subscribe();
+  tournament::subscribe();
+
   /* Initialize game state */
-  game::init(bot);
+  game::init();
+
+  /* Resume the matches of the bot we are replacing, if it hands them over */
+  if (!settings.handoff_socket.empty()) {
+    try {
+      const auto start = std::chrono::steady_clock::now();
+      auto lobbies = handoff::receive(
+          settings.handoff_socket, std::chrono::seconds(settings.handoff_wait));
+      if (lobbies) {
+        const size_t received = lobbies->size();
+        const size_t resumed = game::restore(std::move(*lobbies));
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start);
+        bot.log(resumed == received ? dpp::ll_info : dpp::ll_warning,
+                fmt::format("Resumed {} of {} lobbies from predecessor in {}ms",
+                            resumed, received, elapsed.count()));
+      }
+    } catch (const std::exception &e) {
+      bot.log(dpp::ll_error, fmt::format("Handoff not received: {}", e.what()));
+    }
+  }
+
+  /* After the handoff, so matches whose lobbies came over are kept */
+  try {
+    tournament::start();
+  } catch (const std::exception &e) {
+    bot.log(dpp::ll_error,
+            fmt::format("Saved tournaments not loaded: {}", e.what()));
+  }
+
+  std::thread([&bot, drain_signals]() {
+    int signal{0};
+    if (sigwait(&drain_signals, &signal) == 0) {
+      handoff::drain(bot);
+    }
+  }).detach();
 
   /* Start bot */
   bot.start(dpp::st_wait);
+
+  /* Join the subscribers while what they write to is still alive; static
+   * destruction would otherwise run them against freed metrics and stats */
+  events::stop();
+
+  /* Write out the last actions before exiting */
+  tournament::stop();
+  journal::stop();
 }
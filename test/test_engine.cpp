@@ -0,0 +1,154 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Game engine state: the open lobby index, rounds, handover, and replaying
+ * journalled actions into a fresh engine.
+ */
+
+#include "check.h"
+#include <cstring>
+#include <rps/core/clock.h>
+#include <rps/core/engine.h>
+#include <rps/core/reducer.h>
+#include <string>
+#include <vector>
+
+namespace {
+
+using core::action;
+using core::action_type;
+using core::choice;
+
+void open_lobby_index() {
+  core::virtual_clock time;
+  core::engine e(time);
+  CHECK(e.find_open_lobby() == 0);
+  const core::lobby_id first = e.create_lobby();
+  const core::lobby_id second = e.create_lobby();
+  const core::lobby_id third = e.create_lobby();
+  CHECK(e.open_lobby_count() == 3);
+  /* The oldest open lobby fills first */
+  CHECK(e.find_open_lobby() == first);
+
+  CHECK(e.add_player(first, 1));
+  CHECK(e.find_open_lobby() == first);
+  CHECK(e.add_player(first, 2));
+  CHECK(e.find_open_lobby() == second);
+  CHECK(e.open_lobby_count() == 2);
+  /* A full lobby and a seated player are both refused */
+  CHECK(!e.add_player(first, 3));
+  CHECK(!e.add_player(second, 1));
+
+  CHECK(e.remove_lobby(second, false).has_value());
+  CHECK(e.find_open_lobby() == third);
+  CHECK(e.remove_lobby(first, true).has_value());
+  CHECK(e.find_player_lobby(1) == 0);
+  CHECK(e.open_lobby_count() == 1);
+  CHECK(e.lobby_count() == 1);
+}
+
+void handover_keeps_index() {
+  core::virtual_clock time;
+  core::engine e(time);
+  const core::lobby_id full = e.create_lobby();
+  e.add_player(full, 1);
+  e.add_player(full, 2);
+  const core::lobby_id waiting = e.create_lobby();
+  e.add_player(waiting, 3);
+
+  std::vector<core::lobby> released = e.release_all();
+  CHECK(released.size() == 2);
+  CHECK(e.lobby_count() == 0 && e.open_lobby_count() == 0);
+
+  core::engine successor(time);
+  for (core::lobby &l : released) {
+    CHECK(successor.restore(std::move(l)));
+  }
+  CHECK(successor.open_lobby_count() == 1);
+  CHECK(successor.find_open_lobby() == waiting);
+  CHECK(successor.find_player_lobby(2) == full);
+  /* Ids carry on after the adopted ones */
+  CHECK(successor.create_lobby() == waiting + 1);
+}
+
+void rounds_to_a_match() {
+  core::virtual_clock time;
+  core::engine e(time);
+  const core::lobby_id id = e.create_lobby();
+  e.add_player(id, 1);
+  e.add_player(id, 2);
+  e.set_choice(1, choice::rock);
+  CHECK(!e.resolve_round(id, 2).has_value());
+  e.set_choice(2, choice::scissors);
+  auto round = e.resolve_round(id, 2);
+  CHECK(round && round->result == core::outcome::player_one);
+  CHECK(round && !round->match_over);
+  CHECK(e.get_choice(1) == choice::none);
+
+  e.set_choice(1, choice::paper);
+  e.set_choice(2, choice::rock);
+  round = e.resolve_round(id, 2);
+  CHECK(round && round->match_over);
+  CHECK(round && round->state.players[0].score == 2);
+}
+
+void journal_replay() {
+  core::virtual_clock time;
+  core::engine live(time);
+  std::string journal;
+  const auto apply = [&](action a) {
+    /* Journalled as is, like the journal file */
+    journal.append(reinterpret_cast<const char *>(&a), sizeof(a));
+    return core::reduce(live, a);
+  };
+  const core::lobby_id id =
+      apply({.type = action_type::create_lobby}).created;
+  apply({.players = {1}, .lobby = id, .type = action_type::add_player});
+  apply({.players = {2}, .lobby = id, .type = action_type::add_player});
+  apply({.players = {1}, .type = action_type::set_choice,
+         .picks = {choice::paper}});
+  apply({.players = {2}, .type = action_type::set_choice,
+         .picks = {choice::rock}});
+  apply({.lobby = id, .argument = 3, .type = action_type::resolve_round});
+  apply({.type = action_type::create_lobby});
+  apply({.players = {3}, .lobby = id + 1, .type = action_type::add_player});
+
+  core::engine replayed(time);
+  CHECK(journal.size() % sizeof(action) == 0);
+  for (size_t at = 0; at < journal.size(); at += sizeof(action)) {
+    action a;
+    std::memcpy(&a, journal.data() + at, sizeof(a));
+    core::reduce(replayed, a);
+  }
+  CHECK(replayed.lobby_count() == live.lobby_count());
+  CHECK(replayed.find_open_lobby() == id + 1);
+  CHECK(replayed.find_player_lobby(3) == id + 1);
+  const core::lobby *l = replayed.find(id);
+  CHECK(l != nullptr && l->players[0].score == 1 && l->game_number == 2);
+}
+
+} // namespace
+
+int main() {
+  open_lobby_index();
+  handover_keeps_index();
+  rounds_to_a_match();
+  journal_replay();
+  return failures == 0 ? 0 : 1;
+}
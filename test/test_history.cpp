@@ -0,0 +1,131 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Match history aggregates: round counts, picks and match streaks.
+ */
+
+#include "check.h"
+#include <rps/core/history.h>
+
+namespace {
+
+using core::choice;
+using core::outcome;
+
+constexpr uint64_t alice = 1001;
+constexpr uint64_t bob = 1002;
+constexpr uint64_t carol = 1003;
+
+/**
+ * @brief Play a one round match that the first player wins or loses
+ */
+void match(core::history &h, uint64_t player, uint64_t opponent, bool won,
+           double time) {
+  h.record_round({player, opponent}, {choice::rock, choice::scissors},
+                 won ? outcome::player_one : outcome::player_two, time);
+  h.end_match();
+}
+
+void round_counts() {
+  core::history h(1000);
+  h.record_round({alice, bob}, {choice::rock, choice::scissors},
+                 outcome::player_one, 10);
+  h.record_round({alice, bob}, {choice::paper, choice::paper}, outcome::draw,
+                 11);
+  h.record_round({bob, alice}, {choice::none, choice::none}, outcome::forfeit,
+                 12);
+  CHECK(h.rows() == 6);
+
+  const core::player_stats a = h.stats(alice);
+  CHECK(a.rounds == 3);
+  CHECK(a.wins == 1);
+  CHECK(a.draws == 1);
+  /* A round nobody picked in is lost by both */
+  CHECK(a.losses == 1);
+  CHECK(a.picks[static_cast<size_t>(choice::rock)] == 1);
+  CHECK(a.picks[static_cast<size_t>(choice::none)] == 1);
+  CHECK(a.last_played == 12);
+  CHECK(a.matches == 0);
+
+  const core::player_stats b = h.stats(bob);
+  CHECK(b.wins == 0);
+  CHECK(b.losses == 2);
+  CHECK(h.stats(carol).rounds == 0);
+}
+
+void streaks() {
+  core::history h(1000);
+  const bool results[] = {true, true, false, true, true, true};
+  double time{0};
+  for (const bool won : results) {
+    match(h, alice, bob, won, ++time);
+  }
+  core::player_stats a = h.stats(alice);
+  CHECK(a.matches == 6);
+  CHECK(a.matches_won == 5);
+  CHECK(a.longest_win_streak == 3);
+  CHECK(a.current_streak == 3);
+
+  match(h, alice, bob, false, ++time);
+  match(h, alice, bob, false, ++time);
+  a = h.stats(alice);
+  CHECK(a.current_streak == -2);
+  CHECK(a.longest_win_streak == 3);
+  CHECK(h.stats(bob).current_streak == 2);
+}
+
+void deciding_round_decides() {
+  core::history h(1000);
+  /* Only the last round of a match counts towards matches */
+  h.record_round({alice, bob}, {choice::rock, choice::scissors},
+                 outcome::player_one, 1);
+  h.record_round({alice, bob}, {choice::rock, choice::paper},
+                 outcome::player_two, 2);
+  h.end_match();
+  const core::player_stats a = h.stats(alice);
+  CHECK(a.rounds == 2);
+  CHECK(a.matches == 1);
+  CHECK(a.matches_won == 0);
+  CHECK(a.current_streak == -1);
+}
+
+void versus_one_opponent() {
+  core::history h(1000);
+  match(h, alice, bob, true, 1);
+  match(h, alice, carol, false, 2);
+  match(h, alice, bob, true, 3);
+  const core::player_stats ab = h.versus(alice, bob);
+  CHECK(ab.matches == 2);
+  CHECK(ab.current_streak == 2);
+  const core::player_stats ac = h.versus(alice, carol);
+  CHECK(ac.matches == 1);
+  CHECK(ac.current_streak == -1);
+  CHECK(h.versus(bob, carol).rounds == 0);
+  CHECK(h.stats(alice).current_streak == 1);
+}
+
+} // namespace
+
+int main() {
+  round_counts();
+  streaks();
+  deciding_round_decides();
+  versus_one_opponent();
+  return failures == 0 ? 0 : 1;
+}
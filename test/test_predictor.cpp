@@ -0,0 +1,90 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * The pick predictor: contexts of recent picks, and players sharing a table.
+ */
+
+#include "check.h"
+#include <rps/core/predictor.h>
+
+namespace {
+
+using core::choice;
+
+void unknown_player() {
+  core::predictor p(64);
+  CHECK(p.predict(42) == choice::none);
+  p.observe(42, choice::none);
+  CHECK(p.predict(42) == choice::none);
+}
+
+void favourite_pick() {
+  core::predictor p(64);
+  p.observe(7, choice::rock);
+  /* One sighting is not a favourite */
+  CHECK(p.predict(7) == choice::none);
+  for (int i = 0; i < 5; ++i) {
+    p.observe(7, choice::rock);
+  }
+  CHECK(p.predict(7) == choice::rock);
+}
+
+void follows_a_cycle() {
+  core::predictor p(64);
+  const choice cycle[] = {choice::rock, choice::paper, choice::scissors};
+  for (int i = 0; i < 30; ++i) {
+    p.observe(9, cycle[i % 3]);
+  }
+  /* Overall counts tie, so only the recent context can decide */
+  CHECK(p.predict(9) == choice::rock);
+  p.observe(9, choice::rock);
+  CHECK(p.predict(9) == choice::paper);
+}
+
+void picks_past_the_variant() {
+  core::predictor p(64, 3);
+  for (int i = 0; i < 5; ++i) {
+    p.observe(3, choice::spock);
+  }
+  CHECK(p.predict(3) == choice::none);
+}
+
+void evicted_player_starts_over() {
+  /* One model: each new player replaces the last */
+  core::predictor p(1);
+  for (int i = 0; i < 5; ++i) {
+    p.observe(1, choice::paper);
+  }
+  p.observe(2, choice::rock);
+  CHECK(p.predict(1) == choice::none);
+  CHECK(p.predict(2) == choice::none);
+  p.observe(2, choice::rock);
+  CHECK(p.predict(2) == choice::rock);
+}
+
+} // namespace
+
+int main() {
+  unknown_player();
+  favourite_pick();
+  follows_a_cycle();
+  picks_past_the_variant();
+  evicted_player_starts_over();
+  return failures == 0 ? 0 : 1;
+}
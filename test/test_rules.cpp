@@ -0,0 +1,118 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Outcome tables of the built in variants and of variants built at runtime.
+ */
+
+#include "check.h"
+#include <rps/core/rules.h>
+#include <stdexcept>
+
+namespace {
+
+using core::choice;
+using core::outcome;
+
+void classic_table() {
+  const core::variant &v = core::classic;
+  const choice rock = v.parse("Rock");
+  const choice paper = v.parse("Paper");
+  const choice scissors = v.parse("Scissors");
+  CHECK(v.size() == 3);
+  CHECK(v.complete());
+  CHECK(v.resolve(rock, scissors) == outcome::player_one);
+  CHECK(v.resolve(scissors, rock) == outcome::player_two);
+  CHECK(v.resolve(paper, rock) == outcome::player_one);
+  CHECK(v.resolve(scissors, paper) == outcome::player_one);
+  for (const choice c : {rock, paper, scissors}) {
+    CHECK(v.resolve(c, c) == outcome::draw);
+    /* A player who picked beats one who did not */
+    CHECK(v.resolve(c, choice::none) == outcome::player_one);
+    CHECK(v.resolve(choice::none, c) == outcome::player_two);
+  }
+  CHECK(v.resolve(choice::none, choice::none) == outcome::forfeit);
+  CHECK(v.counter(rock) == paper);
+  CHECK(v.counter(choice::none) == choice::none);
+}
+
+void rpsls_table() {
+  const core::variant &v = core::rpsls;
+  CHECK(v.size() == 5);
+  CHECK(v.complete());
+  /* Every choice beats exactly two others */
+  for (uint8_t a = 1; a <= 5; ++a) {
+    int beaten{0};
+    for (uint8_t b = 1; b <= 5; ++b) {
+      beaten += v.resolve(static_cast<choice>(a), static_cast<choice>(b)) ==
+                outcome::player_one;
+    }
+    CHECK(beaten == 2);
+  }
+  CHECK(v.resolve(v.parse("Spock"), v.parse("Rock")) == outcome::player_one);
+  CHECK(v.resolve(v.parse("Lizard"), v.parse("Spock")) == outcome::player_one);
+}
+
+void out_of_range_picks() {
+  const core::variant &v = core::classic;
+  /* Choices past the variant, and values past max_choices, count as none */
+  const auto unused = static_cast<choice>(4);
+  const auto garbage = static_cast<choice>(200);
+  CHECK(!v.valid(unused));
+  CHECK(!v.valid(garbage));
+  CHECK(v.resolve(v.parse("Rock"), unused) == outcome::player_one);
+  CHECK(v.resolve(garbage, v.parse("Rock")) == outcome::player_two);
+  CHECK(v.resolve(garbage, unused) == outcome::forfeit);
+}
+
+void runtime_variant() {
+  core::variant v{"duel", 2, 10};
+  const choice sword = v.add("Sword", ":crossed_swords:");
+  const choice shield = v.add("Shield", ":shield:");
+  CHECK(!v.complete());
+  CHECK(v.resolve(sword, shield) == outcome::draw);
+  v.beats(sword, shield);
+  CHECK(v.complete());
+  CHECK(v.resolve(sword, shield) == outcome::player_one);
+  CHECK(v.name_of(shield) == "Shield");
+
+  bool threw{false};
+  try {
+    v.beats(shield, sword);
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  CHECK(threw);
+  threw = false;
+  try {
+    v.add("Sword", "");
+  } catch (const std::invalid_argument &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+} // namespace
+
+int main() {
+  classic_table();
+  rpsls_table();
+  out_of_range_picks();
+  runtime_variant();
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/************************************************************************************
+ *
+ * Copyright 2024 tarolling
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ ************************************************************************************/
+
+/**
+ * Tournament brackets: elimination routing with byes, the double elimination
+ * grand final and its reset, Swiss pairing and tie breaks, and saved state.
+ */
+
+#include "check.h"
+#include <rps/core/tournament.h>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+
+using core::bracket_side;
+using core::match_state;
+using core::tournament;
+using core::tournament_format;
+
+const std::vector<core::player_id> four{11, 12, 13, 14};
+
+/**
+ * @brief Play a ready match to a result
+ */
+bool play(tournament &t, uint32_t match, int seat) {
+  t.start(match, match + 1);
+  return t.report(match, seat);
+}
+
+/**
+ * @brief The only ready match, checked to be on the expected side
+ */
+uint32_t only_ready(const tournament &t, bracket_side side) {
+  const std::vector<uint32_t> ready = t.ready();
+  CHECK(ready.size() == 1);
+  if (ready.empty()) {
+    return 0;
+  }
+  CHECK(t.matches()[ready[0]].side == side);
+  return ready[0];
+}
+
+void single_elimination_seeding() {
+  tournament t(tournament_format::single_elimination, four);
+  const auto &m = t.matches();
+  CHECK(m.size() == 3);
+  /* 1 v 4 and 2 v 3, so the top seeds meet in the final */
+  CHECK(m[0].seats[0] == 0 && m[0].seats[1] == 3);
+  CHECK(m[1].seats[0] == 1 && m[1].seats[1] == 2);
+  CHECK(t.ready() == std::vector<uint32_t>({0, 1}));
+
+  /* A draw goes to the higher seed */
+  CHECK(play(t, 0, -1));
+  CHECK(m[0].winner == 0);
+  CHECK(play(t, 1, 1));
+  CHECK(m[2].seats[0] == 0 && m[2].seats[1] == 2);
+  CHECK(play(t, 2, 1));
+  CHECK(t.finished());
+  const auto standings = t.standings();
+  CHECK(standings[0].entrant == 2 && !standings[0].eliminated);
+  CHECK(standings[1].entrant == 0);
+  CHECK(!play(t, 2, 0));
+}
+
+void double_elimination_with_bye_and_reset() {
+  /* Three entrants fill a bracket of four: seed 1 has a bye */
+  tournament t(tournament_format::double_elimination, {11, 12, 13});
+  const auto &m = t.matches();
+  CHECK(m[0].state == match_state::done && m[0].winner == 0);
+
+  const uint32_t semi = only_ready(t, bracket_side::winners);
+  CHECK(m[semi].seats[0] == 1 && m[semi].seats[1] == 2);
+  CHECK(play(t, semi, 0));
+
+  /* The bye's place in the losers bracket passes seed 3 straight through */
+  const uint32_t final = only_ready(t, bracket_side::winners);
+  CHECK(m[final].seats[0] == 0 && m[final].seats[1] == 1);
+  CHECK(play(t, final, 1));
+
+  const uint32_t losers_final = only_ready(t, bracket_side::losers);
+  CHECK(m[losers_final].seats[0] == 2 && m[losers_final].seats[1] == 0);
+  CHECK(play(t, losers_final, 1));
+
+  const uint32_t grand_final = only_ready(t, bracket_side::grand_final);
+  CHECK(m[grand_final].seats[0] == 1 && m[grand_final].seats[1] == 0);
+  /* The losers bracket finalist wins, so the two play again */
+  CHECK(play(t, grand_final, 1));
+  CHECK(!t.finished());
+  const uint32_t reset = only_ready(t, bracket_side::reset);
+  CHECK(reset == grand_final + 1);
+  CHECK(play(t, reset, 0));
+  CHECK(t.finished());
+
+  const auto standings = t.standings();
+  CHECK(standings[0].entrant == 1 && !standings[0].eliminated);
+  CHECK(standings[1].entrant == 0 && standings[1].eliminated);
+  CHECK(standings[2].entrant == 2 && standings[2].eliminated);
+}
+
+void grand_final_without_reset() {
+  tournament t(tournament_format::double_elimination, {11, 12});
+  const uint32_t final = only_ready(t, bracket_side::winners);
+  CHECK(play(t, final, 0));
+  const uint32_t grand_final = only_ready(t, bracket_side::grand_final);
+  /* The unbeaten finalist wins outright */
+  CHECK(play(t, grand_final, 0));
+  CHECK(t.finished());
+  CHECK(t.matches()[grand_final + 1].state == match_state::done);
+  CHECK(t.standings()[0].entrant == 0);
+}
+
+void swiss_pairing_and_buchholz() {
+  tournament t(tournament_format::swiss, four);
+  CHECK(t.rounds() == 2);
+  const auto &m = t.matches();
+  /* Top half of the group meets the bottom half */
+  CHECK(m.size() == 2);
+  CHECK(m[0].seats[0] == 0 && m[0].seats[1] == 2);
+  CHECK(m[1].seats[0] == 1 && m[1].seats[1] == 3);
+  CHECK(play(t, 0, 0));
+  CHECK(play(t, 1, 0));
+
+  /* Round two pairs within score groups */
+  CHECK(m.size() == 4);
+  CHECK(m[2].round == 2 && m[2].seats[0] == 0 && m[2].seats[1] == 1);
+  CHECK(m[3].seats[0] == 2 && m[3].seats[1] == 3);
+  CHECK(play(t, 2, 0));
+  CHECK(!t.finished());
+  CHECK(play(t, 3, -1));
+  CHECK(t.finished());
+
+  const auto standings = t.standings();
+  CHECK(standings[0].entrant == 0 && standings[0].points == 4);
+  CHECK(standings[1].entrant == 1 && standings[1].points == 2);
+  /* Level on a draw each; the harder schedule ranks higher */
+  CHECK(standings[2].entrant == 2 && standings[2].buchholz == 5);
+  CHECK(standings[3].entrant == 3 && standings[3].buchholz == 3);
+  CHECK(standings[2].points == 1 && standings[3].points == 1);
+}
+
+void swiss_byes_and_rematches() {
+  tournament t(tournament_format::swiss, {11, 12, 13});
+  const auto &m = t.matches();
+  /* The lowest ranked entrant sits out with a bye worth a win */
+  CHECK(m[0].seats[0] == 2 && m[0].seats[1] == core::bye);
+  CHECK(m[0].state == match_state::done);
+  CHECK(play(t, 1, 0));
+
+  CHECK(m.size() == 4);
+  /* Nobody sits out twice, and nobody meets the same opponent again */
+  CHECK(m[2].seats[0] == 1 && m[2].seats[1] == core::bye);
+  CHECK(m[3].seats[0] == 0 && m[3].seats[1] == 2);
+  CHECK(play(t, 3, 1));
+  CHECK(t.finished());
+  const auto standings = t.standings();
+  CHECK(standings[0].entrant == 2 && standings[0].points == 4);
+}
+
+void restart_lost_match() {
+  tournament t(tournament_format::single_elimination, four);
+  t.start(0, 5);
+  CHECK(t.matches()[0].state == match_state::playing);
+  t.restart(0);
+  CHECK(t.matches()[0].state == match_state::ready);
+  CHECK(t.matches()[0].lobby == 0);
+  CHECK(!t.report(0, 0));
+}
+
+void encode_round_trip() {
+  tournament t(tournament_format::double_elimination, {11, 12, 13, 14, 15});
+  const std::vector<uint32_t> first = t.ready();
+  CHECK(play(t, first[0], 1));
+  t.start(first[1], 99);
+
+  tournament copy = tournament::decode(t.encode());
+  CHECK(copy.encode() == t.encode());
+  CHECK(copy.format() == tournament_format::double_elimination);
+  CHECK(copy.entrant_count() == 5);
+  CHECK(copy.entrant(4) == 15);
+  CHECK(copy.matches()[first[1]].lobby == 99);
+  CHECK(copy.ready() == t.ready());
+
+  /* Both carry on the same way */
+  while (!t.finished()) {
+    for (const uint32_t match : t.ready()) {
+      t.start(match, match + 1);
+    }
+    for (uint32_t match = 0; match < t.matches().size(); ++match) {
+      if (t.matches()[match].state == match_state::playing) {
+        copy.start(match, t.matches()[match].lobby);
+        CHECK(t.report(match, 0) == copy.report(match, 0));
+      }
+    }
+  }
+  CHECK(copy.finished());
+  CHECK(copy.encode() == t.encode());
+
+  tournament swiss(tournament_format::swiss, four, 3);
+  CHECK(play(swiss, 0, -1));
+  CHECK(tournament::decode(swiss.encode()).encode() == swiss.encode());
+
+  const std::string state = t.encode();
+  bool threw{false};
+  try {
+    (void)tournament::decode(state.substr(0, state.size() / 2));
+  } catch (const std::runtime_error &) {
+    threw = true;
+  }
+  CHECK(threw);
+}
+
+} // namespace
+
+int main() {
+  single_elimination_seeding();
+  double_elimination_with_bye_and_reset();
+  grand_final_without_reset();
+  swiss_pairing_and_buchholz();
+  swiss_byes_and_rematches();
+  restart_lost_match();
+  encode_round_trip();
+  return failures == 0 ? 0 : 1;
+}